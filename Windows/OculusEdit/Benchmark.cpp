@@ -0,0 +1,716 @@
+//
+//  Benchmark.cpp
+//  OculusEdit
+//
+
+#include "Benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "OVR_CAPI.h"
+#include "ClientDistortion.h"
+#include "EyeRenderTarget.h"
+#include "HiddenArea.h"
+#include "MultiResolution.h"
+#include "StereoReprojection.h"
+#include "Scene.h"
+#include "SceneShadows.h"
+#include "ShaderCache.h"
+
+BenchmarkState g_Benchmark;
+
+bool ParseBenchmarkArguments(int p_Argc, const char* p_Argv[])
+{
+	g_Benchmark.Settings.Enabled = false;
+#if defined(__linux__)
+	g_Benchmark.Settings.Headless = true;
+#else
+	g_Benchmark.Settings.Headless = false; // No offscreen context support here yet, use a hidden window...
+#endif
+	g_Benchmark.Settings.FrameCount = 0;
+	g_Benchmark.Settings.WarmupFrames = 30;
+	g_Benchmark.Settings.OutputPath = "benchmark.json";
+	g_Benchmark.Settings.TracePath.clear();
+	g_Benchmark.Settings.SinglePassStereo = true;
+	g_Benchmark.Settings.LateLatch = true;
+	g_Benchmark.Settings.DynamicResolution = true;
+	g_Benchmark.Settings.GpuBudgetMs = 10.0;
+	g_Benchmark.Settings.EyeBufferCount = 3;
+	g_Benchmark.Settings.MsaaSamples = 4;
+	g_Benchmark.Settings.ShaderCachePath = "shadercache";
+	g_Benchmark.Settings.ShaderDirectory = "";
+	g_Benchmark.Settings.Instancing = true;
+	g_Benchmark.Settings.GpuCulling = true;
+	g_Benchmark.Settings.BvhCulling = true;
+	g_Benchmark.Settings.HiddenArea = true;
+	g_Benchmark.Settings.ClientDistortion = false;
+	g_Benchmark.Settings.DistortionCachePath = "distortioncache";
+	g_Benchmark.Settings.MultiResolution = false;
+	g_Benchmark.Settings.MultiResCenter = 0.6f;
+	g_Benchmark.Settings.MultiResDensity = 0.5f;
+	g_Benchmark.Settings.StereoReprojection = false;
+	g_Benchmark.Settings.ReprojectionSplit = 5.0f;
+	g_Benchmark.Settings.Shadows = false;
+	g_Benchmark.Settings.ShadowMapSize = 2048;
+	g_Benchmark.Settings.PointLights = 0;
+	g_Benchmark.Settings.DepthPrePass = false;
+	g_Benchmark.Settings.ReverseZ = false;
+	g_Benchmark.Settings.FarPlane = 100.0f;
+	g_Benchmark.Settings.Occlusion = false;
+	g_Benchmark.Settings.CubeCounts.clear();
+	g_Benchmark.FramesRun = 0;
+	g_Benchmark.Stage = 0;
+	g_Benchmark.StageFramesRun = 0;
+	g_Benchmark.FrameStartTime = 0.0;
+	g_Benchmark.SubmitEndTime = 0.0;
+
+	// Launchers and IDEs pass arguments of their own, they only matter to a benchmark run...
+	const char* l_Unknown = NULL;
+	for (int i = 1; i < p_Argc; i++)
+	{
+		const bool l_HasValue = (i + 1 < p_Argc);
+
+		if (strcmp(p_Argv[i], "--benchmark") == 0 && l_HasValue)
+		{
+			g_Benchmark.Settings.Enabled = true;
+			g_Benchmark.Settings.FrameCount = (unsigned int)atoi(p_Argv[++i]);
+		}
+		else if (strcmp(p_Argv[i], "--benchmark-out") == 0 && l_HasValue)
+		{
+			g_Benchmark.Settings.OutputPath = p_Argv[++i];
+		}
+		else if (strcmp(p_Argv[i], "--benchmark-warmup") == 0 && l_HasValue)
+		{
+			g_Benchmark.Settings.WarmupFrames = (unsigned int)atoi(p_Argv[++i]);
+		}
+		else if (strcmp(p_Argv[i], "--trace") == 0 && l_HasValue)
+		{
+			g_Benchmark.Settings.TracePath = p_Argv[++i];
+		}
+		else if (strcmp(p_Argv[i], "--stereo") == 0 && l_HasValue)
+		{
+			++i;
+			if (strcmp(p_Argv[i], "single") == 0)
+			{
+				g_Benchmark.Settings.SinglePassStereo = true;
+			}
+			else if (strcmp(p_Argv[i], "multi") == 0)
+			{
+				g_Benchmark.Settings.SinglePassStereo = false;
+			}
+			else
+			{
+				printf("--stereo expects single or multi, got %s\n", p_Argv[i]);
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--late-latch") == 0 && l_HasValue)
+		{
+			++i;
+			if (strcmp(p_Argv[i], "on") == 0)
+			{
+				g_Benchmark.Settings.LateLatch = true;
+			}
+			else if (strcmp(p_Argv[i], "off") == 0)
+			{
+				g_Benchmark.Settings.LateLatch = false;
+			}
+			else
+			{
+				printf("--late-latch expects on or off, got %s\n", p_Argv[i]);
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--dynamic-resolution") == 0 && l_HasValue)
+		{
+			++i;
+			if (strcmp(p_Argv[i], "on") == 0)
+			{
+				g_Benchmark.Settings.DynamicResolution = true;
+			}
+			else if (strcmp(p_Argv[i], "off") == 0)
+			{
+				g_Benchmark.Settings.DynamicResolution = false;
+			}
+			else
+			{
+				printf("--dynamic-resolution expects on or off, got %s\n", p_Argv[i]);
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--gpu-budget") == 0 && l_HasValue)
+		{
+			g_Benchmark.Settings.GpuBudgetMs = atof(p_Argv[++i]);
+			if (g_Benchmark.Settings.GpuBudgetMs <= 0.0)
+			{
+				printf("--gpu-budget needs a time in milliseconds greater than zero.\n");
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--eye-buffers") == 0 && l_HasValue)
+		{
+			const int l_Count = atoi(p_Argv[++i]);
+			if (l_Count < 1 || l_Count > 3)
+			{
+				printf("--eye-buffers needs a count from 1 to 3.\n");
+				return false;
+			}
+			g_Benchmark.Settings.EyeBufferCount = (unsigned int)l_Count;
+		}
+		else if (strcmp(p_Argv[i], "--msaa") == 0 && l_HasValue)
+		{
+			const int l_Samples = atoi(p_Argv[++i]);
+			if (l_Samples != 1 && l_Samples != 2 && l_Samples != 4 && l_Samples != 8)
+			{
+				printf("--msaa needs a sample count of 1, 2, 4 or 8.\n");
+				return false;
+			}
+			g_Benchmark.Settings.MsaaSamples = (unsigned int)l_Samples;
+		}
+		else if (strcmp(p_Argv[i], "--shader-cache") == 0 && l_HasValue)
+		{
+			++i;
+			g_Benchmark.Settings.ShaderCachePath = (strcmp(p_Argv[i], "off") == 0) ? "" : p_Argv[i];
+		}
+		else if (strcmp(p_Argv[i], "--shader-dir") == 0 && l_HasValue)
+		{
+			++i;
+			g_Benchmark.Settings.ShaderDirectory = p_Argv[i];
+		}
+		else if (strcmp(p_Argv[i], "--instancing") == 0 && l_HasValue)
+		{
+			++i;
+			if (strcmp(p_Argv[i], "on") == 0)
+			{
+				g_Benchmark.Settings.Instancing = true;
+			}
+			else if (strcmp(p_Argv[i], "off") == 0)
+			{
+				g_Benchmark.Settings.Instancing = false;
+			}
+			else
+			{
+				printf("--instancing expects on or off, got %s\n", p_Argv[i]);
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--gpu-culling") == 0 && l_HasValue)
+		{
+			++i;
+			if (strcmp(p_Argv[i], "on") == 0)
+			{
+				g_Benchmark.Settings.GpuCulling = true;
+			}
+			else if (strcmp(p_Argv[i], "off") == 0)
+			{
+				g_Benchmark.Settings.GpuCulling = false;
+			}
+			else
+			{
+				printf("--gpu-culling expects on or off, got %s\n", p_Argv[i]);
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--bvh-culling") == 0 && l_HasValue)
+		{
+			++i;
+			if (strcmp(p_Argv[i], "on") == 0)
+			{
+				g_Benchmark.Settings.BvhCulling = true;
+			}
+			else if (strcmp(p_Argv[i], "off") == 0)
+			{
+				g_Benchmark.Settings.BvhCulling = false;
+			}
+			else
+			{
+				printf("--bvh-culling expects on or off, got %s\n", p_Argv[i]);
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--hidden-area") == 0 && l_HasValue)
+		{
+			++i;
+			if (strcmp(p_Argv[i], "on") == 0)
+			{
+				g_Benchmark.Settings.HiddenArea = true;
+			}
+			else if (strcmp(p_Argv[i], "off") == 0)
+			{
+				g_Benchmark.Settings.HiddenArea = false;
+			}
+			else
+			{
+				printf("--hidden-area expects on or off, got %s\n", p_Argv[i]);
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--distortion") == 0 && l_HasValue)
+		{
+			++i;
+			if (strcmp(p_Argv[i], "sdk") == 0)
+			{
+				g_Benchmark.Settings.ClientDistortion = false;
+			}
+			else if (strcmp(p_Argv[i], "client") == 0)
+			{
+				g_Benchmark.Settings.ClientDistortion = true;
+			}
+			else
+			{
+				printf("--distortion expects sdk or client, got %s\n", p_Argv[i]);
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--distortion-cache") == 0 && l_HasValue)
+		{
+			++i;
+			g_Benchmark.Settings.DistortionCachePath = (strcmp(p_Argv[i], "off") == 0) ? "" : p_Argv[i];
+		}
+		else if (strcmp(p_Argv[i], "--multires") == 0 && l_HasValue)
+		{
+			++i;
+			float l_Center, l_Density;
+			if (strcmp(p_Argv[i], "off") == 0)
+			{
+				g_Benchmark.Settings.MultiResolution = false;
+			}
+			else if (strcmp(p_Argv[i], "on") == 0)
+			{
+				g_Benchmark.Settings.MultiResolution = true;
+			}
+			else if (sscanf(p_Argv[i], "%f,%f", &l_Center, &l_Density) == 2 &&
+				l_Center > 0.0f && l_Center <= 1.0f &&
+				l_Density >= MULTI_RESOLUTION_MIN_DENSITY && l_Density <= MULTI_RESOLUTION_MAX_DENSITY)
+			{
+				g_Benchmark.Settings.MultiResolution = true;
+				g_Benchmark.Settings.MultiResCenter = l_Center;
+				g_Benchmark.Settings.MultiResDensity = l_Density;
+			}
+			else
+			{
+				printf("--multires expects off, on or <center>,<density> (center 0 to 1, density %.2f to %.2f), got %s\n",
+					MULTI_RESOLUTION_MIN_DENSITY, MULTI_RESOLUTION_MAX_DENSITY, p_Argv[i]);
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--reprojection") == 0 && l_HasValue)
+		{
+			++i;
+			float l_Split;
+			if (strcmp(p_Argv[i], "off") == 0)
+			{
+				g_Benchmark.Settings.StereoReprojection = false;
+			}
+			else if (strcmp(p_Argv[i], "on") == 0)
+			{
+				g_Benchmark.Settings.StereoReprojection = true;
+			}
+			else if (sscanf(p_Argv[i], "%f", &l_Split) == 1 &&
+				l_Split >= STEREO_REPROJECTION_MIN_SPLIT && l_Split <= STEREO_REPROJECTION_MAX_SPLIT)
+			{
+				g_Benchmark.Settings.StereoReprojection = true;
+				g_Benchmark.Settings.ReprojectionSplit = l_Split;
+			}
+			else
+			{
+				printf("--reprojection expects off, on or the split distance in meters (%.0f to %.0f), got %s\n",
+					STEREO_REPROJECTION_MIN_SPLIT, STEREO_REPROJECTION_MAX_SPLIT, p_Argv[i]);
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--shadows") == 0 && l_HasValue)
+		{
+			++i;
+			int l_Size;
+			if (strcmp(p_Argv[i], "off") == 0)
+			{
+				g_Benchmark.Settings.Shadows = false;
+			}
+			else if (strcmp(p_Argv[i], "on") == 0)
+			{
+				g_Benchmark.Settings.Shadows = true;
+			}
+			else if (sscanf(p_Argv[i], "%d", &l_Size) == 1 &&
+				l_Size >= SCENE_SHADOW_MIN_SIZE && l_Size <= SCENE_SHADOW_MAX_SIZE)
+			{
+				g_Benchmark.Settings.Shadows = true;
+				g_Benchmark.Settings.ShadowMapSize = l_Size;
+			}
+			else
+			{
+				printf("--shadows expects on, off or the shadow map size (%d to %d), got %s\n",
+					SCENE_SHADOW_MIN_SIZE, SCENE_SHADOW_MAX_SIZE, p_Argv[i]);
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--lights") == 0 && l_HasValue)
+		{
+			++i;
+			int l_Count;
+			if (sscanf(p_Argv[i], "%d", &l_Count) != 1 || l_Count < 0 || l_Count > 65536)
+			{
+				printf("--lights needs a count from 0 to 65536, got %s\n", p_Argv[i]);
+				return false;
+			}
+			g_Benchmark.Settings.PointLights = (unsigned int)l_Count;
+		}
+		else if (strcmp(p_Argv[i], "--depth-prepass") == 0 && l_HasValue)
+		{
+			++i;
+			if (strcmp(p_Argv[i], "on") == 0)
+			{
+				g_Benchmark.Settings.DepthPrePass = true;
+			}
+			else if (strcmp(p_Argv[i], "off") == 0)
+			{
+				g_Benchmark.Settings.DepthPrePass = false;
+			}
+			else
+			{
+				printf("--depth-prepass expects on or off, got %s\n", p_Argv[i]);
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--reverse-z") == 0 && l_HasValue)
+		{
+			++i;
+			if (strcmp(p_Argv[i], "on") == 0)
+			{
+				g_Benchmark.Settings.ReverseZ = true;
+			}
+			else if (strcmp(p_Argv[i], "off") == 0)
+			{
+				g_Benchmark.Settings.ReverseZ = false;
+			}
+			else
+			{
+				printf("--reverse-z expects on or off, got %s\n", p_Argv[i]);
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--far") == 0 && l_HasValue)
+		{
+			const float l_Far = (float)atof(p_Argv[++i]);
+			if (l_Far < 1.0f || l_Far > 100000.0f)
+			{
+				printf("--far needs a distance from 1 to 100000 meters.\n");
+				return false;
+			}
+			g_Benchmark.Settings.FarPlane = l_Far;
+		}
+		else if (strcmp(p_Argv[i], "--occlusion") == 0 && l_HasValue)
+		{
+			++i;
+			if (strcmp(p_Argv[i], "on") == 0)
+			{
+				g_Benchmark.Settings.Occlusion = true;
+			}
+			else if (strcmp(p_Argv[i], "off") == 0)
+			{
+				g_Benchmark.Settings.Occlusion = false;
+			}
+			else
+			{
+				printf("--occlusion expects on or off, got %s\n", p_Argv[i]);
+				return false;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--cubes") == 0 && l_HasValue)
+		{
+			// Comma separated counts...
+			const char* l_Count = p_Argv[++i];
+			while (*l_Count)
+			{
+				char* l_End;
+				const long l_Value = strtol(l_Count, &l_End, 10);
+				if (l_End == l_Count || l_Value < 0 || (*l_End != ',' && *l_End != '\0'))
+				{
+					printf("--cubes expects a comma separated list of counts, got %s\n", p_Argv[i]);
+					return false;
+				}
+				g_Benchmark.Settings.CubeCounts.push_back((unsigned int)l_Value);
+				l_Count = (*l_End == ',') ? l_End + 1 : l_End;
+			}
+		}
+		else if (strcmp(p_Argv[i], "--windowed") == 0)
+		{
+			g_Benchmark.Settings.Headless = false;
+		}
+		else
+		{
+			printf("Unknown argument: %s\n", p_Argv[i]);
+			if (!l_Unknown)
+				l_Unknown = p_Argv[i];
+		}
+	}
+
+	if (l_Unknown && g_Benchmark.Settings.Enabled)
+	{
+		printf("--benchmark doesn't run with unknown arguments (%s).\n", l_Unknown);
+		return false;
+	}
+
+	if (g_Benchmark.Settings.Enabled && g_Benchmark.Settings.FrameCount == 0)
+	{
+		printf("--benchmark needs a frame count greater than zero.\n");
+		return false;
+	}
+
+	if (!g_Benchmark.Settings.Enabled)
+	{
+		g_Benchmark.Settings.Headless = false;
+	}
+
+	g_Benchmark.Frames.reserve(g_Benchmark.Settings.FrameCount * (g_Benchmark.Settings.CubeCounts.empty() ? 1 : g_Benchmark.Settings.CubeCounts.size()));
+	return true;
+}
+
+void BenchmarkBeginFrame(void)
+{
+	g_Benchmark.FrameStartTime = ovr_GetTimeInSeconds();
+	g_Benchmark.SubmitEndTime = g_Benchmark.FrameStartTime;
+}
+
+void BenchmarkSubmitDone(void)
+{
+	g_Benchmark.SubmitEndTime = ovr_GetTimeInSeconds();
+}
+
+// The recorded frame p_FrameIndex, NULL if it was a warmup frame (or isn't recorded yet)...
+static BenchmarkFrame* FindFrame(unsigned int p_FrameIndex)
+{
+	// Whatever gets resolved late is only a few frames behind, look from the back...
+	for (size_t i = g_Benchmark.Frames.size(); i > 0; i--)
+	{
+		BenchmarkFrame& l_Frame = g_Benchmark.Frames[i - 1];
+		if (l_Frame.FrameIndex == p_FrameIndex)
+			return &l_Frame;
+		if (l_Frame.FrameIndex < p_FrameIndex)
+			break;
+	}
+	return NULL;
+}
+
+void BenchmarkPoseToGpu(unsigned int p_FrameIndex, double p_Ms)
+{
+	BenchmarkFrame* l_Frame = FindFrame(p_FrameIndex);
+	if (l_Frame)
+		l_Frame->PoseToGpuMs = p_Ms;
+}
+
+void BenchmarkEyeGpu(unsigned int p_FrameIndex, double p_Ms)
+{
+	BenchmarkFrame* l_Frame = FindFrame(p_FrameIndex);
+	if (l_Frame)
+		l_Frame->EyeGpuMs = p_Ms;
+}
+
+static unsigned int StageCount(void)
+{
+	return g_Benchmark.Settings.CubeCounts.empty() ? 1 : (unsigned int)g_Benchmark.Settings.CubeCounts.size();
+}
+
+void BenchmarkEndFrame(unsigned int p_MsaaSamples, unsigned int p_SceneObjects, unsigned int p_VisibleObjects, unsigned int p_OccludedObjects)
+{
+	const double l_Now = ovr_GetTimeInSeconds();
+
+	// Every stage warms up again, the first frames after a scene change aren't representative...
+	if (g_Benchmark.StageFramesRun >= g_Benchmark.Settings.WarmupFrames)
+	{
+		BenchmarkFrame l_Frame;
+		l_Frame.FrameIndex = g_Benchmark.FramesRun;
+		l_Frame.CpuMs = (g_Benchmark.SubmitEndTime - g_Benchmark.FrameStartTime) * 1000.0;
+		l_Frame.FrameMs = (l_Now - g_Benchmark.FrameStartTime) * 1000.0;
+		l_Frame.PoseToGpuMs = -1.0; // See BenchmarkPoseToGpu...
+		l_Frame.EyeGpuMs = -1.0; // See BenchmarkEyeGpu...
+		l_Frame.MsaaSamples = p_MsaaSamples;
+		l_Frame.Stage = g_Benchmark.Stage;
+		l_Frame.SceneObjects = p_SceneObjects;
+		l_Frame.VisibleObjects = p_VisibleObjects;
+		l_Frame.OccludedObjects = p_OccludedObjects;
+		g_Benchmark.Frames.push_back(l_Frame);
+	}
+
+	++g_Benchmark.FramesRun;
+	++g_Benchmark.StageFramesRun;
+	if (g_Benchmark.StageFramesRun >= g_Benchmark.Settings.WarmupFrames + g_Benchmark.Settings.FrameCount && g_Benchmark.Stage + 1 < StageCount())
+	{
+		++g_Benchmark.Stage;
+		g_Benchmark.StageFramesRun = 0;
+	}
+}
+
+bool BenchmarkFinished(void)
+{
+	return g_Benchmark.StageFramesRun >= g_Benchmark.Settings.WarmupFrames + g_Benchmark.Settings.FrameCount;
+}
+
+// Nearest-rank percentile of an already sorted list: the smallest value with at least p_Percent of
+// the list at or below it...
+static double Percentile(const std::vector<double>& p_Sorted, double p_Percent)
+{
+	if (p_Sorted.empty())
+		return 0.0;
+
+	size_t l_Rank = (size_t)ceil((p_Percent / 100.0) * (double)p_Sorted.size());
+	if (l_Rank < 1) l_Rank = 1;
+	if (l_Rank > p_Sorted.size()) l_Rank = p_Sorted.size();
+	return p_Sorted[l_Rank - 1];
+}
+
+static void WriteSummary(FILE* p_File, const char* p_Name, std::vector<double>& p_Values)
+{
+	std::sort(p_Values.begin(), p_Values.end());
+
+	double l_Sum = 0.0;
+	for (size_t i = 0; i < p_Values.size(); i++)
+		l_Sum += p_Values[i];
+
+	fprintf(p_File, "  \"%s\": { \"mean\": %.4f, \"min\": %.4f, \"max\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f },\n",
+		p_Name,
+		p_Values.empty() ? 0.0 : l_Sum / (double)p_Values.size(),
+		p_Values.empty() ? 0.0 : p_Values.front(),
+		p_Values.empty() ? 0.0 : p_Values.back(),
+		Percentile(p_Values, 50.0),
+		Percentile(p_Values, 95.0),
+		Percentile(p_Values, 99.0));
+}
+
+// A JSON string with its quotes, escaping what JSON doesn't allow in one (driver strings are free text)...
+static void WriteJsonString(FILE* p_File, const char* p_String)
+{
+	fputc('"', p_File);
+	for (const unsigned char* l_Char = (const unsigned char*)p_String; *l_Char; l_Char++)
+	{
+		if (*l_Char == '"' || *l_Char == '\\')
+			fprintf(p_File, "\\%c", *l_Char);
+		else if (*l_Char < 0x20)
+			fprintf(p_File, "\\u%04x", *l_Char);
+		else
+			fputc(*l_Char, p_File);
+	}
+	fputc('"', p_File);
+}
+
+bool WriteBenchmarkReport(const char* p_Renderer)
+{
+	FILE* l_File = fopen(g_Benchmark.Settings.OutputPath.c_str(), "w");
+	if (!l_File)
+	{
+		printf("Could not open %s for writing.\n", g_Benchmark.Settings.OutputPath.c_str());
+		return false;
+	}
+
+	std::vector<double> l_CpuMs, l_FrameMs, l_PoseToGpuMs, l_EyeGpuMs;
+	for (size_t i = 0; i < g_Benchmark.Frames.size(); i++)
+	{
+		l_CpuMs.push_back(g_Benchmark.Frames[i].CpuMs);
+		l_FrameMs.push_back(g_Benchmark.Frames[i].FrameMs);
+		if (g_Benchmark.Frames[i].PoseToGpuMs >= 0.0)
+			l_PoseToGpuMs.push_back(g_Benchmark.Frames[i].PoseToGpuMs);
+		if (g_Benchmark.Frames[i].EyeGpuMs >= 0.0)
+			l_EyeGpuMs.push_back(g_Benchmark.Frames[i].EyeGpuMs);
+	}
+
+	fprintf(l_File, "{\n");
+	fprintf(l_File, "  \"renderer\": ");
+	WriteJsonString(l_File, p_Renderer ? p_Renderer : "unknown");
+	fprintf(l_File, ",\n");
+	fprintf(l_File, "  \"headless\": %s,\n", g_Benchmark.Settings.Headless ? "true" : "false");
+	fprintf(l_File, "  \"stereo\": \"%s\",\n", g_Benchmark.Settings.SinglePassStereo ? "single" : "multi");
+	fprintf(l_File, "  \"late_latch\": %s,\n", g_Benchmark.Settings.LateLatch ? "true" : "false");
+	fprintf(l_File, "  \"dynamic_resolution\": %s,\n", g_Benchmark.Settings.DynamicResolution ? "true" : "false");
+	fprintf(l_File, "  \"gpu_budget_ms\": %.2f,\n", g_Benchmark.Settings.GpuBudgetMs);
+	fprintf(l_File, "  \"eye_buffers\": %u,\n", g_Benchmark.Settings.EyeBufferCount);
+	fprintf(l_File, "  \"msaa_samples\": %u,\n", g_Benchmark.Settings.MsaaSamples);
+	fprintf(l_File, "  \"shader_cache\": %s,\n", g_ShaderCache.Enabled ? "true" : "false");
+	fprintf(l_File, "  \"shader_programs\": %u,\n", g_ShaderCache.Programs);
+	fprintf(l_File, "  \"shader_cache_hits\": %u,\n", g_ShaderCache.Hits);
+	fprintf(l_File, "  \"shader_build_ms\": %.3f,\n", g_ShaderCache.BuildMs);
+	fprintf(l_File, "  \"shader_cache_saved_ms\": %.3f,\n", g_ShaderCache.SavedMs);
+	fprintf(l_File, "  \"instancing\": %s,\n", g_Benchmark.Settings.Instancing ? "true" : "false");
+	fprintf(l_File, "  \"gpu_culling\": %s,\n", g_Benchmark.Settings.GpuCulling ? "true" : "false");
+	fprintf(l_File, "  \"bvh_culling\": %s,\n", g_Benchmark.Settings.BvhCulling ? "true" : "false");
+	fprintf(l_File, "  \"hidden_area\": %s,\n", g_Benchmark.Settings.HiddenArea ? "true" : "false");
+	fprintf(l_File, "  \"distortion\": \"%s\",\n", g_ClientDistortion.Enabled ? "client" : (g_Benchmark.Settings.Headless ? "none" : "sdk"));
+	fprintf(l_File, "  \"distortion_mesh_cache_hits\": %u,\n", g_ClientDistortion.CacheHits);
+	fprintf(l_File, "  \"multires\": %s,\n", g_Benchmark.Settings.MultiResolution ? "true" : "false");
+	fprintf(l_File, "  \"multires_center\": %.2f,\n", g_Benchmark.Settings.MultiResCenter);
+	fprintf(l_File, "  \"multires_density\": %.2f,\n", g_Benchmark.Settings.MultiResDensity);
+	fprintf(l_File, "  \"multires_pixel_fraction\": %.3f,\n", g_MultiResolution.Enabled ? g_MultiResolution.PixelFraction : 1.0f);
+	fprintf(l_File, "  \"stereo_reprojection\": %s,\n", g_Benchmark.Settings.StereoReprojection ? "true" : "false");
+	fprintf(l_File, "  \"reprojection_split_m\": %.2f,\n", g_Benchmark.Settings.ReprojectionSplit);
+	fprintf(l_File, "  \"shadows\": %s,\n", g_Benchmark.Settings.Shadows ? "true" : "false");
+	fprintf(l_File, "  \"shadow_map_size\": %d,\n", g_SceneShadows.MapSize);
+	fprintf(l_File, "  \"shadow_map_renders\": %u,\n", g_SceneShadows.MapRenders);
+	fprintf(l_File, "  \"point_lights\": %u,\n", (unsigned int)g_ScenePointLights.size());
+	fprintf(l_File, "  \"depth_prepass\": %s,\n", g_Benchmark.Settings.DepthPrePass ? "true" : "false");
+	fprintf(l_File, "  \"reverse_z\": %s,\n", g_EyeRenderTargets.ReverseZ ? "true" : "false");
+	fprintf(l_File, "  \"far_plane_m\": %.1f,\n", g_Benchmark.Settings.FarPlane);
+	fprintf(l_File, "  \"occlusion_culling\": %s,\n", g_Benchmark.Settings.Occlusion ? "true" : "false");
+	fprintf(l_File, "  \"hidden_area_fraction\": [%.3f, %.3f],\n", g_HiddenArea.Fraction[0], g_HiddenArea.Fraction[1]);
+	fprintf(l_File, "  \"warmup_frames\": %u,\n", g_Benchmark.Settings.WarmupFrames);
+	fprintf(l_File, "  \"frames\": %u,\n", (unsigned int)g_Benchmark.Frames.size());
+	WriteSummary(l_File, "cpu_ms", l_CpuMs);
+	WriteSummary(l_File, "frame_ms", l_FrameMs);
+	WriteSummary(l_File, "pose_to_gpu_ms", l_PoseToGpuMs);
+	WriteSummary(l_File, "eye_gpu_ms", l_EyeGpuMs);
+	if (!g_Benchmark.Settings.CubeCounts.empty())
+	{
+		// Frame time against the cube count, one entry per stage...
+		fprintf(l_File, "  \"cube_sweep\": [\n");
+		for (unsigned int l_Stage = 0; l_Stage < StageCount(); l_Stage++)
+		{
+			std::vector<double> l_StageCpuMs, l_StageFrameMs, l_StageEyeGpuMs;
+			unsigned int l_SceneObjects = 0;
+			for (size_t i = 0; i < g_Benchmark.Frames.size(); i++)
+			{
+				const BenchmarkFrame& l_Frame = g_Benchmark.Frames[i];
+				if (l_Frame.Stage != l_Stage)
+					continue;
+				l_StageCpuMs.push_back(l_Frame.CpuMs);
+				l_StageFrameMs.push_back(l_Frame.FrameMs);
+				if (l_Frame.EyeGpuMs >= 0.0)
+					l_StageEyeGpuMs.push_back(l_Frame.EyeGpuMs);
+				l_SceneObjects = l_Frame.SceneObjects;
+			}
+			std::sort(l_StageCpuMs.begin(), l_StageCpuMs.end());
+			std::sort(l_StageFrameMs.begin(), l_StageFrameMs.end());
+			std::sort(l_StageEyeGpuMs.begin(), l_StageEyeGpuMs.end());
+
+			fprintf(l_File, "    { \"cubes\": %u, \"scene_objects\": %u, \"frames\": %u, \"frame_ms_p50\": %.4f, \"frame_ms_p95\": %.4f, \"cpu_ms_p50\": %.4f, \"eye_gpu_ms_p50\": %.4f }%s\n",
+				g_Benchmark.Settings.CubeCounts[l_Stage], l_SceneObjects, (unsigned int)l_StageFrameMs.size(),
+				Percentile(l_StageFrameMs, 50.0), Percentile(l_StageFrameMs, 95.0),
+				Percentile(l_StageCpuMs, 50.0), Percentile(l_StageEyeGpuMs, 50.0),
+				(l_Stage + 1 < StageCount()) ? "," : "");
+			printf("Benchmark: %u cubes, frame p50 %.3f ms, p95 %.3f ms (cpu p50 %.3f ms, eye gpu p50 %.3f ms)\n",
+				g_Benchmark.Settings.CubeCounts[l_Stage],
+				Percentile(l_StageFrameMs, 50.0), Percentile(l_StageFrameMs, 95.0),
+				Percentile(l_StageCpuMs, 50.0), Percentile(l_StageEyeGpuMs, 50.0));
+		}
+		fprintf(l_File, "  ],\n");
+	}
+	fprintf(l_File, "  \"per_frame\": [\n");
+	for (size_t i = 0; i < g_Benchmark.Frames.size(); i++)
+	{
+		const BenchmarkFrame& l_Frame = g_Benchmark.Frames[i];
+		fprintf(l_File, "    { \"frame\": %u, \"cpu_ms\": %.4f, \"frame_ms\": %.4f, \"pose_to_gpu_ms\": %.4f, \"eye_gpu_ms\": %.4f, \"msaa_samples\": %u, \"scene_objects\": %u, \"visible_objects\": %u, \"occluded_objects\": %u }%s\n",
+			l_Frame.FrameIndex, l_Frame.CpuMs, l_Frame.FrameMs, l_Frame.PoseToGpuMs, l_Frame.EyeGpuMs, l_Frame.MsaaSamples, l_Frame.SceneObjects,
+			l_Frame.VisibleObjects, l_Frame.OccludedObjects, (i + 1 < g_Benchmark.Frames.size()) ? "," : "");
+	}
+	fprintf(l_File, "  ]\n");
+	fprintf(l_File, "}\n");
+	fclose(l_File);
+
+	printf("Benchmark: %u frames, frame p50 %.3f ms, p95 %.3f ms, p99 %.3f ms (cpu p50 %.3f ms, pose to gpu p50 %.3f ms), written to %s\n",
+		(unsigned int)g_Benchmark.Frames.size(),
+		Percentile(l_FrameMs, 50.0), Percentile(l_FrameMs, 95.0), Percentile(l_FrameMs, 99.0),
+		Percentile(l_CpuMs, 50.0), Percentile(l_PoseToGpuMs, 50.0),
+		g_Benchmark.Settings.OutputPath.c_str());
+	return true;
+}
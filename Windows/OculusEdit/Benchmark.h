@@ -0,0 +1,135 @@
+//
+//  Benchmark.h
+//  OculusEdit
+//
+//  Headless frame benchmark: runs the draw loop for a fixed number of frames and
+//  writes per-frame timings plus p50/p95/p99 percentiles to a JSON file.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Settings parsed from the command line:
+//   --benchmark <frames>       Run <frames> frames and exit (implies the debug DK2 HMD).
+//   --benchmark-out <file>     Where to write the JSON report (default: benchmark.json).
+//   --benchmark-warmup <n>     Frames to run before recording starts (default: 30).
+//   --windowed                 Use a (hidden) GLFW window instead of an offscreen context.
+//   --trace <file>             Dump the profiler ring buffer as a Chrome trace on exit (and on 'P').
+//   --stereo <single|multi>    Single-pass instanced (default) or multi-pass stereo (toggle with 'S').
+//   --late-latch <on|off>      Re-sample the eye poses right before the eyes are drawn (default on, toggle with 'L').
+//   --dynamic-resolution <on|off>  Scale the eye viewports to the GPU budget (default on, toggle with 'D').
+//   --gpu-budget <ms>          GPU time the eye rendering may take (default 10 ms, a DK2 frame is 13.3 ms).
+//   --eye-buffers <1-3>        Eye render targets to rotate through (default 3).
+//   --msaa <1|2|4|8>           MSAA samples of the eye buffers (default 4, cycle with 'M').
+//   --shader-cache <dir|off>   Where linked shader programs are cached (default: shadercache).
+//   --shader-dir <dir>         Load the shaders from <dir> and reload them when they are edited.
+//   --instancing <on|off>      One instanced draw per mesh instead of one draw per object (default on, toggle with 'I').
+//   --gpu-culling <on|off>     Cull the instances in a compute pass and draw them with multi-draw indirect
+//                              (default on where the GL can, toggle with 'C').
+//   --bvh-culling <on|off>     Cull on the CPU against a bounding volume hierarchy when GPU culling is off
+//                              (default on, toggle with 'B').
+//   --hidden-area <on|off>     Mask what the lenses never show out of the depth buffer first (default on, toggle with 'H').
+//   --distortion <sdk|client>  LibOVR distorts in ovrHmd_EndFrame (default), or we do, from cached meshes.
+//   --distortion-cache <dir|off>  Where client distortion caches the meshes (default: distortioncache).
+//   --multires <off|on|c,d>    Render the middle c of each eye viewport (per axis, default 0.6) at full pixel
+//                              density and the rest at density d (default 0.5). Off by default, toggle with 'F'.
+//   --reprojection <off|on|m>  Render what lies past m meters (default 5) for the left eye only and reproject it
+//                              into the right one. Off by default, toggle with 'T'.
+//   --shadows <on|off|size>    Shadow maps for the lights, size x size texels each (default off, 2048 when on,
+//                              toggle with 'O').
+//   --lights <n>               Adds n moving point lights, drawn with clustered lighting (default 0).
+//   --depth-prepass <on|off>   Draw the scene depth only before shading it (default off, toggle with 'Z').
+//   --reverse-z <on|off>       Float depth buffers with reverse-Z, where the GL has glClipControl (default off).
+//   --far <m>                  Far plane of the eye projections in meters (default 100).
+//   --occlusion <on|off>       Cull against the previous frame's depth as well, with GPU culling (default off,
+//                              toggle with 'Q').
+//   --cubes <n[,n...]>         Adds a grid of n cubes to the scene. With several counts the benchmark runs
+//                              once per count (warmup included) and reports how the frame time grows.
+struct BenchmarkSettings
+{
+	bool Enabled;
+	bool Headless;
+	unsigned int FrameCount;
+	unsigned int WarmupFrames;
+	std::string OutputPath;
+	std::string TracePath;
+	bool SinglePassStereo;
+	bool LateLatch;
+	bool DynamicResolution;
+	double GpuBudgetMs;
+	unsigned int EyeBufferCount;
+	unsigned int MsaaSamples;
+	std::string ShaderCachePath; // Empty when the cache is off.
+	std::string ShaderDirectory; // Empty: built-in shaders only.
+	bool Instancing;
+	bool GpuCulling;
+	bool BvhCulling;
+	bool HiddenArea;
+	bool ClientDistortion;
+	std::string DistortionCachePath; // Empty when the mesh cache is off.
+	bool MultiResolution;
+	float MultiResCenter;  // Share of the eye viewport at full density, per axis.
+	float MultiResDensity; // Pixel density around it.
+	bool StereoReprojection;
+	float ReprojectionSplit; // Meters, the far layer starts here.
+	bool Shadows;
+	int ShadowMapSize;       // Per light.
+	unsigned int PointLights;
+	bool DepthPrePass;
+	bool ReverseZ;
+	float FarPlane;          // Meters.
+	bool Occlusion;
+	std::vector<unsigned int> CubeCounts; // One benchmark stage per count, empty for just the demo scene.
+};
+
+// A single recorded frame. All times are in milliseconds.
+struct BenchmarkFrame
+{
+	unsigned int FrameIndex;
+	double CpuMs;   // Time spent on the CPU building and submitting the frame.
+	double FrameMs; // Full loop iteration, including the wait on the GPU / swap.
+	double PoseToGpuMs;    // Age of the frame's eye poses when the GPU picked them up, negative if unknown.
+	double EyeGpuMs;       // GPU time of the frame's eye rendering, negative if its queries never came back.
+	unsigned int MsaaSamples;
+	unsigned int Stage;
+	unsigned int SceneObjects;
+	unsigned int VisibleObjects;  // Kept by the GPU cull pass (0 without it), a few frames late.
+	unsigned int OccludedObjects; // Of those in the eye frustums, the ones occlusion culling dropped.
+};
+
+struct BenchmarkState
+{
+	BenchmarkSettings Settings;
+	std::vector<BenchmarkFrame> Frames;
+	unsigned int FramesRun;
+	unsigned int Stage;           // Index into Settings.CubeCounts (0 without counts).
+	unsigned int StageFramesRun;  // Frames run in the current stage, warmup included.
+	double FrameStartTime;
+	double SubmitEndTime;
+};
+
+extern BenchmarkState g_Benchmark;
+
+// Fills in g_Benchmark.Settings from argv. Returns false on a malformed command line.
+bool ParseBenchmarkArguments(int p_Argc, const char* p_Argv[]);
+
+// Call at the very top of the frame, after GPU work has been submitted, and at the very end of the frame.
+void BenchmarkBeginFrame(void);
+void BenchmarkSubmitDone(void);
+// The pose to GPU latency of frame p_FrameIndex (ResolvePoseToGpuLatency), whenever it comes back.
+void BenchmarkPoseToGpu(unsigned int p_FrameIndex, double p_Ms);
+// p_MsaaSamples is the MSAA sample count the frame was rendered with, p_SceneObjects the number of objects
+// in the scene, p_VisibleObjects and p_OccludedObjects what the GPU cull pass made of them. Moves on to the
+// next stage once the current one is done.
+void BenchmarkEndFrame(unsigned int p_MsaaSamples, unsigned int p_SceneObjects, unsigned int p_VisibleObjects, unsigned int p_OccludedObjects);
+// The eye rendering GPU time of frame p_FrameIndex, once its queries came back. Passing the same
+// measurement again is harmless.
+void BenchmarkEyeGpu(unsigned int p_FrameIndex, double p_Ms);
+
+// True once the requested number of frames (warmup included) has been run in every stage.
+bool BenchmarkFinished(void);
+
+// Writes the JSON report to g_Benchmark.Settings.OutputPath and prints a one line summary.
+bool WriteBenchmarkReport(const char* p_Renderer);
@@ -0,0 +1,393 @@
+//
+//  ClientDistortion.cpp
+//  OculusEdit
+//
+
+#include "ClientDistortion.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#if !defined(__APPLE__)
+#  include <GL/glew.h>
+#else
+#  include <OpenGL/gl3.h>
+#endif
+
+#if defined(_WIN32)
+#  include <direct.h>
+#else
+#  include <sys/stat.h>
+#endif
+
+#include "OVR_CAPI_GL.h"
+
+#include "MultiResolution.h"
+#include "Profiler.h"
+#include "Shader.h"
+#include "ShaderCache.h"
+
+ClientDistortionState g_ClientDistortion;
+
+static const unsigned int DISTORTION_CACHE_MAGIC = 0x4F45444D; // "OEDM"...
+
+// Fixed header in front of the vertices and indices in every cache file:
+struct DistortionCacheFileHeader
+{
+	unsigned int Magic;
+	unsigned int VertexSize;   // sizeof(ovrDistortionVertex) when it was written.
+	unsigned int VertexCount;
+	unsigned int IndexCount;
+	unsigned long long Key;
+};
+
+// Attribute locations, one per ovrDistortionVertex member:
+static const GLuint DISTORTION_ATTRIBUTE_POSITION = 0;
+static const GLuint DISTORTION_ATTRIBUTE_TIMEWARP = 1;
+static const GLuint DISTORTION_ATTRIBUTE_VIGNETTE = 2;
+static const GLuint DISTORTION_ATTRIBUTE_TAN_R = 3;
+static const GLuint DISTORTION_ATTRIBUTE_TAN_G = 4;
+static const GLuint DISTORTION_ATTRIBUTE_TAN_B = 5;
+
+static GLuint l_Program = 0;
+static GLint l_UVScaleUniform = -1;
+static GLint l_UVOffsetUniform = -1;
+static GLint l_RotationStartUniform = -1;
+static GLint l_RotationEndUniform = -1;
+static GLint l_MultiResolutionUniform = -1;
+static MultiResolutionUniforms l_MultiResolutionUniforms;
+static GLuint l_VertexArrays[2] = { 0, 0 };
+static GLuint l_Buffers[2][2] = { { 0, 0 }, { 0, 0 } }; // Vertices and indices per eye.
+static GLsizei l_IndexCounts[2] = { 0, 0 };
+static ovrFovPort l_Fov[2];
+
+// Where the distortion goes without a window...
+static GLuint l_OffscreenFramebuffer = 0;
+static GLuint l_OffscreenColor = 0;
+static ovrSizei l_OffscreenSize;
+
+// The eye's direction (tangents of its angles) rotated by the timewarp matrices, back to tangents, and
+// then into the eye's part of the texture. The rotated directions are blended across the eye from the
+// start to the end of its scanout...
+static const std::string l_DistortionVertexShader(
+	SHADER_GLSL_VERSION
+	"layout (location = 0) in vec2 position;\n"
+	"layout (location = 1) in float timewarpFactor;\n"
+	"layout (location = 2) in float vignetteFactor;\n"
+	"layout (location = 3) in vec2 tanEyeAnglesR;\n"
+	"layout (location = 4) in vec2 tanEyeAnglesG;\n"
+	"layout (location = 5) in vec2 tanEyeAnglesB;\n"
+	"uniform vec2 eyeToSourceUVScale;\n"
+	"uniform vec2 eyeToSourceUVOffset;\n"
+	"uniform mat4 eyeRotationStart;\n"
+	"uniform mat4 eyeRotationEnd;\n"
+	"out vec2 texCoordR;\n"
+	"out vec2 texCoordG;\n"
+	"out vec2 texCoordB;\n"
+	"out float vignette;\n"
+	"vec2 TimewarpTexCoord(vec2 tanEyeAngles)\n"
+	"{\n"
+	"   vec3 start = (eyeRotationStart * vec4(tanEyeAngles, 1.0, 1.0)).xyz;\n"
+	"   vec3 end = (eyeRotationEnd * vec4(tanEyeAngles, 1.0, 1.0)).xyz;\n"
+	"   vec3 direction = mix(start, end, timewarpFactor);\n"
+	"   return (direction.xy / direction.z) * eyeToSourceUVScale + eyeToSourceUVOffset;\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"   texCoordR = TimewarpTexCoord(tanEyeAnglesR);\n"
+	"   texCoordG = TimewarpTexCoord(tanEyeAnglesG);\n"
+	"   texCoordB = TimewarpTexCoord(tanEyeAnglesB);\n"
+	"   vignette = vignetteFactor;\n"
+	"   gl_Position = vec4(position, 0.5, 1.0);\n"
+	"}\n"
+	);
+
+// With multi-resolution eye buffers each texture coordinate is looked up in the packed layout first...
+static const std::string l_DistortionFragmentShader(
+	SHADER_GLSL_VERSION
+	"in vec2 texCoordR;\n"
+	"in vec2 texCoordG;\n"
+	"in vec2 texCoordB;\n"
+	"in float vignette;\n"
+	"uniform sampler2D eyeTexture;\n"
+	"uniform bool multiResolution;\n"
+	"out vec4 outputColor;\n"
+	+ std::string(MULTI_RESOLUTION_SHADER) +
+	"vec2 EyeTexCoord(vec2 texCoord)\n"
+	"{\n"
+	"   if (!multiResolution)\n"
+	"      return texCoord;\n"
+	"   vec2 size = vec2(textureSize(eyeTexture, 0));\n"
+	"   return MultiResolutionPixel(texCoord * size) / size;\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"   vec3 color = vec3(texture(eyeTexture, EyeTexCoord(texCoordR)).r, texture(eyeTexture, EyeTexCoord(texCoordG)).g, texture(eyeTexture, EyeTexCoord(texCoordB)).b);\n"
+	"   outputColor = vec4(color * vignette, 1.0);\n"
+	"}\n"
+	);
+
+// Everything the mesh depends on...
+static unsigned long long DistortionMeshKey(ovrHmd p_Hmd, ovrEyeType p_Eye, const ovrFovPort& p_Fov, unsigned int p_DistortionCaps)
+{
+	// A different LibOVR may build different meshes for the same HMD...
+#if defined(OVR_VERSION_STRING)
+	const char* l_Version = OVR_VERSION_STRING;
+#else
+	const char* l_Version = "";
+#endif
+
+	// Profile keys our LibOVR headers have no names for, unknown keys just come back as the default...
+	char l_Key[512];
+	sprintf(l_Key, "%s|%s|%d|%d.%d|%s|%s|%.4f|%d|%.6f,%.6f,%.6f,%.6f|%u",
+		l_Version,
+		p_Hmd->ProductName ? p_Hmd->ProductName : "",
+		(int)p_Hmd->Type,
+		(int)p_Hmd->FirmwareMajor, (int)p_Hmd->FirmwareMinor,
+		ovrHmd_GetString(p_Hmd, OVR_KEY_USER, ""),
+		ovrHmd_GetString(p_Hmd, "EyeCup", ""),
+		ovrHmd_GetFloat(p_Hmd, "EyeReliefDial", 0.0f),
+		(int)p_Eye,
+		p_Fov.UpTan, p_Fov.DownTan, p_Fov.LeftTan, p_Fov.RightTan,
+		p_DistortionCaps);
+	return HashString(l_Key);
+}
+
+static std::string DistortionCachePath(unsigned long long p_Key)
+{
+	char l_Name[32];
+	sprintf(l_Name, "%016llx.mesh", p_Key);
+	return g_ClientDistortion.CacheDirectory + "/" + l_Name;
+}
+
+static bool LoadDistortionMesh(unsigned long long p_Key, std::vector<ovrDistortionVertex>& p_Vertices, std::vector<unsigned short>& p_Indices)
+{
+	FILE* l_File = fopen(DistortionCachePath(p_Key).c_str(), "rb");
+	if (!l_File)
+		return false;
+
+	DistortionCacheFileHeader l_Header;
+	bool l_Valid = fread(&l_Header, sizeof(l_Header), 1, l_File) == 1 &&
+		l_Header.Magic == DISTORTION_CACHE_MAGIC && l_Header.Key == p_Key &&
+		l_Header.VertexSize == sizeof(ovrDistortionVertex) && l_Header.VertexCount > 0 && l_Header.IndexCount > 0;
+	if (l_Valid)
+	{
+		p_Vertices.resize(l_Header.VertexCount);
+		p_Indices.resize(l_Header.IndexCount);
+		l_Valid = fread(&p_Vertices[0], sizeof(ovrDistortionVertex), p_Vertices.size(), l_File) == p_Vertices.size() &&
+			fread(&p_Indices[0], sizeof(unsigned short), p_Indices.size(), l_File) == p_Indices.size();
+	}
+	fclose(l_File);
+	return l_Valid;
+}
+
+static void StoreDistortionMesh(unsigned long long p_Key, const std::vector<ovrDistortionVertex>& p_Vertices, const std::vector<unsigned short>& p_Indices)
+{
+	DistortionCacheFileHeader l_Header;
+	l_Header.Magic = DISTORTION_CACHE_MAGIC;
+	l_Header.VertexSize = sizeof(ovrDistortionVertex);
+	l_Header.VertexCount = (unsigned int)p_Vertices.size();
+	l_Header.IndexCount = (unsigned int)p_Indices.size();
+	l_Header.Key = p_Key;
+
+	// A failed write only costs us asking LibOVR again next time...
+	const std::string l_Path = DistortionCachePath(p_Key);
+	FILE* l_File = fopen(l_Path.c_str(), "wb");
+	if (!l_File)
+		return;
+	const bool l_Written = fwrite(&l_Header, sizeof(l_Header), 1, l_File) == 1 &&
+		fwrite(&p_Vertices[0], sizeof(ovrDistortionVertex), p_Vertices.size(), l_File) == p_Vertices.size() &&
+		fwrite(&p_Indices[0], sizeof(unsigned short), p_Indices.size(), l_File) == p_Indices.size();
+	fclose(l_File);
+	if (!l_Written)
+		remove(l_Path.c_str());
+}
+
+// From the cache if it's there, from LibOVR (and into the cache) otherwise...
+static bool GetDistortionMesh(ovrHmd p_Hmd, ovrEyeType p_Eye, const ovrFovPort& p_Fov, unsigned int p_DistortionCaps, std::vector<ovrDistortionVertex>& p_Vertices, std::vector<unsigned short>& p_Indices)
+{
+	const unsigned long long l_Key = DistortionMeshKey(p_Hmd, p_Eye, p_Fov, p_DistortionCaps);
+	if (!g_ClientDistortion.CacheDirectory.empty() && LoadDistortionMesh(l_Key, p_Vertices, p_Indices))
+	{
+		++g_ClientDistortion.CacheHits;
+		return true;
+	}
+
+	ovrDistortionMesh l_Mesh;
+	if (!ovrHmd_CreateDistortionMesh(p_Hmd, p_Eye, p_Fov, p_DistortionCaps, &l_Mesh))
+		return false;
+	p_Vertices.assign(l_Mesh.pVertexData, l_Mesh.pVertexData + l_Mesh.VertexCount);
+	p_Indices.assign(l_Mesh.pIndexData, l_Mesh.pIndexData + l_Mesh.IndexCount);
+	ovrHmd_DestroyDistortionMesh(&l_Mesh);
+
+	if (!g_ClientDistortion.CacheDirectory.empty())
+		StoreDistortionMesh(l_Key, p_Vertices, p_Indices);
+	return true;
+}
+
+static void SetupDistortionAttribute(GLuint p_Location, GLint p_Size, size_t p_Offset)
+{
+	glEnableVertexAttribArray(p_Location);
+	glVertexAttribPointer(p_Location, p_Size, GL_FLOAT, GL_FALSE, sizeof(ovrDistortionVertex), (const GLvoid*)p_Offset);
+}
+
+void InitializeClientDistortion(ovrHmd p_Hmd, const ovrFovPort p_Fov[2], unsigned int p_DistortionCaps, const char* p_CacheDirectory, bool p_Offscreen)
+{
+	g_ClientDistortion.Enabled = true;
+	g_ClientDistortion.DistortionCaps = p_DistortionCaps;
+	g_ClientDistortion.CacheDirectory = p_CacheDirectory ? p_CacheDirectory : "";
+	g_ClientDistortion.CacheHits = 0;
+	if (!g_ClientDistortion.CacheDirectory.empty())
+	{
+#if defined(_WIN32)
+		_mkdir(g_ClientDistortion.CacheDirectory.c_str());
+#else
+		mkdir(g_ClientDistortion.CacheDirectory.c_str(), 0755);
+#endif
+	}
+
+	const double l_Start = ovr_GetTimeInSeconds();
+	glGenVertexArrays(2, l_VertexArrays);
+	for (int l_Eye = 0; l_Eye < 2; l_Eye++)
+	{
+		l_Fov[l_Eye] = p_Fov[l_Eye];
+
+		std::vector<ovrDistortionVertex> l_Vertices;
+		std::vector<unsigned short> l_Indices;
+		if (!GetDistortionMesh(p_Hmd, (ovrEyeType)l_Eye, p_Fov[l_Eye], p_DistortionCaps, l_Vertices, l_Indices))
+		{
+			printf("Could not create the distortion mesh of the %s eye.\n", l_Eye == ovrEye_Left ? "left" : "right");
+			exit(EXIT_FAILURE);
+		}
+
+		glBindVertexArray(l_VertexArrays[l_Eye]);
+		glGenBuffers(2, l_Buffers[l_Eye]);
+		glBindBuffer(GL_ARRAY_BUFFER, l_Buffers[l_Eye][0]);
+		glBufferData(GL_ARRAY_BUFFER, l_Vertices.size() * sizeof(ovrDistortionVertex), &l_Vertices[0], GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, l_Buffers[l_Eye][1]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, l_Indices.size() * sizeof(unsigned short), &l_Indices[0], GL_STATIC_DRAW);
+		SetupDistortionAttribute(DISTORTION_ATTRIBUTE_POSITION, 2, offsetof(ovrDistortionVertex, ScreenPosNDC));
+		SetupDistortionAttribute(DISTORTION_ATTRIBUTE_TIMEWARP, 1, offsetof(ovrDistortionVertex, TimeWarpFactor));
+		SetupDistortionAttribute(DISTORTION_ATTRIBUTE_VIGNETTE, 1, offsetof(ovrDistortionVertex, VignetteFactor));
+		SetupDistortionAttribute(DISTORTION_ATTRIBUTE_TAN_R, 2, offsetof(ovrDistortionVertex, TanEyeAnglesR));
+		SetupDistortionAttribute(DISTORTION_ATTRIBUTE_TAN_G, 2, offsetof(ovrDistortionVertex, TanEyeAnglesG));
+		SetupDistortionAttribute(DISTORTION_ATTRIBUTE_TAN_B, 2, offsetof(ovrDistortionVertex, TanEyeAnglesB));
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		l_IndexCounts[l_Eye] = (GLsizei)l_Indices.size();
+	}
+	g_ClientDistortion.MeshMs = (ovr_GetTimeInSeconds() - l_Start) * 1000.0;
+	printf("Distortion meshes: %u of 2 from the cache, %.2f ms.\n", g_ClientDistortion.CacheHits, g_ClientDistortion.MeshMs);
+
+	// Tiny, needed for the first frame anyway...
+	l_Program = CreateCachedProgram(l_DistortionVertexShader, l_DistortionFragmentShader);
+	if (!l_Program)
+	{
+		printf("The distortion shader failed to build.\n");
+		exit(EXIT_FAILURE);
+	}
+	l_UVScaleUniform = glGetUniformLocation(l_Program, "eyeToSourceUVScale");
+	l_UVOffsetUniform = glGetUniformLocation(l_Program, "eyeToSourceUVOffset");
+	l_RotationStartUniform = glGetUniformLocation(l_Program, "eyeRotationStart");
+	l_RotationEndUniform = glGetUniformLocation(l_Program, "eyeRotationEnd");
+	l_MultiResolutionUniform = glGetUniformLocation(l_Program, "multiResolution");
+	GetMultiResolutionUniforms(l_Program, l_MultiResolutionUniforms);
+	glUseProgram(l_Program);
+	glUniform1i(glGetUniformLocation(l_Program, "eyeTexture"), 0);
+	glUseProgram(0);
+
+	if (p_Offscreen)
+	{
+		l_OffscreenSize = p_Hmd->Resolution;
+		glGenRenderbuffers(1, &l_OffscreenColor);
+		glBindRenderbuffer(GL_RENDERBUFFER, l_OffscreenColor);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, l_OffscreenSize.w, l_OffscreenSize.h);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glGenFramebuffers(1, &l_OffscreenFramebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, l_OffscreenFramebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, l_OffscreenColor);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+}
+
+void DestroyClientDistortion(void)
+{
+	if (!g_ClientDistortion.Enabled)
+		return;
+
+	glDeleteProgram(l_Program);
+	glDeleteVertexArrays(2, l_VertexArrays);
+	for (int l_Eye = 0; l_Eye < 2; l_Eye++)
+	{
+		glDeleteBuffers(2, l_Buffers[l_Eye]);
+		l_Buffers[l_Eye][0] = l_Buffers[l_Eye][1] = 0;
+		l_IndexCounts[l_Eye] = 0;
+	}
+	glDeleteFramebuffers(1, &l_OffscreenFramebuffer);
+	glDeleteRenderbuffers(1, &l_OffscreenColor);
+	l_Program = 0;
+	l_VertexArrays[0] = l_VertexArrays[1] = 0;
+	l_OffscreenFramebuffer = l_OffscreenColor = 0;
+	g_ClientDistortion.Enabled = false;
+}
+
+void RenderClientDistortion(ovrHmd p_Hmd, const ovrTexture p_EyeTextures[2], const ovrPosef p_EyePoses[2], ovrSizei p_WindowSize)
+{
+	ProfileZone l_Zone("Distortion");
+
+	const ovrSizei l_Size = l_OffscreenFramebuffer ? l_OffscreenSize : p_WindowSize;
+	glBindFramebuffer(GL_FRAMEBUFFER, l_OffscreenFramebuffer);
+	glViewport(0, 0, l_Size.w, l_Size.h);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	// The mesh covers what it covers, no depth or blending...
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	glUseProgram(l_Program);
+	glUniform1i(l_MultiResolutionUniform, g_MultiResolution.Enabled ? 1 : 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	for (int l_Eye = 0; l_Eye < 2; l_Eye++)
+	{
+		const ovrTextureHeader& l_Header = p_EyeTextures[l_Eye].Header;
+
+		// LibOVR counts viewport rows from the top of the texture and hands out UVs with v going
+		// down. Our eyes are drawn from the bottom of the texture up, so turn the viewport upside
+		// down on the way in and the UVs on the way out...
+		ovrRecti l_Viewport = l_Header.RenderViewport;
+		l_Viewport.Pos.y = l_Header.TextureSize.h - l_Viewport.Pos.y - l_Viewport.Size.h;
+		ovrVector2f l_UVScaleOffset[2];
+		ovrHmd_GetRenderScaleAndOffset(l_Fov[l_Eye], l_Header.TextureSize, l_Viewport, l_UVScaleOffset);
+		glUniform2f(l_UVScaleUniform, l_UVScaleOffset[0].x, -l_UVScaleOffset[0].y);
+		glUniform2f(l_UVOffsetUniform, l_UVScaleOffset[1].x, 1.0f - l_UVScaleOffset[1].y);
+		if (g_MultiResolution.Enabled)
+			SetMultiResolutionUniforms(l_MultiResolutionUniforms, l_Eye, l_Header.RenderViewport);
+
+		// Rotation from the pose the eye was rendered with to the latest one, at the start and the end of the eye's scanout...
+		ovrMatrix4f l_Timewarp[2];
+		if (g_ClientDistortion.DistortionCaps & ovrDistortionCap_TimeWarp)
+		{
+			ovrHmd_GetEyeTimewarpMatrices(p_Hmd, (ovrEyeType)l_Eye, p_EyePoses[l_Eye], l_Timewarp);
+		}
+		else
+		{
+			l_Timewarp[0] = l_Timewarp[1] = OVR::Matrix4f::Identity();
+		}
+		glUniformMatrix4fv(l_RotationStartUniform, 1, GL_TRUE, &l_Timewarp[0].M[0][0]);
+		glUniformMatrix4fv(l_RotationEndUniform, 1, GL_TRUE, &l_Timewarp[1].M[0][0]);
+
+		glBindTexture(GL_TEXTURE_2D, ((const ovrGLTexture&)p_EyeTextures[l_Eye]).OGL.TexId);
+		glBindVertexArray(l_VertexArrays[l_Eye]);
+		glDrawElements(GL_TRIANGLES, l_IndexCounts[l_Eye], GL_UNSIGNED_SHORT, 0);
+	}
+
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+	glEnable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,47 @@
+//
+//  ClientDistortion.h
+//  OculusEdit
+//
+//  Lens distortion drawn by us instead of inside ovrHmd_EndFrame. LibOVR still builds
+//  the distortion mesh of each eye (for the eye's FOV and the distortion caps), but
+//  only once: the meshes are cached on disk, keyed by the HMD, its profile (user, eye
+//  cups, eye relief), the FOV and the caps, so later launches just load them. Each eye
+//  is then a single draw that samples the eye texture three times (chromatic aberration
+//  correction) and applies the vignette. Timewarp happens in the vertex shader, it
+//  rotates every vertex's eye direction by LibOVR's timewarp matrices for the latest
+//  head pose. Multi-resolution eye buffers are sampled in their packed layout, they
+//  don't get stretched back first.
+//
+//  The pass runs under our own profiler zones and leaves no GL state behind. Without a
+//  window (the headless benchmark) it draws into an offscreen framebuffer of the HMD's
+//  resolution, so its cost still shows up.
+//
+
+#pragma once
+
+#include <string>
+
+#include "OVR.h"
+#include "OVR_CAPI.h"
+
+struct ClientDistortionState
+{
+	bool Enabled;
+	unsigned int DistortionCaps;
+	std::string CacheDirectory; // Empty when the mesh cache is off.
+	unsigned int CacheHits;     // Eye meshes loaded from the cache (0 to 2).
+	double MeshMs;              // Spent creating or loading the meshes.
+};
+
+extern ClientDistortionState g_ClientDistortion;
+
+// Needs a current GL context. Creates (or loads) the meshes of both eyes for p_Fov and builds the
+// distortion program. p_CacheDirectory empty disables the mesh cache. p_Offscreen: there's no
+// window, draw into an offscreen framebuffer of p_Hmd->Resolution instead.
+void InitializeClientDistortion(ovrHmd p_Hmd, const ovrFovPort p_Fov[2], unsigned int p_DistortionCaps, const char* p_CacheDirectory, bool p_Offscreen);
+void DestroyClientDistortion(void);
+
+// Distorts both eyes of p_EyeTextures (their current RenderViewport is what gets sampled) into the
+// default framebuffer (p_WindowSize) or the offscreen one, timewarped from p_EyePoses (the poses they
+// were rendered with) to the latest head pose. Presenting is up to the caller.
+void RenderClientDistortion(ovrHmd p_Hmd, const ovrTexture p_EyeTextures[2], const ovrPosef p_EyePoses[2], ovrSizei p_WindowSize);
@@ -0,0 +1,92 @@
+//
+//  DynamicResolution.cpp
+//  OculusEdit
+//
+
+#include "DynamicResolution.h"
+
+#include <math.h>
+
+#include "Profiler.h"
+
+DynamicResolutionState g_DynamicResolution;
+
+// Hysteresis: shrink above the budget, grow only after this many measurements below the lower mark...
+static const double GROW_BELOW = 0.75;
+static const unsigned int GROW_AFTER_MEASUREMENTS = 30;
+static const float GROW_STEP = 0.05f;
+static const float MAX_SHRINK_STEP = 0.25f;
+
+static float ClampScale(float p_Scale)
+{
+	if (p_Scale < DYNAMIC_RESOLUTION_MIN_SCALE) return DYNAMIC_RESOLUTION_MIN_SCALE;
+	if (p_Scale > DYNAMIC_RESOLUTION_MAX_SCALE) return DYNAMIC_RESOLUTION_MAX_SCALE;
+	return p_Scale;
+}
+
+void InitializeDynamicResolution(bool p_Enabled, double p_TargetGpuMs, float p_InitialScale)
+{
+	g_DynamicResolution.Enabled = p_Enabled;
+	g_DynamicResolution.Scale = ClampScale(p_InitialScale);
+	g_DynamicResolution.TargetGpuMs = p_TargetGpuMs;
+	g_DynamicResolution.LastGpuMs = -1.0;
+	g_DynamicResolution.LastGpuFrame = 0;
+	g_DynamicResolution.Headroom = 0;
+	g_DynamicResolution.ScaleFrame = 0;
+	g_DynamicResolution.Restarted = true;
+}
+
+float UpdateDynamicResolution(double p_GpuMs, unsigned int p_GpuFrame, unsigned int p_FrameIndex)
+{
+	DynamicResolutionState& l_State = g_DynamicResolution;
+	if (!l_State.Enabled)
+		return l_State.Scale;
+
+	if (l_State.Restarted)
+	{
+		l_State.ScaleFrame = p_FrameIndex;
+		l_State.Restarted = false;
+	}
+
+	// The profiler hands out the same time until a newer query resolves, act on every measurement once...
+	if (p_GpuMs < 0.0 || (l_State.LastGpuMs >= 0.0 && p_GpuFrame == l_State.LastGpuFrame))
+		return l_State.Scale;
+
+	l_State.LastGpuMs = p_GpuMs;
+	l_State.LastGpuFrame = p_GpuFrame;
+
+	// GPU timings come back a couple of frames late, don't react to frames rendered before the last change...
+	if (p_GpuFrame < l_State.ScaleFrame)
+		return l_State.Scale;
+
+	float l_NewScale = l_State.Scale;
+	if (p_GpuMs > l_State.TargetGpuMs)
+	{
+		// Over budget: the cost goes with the pixel count (scale squared), so aim straight for the target...
+		const float l_Wanted = l_State.Scale * (float)sqrt(l_State.TargetGpuMs / p_GpuMs);
+		l_NewScale = (l_State.Scale - l_Wanted > MAX_SHRINK_STEP) ? l_State.Scale - MAX_SHRINK_STEP : l_Wanted;
+		l_State.Headroom = 0;
+	}
+	else if (p_GpuMs < l_State.TargetGpuMs * GROW_BELOW)
+	{
+		if (++l_State.Headroom >= GROW_AFTER_MEASUREMENTS)
+		{
+			l_NewScale = l_State.Scale + GROW_STEP;
+			l_State.Headroom = 0;
+		}
+	}
+	else
+	{
+		l_State.Headroom = 0; // Inside the band, hold...
+	}
+
+	l_NewScale = ClampScale(l_NewScale);
+	if (l_NewScale != l_State.Scale)
+	{
+		l_State.Scale = l_NewScale;
+		l_State.ScaleFrame = p_FrameIndex;
+	}
+
+	ProfilerCounter("ResolutionScale", l_State.Scale);
+	return l_State.Scale;
+}
@@ -0,0 +1,41 @@
+//
+//  DynamicResolution.h
+//  OculusEdit
+//
+//  Adaptive render resolution. The eye texture is allocated once at the highest pixel
+//  density we ever want; every frame the controller looks at the measured GPU time of
+//  the eye rendering and picks how much of that texture the eye viewports use. Over
+//  budget it shrinks right away (in proportion to the overshoot), it only grows again
+//  after a run of measurements with clear headroom, and in between it leaves things
+//  alone. Only new measurements of frames rendered at the current scale count.
+//
+
+#pragma once
+
+// Pixel density the eye texture is allocated at (1.0 is LibOVR's 1:1 at the center)...
+const float DYNAMIC_RESOLUTION_MAX_DENSITY = 1.25f;
+// ... and the range of the viewport scale, relative to that texture.
+const float DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;
+const float DYNAMIC_RESOLUTION_MAX_SCALE = 1.0f;
+
+struct DynamicResolutionState
+{
+	bool Enabled;
+	float Scale;             // Current viewport scale (per axis).
+	double TargetGpuMs;      // Budget for the eye rendering.
+	double LastGpuMs;        // Last measurement the controller acted on.
+	unsigned int LastGpuFrame; // ... and the frame it was measured in.
+	unsigned int Headroom;   // Consecutive measurements comfortably under budget.
+	unsigned int ScaleFrame; // First frame rendered at the current scale.
+	bool Restarted;          // Scale set by InitializeDynamicResolution, ScaleFrame not known yet.
+};
+
+extern DynamicResolutionState g_DynamicResolution;
+
+// p_TargetGpuMs is the GPU time the eye rendering may take. Starts at p_InitialScale.
+void InitializeDynamicResolution(bool p_Enabled, double p_TargetGpuMs, float p_InitialScale);
+
+// Feeds the newest GPU measurement (negative if there is none), taken in frame p_GpuFrame, and
+// returns the viewport scale for the coming frame p_FrameIndex. A measurement already fed is
+// ignored, calling this every frame with whatever the profiler has last is fine.
+float UpdateDynamicResolution(double p_GpuMs, unsigned int p_GpuFrame, unsigned int p_FrameIndex);
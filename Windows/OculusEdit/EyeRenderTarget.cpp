@@ -0,0 +1,277 @@
+//
+//  EyeRenderTarget.cpp
+//  OculusEdit
+//
+
+#include "EyeRenderTarget.h"
+
+#include <stdio.h>
+
+#include "Profiler.h"
+
+EyeRenderTargetPool g_EyeRenderTargets;
+
+static bool CreateEyeRenderTarget(OVR::Sizei p_Size, EyeRenderTarget& p_Target)
+{
+	p_Target.Fence = 0;
+
+	// Create the FBO being a single one for both eyes (using one texture for both is open for debate)...
+	// Because we are binding this buffer to the GL_FRAMEBUFFER OpenGL target, it will be used for
+	// both drawing and reading functions. This replaces the default OpenGL framebuffer and allows
+	// us (and LibOVR) to control the rendering pipeline specifically instead of just writing to
+	// the screen itself. LibOVR needs to read this framebuffer to be able to warp it during rendering.
+	glGenFramebuffers(1, &p_Target.Framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, p_Target.Framebuffer);
+
+	// Create the texture we're going to render to...
+	glGenTextures(1, &p_Target.ColorTexture);
+	// "Bind" the newly created texture : all future texture functions will modify this texture...
+	glBindTexture(GL_TEXTURE_2D, p_Target.ColorTexture);
+	// Give an empty image to OpenGL (the last "0")
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, p_Size.w, p_Size.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	// Linear filtering...
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+	// Create Depth Buffer (Depth Buffers are just special types of RenderBuffers). Sized like the
+	// multisampled one, depth only copies between matching formats (stereo reprojection)...
+	glGenRenderbuffers(1, &p_Target.DepthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, p_Target.DepthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GetEyeDepthFormat(), p_Size.w, p_Size.h);
+	// Bind the depth buffer (Z buffer) to our custom framebuffer:
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, p_Target.DepthBuffer);
+	// Set the texture as our colour attachment #0...
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, p_Target.ColorTexture, 0);
+
+	// Set the list of draw buffers...
+	GLenum l_GLDrawBuffers[1] = { GL_COLOR_ATTACHMENT0 };
+	glDrawBuffers(1, l_GLDrawBuffers); // "1" is the size of DrawBuffers
+
+	// Check if everything is OK...
+	const GLenum l_Check = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	return l_Check == GL_FRAMEBUFFER_COMPLETE;
+}
+
+static void DestroyMultisampleFramebuffer(void)
+{
+	if (g_EyeRenderTargets.MultisampleFramebuffer == 0)
+		return;
+
+	glDeleteRenderbuffers(1, &g_EyeRenderTargets.MultisampleDepth);
+	glDeleteRenderbuffers(1, &g_EyeRenderTargets.MultisampleColor);
+	glDeleteFramebuffers(1, &g_EyeRenderTargets.MultisampleFramebuffer);
+	g_EyeRenderTargets.MultisampleFramebuffer = 0;
+	g_EyeRenderTargets.MultisampleColor = 0;
+	g_EyeRenderTargets.MultisampleDepth = 0;
+}
+
+static bool CreateMultisampleFramebuffer(OVR::Sizei p_Size, unsigned int p_Samples)
+{
+	// Same layout as the targets, but both attachments are multisampled renderbuffers (never sampled as textures)...
+	glGenFramebuffers(1, &g_EyeRenderTargets.MultisampleFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, g_EyeRenderTargets.MultisampleFramebuffer);
+
+	glGenRenderbuffers(1, &g_EyeRenderTargets.MultisampleColor);
+	glBindRenderbuffer(GL_RENDERBUFFER, g_EyeRenderTargets.MultisampleColor);
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, p_Samples, GL_RGBA8, p_Size.w, p_Size.h);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, g_EyeRenderTargets.MultisampleColor);
+
+	glGenRenderbuffers(1, &g_EyeRenderTargets.MultisampleDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, g_EyeRenderTargets.MultisampleDepth);
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, p_Samples, GetEyeDepthFormat(), p_Size.w, p_Size.h);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, g_EyeRenderTargets.MultisampleDepth);
+
+	GLenum l_GLDrawBuffers[1] = { GL_COLOR_ATTACHMENT0 };
+	glDrawBuffers(1, l_GLDrawBuffers);
+
+	const GLenum l_Check = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	return l_Check == GL_FRAMEBUFFER_COMPLETE;
+}
+
+bool CreateEyeRenderTargets(OVR::Sizei p_Size, unsigned int p_Count, bool p_ReverseZ)
+{
+	if (p_Count < 1) p_Count = 1;
+	if (p_Count > EYE_RENDER_TARGET_MAX_COUNT) p_Count = EYE_RENDER_TARGET_MAX_COUNT;
+
+	g_EyeRenderTargets.Count = p_Count;
+	g_EyeRenderTargets.Current = p_Count - 1; // The first acquire moves on to target 0...
+	g_EyeRenderTargets.Size = p_Size;
+	g_EyeRenderTargets.Samples = 1;
+	g_EyeRenderTargets.MultisampleFramebuffer = 0;
+	g_EyeRenderTargets.MultisampleColor = 0;
+	g_EyeRenderTargets.MultisampleDepth = 0;
+	g_EyeRenderTargets.ReverseZ = p_ReverseZ && ReverseZSupported();
+	if (p_ReverseZ && !g_EyeRenderTargets.ReverseZ)
+		printf("glClipControl not supported, reverse-Z disabled.\n");
+
+	for (unsigned int i = 0; i < p_Count; i++)
+	{
+		if (!CreateEyeRenderTarget(p_Size, g_EyeRenderTargets.Targets[i]))
+		{
+			printf("There is a problem with the FBO.\n");
+			return false;
+		}
+	}
+	return true;
+}
+
+void DestroyEyeRenderTargets(void)
+{
+	DestroyMultisampleFramebuffer();
+	g_EyeRenderTargets.Samples = 1;
+
+	for (unsigned int i = 0; i < g_EyeRenderTargets.Count; i++)
+	{
+		EyeRenderTarget& l_Target = g_EyeRenderTargets.Targets[i];
+		if (l_Target.Fence)
+			glDeleteSync(l_Target.Fence);
+		glDeleteRenderbuffers(1, &l_Target.DepthBuffer);
+		glDeleteTextures(1, &l_Target.ColorTexture);
+		glDeleteFramebuffers(1, &l_Target.Framebuffer);
+	}
+	g_EyeRenderTargets.Count = 0;
+}
+
+const EyeRenderTarget& AcquireEyeRenderTarget(void)
+{
+	g_EyeRenderTargets.Current = (g_EyeRenderTargets.Current + 1) % g_EyeRenderTargets.Count;
+	EyeRenderTarget& l_Target = g_EyeRenderTargets.Targets[g_EyeRenderTargets.Current];
+
+	// This fence is a frame or two old and normally signaled already (a single target has none). The
+	// target isn't handed back before it has: a timeout just waits again, a failed wait waits for everything...
+	if (l_Target.Fence)
+	{
+		ProfileZone l_Zone("WaitRenderTarget", -1, false);
+		GLenum l_Status;
+		do
+		{
+			l_Status = glClientWaitSync(l_Target.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+		} while (l_Status == GL_TIMEOUT_EXPIRED);
+		if (l_Status == GL_WAIT_FAILED)
+			glFinish();
+		glDeleteSync(l_Target.Fence);
+		l_Target.Fence = 0;
+	}
+	return l_Target;
+}
+
+void ReleaseEyeRenderTarget(void)
+{
+	// A single target is rendered into right after its last use anyway, the GL orders that on its own
+	// and waiting on the CPU would only serialize the two...
+	if (g_EyeRenderTargets.Count < 2)
+		return;
+
+	EyeRenderTarget& l_Target = g_EyeRenderTargets.Targets[g_EyeRenderTargets.Current];
+	if (l_Target.Fence)
+		glDeleteSync(l_Target.Fence);
+	l_Target.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+unsigned int SetEyeRenderTargetSamples(unsigned int p_Samples)
+{
+	GLint l_MaxSamples = 1;
+	glGetIntegerv(GL_MAX_SAMPLES, &l_MaxSamples);
+
+	unsigned int l_Samples = 1;
+	while (l_Samples * 2 <= p_Samples && l_Samples * 2 <= 8 && (GLint)(l_Samples * 2) <= l_MaxSamples)
+		l_Samples *= 2;
+
+	if (l_Samples == g_EyeRenderTargets.Samples)
+		return l_Samples;
+
+	// The old multisampled buffers may still be in flight, GL keeps them alive until the GPU is done...
+	DestroyMultisampleFramebuffer();
+	g_EyeRenderTargets.Samples = 1;
+	if (l_Samples > 1)
+	{
+		if (!CreateMultisampleFramebuffer(g_EyeRenderTargets.Size, l_Samples))
+		{
+			printf("There is a problem with the %ux MSAA FBO, rendering without MSAA.\n", l_Samples);
+			DestroyMultisampleFramebuffer();
+			return 1;
+		}
+		g_EyeRenderTargets.Samples = l_Samples;
+	}
+	return g_EyeRenderTargets.Samples;
+}
+
+bool ReverseZSupported(void)
+{
+#if !defined(__APPLE__)
+	return GLEW_VERSION_4_5 || GLEW_ARB_clip_control;
+#else
+	return false;
+#endif
+}
+
+GLenum GetEyeDepthFormat(void)
+{
+	return g_EyeRenderTargets.ReverseZ ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24;
+}
+
+GLenum GetEyeDepthFunc(void)
+{
+	return g_EyeRenderTargets.ReverseZ ? GL_GREATER : GL_LESS;
+}
+
+void SetEyeProjectionDepth(OVR::Matrix4f& p_Projection, float p_Near, float p_Far)
+{
+	// Clip z = a * w + b with w the distance in front of the eye, M[3][2] (-1) turns view z into w...
+	const float l_A = g_EyeRenderTargets.ReverseZ ? -p_Near / (p_Far - p_Near) : (p_Far + p_Near) / (p_Far - p_Near);
+	const float l_B = g_EyeRenderTargets.ReverseZ ? p_Far * p_Near / (p_Far - p_Near) : -2.0f * p_Far * p_Near / (p_Far - p_Near);
+	p_Projection.M[2][0] = 0.0f;
+	p_Projection.M[2][1] = 0.0f;
+	p_Projection.M[2][2] = p_Projection.M[3][2] * l_A;
+	p_Projection.M[2][3] = l_B;
+}
+
+void BeginEyeDepth(void)
+{
+	if (!g_EyeRenderTargets.ReverseZ)
+		return;
+
+#if !defined(__APPLE__)
+	glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+#endif
+	glDepthFunc(GL_GREATER);
+	glClearDepth(0.0);
+}
+
+void EndEyeDepth(void)
+{
+	if (!g_EyeRenderTargets.ReverseZ)
+		return;
+
+#if !defined(__APPLE__)
+	glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+#endif
+	glDepthFunc(GL_LESS);
+	glClearDepth(1.0);
+}
+
+GLuint GetEyeRenderFramebuffer(const EyeRenderTarget& p_Target)
+{
+	return g_EyeRenderTargets.MultisampleFramebuffer ? g_EyeRenderTargets.MultisampleFramebuffer : p_Target.Framebuffer;
+}
+
+void ResolveEyeRenderTarget(const EyeRenderTarget& p_Target, int p_Width, int p_Height)
+{
+	if (g_EyeRenderTargets.MultisampleFramebuffer == 0)
+		return;
+
+	// Only color is resolved, LibOVR has no use for depth...
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, g_EyeRenderTargets.MultisampleFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, p_Target.Framebuffer);
+	glBlitFramebuffer(0, 0, p_Width, p_Height, 0, 0, p_Width, p_Height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
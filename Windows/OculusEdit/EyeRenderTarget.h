@@ -0,0 +1,95 @@
+//
+//  EyeRenderTarget.h
+//  OculusEdit
+//
+//  Pool of eye render targets (FBO + color texture + depth buffer, both eyes side by
+//  side). The pool rotates through them so a frame never renders into the texture the
+//  SDK distortion pass of the previous frame may still be reading. Every target is
+//  fenced once its frame has been submitted, and only waited on when it comes around
+//  again. A pool of one has no fence, the GL orders the reuse on its own.
+//  With MSAA on, the scene goes into one shared multisampled FBO (color and depth
+//  renderbuffers) that gets resolved into the current target's texture at the end of
+//  the eye rendering, LibOVR only ever sees resolved textures.
+//  With reverse-Z the depth buffers are 32-bit float and the eye projections map the
+//  near plane to 1 and the far one to 0 (glClipControl with a [0, 1] clip range, so
+//  the projection's precision isn't halved on the way). Float precision follows 1 / z
+//  that way, depth is about as precise at 100 m as it is up close. Anything drawing
+//  into the eye buffers goes between BeginEyeDepth and EndEyeDepth and compares with
+//  GetEyeDepthFunc.
+//
+
+#pragma once
+
+#if !defined(__APPLE__)
+#  include <GL/glew.h>
+#else
+#  include <OpenGL/gl3.h>
+#endif
+
+#include "OVR.h"
+
+const unsigned int EYE_RENDER_TARGET_MAX_COUNT = 3;
+
+struct EyeRenderTarget
+{
+	GLuint Framebuffer;
+	GLuint ColorTexture;  // Handed to LibOVR.
+	GLuint DepthBuffer;
+	GLsync Fence;         // Set when the frame using the target was submitted, 0 if free.
+};
+
+struct EyeRenderTargetPool
+{
+	EyeRenderTarget Targets[EYE_RENDER_TARGET_MAX_COUNT];
+	unsigned int Count;
+	unsigned int Current;
+	OVR::Sizei Size;
+
+	unsigned int Samples;          // 1 renders straight into the targets.
+	GLuint MultisampleFramebuffer; // 0 unless Samples > 1.
+	GLuint MultisampleColor;
+	GLuint MultisampleDepth;
+
+	bool ReverseZ;                 // Float depth, 1 at the near plane and 0 at the far one.
+};
+
+extern EyeRenderTargetPool g_EyeRenderTargets;
+
+// Creates p_Count (1 to EYE_RENDER_TARGET_MAX_COUNT) targets of p_Size. Returns false if an FBO is incomplete.
+// p_ReverseZ stays off if the GL has no glClipControl.
+bool CreateEyeRenderTargets(OVR::Sizei p_Size, unsigned int p_Count, bool p_ReverseZ);
+void DestroyEyeRenderTargets(void);
+
+// Moves on to the next target, waiting for the GPU to be done with it if needed (never with a single target).
+const EyeRenderTarget& AcquireEyeRenderTarget(void);
+
+// Call once the frame rendered into the current target has been submitted.
+void ReleaseEyeRenderTarget(void);
+
+// Changes the MSAA sample count (1, 2, 4 or 8, clamped to what the GL supports). Returns the count in use.
+unsigned int SetEyeRenderTargetSamples(unsigned int p_Samples);
+
+// The framebuffer to draw the eyes of p_Target into: the multisampled one, or the target itself.
+GLuint GetEyeRenderFramebuffer(const EyeRenderTarget& p_Target);
+
+// Reverse-Z needs glClipControl (GL 4.5 or GL_ARB_clip_control).
+bool ReverseZSupported(void);
+
+// Depth format of the eye buffers, for whatever depth gets copied out of them.
+GLenum GetEyeDepthFormat(void);
+
+// The depth test of the eye buffers: GL_LESS, or GL_GREATER with reverse-Z.
+GLenum GetEyeDepthFunc(void);
+
+// Replaces the depth row of p_Projection (a right handed ovrMatrix4f_Projection) with one for p_Near
+// to p_Far in the eye buffers' convention: GL style -1 to 1, or 1 to 0 with reverse-Z.
+void SetEyeProjectionDepth(OVR::Matrix4f& p_Projection, float p_Near, float p_Far);
+
+// Clip control, depth test and clear depth for drawing into the eye buffers, and back to the GL
+// defaults for everything else (the shadow maps, the distortion).
+void BeginEyeDepth(void);
+void EndEyeDepth(void);
+
+// Resolves the multisampled framebuffer into p_Target (only the p_Width x p_Height corner the eye
+// viewports use). Does nothing without MSAA.
+void ResolveEyeRenderTarget(const EyeRenderTarget& p_Target, int p_Width, int p_Height);
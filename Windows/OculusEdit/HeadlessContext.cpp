@@ -0,0 +1,135 @@
+//
+//  HeadlessContext.cpp
+//  OculusEdit
+//
+
+#include "HeadlessContext.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux__)
+#  include <EGL/egl.h>
+#  include <EGL/eglext.h>
+
+#  ifndef EGL_PLATFORM_SURFACELESS_MESA
+#    define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#  endif
+
+static EGLDisplay l_Display = EGL_NO_DISPLAY;
+static EGLContext l_Context = EGL_NO_CONTEXT;
+static EGLSurface l_Surface = EGL_NO_SURFACE;
+
+static bool HasExtension(const char* p_Extensions, const char* p_Name)
+{
+	if (!p_Extensions)
+		return false;
+
+	const size_t l_Length = strlen(p_Name);
+	const char* l_Position = p_Extensions;
+	while ((l_Position = strstr(l_Position, p_Name)) != NULL)
+	{
+		if ((l_Position == p_Extensions || l_Position[-1] == ' ') && (l_Position[l_Length] == ' ' || l_Position[l_Length] == '\0'))
+			return true;
+		l_Position += l_Length;
+	}
+	return false;
+}
+
+bool CreateHeadlessContext(void)
+{
+	// Prefer the surfaceless platform, it doesn't need an X server or a DRM device...
+	PFNEGLGETPLATFORMDISPLAYEXTPROC l_GetPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (l_GetPlatformDisplay && HasExtension(eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS), "EGL_MESA_platform_surfaceless"))
+	{
+		l_Display = l_GetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	if (l_Display == EGL_NO_DISPLAY)
+	{
+		l_Display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+
+	EGLint l_Major, l_Minor;
+	if (l_Display == EGL_NO_DISPLAY || !eglInitialize(l_Display, &l_Major, &l_Minor))
+	{
+		printf("Could not initialize EGL.\n");
+		return false;
+	}
+	printf("EGL: %d.%d\n", l_Major, l_Minor);
+
+	const bool l_Surfaceless = HasExtension(eglQueryString(l_Display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+	// We render into our own FBO, so the default framebuffer doesn't matter. A zero surface
+	// type mask matches every config, which is what we want when going surfaceless...
+	const EGLint l_ConfigAttributes[] = {
+		EGL_SURFACE_TYPE, l_Surfaceless ? 0 : EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig l_Config;
+	EGLint l_ConfigCount = 0;
+	if (!eglChooseConfig(l_Display, l_ConfigAttributes, &l_Config, 1, &l_ConfigCount) || l_ConfigCount == 0)
+	{
+		printf("No usable EGL config found.\n");
+		DestroyHeadlessContext();
+		return false;
+	}
+
+	// Desktop GL (compatibility profile, same as the GLFW window gets)...
+	eglBindAPI(EGL_OPENGL_API);
+	l_Context = eglCreateContext(l_Display, l_Config, EGL_NO_CONTEXT, NULL);
+	if (l_Context == EGL_NO_CONTEXT)
+	{
+		printf("Could not create the EGL context.\n");
+		DestroyHeadlessContext();
+		return false;
+	}
+
+	if (!l_Surfaceless)
+	{
+		const EGLint l_PbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		l_Surface = eglCreatePbufferSurface(l_Display, l_Config, l_PbufferAttributes);
+	}
+
+	if (!eglMakeCurrent(l_Display, l_Surface, l_Surface, l_Context))
+	{
+		printf("Could not make the EGL context current.\n");
+		DestroyHeadlessContext();
+		return false;
+	}
+
+	return true;
+}
+
+void DestroyHeadlessContext(void)
+{
+	if (l_Display == EGL_NO_DISPLAY)
+		return;
+
+	eglMakeCurrent(l_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (l_Surface != EGL_NO_SURFACE)
+		eglDestroySurface(l_Display, l_Surface);
+	if (l_Context != EGL_NO_CONTEXT)
+		eglDestroyContext(l_Display, l_Context);
+	eglTerminate(l_Display);
+
+	l_Display = EGL_NO_DISPLAY;
+	l_Context = EGL_NO_CONTEXT;
+	l_Surface = EGL_NO_SURFACE;
+}
+
+#else
+
+bool CreateHeadlessContext(void)
+{
+	return false;
+}
+
+void DestroyHeadlessContext(void)
+{
+}
+
+#endif
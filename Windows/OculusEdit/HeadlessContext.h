@@ -0,0 +1,17 @@
+//
+//  HeadlessContext.h
+//  OculusEdit
+//
+//  Offscreen OpenGL context for running the draw loop on machines without a
+//  display or HMD. On Linux this is an EGL context on Mesa's surfaceless platform
+//  (falling back to the default display with a 1x1 pbuffer), which also works on
+//  software rasterizers. Other platforms return false and the caller falls back to
+//  a hidden GLFW window.
+//
+
+#pragma once
+
+// Creates the context and makes it current. Returns false if no offscreen context could be created.
+bool CreateHeadlessContext(void);
+
+void DestroyHeadlessContext(void);
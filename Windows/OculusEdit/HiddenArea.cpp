@@ -0,0 +1,214 @@
+//
+//  HiddenArea.cpp
+//  OculusEdit
+//
+
+#include "HiddenArea.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#if !defined(__APPLE__)
+#  include <GL/glew.h>
+#else
+#  include <OpenGL/gl3.h>
+#endif
+
+#include "EyeRenderTarget.h"
+#include "Shader.h"
+
+HiddenAreaState g_HiddenArea = { false, { 0.0f, 0.0f } };
+
+// The visible outline is a polygon around the eye's center with a vertex every 360 / HIDDEN_AREA_SECTORS
+// degrees. The mask goes from there out to HIDDEN_AREA_OUTER, well past the corners of the viewport
+// (clipping cuts it back to the viewport)...
+static const int HIDDEN_AREA_SECTORS = 64;
+static const float HIDDEN_AREA_OUTER = 4.0f;
+// Pushes the outline out a little: the chords between its vertices cut into the visible area...
+static const float HIDDEN_AREA_MARGIN = 1.02f;
+
+static GLuint l_Program = 0;
+static GLuint l_VertexArrays[2] = { 0, 0 };
+static GLuint l_Buffers[2] = { 0, 0 };
+static GLsizei l_VertexCounts[2] = { 0, 0 };
+
+// Straight to the near plane (-1, or 1 with reverse-Z), the color writes are masked off anyway...
+static const std::string l_VertexShader(
+	SHADER_GLSL_VERSION
+	"layout (location = 0) in vec2 position;\n"
+	"uniform float nearDepth;\n"
+	"void main()\n"
+	"{\n"
+	"   gl_Position = vec4(position, nearDepth, 1.0);\n"
+	"}\n"
+	);
+
+static const std::string l_FragmentShader(
+	SHADER_GLSL_VERSION
+	"out vec4 outputColor;\n"
+	"void main()\n"
+	"{\n"
+	"   outputColor = vec4(0.0);\n"
+	"}\n"
+	);
+
+static int SectorOf(float p_X, float p_Y)
+{
+	const float l_Angle = atan2f(p_Y, p_X);
+	const int l_Sector = (int)floorf((l_Angle + MATH_FLOAT_PI) / (2.0f * MATH_FLOAT_PI) * HIDDEN_AREA_SECTORS);
+	return (l_Sector + HIDDEN_AREA_SECTORS) % HIDDEN_AREA_SECTORS;
+}
+
+// Outline radius per sector, in viewport coordinates ([-1, 1] both ways) around p_Center. Sectors the
+// distortion mesh doesn't reach keep HIDDEN_AREA_OUTER, nothing gets masked there.
+static bool ComputeVisibleOutline(ovrHmd p_Hmd, ovrEyeType p_Eye, const ovrFovPort& p_Fov, unsigned int p_DistortionCaps, float p_Center[2], float p_Radii[HIDDEN_AREA_SECTORS])
+{
+	ovrDistortionMesh l_Mesh;
+	if (!ovrHmd_CreateDistortionMesh(p_Hmd, p_Eye, p_Fov, p_DistortionCaps, &l_Mesh))
+		return false;
+
+	// Tangents of the eye angles to the viewport, like the projection does it (tangent space has y down)...
+	const float l_ScaleX = 2.0f / (p_Fov.LeftTan + p_Fov.RightTan);
+	const float l_OffsetX = (p_Fov.LeftTan - p_Fov.RightTan) * l_ScaleX * 0.5f;
+	const float l_ScaleY = 2.0f / (p_Fov.UpTan + p_Fov.DownTan);
+	const float l_OffsetY = (p_Fov.UpTan - p_Fov.DownTan) * l_ScaleY * 0.5f;
+	p_Center[0] = l_OffsetX;
+	p_Center[1] = -l_OffsetY;
+
+	bool l_Reached[HIDDEN_AREA_SECTORS] = { false };
+	for (int i = 0; i < HIDDEN_AREA_SECTORS; i++)
+		p_Radii[i] = 0.0f;
+
+	for (unsigned int i = 0; i < l_Mesh.VertexCount; i++)
+	{
+		const ovrDistortionVertex& l_Vertex = l_Mesh.pVertexData[i];
+		if (l_Vertex.VignetteFactor <= 0.0f)
+			continue;
+
+		// Chromatic aberration correction samples every channel somewhere else, the outline has to hold all three...
+		const ovrVector2f l_Tangents[3] = { l_Vertex.TanEyeAnglesR, l_Vertex.TanEyeAnglesG, l_Vertex.TanEyeAnglesB };
+		for (int c = 0; c < 3; c++)
+		{
+			const float l_X = l_Tangents[c].x * l_ScaleX + l_OffsetX - p_Center[0];
+			const float l_Y = -(l_Tangents[c].y * l_ScaleY + l_OffsetY) - p_Center[1];
+			const float l_Radius = sqrtf(l_X * l_X + l_Y * l_Y);
+
+			// A vertex stands for the area around it, so it counts for the neighbouring sectors too...
+			const int l_Sector = SectorOf(l_X, l_Y);
+			for (int d = -1; d <= 1; d++)
+			{
+				const int l_Neighbour = (l_Sector + d + HIDDEN_AREA_SECTORS) % HIDDEN_AREA_SECTORS;
+				l_Reached[l_Neighbour] = true;
+				if (l_Radius > p_Radii[l_Neighbour])
+					p_Radii[l_Neighbour] = l_Radius;
+			}
+		}
+	}
+	ovrHmd_DestroyDistortionMesh(&l_Mesh);
+
+	for (int i = 0; i < HIDDEN_AREA_SECTORS; i++)
+	{
+		p_Radii[i] = l_Reached[i] ? p_Radii[i] * HIDDEN_AREA_MARGIN : HIDDEN_AREA_OUTER;
+		if (p_Radii[i] > HIDDEN_AREA_OUTER)
+			p_Radii[i] = HIDDEN_AREA_OUTER;
+	}
+	return true;
+}
+
+// How much of the viewport lies outside the outline, from a grid of samples...
+static float ComputeHiddenFraction(const float p_Center[2], const float p_Radii[HIDDEN_AREA_SECTORS])
+{
+	const int l_Samples = 128;
+	int l_Hidden = 0;
+	for (int y = 0; y < l_Samples; y++)
+	{
+		for (int x = 0; x < l_Samples; x++)
+		{
+			const float l_X = (x + 0.5f) / l_Samples * 2.0f - 1.0f - p_Center[0];
+			const float l_Y = (y + 0.5f) / l_Samples * 2.0f - 1.0f - p_Center[1];
+			if (sqrtf(l_X * l_X + l_Y * l_Y) > p_Radii[SectorOf(l_X, l_Y)])
+				++l_Hidden;
+		}
+	}
+	return (float)l_Hidden / (float)(l_Samples * l_Samples);
+}
+
+void InitializeHiddenArea(ovrHmd p_Hmd, const ovrFovPort p_Fov[2], unsigned int p_DistortionCaps, bool p_Enabled)
+{
+	g_HiddenArea.Enabled = p_Enabled;
+	l_Program = CreateProgram(l_VertexShader, l_FragmentShader);
+	glUseProgram(l_Program);
+	glUniform1f(glGetUniformLocation(l_Program, "nearDepth"), g_EyeRenderTargets.ReverseZ ? 1.0f : -1.0f);
+	glUseProgram(0);
+	glGenVertexArrays(2, l_VertexArrays);
+	glGenBuffers(2, l_Buffers);
+
+	for (int l_Eye = 0; l_Eye < 2; l_Eye++)
+	{
+		float l_Center[2];
+		float l_Radii[HIDDEN_AREA_SECTORS];
+		if (!ComputeVisibleOutline(p_Hmd, (ovrEyeType)l_Eye, p_Fov[l_Eye], p_DistortionCaps, l_Center, l_Radii))
+		{
+			printf("No distortion mesh for the %s eye, it gets no hidden area mask.\n", l_Eye == ovrEye_Left ? "left" : "right");
+			l_VertexCounts[l_Eye] = 0;
+			g_HiddenArea.Fraction[l_Eye] = 0.0f;
+			continue;
+		}
+
+		// A strip around the outline: inner and outer vertex of every sector direction, closed at the end...
+		std::vector<GLfloat> l_Vertices;
+		for (int i = 0; i <= HIDDEN_AREA_SECTORS; i++)
+		{
+			const int l_Sector = i % HIDDEN_AREA_SECTORS;
+			const float l_Angle = (l_Sector + 0.5f) / HIDDEN_AREA_SECTORS * 2.0f * MATH_FLOAT_PI - MATH_FLOAT_PI;
+			const float l_X = cosf(l_Angle);
+			const float l_Y = sinf(l_Angle);
+			l_Vertices.push_back(l_Center[0] + l_X * l_Radii[l_Sector]);
+			l_Vertices.push_back(l_Center[1] + l_Y * l_Radii[l_Sector]);
+			l_Vertices.push_back(l_Center[0] + l_X * HIDDEN_AREA_OUTER);
+			l_Vertices.push_back(l_Center[1] + l_Y * HIDDEN_AREA_OUTER);
+		}
+		l_VertexCounts[l_Eye] = (GLsizei)(l_Vertices.size() / 2);
+		g_HiddenArea.Fraction[l_Eye] = ComputeHiddenFraction(l_Center, l_Radii);
+
+		glBindVertexArray(l_VertexArrays[l_Eye]);
+		glBindBuffer(GL_ARRAY_BUFFER, l_Buffers[l_Eye]);
+		glBufferData(GL_ARRAY_BUFFER, l_Vertices.size() * sizeof(GLfloat), &l_Vertices[0], GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	printf("Hidden area: %.1f%% of the left and %.1f%% of the right eye viewport.\n", g_HiddenArea.Fraction[0] * 100.0f, g_HiddenArea.Fraction[1] * 100.0f);
+}
+
+void DestroyHiddenArea(void)
+{
+	glDeleteProgram(l_Program);
+	glDeleteVertexArrays(2, l_VertexArrays);
+	glDeleteBuffers(2, l_Buffers);
+	l_Program = 0;
+	l_VertexArrays[0] = l_VertexArrays[1] = 0;
+	l_Buffers[0] = l_Buffers[1] = 0;
+	l_VertexCounts[0] = l_VertexCounts[1] = 0;
+}
+
+void DrawHiddenArea(int p_Eye)
+{
+	if (!g_HiddenArea.Enabled || !l_Program || l_VertexCounts[p_Eye] == 0)
+		return;
+
+	// Depth only, and always...
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthFunc(GL_ALWAYS);
+	glUseProgram(l_Program);
+	glBindVertexArray(l_VertexArrays[p_Eye]);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, l_VertexCounts[p_Eye]);
+	glBindVertexArray(0);
+	glUseProgram(0);
+	glDepthFunc(GetEyeDepthFunc());
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
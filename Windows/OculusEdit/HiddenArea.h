@@ -0,0 +1,37 @@
+//
+//  HiddenArea.h
+//  OculusEdit
+//
+//  Hidden area masks. The lenses only ever show a rounded part of each eye's viewport,
+//  the corners outside it are never sampled by the distortion (or only ever come out
+//  black through the vignette). The visible outline is taken from LibOVR's distortion
+//  mesh for the eye's FOV, everything between it and the edges of the viewport becomes
+//  a mesh that is drawn into the depth buffer at the near plane right after the clear.
+//  Every later fragment there fails the depth test early, before any shading.
+//
+//  The eye render targets have no stencil, so the mask lives in depth. The meshes are in
+//  the eye's normalized viewport coordinates, a scaled viewport (dynamic resolution)
+//  scales them along.
+//
+
+#pragma once
+
+#include "OVR.h"
+#include "OVR_CAPI.h"
+
+struct HiddenAreaState
+{
+	bool Enabled;
+	float Fraction[2]; // Share of each eye's viewport the mask covers.
+};
+
+extern HiddenAreaState g_HiddenArea;
+
+// Needs a current GL context. Builds the masks for the eye FOVs (the ones the distortion is
+// configured with) and p_DistortionCaps.
+void InitializeHiddenArea(ovrHmd p_Hmd, const ovrFovPort p_Fov[2], unsigned int p_DistortionCaps, bool p_Enabled);
+void DestroyHiddenArea(void);
+
+// Writes the mask of p_Eye into the depth buffer of the current viewport. Call right after the
+// depth clear, before anything else is drawn for that eye.
+void DrawHiddenArea(int p_Eye);
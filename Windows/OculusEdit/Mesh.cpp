@@ -0,0 +1,334 @@
+//
+//  Mesh.cpp
+//  OculusEdit
+//
+
+#include "Mesh.h"
+
+#include <math.h>
+#include <stddef.h>
+
+std::vector<Mesh> g_Meshes;
+
+// The shared buffers of the meshes with 16 bit indices, sizes and capacities are in vertices and indices...
+static GLuint l_ArenaVertexArray = 0;
+static GLuint l_ArenaVertexBuffer = 0;
+static GLuint l_ArenaIndexBuffer = 0;
+static GLsizei l_ArenaVertexCount = 0;
+static GLsizei l_ArenaVertexCapacity = 0;
+static GLsizei l_ArenaIndexCount = 0;
+static GLsizei l_ArenaIndexCapacity = 0;
+
+// Generic attributes for the shader programs (see MESH_ATTRIBUTE_*), for the vertex buffer bound to GL_ARRAY_BUFFER...
+static void SetupVertexAttributes(void)
+{
+	glEnableVertexAttribArray(MESH_ATTRIBUTE_POSITION);
+	glVertexAttribPointer(MESH_ATTRIBUTE_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, Position));
+	glEnableVertexAttribArray(MESH_ATTRIBUTE_NORMAL);
+	glVertexAttribPointer(MESH_ATTRIBUTE_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, Normal));
+}
+
+// Moves p_Buffer into a new one of p_NewSize bytes, keeping the first p_UsedSize...
+static GLuint GrowBuffer(GLuint p_Buffer, GLsizeiptr p_UsedSize, GLsizeiptr p_NewSize)
+{
+	GLuint l_Buffer;
+	glGenBuffers(1, &l_Buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, l_Buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, p_NewSize, NULL, GL_STATIC_DRAW);
+	if (p_Buffer && p_UsedSize > 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, p_Buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, p_UsedSize);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &p_Buffer);
+	return l_Buffer;
+}
+
+// Makes room for more vertices and indices in the arena, the VAO is pointed at the new buffers...
+static void ReserveArena(GLsizei p_VertexCount, GLsizei p_IndexCount)
+{
+	if (!l_ArenaVertexArray)
+		glGenVertexArrays(1, &l_ArenaVertexArray);
+
+	const bool l_GrowVertices = l_ArenaVertexCount + p_VertexCount > l_ArenaVertexCapacity;
+	const bool l_GrowIndices = l_ArenaIndexCount + p_IndexCount > l_ArenaIndexCapacity;
+	if (!l_GrowVertices && !l_GrowIndices)
+		return;
+
+	// Doubling keeps the copies rare, meshes are mostly created up front anyway...
+	if (l_GrowVertices)
+	{
+		GLsizei l_Capacity = l_ArenaVertexCapacity ? l_ArenaVertexCapacity * 2 : 4096;
+		while (l_Capacity < l_ArenaVertexCount + p_VertexCount)
+			l_Capacity *= 2;
+		l_ArenaVertexBuffer = GrowBuffer(l_ArenaVertexBuffer, l_ArenaVertexCount * sizeof(MeshVertex), l_Capacity * sizeof(MeshVertex));
+		l_ArenaVertexCapacity = l_Capacity;
+	}
+	if (l_GrowIndices)
+	{
+		GLsizei l_Capacity = l_ArenaIndexCapacity ? l_ArenaIndexCapacity * 2 : 16384;
+		while (l_Capacity < l_ArenaIndexCount + p_IndexCount)
+			l_Capacity *= 2;
+		l_ArenaIndexBuffer = GrowBuffer(l_ArenaIndexBuffer, l_ArenaIndexCount * sizeof(GLushort), l_Capacity * sizeof(GLushort));
+		l_ArenaIndexCapacity = l_Capacity;
+	}
+
+	glBindVertexArray(l_ArenaVertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, l_ArenaVertexBuffer);
+	SetupVertexAttributes();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, l_ArenaIndexBuffer);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Center of the bounding box and the farthest vertex from it, close enough to the smallest sphere for culling...
+static void ComputeBoundingSphere(const std::vector<MeshVertex>& p_Vertices, GLfloat p_Sphere[4])
+{
+	GLfloat l_Min[3] = { 0.0f, 0.0f, 0.0f };
+	GLfloat l_Max[3] = { 0.0f, 0.0f, 0.0f };
+	for (size_t i = 0; i < p_Vertices.size(); i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			if (i == 0 || p_Vertices[i].Position[c] < l_Min[c]) l_Min[c] = p_Vertices[i].Position[c];
+			if (i == 0 || p_Vertices[i].Position[c] > l_Max[c]) l_Max[c] = p_Vertices[i].Position[c];
+		}
+	}
+
+	GLfloat l_RadiusSquared = 0.0f;
+	for (int c = 0; c < 3; c++)
+		p_Sphere[c] = (l_Min[c] + l_Max[c]) * 0.5f;
+	for (size_t i = 0; i < p_Vertices.size(); i++)
+	{
+		GLfloat l_DistanceSquared = 0.0f;
+		for (int c = 0; c < 3; c++)
+			l_DistanceSquared += (p_Vertices[i].Position[c] - p_Sphere[c]) * (p_Vertices[i].Position[c] - p_Sphere[c]);
+		if (l_DistanceSquared > l_RadiusSquared)
+			l_RadiusSquared = l_DistanceSquared;
+	}
+	p_Sphere[3] = sqrtf(l_RadiusSquared);
+}
+
+MeshHandle CreateMesh(const std::vector<MeshVertex>& p_Vertices, const std::vector<GLuint>& p_Indices)
+{
+	Mesh l_Mesh;
+	l_Mesh.VertexCount = (GLsizei)p_Vertices.size();
+	l_Mesh.IndexCount = (GLsizei)p_Indices.size();
+	ComputeBoundingSphere(p_Vertices, l_Mesh.BoundingSphere);
+
+	// Half the index bandwidth when every index fits in 16 bits, those meshes go into the arena...
+	l_Mesh.Shared = (p_Vertices.size() <= 0x10000);
+	l_Mesh.IndexType = l_Mesh.Shared ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	if (l_Mesh.Shared)
+	{
+		ReserveArena(l_Mesh.VertexCount, l_Mesh.IndexCount);
+		l_Mesh.VertexArray = l_ArenaVertexArray;
+		l_Mesh.VertexBuffer = 0;
+		l_Mesh.IndexBuffer = 0;
+		l_Mesh.FirstIndex = (GLuint)l_ArenaIndexCount;
+		l_Mesh.BaseVertex = (GLint)l_ArenaVertexCount;
+
+		// The indices stay relative to the mesh, the base vertex moves them to where it lives...
+		std::vector<GLushort> l_ShortIndices(p_Indices.begin(), p_Indices.end());
+		glBindBuffer(GL_ARRAY_BUFFER, l_ArenaVertexBuffer);
+		if (!p_Vertices.empty())
+			glBufferSubData(GL_ARRAY_BUFFER, l_ArenaVertexCount * sizeof(MeshVertex), p_Vertices.size() * sizeof(MeshVertex), &p_Vertices[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, l_ArenaIndexBuffer);
+		if (!l_ShortIndices.empty())
+			glBufferSubData(GL_COPY_WRITE_BUFFER, l_ArenaIndexCount * sizeof(GLushort), l_ShortIndices.size() * sizeof(GLushort), &l_ShortIndices[0]);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		l_ArenaVertexCount += l_Mesh.VertexCount;
+		l_ArenaIndexCount += l_Mesh.IndexCount;
+	}
+	else
+	{
+		l_Mesh.FirstIndex = 0;
+		l_Mesh.BaseVertex = 0;
+
+		glGenVertexArrays(1, &l_Mesh.VertexArray);
+		glBindVertexArray(l_Mesh.VertexArray);
+
+		glGenBuffers(1, &l_Mesh.VertexBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, l_Mesh.VertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, p_Vertices.size() * sizeof(MeshVertex), &p_Vertices[0], GL_STATIC_DRAW);
+
+		glGenBuffers(1, &l_Mesh.IndexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, l_Mesh.IndexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, p_Indices.size() * sizeof(GLuint), p_Indices.empty() ? NULL : &p_Indices[0], GL_STATIC_DRAW);
+
+		SetupVertexAttributes();
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	g_Meshes.push_back(l_Mesh);
+	return (MeshHandle)(g_Meshes.size() - 1);
+}
+
+MeshHandle CreateMeshFromQuads(const GLfloat* p_Positions, const GLfloat* p_Normals, GLsizei p_VertexCount, const GLuint* p_QuadIndices, GLsizei p_IndexCount)
+{
+	std::vector<MeshVertex> l_Vertices(p_VertexCount);
+	for (GLsizei i = 0; i < p_VertexCount; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			l_Vertices[i].Position[c] = p_Positions[i * 3 + c];
+			l_Vertices[i].Normal[c] = p_Normals[i * 3 + c];
+		}
+	}
+
+	// Every quad (a, b, c, d) becomes (a, b, c) and (a, c, d), keeping the winding...
+	std::vector<GLuint> l_Indices;
+	l_Indices.reserve((p_IndexCount / 4) * 6);
+	for (GLsizei i = 0; i + 3 < p_IndexCount; i += 4)
+	{
+		l_Indices.push_back(p_QuadIndices[i + 0]);
+		l_Indices.push_back(p_QuadIndices[i + 1]);
+		l_Indices.push_back(p_QuadIndices[i + 2]);
+		l_Indices.push_back(p_QuadIndices[i + 0]);
+		l_Indices.push_back(p_QuadIndices[i + 2]);
+		l_Indices.push_back(p_QuadIndices[i + 3]);
+	}
+
+	return CreateMesh(l_Vertices, l_Indices);
+}
+
+// Byte offset of the mesh's first index, as the draw calls want it...
+static const void* IndexOffset(const Mesh& p_Mesh)
+{
+	return (const void*)((size_t)p_Mesh.FirstIndex * (p_Mesh.IndexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)));
+}
+
+void DrawMesh(MeshHandle p_Mesh)
+{
+	if (p_Mesh >= g_Meshes.size())
+		return;
+
+	const Mesh& l_Mesh = g_Meshes[p_Mesh];
+	glBindVertexArray(l_Mesh.VertexArray);
+	glDrawElementsBaseVertex(GL_TRIANGLES, l_Mesh.IndexCount, l_Mesh.IndexType, IndexOffset(l_Mesh), l_Mesh.BaseVertex);
+	glBindVertexArray(0);
+}
+
+void DrawMeshInstanced(MeshHandle p_Mesh, GLsizei p_InstanceCount)
+{
+	if (p_Mesh >= g_Meshes.size())
+		return;
+
+	const Mesh& l_Mesh = g_Meshes[p_Mesh];
+	glBindVertexArray(l_Mesh.VertexArray);
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, l_Mesh.IndexCount, l_Mesh.IndexType, IndexOffset(l_Mesh), p_InstanceCount, l_Mesh.BaseVertex);
+	glBindVertexArray(0);
+}
+
+// Points the instance matrix attributes of the bound VAO at p_TransformBuffer, from p_FirstTransform on...
+static void EnableInstanceTransforms(GLuint p_TransformBuffer, GLuint p_FirstTransform, GLuint p_Repeat)
+{
+	// The matrix goes in as four vec4 attributes, advancing once every p_Repeat instances...
+	const GLsizei l_Stride = 16 * sizeof(GLfloat);
+	glBindBuffer(GL_ARRAY_BUFFER, p_TransformBuffer);
+	for (GLuint i = 0; i < 4; i++)
+	{
+		glEnableVertexAttribArray(MESH_ATTRIBUTE_INSTANCE_MODEL + i);
+		glVertexAttribPointer(MESH_ATTRIBUTE_INSTANCE_MODEL + i, 4, GL_FLOAT, GL_FALSE, l_Stride, (void*)((size_t)p_FirstTransform * l_Stride + i * 4 * sizeof(GLfloat)));
+		glVertexAttribDivisor(MESH_ATTRIBUTE_INSTANCE_MODEL + i, p_Repeat);
+	}
+}
+
+// Leave the VAO the way DrawMesh expects it...
+static void DisableInstanceTransforms(void)
+{
+	for (GLuint i = 0; i < 4; i++)
+		glDisableVertexAttribArray(MESH_ATTRIBUTE_INSTANCE_MODEL + i);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void DrawMeshTransformed(MeshHandle p_Mesh, GLuint p_TransformBuffer, GLuint p_FirstTransform, GLsizei p_TransformCount, GLuint p_Repeat)
+{
+	if (p_Mesh >= g_Meshes.size() || p_TransformCount <= 0)
+		return;
+
+	const Mesh& l_Mesh = g_Meshes[p_Mesh];
+	glBindVertexArray(l_Mesh.VertexArray);
+
+	// Pointing the attributes at the first matrix saves needing base instance (GL 4.2)...
+	EnableInstanceTransforms(p_TransformBuffer, p_FirstTransform, p_Repeat);
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, l_Mesh.IndexCount, l_Mesh.IndexType, IndexOffset(l_Mesh), p_TransformCount * p_Repeat, l_Mesh.BaseVertex);
+	DisableInstanceTransforms();
+
+	glBindVertexArray(0);
+}
+
+DrawElementsIndirectCommand GetMeshDrawCommand(MeshHandle p_Mesh)
+{
+	DrawElementsIndirectCommand l_Command = { 0, 0, 0, 0, 0 };
+	if (p_Mesh >= g_Meshes.size())
+		return l_Command;
+
+	const Mesh& l_Mesh = g_Meshes[p_Mesh];
+	l_Command.Count = (GLuint)l_Mesh.IndexCount;
+	l_Command.FirstIndex = l_Mesh.FirstIndex;
+	l_Command.BaseVertex = l_Mesh.BaseVertex;
+	return l_Command;
+}
+
+unsigned int DrawMeshesIndirect(const MeshHandle* p_Meshes, GLsizei p_Count, GLuint p_IndirectBuffer, GLuint p_TransformBuffer, GLuint p_Repeat)
+{
+	unsigned int l_DrawCalls = 0;
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, p_IndirectBuffer);
+	for (GLsizei i = 0; i < p_Count;)
+	{
+		if (p_Meshes[i] >= g_Meshes.size())
+		{
+			++i;
+			continue;
+		}
+
+		// Every shared mesh in a row goes into the same multi-draw...
+		const Mesh& l_Mesh = g_Meshes[p_Meshes[i]];
+		GLsizei l_Run = 1;
+		while (l_Mesh.Shared && i + l_Run < p_Count && p_Meshes[i + l_Run] < g_Meshes.size() && g_Meshes[p_Meshes[i + l_Run]].Shared)
+			++l_Run;
+
+		// The base instance of each command picks its matrices, so the attributes start at the first one...
+		glBindVertexArray(l_Mesh.VertexArray);
+		EnableInstanceTransforms(p_TransformBuffer, 0, p_Repeat);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, l_Mesh.IndexType, (const void*)(i * sizeof(DrawElementsIndirectCommand)), l_Run, 0);
+		DisableInstanceTransforms();
+		glBindVertexArray(0);
+
+		++l_DrawCalls;
+		i += l_Run;
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	return l_DrawCalls;
+}
+
+void DestroyMeshes(void)
+{
+	for (size_t i = 0; i < g_Meshes.size(); i++)
+	{
+		if (g_Meshes[i].Shared)
+			continue;
+		glDeleteVertexArrays(1, &g_Meshes[i].VertexArray);
+		glDeleteBuffers(1, &g_Meshes[i].VertexBuffer);
+		glDeleteBuffers(1, &g_Meshes[i].IndexBuffer);
+	}
+	g_Meshes.clear();
+
+	glDeleteVertexArrays(1, &l_ArenaVertexArray);
+	glDeleteBuffers(1, &l_ArenaVertexBuffer);
+	glDeleteBuffers(1, &l_ArenaIndexBuffer);
+	l_ArenaVertexArray = 0;
+	l_ArenaVertexBuffer = 0;
+	l_ArenaIndexBuffer = 0;
+	l_ArenaVertexCount = l_ArenaVertexCapacity = 0;
+	l_ArenaIndexCount = l_ArenaIndexCapacity = 0;
+}
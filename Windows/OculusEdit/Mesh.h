@@ -0,0 +1,92 @@
+//
+//  Mesh.h
+//  OculusEdit
+//
+//  Static GPU meshes. Geometry is uploaded once into an interleaved vertex buffer
+//  and an index buffer (16 bit indices when they fit), and all the vertex state is
+//  captured in a VAO. Meshes are referred to by handle so any number of scene
+//  objects can share one.
+//
+//  Meshes that fit 16 bit indices all live in one shared vertex/index buffer pair (the
+//  arena) behind a single VAO, each at its own first index and base vertex. That's what
+//  lets one multi-draw indirect call draw any mix of them. Bigger meshes get buffers of
+//  their own.
+//
+
+#pragma once
+
+#include <vector>
+
+#if !defined(__APPLE__)
+#  include <GL/glew.h>
+#else
+#  include <OpenGL/gl3.h>
+#endif
+
+// Generic attribute locations every scene shader uses:
+const GLuint MESH_ATTRIBUTE_POSITION = 0;
+const GLuint MESH_ATTRIBUTE_NORMAL = 1;
+// Per instance object to world matrix (a mat4 takes this location and the three after it):
+const GLuint MESH_ATTRIBUTE_INSTANCE_MODEL = 4;
+
+struct MeshVertex
+{
+	GLfloat Position[3];
+	GLfloat Normal[3];
+};
+
+struct Mesh
+{
+	GLuint VertexArray;  // The arena's VAO for shared meshes.
+	GLuint VertexBuffer; // Own buffers, 0 for shared meshes.
+	GLuint IndexBuffer;
+	GLenum IndexType;    // GL_UNSIGNED_SHORT (always for shared meshes) or GL_UNSIGNED_INT.
+	GLsizei IndexCount;
+	GLsizei VertexCount;
+	GLuint FirstIndex;   // Where the mesh starts in its buffers.
+	GLint BaseVertex;
+	bool Shared;
+	GLfloat BoundingSphere[4]; // Object space center and radius.
+};
+
+// glMultiDrawElementsIndirect's command layout:
+struct DrawElementsIndirectCommand
+{
+	GLuint Count;
+	GLuint InstanceCount;
+	GLuint FirstIndex;
+	GLint BaseVertex;
+	GLuint BaseInstance;
+};
+
+typedef unsigned int MeshHandle;
+const MeshHandle INVALID_MESH_HANDLE = 0xFFFFFFFF;
+
+extern std::vector<Mesh> g_Meshes;
+
+// Uploads an indexed triangle list.
+MeshHandle CreateMesh(const std::vector<MeshVertex>& p_Vertices, const std::vector<GLuint>& p_Indices);
+
+// Same, but from separate position/normal arrays (3 floats each) and quad indices, which get triangulated.
+MeshHandle CreateMeshFromQuads(const GLfloat* p_Positions, const GLfloat* p_Normals, GLsizei p_VertexCount, const GLuint* p_QuadIndices, GLsizei p_IndexCount);
+
+// Binds the mesh VAO and draws it, for shaders using the MESH_ATTRIBUTE_* locations.
+void DrawMesh(MeshHandle p_Mesh);
+
+// Same as DrawMesh, p_InstanceCount times in a single draw call (gl_InstanceID tells them apart).
+void DrawMeshInstanced(MeshHandle p_Mesh, GLsizei p_InstanceCount);
+
+// Draws p_TransformCount copies of the mesh in a single draw call, each with its own matrix (16 floats,
+// row major) out of p_TransformBuffer starting at p_FirstTransform. Every matrix is used for p_Repeat
+// instances in a row (2 for single-pass stereo), so that many times more instances are drawn.
+void DrawMeshTransformed(MeshHandle p_Mesh, GLuint p_TransformBuffer, GLuint p_FirstTransform, GLsizei p_TransformCount, GLuint p_Repeat);
+
+// The command that draws the whole mesh (no instances yet, the caller fills those in).
+DrawElementsIndirectCommand GetMeshDrawCommand(MeshHandle p_Mesh);
+
+// Draws p_Meshes[i] with the i-th command of p_IndirectBuffer (bound to GL_DRAW_INDIRECT_BUFFER),
+// instance transforms like DrawMeshTransformed but found through each command's base instance.
+// Runs of shared meshes go out as one glMultiDrawElementsIndirect. Returns the number of draw calls.
+unsigned int DrawMeshesIndirect(const MeshHandle* p_Meshes, GLsizei p_Count, GLuint p_IndirectBuffer, GLuint p_TransformBuffer, GLuint p_Repeat);
+
+void DestroyMeshes(void);
@@ -0,0 +1,345 @@
+//
+//  MultiResolution.cpp
+//  OculusEdit
+//
+
+#include "MultiResolution.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string>
+
+#include "Profiler.h"
+#include "Shader.h"
+
+MultiResolutionState g_MultiResolution = { false, 1.0f, 1.0f, 1.0f };
+
+// The grid is the same split along x and y, so each axis is laid out on its own. Along an axis the
+// eye's [-1, 1] splits into three segments (periphery, center, periphery)...
+struct MultiResolutionAxis
+{
+	float Split[2];       // Where the center segment starts and ends, in the eye's normalized device coordinates.
+	int ViewportPos[3];   // Per segment: the viewport the eye's clip space is drawn with...
+	int ViewportSize[3];
+	int Start[3];         // ... and the pixels the segment gets in the packed layout.
+	int End[3];
+};
+
+static ovrFovPort l_Fov[2];
+static float l_Center[2][2];           // Projection center of each eye, normalized device coordinates.
+static GLuint l_Framebuffer = 0;        // The packed regions get copied in here...
+static GLuint l_Texture = 0;
+static GLuint l_Program = 0;            // ... and stretched back from here.
+static GLuint l_VertexArray = 0;
+static MultiResolutionUniforms l_Uniforms;
+
+// Where pixel p_Pixel of the eye viewport was drawn in the packed layout. Per axis: the segment the pixel
+// falls in and where that segment's viewport put it, kept half a texel inside the segment so bilinear
+// filtering doesn't pull in its neighbour...
+const char* const MULTI_RESOLUTION_SHADER =
+	"uniform vec4 multiResEyeViewport;\n"
+	"uniform vec4 multiResSplit;\n"
+	"uniform vec4 multiResSegmentsX[3];\n"
+	"uniform vec4 multiResSegmentsY[3];\n"
+	"float MultiResolutionSegment(float ndc, vec2 split, vec4 first, vec4 center, vec4 last)\n"
+	"{\n"
+	"   vec4 segment = ndc < split.x ? first : (ndc < split.y ? center : last);\n"
+	"   return clamp(segment.x + (ndc + 1.0) * 0.5 * segment.y, segment.z + 0.5, segment.w - 0.5);\n"
+	"}\n"
+	"vec2 MultiResolutionPixel(vec2 pixel)\n"
+	"{\n"
+	"   vec2 ndc = (pixel - multiResEyeViewport.xy) / multiResEyeViewport.zw * 2.0 - 1.0;\n"
+	"   return vec2(\n"
+	"      MultiResolutionSegment(ndc.x, multiResSplit.xy, multiResSegmentsX[0], multiResSegmentsX[1], multiResSegmentsX[2]),\n"
+	"      MultiResolutionSegment(ndc.y, multiResSplit.zw, multiResSegmentsY[0], multiResSegmentsY[1], multiResSegmentsY[2]));\n"
+	"}\n";
+
+// A triangle over the whole viewport, from the vertex ID alone...
+static const std::string l_VertexShader(
+	SHADER_GLSL_VERSION
+	"void main()\n"
+	"{\n"
+	"   vec2 position = vec2((gl_VertexID & 1) * 4.0 - 1.0, (gl_VertexID & 2) * 2.0 - 1.0);\n"
+	"   gl_Position = vec4(position, 0.0, 1.0);\n"
+	"}\n"
+	);
+
+static const std::string l_FragmentShader(
+	SHADER_GLSL_VERSION
+	"uniform sampler2D packedTexture;\n"
+	"out vec4 outputColor;\n"
+	+ std::string(MULTI_RESOLUTION_SHADER) +
+	"void main()\n"
+	"{\n"
+	"   outputColor = texture(packedTexture, MultiResolutionPixel(gl_FragCoord.xy) / vec2(textureSize(packedTexture, 0)));\n"
+	"}\n"
+	);
+
+static void LayoutAxis(int p_Pos, int p_Size, float p_Center, MultiResolutionAxis& p_Axis)
+{
+	// The center segment is as wide as it is asked to be, shifted back inside the viewport if needed...
+	const float l_HalfWidth = g_MultiResolution.CenterFraction;
+	float l_Low = p_Center - l_HalfWidth;
+	float l_High = p_Center + l_HalfWidth;
+	if (l_Low < -1.0f)
+	{
+		l_Low = -1.0f;
+		l_High = -1.0f + 2.0f * l_HalfWidth;
+	}
+	else if (l_High > 1.0f)
+	{
+		l_High = 1.0f;
+		l_Low = 1.0f - 2.0f * l_HalfWidth;
+	}
+	p_Axis.Split[0] = l_Low;
+	p_Axis.Split[1] = l_High;
+
+	const float l_Edges[4] = { -1.0f, l_Low, l_High, 1.0f };
+	const float l_Densities[3] = { g_MultiResolution.PeripheryDensity, 1.0f, g_MultiResolution.PeripheryDensity };
+	// The segment ends are rounded from their running total, so the packed layout never grows past the
+	// viewport (the MSAA resolve stops there)...
+	float l_Packed = 0.0f;
+	int l_Start = p_Pos;
+	for (int i = 0; i < 3; i++)
+	{
+		// The viewport is the whole eye at the segment's density, moved so the segment's edge lands on its start...
+		p_Axis.ViewportSize[i] = (int)(p_Size * l_Densities[i] + 0.5f);
+		p_Axis.ViewportPos[i] = l_Start - (int)floorf((l_Edges[i] + 1.0f) * 0.5f * p_Axis.ViewportSize[i] + 0.5f);
+		p_Axis.Start[i] = l_Start;
+		l_Packed += (l_Edges[i + 1] - l_Edges[i]) * 0.5f * p_Size * l_Densities[i];
+		p_Axis.End[i] = p_Pos + (int)(l_Packed + 0.5f);
+		if (p_Axis.End[i] > p_Pos + p_Size)
+			p_Axis.End[i] = p_Pos + p_Size;
+		l_Start = p_Axis.End[i];
+	}
+}
+
+// Where pixel p_Pixel of segment p_Segment shows the eye, in its normalized device coordinates...
+static float SegmentToNdc(const MultiResolutionAxis& p_Axis, int p_Segment, int p_Pixel)
+{
+	return (float)(p_Pixel - p_Axis.ViewportPos[p_Segment]) / (float)p_Axis.ViewportSize[p_Segment] * 2.0f - 1.0f;
+}
+
+static void LayoutEye(int p_Eye, const ovrRecti& p_EyeViewport, MultiResolutionAxis& p_X, MultiResolutionAxis& p_Y)
+{
+	LayoutAxis(p_EyeViewport.Pos.x, p_EyeViewport.Size.w, l_Center[p_Eye][0], p_X);
+	LayoutAxis(p_EyeViewport.Pos.y, p_EyeViewport.Size.h, l_Center[p_Eye][1], p_Y);
+}
+
+void InitializeMultiResolution(OVR::Sizei p_TargetSize, const ovrFovPort p_Fov[2], float p_CenterFraction, float p_PeripheryDensity, bool p_Enabled)
+{
+	g_MultiResolution.Enabled = p_Enabled;
+	g_MultiResolution.CenterFraction = p_CenterFraction;
+	g_MultiResolution.PeripheryDensity = p_PeripheryDensity;
+	g_MultiResolution.PixelFraction = 1.0f;
+
+	// Where the eye looks straight ahead, like the projection puts it (tangent space has y down)...
+	for (int l_Eye = 0; l_Eye < 2; l_Eye++)
+	{
+		l_Fov[l_Eye] = p_Fov[l_Eye];
+		l_Center[l_Eye][0] = (p_Fov[l_Eye].LeftTan - p_Fov[l_Eye].RightTan) / (p_Fov[l_Eye].LeftTan + p_Fov[l_Eye].RightTan);
+		l_Center[l_Eye][1] = -(p_Fov[l_Eye].UpTan - p_Fov[l_Eye].DownTan) / (p_Fov[l_Eye].UpTan + p_Fov[l_Eye].DownTan);
+	}
+
+	glGenFramebuffers(1, &l_Framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, l_Framebuffer);
+	glGenTextures(1, &l_Texture);
+	glBindTexture(GL_TEXTURE_2D, l_Texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, p_TargetSize.w, p_TargetSize.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, l_Texture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("The multi-resolution framebuffer is incomplete, multi-resolution stays off.\n");
+		g_MultiResolution.Enabled = false;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	l_Program = CreateProgram(l_VertexShader, l_FragmentShader);
+	GetMultiResolutionUniforms(l_Program, l_Uniforms);
+	glUseProgram(l_Program);
+	glUniform1i(glGetUniformLocation(l_Program, "packedTexture"), 0);
+	glUseProgram(0);
+	glGenVertexArrays(1, &l_VertexArray);
+
+	// What the split costs at full size...
+	MultiResolutionAxis l_X, l_Y;
+	const ovrRecti l_Full = { { 0, 0 }, { 1000, 1000 } };
+	LayoutEye(0, l_Full, l_X, l_Y);
+	printf("Multi-resolution: %s, %.0f%% of the viewport at full density, the rest at %.0f%% (%.0f%% of the pixels).\n",
+		g_MultiResolution.Enabled ? "on" : "off", p_CenterFraction * 100.0f, p_PeripheryDensity * 100.0f,
+		(float)(l_X.End[2] - l_X.Start[0]) * (float)(l_Y.End[2] - l_Y.Start[0]) / 10000.0f);
+}
+
+void DestroyMultiResolution(void)
+{
+	glDeleteProgram(l_Program);
+	glDeleteVertexArrays(1, &l_VertexArray);
+	glDeleteFramebuffers(1, &l_Framebuffer);
+	glDeleteTextures(1, &l_Texture);
+	l_Program = 0;
+	l_VertexArray = 0;
+	l_Framebuffer = 0;
+	l_Texture = 0;
+	g_MultiResolution.Enabled = false;
+}
+
+int GetMultiResolutionRegions(int p_Eye, const ovrRecti& p_EyeViewport, MultiResolutionRegion p_Regions[MULTI_RESOLUTION_REGION_COUNT])
+{
+	MultiResolutionAxis l_X, l_Y;
+	LayoutEye(p_Eye, p_EyeViewport, l_X, l_Y);
+
+	// The center first, then the ring around it...
+	static const int l_Order[MULTI_RESOLUTION_REGION_COUNT] = { 4, 0, 1, 2, 3, 5, 6, 7, 8 };
+	int l_Count = 0;
+	for (int i = 0; i < MULTI_RESOLUTION_REGION_COUNT; i++)
+	{
+		const int l_Column = l_Order[i] % 3;
+		const int l_Row = l_Order[i] / 3;
+		if (l_X.End[l_Column] <= l_X.Start[l_Column] || l_Y.End[l_Row] <= l_Y.Start[l_Row])
+			continue;
+
+		MultiResolutionRegion& l_Region = p_Regions[l_Count++];
+		l_Region.Viewport.Pos.x = l_X.ViewportPos[l_Column];
+		l_Region.Viewport.Pos.y = l_Y.ViewportPos[l_Row];
+		l_Region.Viewport.Size.w = l_X.ViewportSize[l_Column];
+		l_Region.Viewport.Size.h = l_Y.ViewportSize[l_Row];
+		l_Region.Scissor.Pos.x = l_X.Start[l_Column];
+		l_Region.Scissor.Pos.y = l_Y.Start[l_Row];
+		l_Region.Scissor.Size.w = l_X.End[l_Column] - l_X.Start[l_Column];
+		l_Region.Scissor.Size.h = l_Y.End[l_Row] - l_Y.Start[l_Row];
+
+		// Back from the region's edges to tangents, the inverse of the projection (tangent space has y down)...
+		const ovrFovPort& l_EyeFov = l_Fov[p_Eye];
+		const float l_ScaleX = 2.0f / (l_EyeFov.LeftTan + l_EyeFov.RightTan);
+		const float l_ScaleY = 2.0f / (l_EyeFov.UpTan + l_EyeFov.DownTan);
+		const float l_Left = SegmentToNdc(l_X, l_Column, l_X.Start[l_Column]);
+		const float l_Right = SegmentToNdc(l_X, l_Column, l_X.End[l_Column]);
+		const float l_Bottom = SegmentToNdc(l_Y, l_Row, l_Y.Start[l_Row]);
+		const float l_Top = SegmentToNdc(l_Y, l_Row, l_Y.End[l_Row]);
+		l_Region.Fov.LeftTan = (l_Center[p_Eye][0] - l_Left) / l_ScaleX;
+		l_Region.Fov.RightTan = (l_Right - l_Center[p_Eye][0]) / l_ScaleX;
+		l_Region.Fov.UpTan = (l_Top - l_Center[p_Eye][1]) / l_ScaleY;
+		l_Region.Fov.DownTan = (l_Center[p_Eye][1] - l_Bottom) / l_ScaleY;
+	}
+	return l_Count;
+}
+
+void GetMultiResolutionUniforms(GLuint p_Program, MultiResolutionUniforms& p_Uniforms)
+{
+	p_Uniforms.EyeViewport = glGetUniformLocation(p_Program, "multiResEyeViewport");
+	p_Uniforms.Split = glGetUniformLocation(p_Program, "multiResSplit");
+	p_Uniforms.SegmentsX = glGetUniformLocation(p_Program, "multiResSegmentsX");
+	p_Uniforms.SegmentsY = glGetUniformLocation(p_Program, "multiResSegmentsY");
+}
+
+void SetMultiResolutionUniforms(const MultiResolutionUniforms& p_Uniforms, int p_Eye, const ovrRecti& p_EyeViewport)
+{
+	MultiResolutionAxis l_X, l_Y;
+	LayoutEye(p_Eye, p_EyeViewport, l_X, l_Y);
+	GLfloat l_SegmentsX[3][4], l_SegmentsY[3][4];
+	for (int i = 0; i < 3; i++)
+	{
+		l_SegmentsX[i][0] = (GLfloat)l_X.ViewportPos[i];
+		l_SegmentsX[i][1] = (GLfloat)l_X.ViewportSize[i];
+		l_SegmentsX[i][2] = (GLfloat)l_X.Start[i];
+		l_SegmentsX[i][3] = (GLfloat)l_X.End[i];
+		l_SegmentsY[i][0] = (GLfloat)l_Y.ViewportPos[i];
+		l_SegmentsY[i][1] = (GLfloat)l_Y.ViewportSize[i];
+		l_SegmentsY[i][2] = (GLfloat)l_Y.Start[i];
+		l_SegmentsY[i][3] = (GLfloat)l_Y.End[i];
+	}
+	glUniform4f(p_Uniforms.EyeViewport, (GLfloat)p_EyeViewport.Pos.x, (GLfloat)p_EyeViewport.Pos.y, (GLfloat)p_EyeViewport.Size.w, (GLfloat)p_EyeViewport.Size.h);
+	glUniform4f(p_Uniforms.Split, l_X.Split[0], l_X.Split[1], l_Y.Split[0], l_Y.Split[1]);
+	glUniform4fv(p_Uniforms.SegmentsX, 3, &l_SegmentsX[0][0]);
+	glUniform4fv(p_Uniforms.SegmentsY, 3, &l_SegmentsY[0][0]);
+}
+
+void ComposeMultiResolution(GLuint p_Framebuffer, const ovrRecti p_EyeViewports[2], bool p_Stretch)
+{
+	ProfileZone l_Zone("ComposeMultiResolution");
+
+	MultiResolutionAxis l_X[2], l_Y[2];
+	float l_Rendered = 0.0f;
+	float l_Full = 0.0f;
+	for (int l_Eye = 0; l_Eye < 2; l_Eye++)
+	{
+		LayoutEye(l_Eye, p_EyeViewports[l_Eye], l_X[l_Eye], l_Y[l_Eye]);
+		l_Rendered += (float)(l_X[l_Eye].End[2] - l_X[l_Eye].Start[0]) * (float)(l_Y[l_Eye].End[2] - l_Y[l_Eye].Start[0]);
+		l_Full += (float)p_EyeViewports[l_Eye].Size.w * (float)p_EyeViewports[l_Eye].Size.h;
+	}
+	g_MultiResolution.PixelFraction = l_Rendered / l_Full;
+	if (!p_Stretch)
+		return;
+
+	// The packed regions sit where the eyes get stretched to, copy them aside first...
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, p_Framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, l_Framebuffer);
+	for (int l_Eye = 0; l_Eye < 2; l_Eye++)
+	{
+		const GLint l_X0 = l_X[l_Eye].Start[0];
+		const GLint l_Y0 = l_Y[l_Eye].Start[0];
+		const GLint l_X1 = l_X[l_Eye].End[2];
+		const GLint l_Y1 = l_Y[l_Eye].End[2];
+		glBlitFramebuffer(l_X0, l_Y0, l_X1, l_Y1, l_X0, l_Y0, l_X1, l_Y1, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}
+
+	// The center segments have the full density, a plain copy puts them back where they belong...
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, l_Framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, p_Framebuffer);
+	GLint l_CenterX[2][2], l_CenterY[2][2];
+	for (int l_Eye = 0; l_Eye < 2; l_Eye++)
+	{
+		const MultiResolutionAxis& l_AxisX = l_X[l_Eye];
+		const MultiResolutionAxis& l_AxisY = l_Y[l_Eye];
+		const GLint l_OffsetX = p_EyeViewports[l_Eye].Pos.x - l_AxisX.ViewportPos[1];
+		const GLint l_OffsetY = p_EyeViewports[l_Eye].Pos.y - l_AxisY.ViewportPos[1];
+		l_CenterX[l_Eye][0] = l_AxisX.Start[1] + l_OffsetX;
+		l_CenterX[l_Eye][1] = l_AxisX.End[1] + l_OffsetX;
+		l_CenterY[l_Eye][0] = l_AxisY.Start[1] + l_OffsetY;
+		l_CenterY[l_Eye][1] = l_AxisY.End[1] + l_OffsetY;
+		glBlitFramebuffer(l_AxisX.Start[1], l_AxisY.Start[1], l_AxisX.End[1], l_AxisY.End[1],
+			l_CenterX[l_Eye][0], l_CenterY[l_Eye][0], l_CenterX[l_Eye][1], l_CenterY[l_Eye][1], GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}
+
+	// Only the regions around the center get stretched, each under its own scissor. Every one of
+	// their pixels gets written, no depth or blending...
+	glBindFramebuffer(GL_FRAMEBUFFER, p_Framebuffer);
+	glEnable(GL_SCISSOR_TEST);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	glUseProgram(l_Program);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, l_Texture);
+	glBindVertexArray(l_VertexArray);
+	for (int l_Eye = 0; l_Eye < 2; l_Eye++)
+	{
+		const ovrRecti& l_Viewport = p_EyeViewports[l_Eye];
+		glViewport(l_Viewport.Pos.x, l_Viewport.Pos.y, l_Viewport.Size.w, l_Viewport.Size.h);
+		SetMultiResolutionUniforms(l_Uniforms, l_Eye, l_Viewport);
+
+		const GLint l_EdgesX[4] = { l_Viewport.Pos.x, l_CenterX[l_Eye][0], l_CenterX[l_Eye][1], l_Viewport.Pos.x + l_Viewport.Size.w };
+		const GLint l_EdgesY[4] = { l_Viewport.Pos.y, l_CenterY[l_Eye][0], l_CenterY[l_Eye][1], l_Viewport.Pos.y + l_Viewport.Size.h };
+		for (int y = 0; y < 3; y++)
+		{
+			for (int x = 0; x < 3; x++)
+			{
+				if ((x == 1 && y == 1) || l_EdgesX[x + 1] <= l_EdgesX[x] || l_EdgesY[y + 1] <= l_EdgesY[y])
+					continue;
+				glScissor(l_EdgesX[x], l_EdgesY[y], l_EdgesX[x + 1] - l_EdgesX[x], l_EdgesY[y + 1] - l_EdgesY[y]);
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+			}
+		}
+	}
+
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+	glDisable(GL_SCISSOR_TEST);
+	glEnable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+}
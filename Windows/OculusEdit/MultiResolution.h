@@ -0,0 +1,84 @@
+//
+//  MultiResolution.h
+//  OculusEdit
+//
+//  Multi-resolution eye buffers. The distortion squeezes the edges of each eye viewport
+//  together, so most of the pixels rendered out there never make it to the display
+//  sharper than a fraction of them would. Each eye viewport is split into a 3 x 3 grid:
+//  the center region (around the eye's projection center) keeps the full pixel density,
+//  the regions around it get a lower one. The regions are packed next to each other in
+//  the corner of the eye viewport and drawn one after the other, each with a viewport
+//  that puts the eye's whole clip space where the region wants it and a scissor around
+//  the region, so the scene shaders and the eye uniforms stay as they are. Every region
+//  also knows its part of the eye's FOV, the scene gets culled per region.
+//
+//  LibOVR's distortion expects the usual layout, so before the eye texture goes there the
+//  packed regions are copied aside and put back over the full eye viewports: the center
+//  ones with a plain copy, only the ones around them get stretched by a shader. Our own
+//  distortion (ClientDistortion) skips that pass, it samples the packed layout directly.
+//
+
+#pragma once
+
+#if !defined(__APPLE__)
+#  include <GL/glew.h>
+#else
+#  include <OpenGL/gl3.h>
+#endif
+
+#include "OVR.h"
+#include "OVR_CAPI.h"
+
+const int MULTI_RESOLUTION_REGION_COUNT = 9;
+
+// Range of the periphery pixel density (1 is the same as the center).
+const float MULTI_RESOLUTION_MIN_DENSITY = 0.25f;
+const float MULTI_RESOLUTION_MAX_DENSITY = 1.0f;
+
+struct MultiResolutionState
+{
+	bool Enabled;
+	float CenterFraction;   // Share of the eye viewport (per axis) rendered at full density.
+	float PeripheryDensity; // Pixel density of the regions around the center (per axis).
+	float PixelFraction;    // Pixels rendered against the full eye viewports, last frame.
+};
+
+extern MultiResolutionState g_MultiResolution;
+
+// One region of an eye:
+struct MultiResolutionRegion
+{
+	ovrRecti Viewport; // Where the eye's clip space goes for this region, may reach past the render target.
+	ovrRecti Scissor;  // The region itself, in the packed layout.
+	ovrFovPort Fov;    // The part of the eye's FOV the region shows (for culling).
+};
+
+// Needs a current GL context. p_TargetSize is the size of the eye render targets, p_Fov the eye FOVs
+// (the full density region is centered on their projection center).
+void InitializeMultiResolution(OVR::Sizei p_TargetSize, const ovrFovPort p_Fov[2], float p_CenterFraction, float p_PeripheryDensity, bool p_Enabled);
+void DestroyMultiResolution(void);
+
+// Regions of p_Eye for its current viewport (empty ones are left out). Returns how many there are.
+int GetMultiResolutionRegions(int p_Eye, const ovrRecti& p_EyeViewport, MultiResolutionRegion p_Regions[MULTI_RESOLUTION_REGION_COUNT]);
+
+// GLSL for shaders reading an eye texture with packed regions: declares the multiRes* uniforms and
+// vec2 MultiResolutionPixel(vec2 pixel), which turns a pixel of the full eye viewport into the pixel
+// of the packed layout that shows it (for bilinear sampling).
+extern const char* const MULTI_RESOLUTION_SHADER;
+
+struct MultiResolutionUniforms
+{
+	GLint EyeViewport;
+	GLint Split;
+	GLint SegmentsX;
+	GLint SegmentsY;
+};
+
+void GetMultiResolutionUniforms(GLuint p_Program, MultiResolutionUniforms& p_Uniforms);
+// Sets the layout of p_Eye for its viewport p_EyeViewport, on the current program.
+void SetMultiResolutionUniforms(const MultiResolutionUniforms& p_Uniforms, int p_Eye, const ovrRecti& p_EyeViewport);
+
+// Stretches the packed regions of both eyes back over p_EyeViewports in p_Framebuffer (single sampled,
+// the eye render target after the MSAA resolve). Leaves the framebuffer bound. Without p_Stretch
+// (the eye texture is read by a shader using MULTI_RESOLUTION_SHADER) only the stats get updated.
+void ComposeMultiResolution(GLuint p_Framebuffer, const ovrRecti p_EyeViewports[2], bool p_Stretch);
@@ -0,0 +1,193 @@
+//
+//  PoseSampler.cpp
+//  OculusEdit
+//
+
+#include "PoseSampler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <system_error>
+
+#include "OVR.h"
+
+PoseSamplerState g_PoseSampler;
+
+static void WriteSample(const PoseSample& p_Sample)
+{
+	const unsigned int l_Count = g_PoseSampler.WriteCount.load(std::memory_order_relaxed);
+	PoseSlot& l_Slot = g_PoseSampler.Ring[l_Count % POSE_SAMPLER_RING_SIZE];
+
+	// Mark the slot busy, write it, mark it done. Readers that saw the busy (odd) or an older
+	// sequence number just try again or skip the slot...
+	const unsigned int l_Sequence = l_Slot.Sequence.load(std::memory_order_relaxed);
+	l_Slot.Sequence.store(l_Sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	l_Slot.Sample = p_Sample;
+	l_Slot.Sequence.store(l_Sequence + 2, std::memory_order_release);
+
+	g_PoseSampler.WriteCount.store(l_Count + 1, std::memory_order_release);
+}
+
+// Copies slot p_Index (a write count, not a ring index). Fails if the sampler is writing it, or
+// has already reused it for a newer sample.
+static bool ReadSample(unsigned int p_Index, PoseSample& p_Sample)
+{
+	const PoseSlot& l_Slot = g_PoseSampler.Ring[p_Index % POSE_SAMPLER_RING_SIZE];
+	const unsigned int l_Expected = ((p_Index / POSE_SAMPLER_RING_SIZE) + 1) * 2;
+
+	for (int l_Try = 0; l_Try < 4; l_Try++)
+	{
+		const unsigned int l_Before = l_Slot.Sequence.load(std::memory_order_acquire);
+		if (l_Before > l_Expected)
+			return false; // Overwritten already...
+		if (l_Before != l_Expected)
+			continue;     // Being written...
+
+		p_Sample = l_Slot.Sample;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (l_Slot.Sequence.load(std::memory_order_relaxed) == l_Before)
+			return true;
+	}
+	return false;
+}
+
+static void SamplerThread(void)
+{
+	const std::chrono::microseconds l_Period((long long)(1.0e6 / POSE_SAMPLER_RATE_HZ));
+	std::chrono::steady_clock::time_point l_Next = std::chrono::steady_clock::now();
+
+	while (g_PoseSampler.Running.load(std::memory_order_acquire))
+	{
+		const ovrTrackingState l_State = ovrHmd_GetTrackingState(g_PoseSampler.Hmd, ovr_GetTimeInSeconds());
+
+		PoseSample l_Sample;
+		l_Sample.HeadPose = l_State.HeadPose;
+		l_Sample.StatusFlags = l_State.StatusFlags;
+		WriteSample(l_Sample);
+
+		// Fixed rate, but don't try to catch up after a hiccup...
+		l_Next += l_Period;
+		const std::chrono::steady_clock::time_point l_Now = std::chrono::steady_clock::now();
+		if (l_Next < l_Now)
+			l_Next = l_Now;
+		std::this_thread::sleep_until(l_Next);
+	}
+}
+
+bool StartPoseSampler(ovrHmd p_Hmd)
+{
+	if (g_PoseSampler.Running.load())
+		return true;
+
+	g_PoseSampler.Hmd = p_Hmd;
+	g_PoseSampler.WriteCount.store(0);
+	for (unsigned int i = 0; i < POSE_SAMPLER_RING_SIZE; i++)
+		g_PoseSampler.Ring[i].Sequence.store(0);
+
+	g_PoseSampler.Running.store(true);
+	try
+	{
+		g_PoseSampler.Thread = std::thread(SamplerThread);
+	}
+	catch (const std::system_error&)
+	{
+		printf("Could not start the tracking thread.\n");
+		g_PoseSampler.Running.store(false);
+		return false;
+	}
+
+	// The error paths leave through exit(), a still joinable std::thread would abort there...
+	static bool l_AtExitRegistered = false;
+	if (!l_AtExitRegistered)
+	{
+		atexit(StopPoseSampler);
+		l_AtExitRegistered = true;
+	}
+	return true;
+}
+
+void StopPoseSampler(void)
+{
+	if (!g_PoseSampler.Running.load())
+		return;
+
+	g_PoseSampler.Running.store(false, std::memory_order_release);
+	g_PoseSampler.Thread.join();
+}
+
+bool GetLatestPose(PoseSample& p_Sample)
+{
+	// The newest slot can only be lost if the sampler laps the whole ring in between, step back then...
+	const unsigned int l_Count = g_PoseSampler.WriteCount.load(std::memory_order_acquire);
+	for (unsigned int i = 1; i <= 2 && i <= l_Count; i++)
+	{
+		if (ReadSample(l_Count - i, p_Sample))
+			return true;
+	}
+	return false;
+}
+
+bool GetPoseAtTime(double p_Time, PoseSample& p_Sample)
+{
+	const unsigned int l_Count = g_PoseSampler.WriteCount.load(std::memory_order_acquire);
+	const unsigned int l_Available = (l_Count < POSE_SAMPLER_RING_SIZE) ? l_Count : POSE_SAMPLER_RING_SIZE;
+
+	// Walk back from the newest sample until we pass p_Time...
+	PoseSample l_Newer;
+	bool l_HaveNewer = false;
+	for (unsigned int i = 1; i <= l_Available; i++)
+	{
+		PoseSample l_Older;
+		if (!ReadSample(l_Count - i, l_Older))
+			break;
+
+		if (l_Older.HeadPose.TimeInSeconds <= p_Time)
+		{
+			if (!l_HaveNewer)
+			{
+				p_Sample = l_Older; // p_Time is past the newest sample...
+				return true;
+			}
+
+			const double l_Span = l_Newer.HeadPose.TimeInSeconds - l_Older.HeadPose.TimeInSeconds;
+			const float l_Factor = (l_Span > 0.0) ? (float)((p_Time - l_Older.HeadPose.TimeInSeconds) / l_Span) : 0.0f;
+
+			const OVR::Quatf l_OlderOrientation(l_Older.HeadPose.ThePose.Orientation);
+			const OVR::Quatf l_NewerOrientation(l_Newer.HeadPose.ThePose.Orientation);
+			const OVR::Vector3f l_OlderPosition(l_Older.HeadPose.ThePose.Position);
+			const OVR::Vector3f l_NewerPosition(l_Newer.HeadPose.ThePose.Position);
+
+			// At 1 kHz the samples are close enough together for a normalized lerp...
+			p_Sample = l_Newer;
+			p_Sample.HeadPose.ThePose.Orientation = l_OlderOrientation.Nlerp(l_NewerOrientation, l_Factor);
+			p_Sample.HeadPose.ThePose.Position = l_OlderPosition.Lerp(l_NewerPosition, l_Factor);
+			p_Sample.HeadPose.TimeInSeconds = p_Time;
+			return true;
+		}
+
+		l_Newer = l_Older;
+		l_HaveNewer = true;
+	}
+
+	// Older than anything we still have (or the ring moved under us), the oldest one will do...
+	if (l_HaveNewer)
+		p_Sample = l_Newer;
+	return l_HaveNewer;
+}
+
+unsigned int CopyPoseHistory(PoseSample* p_Samples, unsigned int p_MaxSamples)
+{
+	const unsigned int l_Count = g_PoseSampler.WriteCount.load(std::memory_order_acquire);
+	const unsigned int l_Available = (l_Count < POSE_SAMPLER_RING_SIZE) ? l_Count : POSE_SAMPLER_RING_SIZE;
+
+	unsigned int l_Copied = 0;
+	for (unsigned int i = 1; i <= l_Available && l_Copied < p_MaxSamples; i++)
+	{
+		if (!ReadSample(l_Count - i, p_Samples[l_Copied]))
+			break; // Lapped by the sampler, everything older is gone too...
+		++l_Copied;
+	}
+	return l_Copied;
+}
@@ -0,0 +1,58 @@
+//
+//  PoseSampler.h
+//  OculusEdit
+//
+//  Head tracking on its own thread. The sampler polls ovrHmd_GetTrackingState at the
+//  sensor rate and appends timestamped poses to a fixed size ring buffer. There is a
+//  single writer; every slot carries a sequence number (seqlock) so any number of
+//  readers (render loop, picking, logging) can look at the newest sample or the
+//  history without locks and without ever blocking the sampler.
+//
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include "OVR_CAPI.h"
+
+// About a second of history at the DK2's 1000 Hz sensor rate:
+const unsigned int POSE_SAMPLER_RING_SIZE = 1024;
+const double POSE_SAMPLER_RATE_HZ = 1000.0;
+
+struct PoseSample
+{
+	ovrPoseStatef HeadPose;   // HeadPose.TimeInSeconds is the sample time (ovr_GetTimeInSeconds timebase).
+	unsigned int StatusFlags; // ovrStatus_* of the tracking state.
+};
+
+struct PoseSlot
+{
+	std::atomic<unsigned int> Sequence; // Odd while the sampler is writing the slot.
+	PoseSample Sample;
+};
+
+struct PoseSamplerState
+{
+	ovrHmd Hmd;
+	std::thread Thread;
+	std::atomic<bool> Running;
+	std::atomic<unsigned int> WriteCount; // Samples written so far, the newest is at (WriteCount - 1) % POSE_SAMPLER_RING_SIZE.
+	PoseSlot Ring[POSE_SAMPLER_RING_SIZE];
+};
+
+extern PoseSamplerState g_PoseSampler;
+
+// Starts sampling p_Hmd (tracking has to be configured already). StopPoseSampler joins the thread.
+bool StartPoseSampler(ovrHmd p_Hmd);
+void StopPoseSampler(void);
+
+// Copies the newest sample. Returns false if there is none yet.
+bool GetLatestPose(PoseSample& p_Sample);
+
+// Pose at p_Time: interpolated between the two samples around it, clamped to the oldest and
+// newest sample in the ring. Returns false if there are no samples yet.
+bool GetPoseAtTime(double p_Time, PoseSample& p_Sample);
+
+// Copies up to p_MaxSamples of the history, newest first. Returns the number copied.
+unsigned int CopyPoseHistory(PoseSample* p_Samples, unsigned int p_MaxSamples);
@@ -0,0 +1,298 @@
+//
+//  Profiler.cpp
+//  OculusEdit
+//
+
+#include "Profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "OVR_CAPI.h"
+
+ProfilerState g_Profiler;
+
+// Re-measures the offset between the GL timestamp clock and ovr_GetTimeInSeconds. Reading
+// GL_TIMESTAMP directly doesn't wait for queued commands, so this is cheap enough to do every frame.
+static void CalibrateGpuClock(void)
+{
+	GLint64 l_GpuNow = 0;
+	glGetInteger64v(GL_TIMESTAMP, &l_GpuNow);
+	const double l_CpuNow = ovr_GetTimeInSeconds();
+	g_Profiler.GpuToCpuOffset = l_CpuNow - (double)l_GpuNow * 1.0e-9;
+}
+
+static ProfileEvent* PushEvent(void)
+{
+	ProfileEvent* l_Event = &g_Profiler.Events[g_Profiler.EventHead];
+	g_Profiler.EventHead = (g_Profiler.EventHead + 1) % PROFILER_MAX_EVENTS;
+	if (g_Profiler.EventCount < PROFILER_MAX_EVENTS)
+		++g_Profiler.EventCount;
+	return l_Event;
+}
+
+static ProfileZoneStats* FindStats(const char* p_Name)
+{
+	for (size_t i = 0; i < g_Profiler.Stats.size(); i++)
+	{
+		// Names are literals, so the pointer compare nearly always hits...
+		if (g_Profiler.Stats[i].Name == p_Name || strcmp(g_Profiler.Stats[i].Name, p_Name) == 0)
+			return &g_Profiler.Stats[i];
+	}
+
+	ProfileZoneStats l_Stats;
+	l_Stats.Name = p_Name;
+	l_Stats.LastCpuMs = -1.0;
+	l_Stats.LastGpuMs = -1.0;
+	l_Stats.LastGpuFrame = 0;
+	g_Profiler.Stats.push_back(l_Stats);
+	return &g_Profiler.Stats.back();
+}
+
+void InitializeProfiler(void)
+{
+	g_Profiler.Enabled = true;
+	g_Profiler.Frame = 0;
+	g_Profiler.Events.resize(PROFILER_MAX_EVENTS);
+	g_Profiler.EventHead = 0;
+	g_Profiler.EventCount = 0;
+	g_Profiler.DroppedGpuZones = 0;
+	g_Profiler.GpuToCpuOffset = 0.0;
+	g_Profiler.Stats.reserve(64);
+
+#if !defined(__APPLE__)
+	g_Profiler.GpuTiming = (GLEW_ARB_timer_query == GL_TRUE);
+#else
+	g_Profiler.GpuTiming = true; // Core in every context OS X hands out...
+#endif
+
+	for (unsigned int f = 0; f < PROFILER_QUERY_FRAMES; f++)
+	{
+		g_Profiler.QueriesUsed[f] = 0;
+		for (unsigned int i = 0; i < PROFILER_MAX_GPU_ZONES_PER_FRAME; i++)
+		{
+			ProfileQueryPair& l_Pair = g_Profiler.QueryPool[f][i];
+			l_Pair.Queries[0] = l_Pair.Queries[1] = 0;
+			if (g_Profiler.GpuTiming)
+				glGenQueries(2, l_Pair.Queries);
+		}
+	}
+
+	if (g_Profiler.GpuTiming)
+		CalibrateGpuClock();
+	else
+		printf("GL_ARB_timer_query not supported, profiling CPU time only.\n");
+}
+
+void ShutdownProfiler(void)
+{
+	if (!g_Profiler.Enabled)
+		return;
+
+	for (unsigned int f = 0; f < PROFILER_QUERY_FRAMES; f++)
+	{
+		for (unsigned int i = 0; i < PROFILER_MAX_GPU_ZONES_PER_FRAME; i++)
+		{
+			if (g_Profiler.QueryPool[f][i].Queries[0])
+				glDeleteQueries(2, g_Profiler.QueryPool[f][i].Queries);
+		}
+	}
+	g_Profiler.Enabled = false;
+}
+
+// Picks up the timestamps of the frame that last used this query set. Zones whose queries
+// aren't done yet are dropped instead of waited on.
+static void ResolveQueries(unsigned int p_Set)
+{
+	for (unsigned int i = 0; i < g_Profiler.QueriesUsed[p_Set]; i++)
+	{
+		ProfileQueryPair& l_Pair = g_Profiler.QueryPool[p_Set][i];
+
+		GLint l_Available = GL_FALSE;
+		glGetQueryObjectiv(l_Pair.Queries[1], GL_QUERY_RESULT_AVAILABLE, &l_Available);
+		if (!l_Available)
+		{
+			++g_Profiler.DroppedGpuZones;
+			continue;
+		}
+
+		GLuint64 l_Begin = 0, l_End = 0;
+		glGetQueryObjectui64v(l_Pair.Queries[0], GL_QUERY_RESULT, &l_Begin);
+		glGetQueryObjectui64v(l_Pair.Queries[1], GL_QUERY_RESULT, &l_End);
+
+		// The ring buffer may have wrapped around since, only patch our own event...
+		ProfileEvent& l_Event = g_Profiler.Events[l_Pair.EventIndex];
+		if (l_Event.Frame != l_Pair.EventFrame || l_Event.Type != ProfileEvent_Zone)
+			continue;
+
+		l_Event.GpuBegin = (double)l_Begin * 1.0e-9 + g_Profiler.GpuToCpuOffset;
+		l_Event.GpuEnd = (double)l_End * 1.0e-9 + g_Profiler.GpuToCpuOffset;
+		ProfileZoneStats* l_Stats = FindStats(l_Event.Name);
+		l_Stats->LastGpuMs = (double)(l_End - l_Begin) * 1.0e-6;
+		l_Stats->LastGpuFrame = l_Pair.EventFrame;
+	}
+	g_Profiler.QueriesUsed[p_Set] = 0;
+}
+
+void ProfilerBeginFrame(unsigned int p_FrameIndex)
+{
+	if (!g_Profiler.Enabled)
+		return;
+
+	g_Profiler.Frame = p_FrameIndex;
+	if (g_Profiler.GpuTiming)
+	{
+		ResolveQueries(p_FrameIndex % PROFILER_QUERY_FRAMES);
+		CalibrateGpuClock();
+	}
+}
+
+void ProfilerCounter(const char* p_Name, double p_Value)
+{
+	if (!g_Profiler.Enabled)
+		return;
+
+	ProfileEvent* l_Event = PushEvent();
+	l_Event->Type = ProfileEvent_Counter;
+	l_Event->Name = p_Name;
+	l_Event->Eye = -1;
+	l_Event->Frame = g_Profiler.Frame;
+	l_Event->CpuBegin = l_Event->CpuEnd = ovr_GetTimeInSeconds();
+	l_Event->GpuBegin = l_Event->GpuEnd = -1.0;
+	l_Event->Value = p_Value;
+}
+
+double ProfilerLastCpuMs(const char* p_Name)
+{
+	return g_Profiler.Enabled ? FindStats(p_Name)->LastCpuMs : -1.0;
+}
+
+double ProfilerLastGpuMs(const char* p_Name)
+{
+	return g_Profiler.Enabled ? FindStats(p_Name)->LastGpuMs : -1.0;
+}
+
+double ProfilerLastGpuMs(const char* p_Name, unsigned int& p_Frame)
+{
+	if (!g_Profiler.Enabled)
+		return -1.0;
+
+	const ProfileZoneStats* l_Stats = FindStats(p_Name);
+	p_Frame = l_Stats->LastGpuFrame;
+	return l_Stats->LastGpuMs;
+}
+
+ProfileZone::ProfileZone(const char* p_Name, int p_Eye, bool p_Gpu)
+	: m_Name(p_Name)
+	, m_Eye(p_Eye)
+	, m_CpuBegin(0.0)
+	, m_QueryPair(NULL)
+{
+	if (!g_Profiler.Enabled)
+		return;
+
+	m_CpuBegin = ovr_GetTimeInSeconds();
+
+	if (p_Gpu && g_Profiler.GpuTiming)
+	{
+		const unsigned int l_Set = g_Profiler.Frame % PROFILER_QUERY_FRAMES;
+		if (g_Profiler.QueriesUsed[l_Set] < PROFILER_MAX_GPU_ZONES_PER_FRAME)
+		{
+			m_QueryPair = &g_Profiler.QueryPool[l_Set][g_Profiler.QueriesUsed[l_Set]++];
+			glQueryCounter(m_QueryPair->Queries[0], GL_TIMESTAMP);
+		}
+		else
+		{
+			++g_Profiler.DroppedGpuZones;
+		}
+	}
+}
+
+ProfileZone::~ProfileZone()
+{
+	if (!g_Profiler.Enabled)
+		return;
+
+	if (m_QueryPair)
+		glQueryCounter(m_QueryPair->Queries[1], GL_TIMESTAMP);
+
+	const double l_CpuEnd = ovr_GetTimeInSeconds();
+
+	const unsigned int l_Index = g_Profiler.EventHead;
+	ProfileEvent* l_Event = PushEvent();
+	l_Event->Type = ProfileEvent_Zone;
+	l_Event->Name = m_Name;
+	l_Event->Eye = m_Eye;
+	l_Event->Frame = g_Profiler.Frame;
+	l_Event->CpuBegin = m_CpuBegin;
+	l_Event->CpuEnd = l_CpuEnd;
+	l_Event->GpuBegin = l_Event->GpuEnd = -1.0;
+	l_Event->Value = 0.0;
+
+	if (m_QueryPair)
+	{
+		m_QueryPair->EventIndex = l_Index;
+		m_QueryPair->EventFrame = g_Profiler.Frame;
+	}
+
+	FindStats(m_Name)->LastCpuMs = (l_CpuEnd - m_CpuBegin) * 1000.0;
+}
+
+static void WriteTraceName(FILE* p_File, const ProfileEvent& p_Event)
+{
+	if (p_Event.Eye == 0)
+		fprintf(p_File, "\"%s (left)\"", p_Event.Name);
+	else if (p_Event.Eye == 1)
+		fprintf(p_File, "\"%s (right)\"", p_Event.Name);
+	else
+		fprintf(p_File, "\"%s\"", p_Event.Name);
+}
+
+bool WriteChromeTrace(const char* p_Path)
+{
+	FILE* l_File = fopen(p_Path, "w");
+	if (!l_File)
+	{
+		printf("Could not open %s for writing.\n", p_Path);
+		return false;
+	}
+
+	// Chrome wants microseconds, relative to anything. Use the oldest event as zero...
+	const unsigned int l_First = (g_Profiler.EventHead + PROFILER_MAX_EVENTS - g_Profiler.EventCount) % PROFILER_MAX_EVENTS;
+	const double l_Origin = g_Profiler.EventCount ? g_Profiler.Events[l_First].CpuBegin : 0.0;
+
+	fprintf(l_File, "{\"traceEvents\":[\n");
+	fprintf(l_File, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+	fprintf(l_File, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+
+	for (unsigned int i = 0; i < g_Profiler.EventCount; i++)
+	{
+		const ProfileEvent& l_Event = g_Profiler.Events[(l_First + i) % PROFILER_MAX_EVENTS];
+
+		if (l_Event.Type == ProfileEvent_Counter)
+		{
+			fprintf(l_File, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"args\":{\"value\":%g}}",
+				l_Event.Name, (l_Event.CpuBegin - l_Origin) * 1.0e6, l_Event.Value);
+			continue;
+		}
+
+		fprintf(l_File, ",\n{\"name\":");
+		WriteTraceName(l_File, l_Event);
+		fprintf(l_File, ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+			(l_Event.CpuBegin - l_Origin) * 1.0e6, (l_Event.CpuEnd - l_Event.CpuBegin) * 1.0e6, l_Event.Frame);
+
+		if (l_Event.GpuBegin >= 0.0)
+		{
+			fprintf(l_File, ",\n{\"name\":");
+			WriteTraceName(l_File, l_Event);
+			fprintf(l_File, ",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+				(l_Event.GpuBegin - l_Origin) * 1.0e6, (l_Event.GpuEnd - l_Event.GpuBegin) * 1.0e6, l_Event.Frame);
+		}
+	}
+
+	fprintf(l_File, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(l_File);
+
+	printf("Profiler: %u events written to %s (%u GPU zones dropped).\n", g_Profiler.EventCount, p_Path, g_Profiler.DroppedGpuZones);
+	return true;
+}
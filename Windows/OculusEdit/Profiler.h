@@ -0,0 +1,119 @@
+//
+//  Profiler.h
+//  OculusEdit
+//
+//  Scoped CPU/GPU zones for the frame loop. Every zone records CPU timestamps and,
+//  optionally, a pair of GL timestamp queries. The queries are double buffered per
+//  frame and only read back once the driver reports them available, so profiling
+//  never stalls the pipeline. Finished zones land in a fixed size ring buffer which
+//  can be dumped as a Chrome trace (load it in chrome://tracing).
+//
+
+#pragma once
+
+#include <vector>
+
+#if !defined(__APPLE__)
+#  include <GL/glew.h>
+#else
+#  include <OpenGL/gl3.h>
+#endif
+
+// Sizes of the ring buffer and of the per frame query pool:
+const unsigned int PROFILER_MAX_EVENTS = 16384;
+const unsigned int PROFILER_MAX_GPU_ZONES_PER_FRAME = 64;
+const unsigned int PROFILER_QUERY_FRAMES = 2;
+
+enum ProfileEventType
+{
+	ProfileEvent_Zone,
+	ProfileEvent_Counter
+};
+
+struct ProfileEvent
+{
+	ProfileEventType Type;
+	const char* Name;     // Must be a string literal (or otherwise outlive the profiler)...
+	int Eye;              // -1 if the zone isn't tied to an eye.
+	unsigned int Frame;
+	double CpuBegin;      // Seconds (ovr_GetTimeInSeconds timebase).
+	double CpuEnd;
+	double GpuBegin;      // Seconds, already mapped onto the CPU timebase. Negative while unresolved.
+	double GpuEnd;
+	double Value;         // Counters only.
+};
+
+struct ProfileQueryPair
+{
+	GLuint Queries[2];
+	unsigned int EventIndex;
+	unsigned int EventFrame;
+};
+
+// Last resolved durations per zone name, used for feedback (e.g. GPU frame time).
+struct ProfileZoneStats
+{
+	const char* Name;
+	double LastCpuMs;
+	double LastGpuMs;
+	unsigned int LastGpuFrame; // Frame LastGpuMs was measured in.
+};
+
+struct ProfilerState
+{
+	bool Enabled;
+	bool GpuTiming;
+	unsigned int Frame;
+
+	std::vector<ProfileEvent> Events; // Ring buffer...
+	unsigned int EventHead;           // ... next slot to write.
+	unsigned int EventCount;
+
+	ProfileQueryPair QueryPool[PROFILER_QUERY_FRAMES][PROFILER_MAX_GPU_ZONES_PER_FRAME];
+	unsigned int QueriesUsed[PROFILER_QUERY_FRAMES];
+	unsigned int DroppedGpuZones;
+
+	double GpuToCpuOffset;            // Add to a GL timestamp (in seconds) to get CPU time.
+
+	std::vector<ProfileZoneStats> Stats;
+};
+
+extern ProfilerState g_Profiler;
+
+// Needs a current GL context. GPU timing is silently disabled without GL_ARB_timer_query.
+void InitializeProfiler(void);
+void ShutdownProfiler(void);
+
+// Call once at the start of every frame, this also reads back the queries of older frames.
+void ProfilerBeginFrame(unsigned int p_FrameIndex);
+
+// Records a value (e.g. a culling count) that shows up as a counter track in the trace.
+void ProfilerCounter(const char* p_Name, double p_Value);
+
+// Last measured times of a zone, or a negative value if there is none (yet).
+double ProfilerLastCpuMs(const char* p_Name);
+double ProfilerLastGpuMs(const char* p_Name);
+
+// The same, and the frame it was measured in. The time sticks around until a newer one resolves,
+// the frame tells a new measurement from the last one read again.
+double ProfilerLastGpuMs(const char* p_Name, unsigned int& p_Frame);
+
+// Writes everything in the ring buffer as Chrome trace JSON.
+bool WriteChromeTrace(const char* p_Path);
+
+// RAII zone: times from construction to destruction.
+class ProfileZone
+{
+public:
+	ProfileZone(const char* p_Name, int p_Eye = -1, bool p_Gpu = true);
+	~ProfileZone();
+
+private:
+	ProfileZone(const ProfileZone&);
+	ProfileZone& operator=(const ProfileZone&);
+
+	const char* m_Name;
+	int m_Eye;
+	double m_CpuBegin;
+	ProfileQueryPair* m_QueryPair;
+};
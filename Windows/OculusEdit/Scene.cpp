@@ -0,0 +1,47 @@
+//
+//  Scene.cpp
+//  OculusEdit
+//
+
+#include "Scene.h"
+
+std::vector<SceneObject> g_SceneObjects;
+unsigned int g_SceneRevision = 0;
+std::vector<unsigned int> g_SceneMovedObjects;
+std::vector<ScenePointLight> g_ScenePointLights;
+
+// Same values the old fixed function lights had: only the first one has a specular color.
+const SceneLight g_SceneLights[SCENE_LIGHT_COUNT] =
+{
+	{ { 3.0f, 4.0f, 2.0f, 0.0f }, { 1.0f, 0.8f, 0.6f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } },
+	{ { -3.0f, -4.0f, 2.0f, 0.0f }, { 0.6f, 0.8f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } }
+};
+
+const SceneMaterial g_SceneMaterial =
+{
+	{ 0.3f, 0.3f, 0.3f, 1.0f },
+	10.0f
+};
+
+unsigned int AddSceneObject(MeshHandle p_Mesh, const OVR::Matrix4f& p_Transform)
+{
+	SceneObject l_Object;
+	l_Object.Mesh = p_Mesh;
+	l_Object.Transform = p_Transform;
+	g_SceneObjects.push_back(l_Object);
+	++g_SceneRevision;
+	return (unsigned int)(g_SceneObjects.size() - 1);
+}
+
+void SetSceneObjectTransform(unsigned int p_Object, const OVR::Matrix4f& p_Transform)
+{
+	g_SceneObjects[p_Object].Transform = p_Transform;
+	g_SceneMovedObjects.push_back(p_Object);
+}
+
+void ClearScene(void)
+{
+	g_SceneObjects.clear();
+	g_SceneMovedObjects.clear();
+	++g_SceneRevision;
+}
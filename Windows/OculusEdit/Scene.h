@@ -0,0 +1,66 @@
+//
+//  Scene.h
+//  OculusEdit
+//
+//  Flat list of scene objects. Each object references a shared mesh by handle and
+//  carries its own object-to-world transform. The renderer keeps copies of the
+//  transforms on the GPU, so objects are added, removed and moved through the functions
+//  below, which tell it what changed.
+//
+
+#pragma once
+
+#include <vector>
+
+#include "OVR.h"
+#include "Mesh.h"
+
+struct SceneObject
+{
+	MeshHandle Mesh;
+	OVR::Matrix4f Transform; // Object to world, row major (OVR convention).
+};
+
+// The two stationary directional lights (w = 0) and the single material every object uses.
+// The scene shaders get these as uniforms.
+struct SceneLight
+{
+	GLfloat Position[4];
+	GLfloat Diffuse[4];
+	GLfloat Specular[4];
+};
+
+// Any number of point lights, moved around freely: the renderer bins them into its light clusters
+// every frame (see SceneClusters.h). The light fades out to nothing at Radius.
+struct ScenePointLight
+{
+	GLfloat Position[3];
+	GLfloat Radius;
+	GLfloat Color[3];
+};
+
+struct SceneMaterial
+{
+	GLfloat Specular[4];
+	GLfloat Shininess;
+};
+
+const unsigned int SCENE_LIGHT_COUNT = 2;
+
+extern std::vector<SceneObject> g_SceneObjects;
+extern const SceneLight g_SceneLights[SCENE_LIGHT_COUNT];
+extern std::vector<ScenePointLight> g_ScenePointLights;
+extern const SceneMaterial g_SceneMaterial;
+
+// Bumped whenever objects are added or removed.
+extern unsigned int g_SceneRevision;
+
+// Objects moved since the renderer last caught up (it clears the list).
+extern std::vector<unsigned int> g_SceneMovedObjects;
+
+// Returns the index of the new object in g_SceneObjects.
+unsigned int AddSceneObject(MeshHandle p_Mesh, const OVR::Matrix4f& p_Transform);
+
+void SetSceneObjectTransform(unsigned int p_Object, const OVR::Matrix4f& p_Transform);
+
+void ClearScene(void);
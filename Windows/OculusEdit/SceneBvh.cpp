@@ -0,0 +1,479 @@
+//
+//  SceneBvh.cpp
+//  OculusEdit
+//
+
+#include "SceneBvh.h"
+
+#include <algorithm>
+
+#include "Mesh.h"
+#include "Scene.h"
+
+SceneBvhStats g_SceneBvhStats = { 0, 0, 0, 0, { 0, 0 }, 0, 0 };
+
+static const unsigned int BVH_LEAF_SIZE = 4;
+
+// The frustums are widened a little: culling uses the pose from the start of the frame, late
+// latching may still turn the view by a fraction of a degree...
+static const float BVH_FRUSTUM_PADDING = 1.03f;
+
+struct ObjectBounds
+{
+	float Min[3];
+	float Max[3];
+};
+
+static bool l_Valid = false;
+static unsigned int l_Revision = 0;
+static std::vector<SceneBvhNode> l_Nodes;
+static std::vector<unsigned int> l_Objects;     // Object indices, every leaf owns a range.
+static std::vector<int> l_ObjectLeaves;         // Object index to its leaf.
+static std::vector<ObjectBounds> l_ObjectBounds; // By object index.
+
+// Box around the mesh's bounding sphere in world space...
+static void ComputeObjectBounds(unsigned int p_Object, ObjectBounds& p_Bounds)
+{
+	const SceneObject& l_Object = g_SceneObjects[p_Object];
+	if (l_Object.Mesh >= g_Meshes.size())
+	{
+		for (int c = 0; c < 3; c++)
+			p_Bounds.Min[c] = p_Bounds.Max[c] = 0.0f;
+		return;
+	}
+
+	const GLfloat* l_Sphere = g_Meshes[l_Object.Mesh].BoundingSphere;
+	const OVR::Matrix4f& l_M = l_Object.Transform;
+	const OVR::Vector3f l_Center = l_M.Transform(OVR::Vector3f(l_Sphere[0], l_Sphere[1], l_Sphere[2]));
+
+	float l_ScaleSquared = 0.0f;
+	for (int j = 0; j < 3; j++)
+	{
+		const float l_ColumnSquared = l_M.M[0][j] * l_M.M[0][j] + l_M.M[1][j] * l_M.M[1][j] + l_M.M[2][j] * l_M.M[2][j];
+		l_ScaleSquared = std::max(l_ScaleSquared, l_ColumnSquared);
+	}
+	const float l_Radius = l_Sphere[3] * sqrtf(l_ScaleSquared);
+
+	p_Bounds.Min[0] = l_Center.x - l_Radius; p_Bounds.Max[0] = l_Center.x + l_Radius;
+	p_Bounds.Min[1] = l_Center.y - l_Radius; p_Bounds.Max[1] = l_Center.y + l_Radius;
+	p_Bounds.Min[2] = l_Center.z - l_Radius; p_Bounds.Max[2] = l_Center.z + l_Radius;
+}
+
+static void FitLeaf(SceneBvhNode& p_Node)
+{
+	for (int c = 0; c < 3; c++)
+	{
+		p_Node.Min[c] = l_ObjectBounds[l_Objects[p_Node.First]].Min[c];
+		p_Node.Max[c] = l_ObjectBounds[l_Objects[p_Node.First]].Max[c];
+	}
+	for (unsigned int i = 1; i < p_Node.Count; i++)
+	{
+		const ObjectBounds& l_Bounds = l_ObjectBounds[l_Objects[p_Node.First + i]];
+		for (int c = 0; c < 3; c++)
+		{
+			p_Node.Min[c] = std::min(p_Node.Min[c], l_Bounds.Min[c]);
+			p_Node.Max[c] = std::max(p_Node.Max[c], l_Bounds.Max[c]);
+		}
+	}
+}
+
+static void FitInner(SceneBvhNode& p_Node)
+{
+	const SceneBvhNode& l_Left = l_Nodes[p_Node.Left];
+	const SceneBvhNode& l_Right = l_Nodes[p_Node.Right];
+	for (int c = 0; c < 3; c++)
+	{
+		p_Node.Min[c] = std::min(l_Left.Min[c], l_Right.Min[c]);
+		p_Node.Max[c] = std::max(l_Left.Max[c], l_Right.Max[c]);
+	}
+}
+
+// Orders objects by their box centers along one axis...
+struct CenterLess
+{
+	int Axis;
+	bool operator()(unsigned int p_A, unsigned int p_B) const
+	{
+		return l_ObjectBounds[p_A].Min[Axis] + l_ObjectBounds[p_A].Max[Axis] < l_ObjectBounds[p_B].Min[Axis] + l_ObjectBounds[p_B].Max[Axis];
+	}
+};
+
+// Median split along the longest side of the centers' box, returns the node index...
+static int BuildNode(unsigned int p_First, unsigned int p_Count, int p_Parent)
+{
+	const int l_Index = (int)l_Nodes.size();
+	SceneBvhNode l_Node;
+	l_Node.Parent = p_Parent;
+	l_Node.Left = l_Node.Right = -1;
+	l_Node.First = p_First;
+	l_Node.Count = p_Count;
+	l_Nodes.push_back(l_Node);
+
+	if (p_Count <= BVH_LEAF_SIZE)
+	{
+		for (unsigned int i = 0; i < p_Count; i++)
+			l_ObjectLeaves[l_Objects[p_First + i]] = l_Index;
+		FitLeaf(l_Nodes[l_Index]);
+		return l_Index;
+	}
+
+	float l_Min[3] = { 1e30f, 1e30f, 1e30f };
+	float l_Max[3] = { -1e30f, -1e30f, -1e30f };
+	for (unsigned int i = 0; i < p_Count; i++)
+	{
+		const ObjectBounds& l_Bounds = l_ObjectBounds[l_Objects[p_First + i]];
+		for (int c = 0; c < 3; c++)
+		{
+			const float l_Center = l_Bounds.Min[c] + l_Bounds.Max[c];
+			l_Min[c] = std::min(l_Min[c], l_Center);
+			l_Max[c] = std::max(l_Max[c], l_Center);
+		}
+	}
+	CenterLess l_Less;
+	l_Less.Axis = 0;
+	for (int c = 1; c < 3; c++)
+	{
+		if (l_Max[c] - l_Min[c] > l_Max[l_Less.Axis] - l_Min[l_Less.Axis])
+			l_Less.Axis = c;
+	}
+
+	const unsigned int l_Half = p_Count / 2;
+	std::nth_element(l_Objects.begin() + p_First, l_Objects.begin() + p_First + l_Half, l_Objects.begin() + p_First + p_Count, l_Less);
+
+	// l_Nodes may grow while building the children, so no references across the calls...
+	const int l_Left = BuildNode(p_First, l_Half, l_Index);
+	const int l_Right = BuildNode(p_First + l_Half, p_Count - l_Half, l_Index);
+	l_Nodes[l_Index].Left = l_Left;
+	l_Nodes[l_Index].Right = l_Right;
+	FitInner(l_Nodes[l_Index]);
+	return l_Index;
+}
+
+static void BuildSceneBvh(void)
+{
+	const unsigned int l_Count = (unsigned int)g_SceneObjects.size();
+	l_ObjectBounds.resize(l_Count);
+	l_ObjectLeaves.assign(l_Count, -1);
+	l_Objects.resize(l_Count);
+	for (unsigned int i = 0; i < l_Count; i++)
+	{
+		ComputeObjectBounds(i, l_ObjectBounds[i]);
+		l_Objects[i] = i;
+	}
+
+	l_Nodes.clear();
+	l_Nodes.reserve(l_Count / 2 + 1);
+	if (l_Count > 0)
+		BuildNode(0, l_Count, -1);
+
+	l_Valid = true;
+	l_Revision = g_SceneRevision;
+	g_SceneBvhStats.Nodes = (unsigned int)l_Nodes.size();
+	g_SceneBvhStats.Refits = 0;
+	++g_SceneBvhStats.Rebuilds;
+}
+
+// New box for the object, then up the tree until a box doesn't change. Objects set to the transform
+// they had (or moved without their box changing) leave the tree alone, returns false for those...
+static bool RefitObject(unsigned int p_Object)
+{
+	ObjectBounds l_Bounds;
+	ComputeObjectBounds(p_Object, l_Bounds);
+	ObjectBounds& l_Current = l_ObjectBounds[p_Object];
+	if (std::equal(l_Bounds.Min, l_Bounds.Min + 3, l_Current.Min) && std::equal(l_Bounds.Max, l_Bounds.Max + 3, l_Current.Max))
+		return false;
+	l_Current = l_Bounds;
+
+	int l_Node = l_ObjectLeaves[p_Object];
+	FitLeaf(l_Nodes[l_Node]);
+	for (l_Node = l_Nodes[l_Node].Parent; l_Node >= 0; l_Node = l_Nodes[l_Node].Parent)
+	{
+		SceneBvhNode& l_Inner = l_Nodes[l_Node];
+		const SceneBvhNode l_Before = l_Inner;
+		FitInner(l_Inner);
+		if (std::equal(l_Before.Min, l_Before.Min + 3, l_Inner.Min) && std::equal(l_Before.Max, l_Before.Max + 3, l_Inner.Max))
+			break;
+	}
+	return true;
+}
+
+void UpdateSceneBvh(void)
+{
+	if (!l_Valid || l_Revision != g_SceneRevision)
+	{
+		BuildSceneBvh();
+		return;
+	}
+
+	for (size_t i = 0; i < g_SceneMovedObjects.size(); i++)
+	{
+		if (RefitObject(g_SceneMovedObjects[i]))
+			++g_SceneBvhStats.Refits;
+	}
+
+	// Refitted boxes only ever grow looser, once half the objects have moved it's time for a new tree...
+	if (g_SceneBvhStats.Refits * 2 > l_Objects.size())
+		BuildSceneBvh();
+}
+
+void InvalidateSceneBvh(void)
+{
+	l_Valid = false;
+}
+
+// Planes are (a, b, c, d) with a * x + b * y + c * z + d >= 0 inside.
+enum PlaneTest
+{
+	Plane_Outside,
+	Plane_Straddles,
+	Plane_Inside
+};
+
+static PlaneTest TestBox(const float p_Plane[4], const float p_Min[3], const float p_Max[3])
+{
+	float l_Farthest = p_Plane[3];
+	float l_Nearest = p_Plane[3];
+	for (int c = 0; c < 3; c++)
+	{
+		l_Farthest += p_Plane[c] * (p_Plane[c] >= 0.0f ? p_Max[c] : p_Min[c]);
+		l_Nearest += p_Plane[c] * (p_Plane[c] >= 0.0f ? p_Min[c] : p_Max[c]);
+	}
+	if (l_Farthest < 0.0f)
+		return Plane_Outside;
+	return (l_Nearest >= 0.0f) ? Plane_Inside : Plane_Straddles;
+}
+
+// Eye space plane to world space, for the world to eye matrix p_View...
+static void PlaneToWorld(const OVR::Matrix4f& p_View, const float p_Plane[4], float p_World[4])
+{
+	for (int j = 0; j < 4; j++)
+		p_World[j] = p_Plane[0] * p_View.M[0][j] + p_Plane[1] * p_View.M[1][j] + p_Plane[2] * p_View.M[2][j] + p_Plane[3] * p_View.M[3][j];
+}
+
+// p_Fov widened by the padding of p_EyeFov (the FOV it is a part of). Tangents of a part can be
+// negative (a side past the eye's center), so the padding gets added rather than scaled in...
+static ovrFovPort PaddedFov(const ovrFovPort& p_Fov, const ovrFovPort& p_EyeFov)
+{
+	ovrFovPort l_Fov;
+	l_Fov.UpTan = p_Fov.UpTan + (BVH_FRUSTUM_PADDING - 1.0f) * p_EyeFov.UpTan;
+	l_Fov.DownTan = p_Fov.DownTan + (BVH_FRUSTUM_PADDING - 1.0f) * p_EyeFov.DownTan;
+	l_Fov.LeftTan = p_Fov.LeftTan + (BVH_FRUSTUM_PADDING - 1.0f) * p_EyeFov.LeftTan;
+	l_Fov.RightTan = p_Fov.RightTan + (BVH_FRUSTUM_PADDING - 1.0f) * p_EyeFov.RightTan;
+	return l_Fov;
+}
+
+// The four sides of a frustum looking down -z, in world space...
+static void FrustumSides(const OVR::Matrix4f& p_View, const ovrFovPort& p_Fov, float p_Planes[4][4])
+{
+	const float l_Left[4] = { 1.0f, 0.0f, -p_Fov.LeftTan, 0.0f };
+	const float l_Right[4] = { -1.0f, 0.0f, -p_Fov.RightTan, 0.0f };
+	const float l_Up[4] = { 0.0f, -1.0f, -p_Fov.UpTan, 0.0f };
+	const float l_Down[4] = { 0.0f, 1.0f, -p_Fov.DownTan, 0.0f };
+	PlaneToWorld(p_View, l_Left, p_Planes[0]);
+	PlaneToWorld(p_View, l_Right, p_Planes[1]);
+	PlaneToWorld(p_View, l_Up, p_Planes[2]);
+	PlaneToWorld(p_View, l_Down, p_Planes[3]);
+}
+
+// The eyes share an orientation, the union frustum gets the widest tangent on each side and its
+// apex moves back from between the eyes until its left and right sides clear both eyes...
+void GetSceneUnionFrustum(const EyeView p_Eyes[2], OVR::Matrix4f& p_View, ovrFovPort& p_Fov)
+{
+	p_Fov.LeftTan = std::max(p_Eyes[0].Fov.LeftTan, p_Eyes[1].Fov.LeftTan);
+	p_Fov.RightTan = std::max(p_Eyes[0].Fov.RightTan, p_Eyes[1].Fov.RightTan);
+	p_Fov.UpTan = std::max(p_Eyes[0].Fov.UpTan, p_Eyes[1].Fov.UpTan);
+	p_Fov.DownTan = std::max(p_Eyes[0].Fov.DownTan, p_Eyes[1].Fov.DownTan);
+	p_Fov = PaddedFov(p_Fov, p_Fov);
+
+	const OVR::Vector3f l_Center = p_Eyes[0].View.Transform((p_Eyes[0].Position + p_Eyes[1].Position) * 0.5f);
+	const float l_HalfSeparation = l_Center.Length();
+	const float l_PullBack = l_HalfSeparation / std::min(p_Fov.LeftTan, p_Fov.RightTan);
+	p_View = OVR::Matrix4f::Translation(-(l_Center + OVR::Vector3f(0.0f, 0.0f, l_PullBack))) * p_Eyes[0].View;
+}
+
+// Sides and front of the frustum around both eyes...
+static void UnionFrustum(const EyeView p_Eyes[2], float p_Planes[5][4])
+{
+	OVR::Matrix4f l_View;
+	ovrFovPort l_Fov;
+	GetSceneUnionFrustum(p_Eyes, l_View, l_Fov);
+
+	FrustumSides(l_View, l_Fov, p_Planes);
+	const float l_Front[4] = { 0.0f, 0.0f, -1.0f, 0.0f };
+	PlaneToWorld(l_View, l_Front, p_Planes[4]);
+}
+
+// Where a node stands: the planes it still straddles (a bit per plane) and the eyes that may see it...
+struct CullState
+{
+	unsigned int UnionPlanes;
+	unsigned int EyePlanes[2];
+	unsigned int Eyes;
+};
+
+// Tests a box against the planes it still straddles (bits of p_Straddled), drops the ones it turns
+// out to be inside of. False if the box is outside any of them.
+static bool CullBoxPlanes(const float p_Min[3], const float p_Max[3], const float p_Planes[][4], unsigned int p_PlaneCount, unsigned int& p_Straddled)
+{
+	for (unsigned int i = 0; i < p_PlaneCount; i++)
+	{
+		if (!(p_Straddled & (1u << i)))
+			continue;
+		const PlaneTest l_Test = TestBox(p_Planes[i], p_Min, p_Max);
+		if (l_Test == Plane_Outside)
+			return false;
+		if (l_Test == Plane_Inside)
+			p_Straddled &= ~(1u << i);
+	}
+	return true;
+}
+
+// Tests a box against what p_State still straddles, updates it. False if nothing sees the box.
+static bool CullBox(const float p_Min[3], const float p_Max[3], const float p_Union[5][4], const float p_EyeSides[2][4][4], bool p_PerEye, CullState& p_State)
+{
+	if (!CullBoxPlanes(p_Min, p_Max, p_Union, 5, p_State.UnionPlanes))
+		return false;
+
+	if (!p_PerEye)
+		return true;
+
+	for (int l_Eye = 0; l_Eye < 2; l_Eye++)
+	{
+		if (!(p_State.Eyes & (1u << l_Eye)) || !p_State.EyePlanes[l_Eye])
+			continue;
+
+		++g_SceneBvhStats.EyeRefinements;
+		if (!CullBoxPlanes(p_Min, p_Max, p_EyeSides[l_Eye], 4, p_State.EyePlanes[l_Eye]))
+			p_State.Eyes &= ~(1u << l_Eye);
+	}
+	return p_State.Eyes != 0;
+}
+
+void CullSceneBvh(const EyeView p_Eyes[2], bool p_PerEye, std::vector<unsigned int> p_Visible[2])
+{
+	p_Visible[0].clear();
+	p_Visible[1].clear();
+	g_SceneBvhStats.NodesVisited = 0;
+	g_SceneBvhStats.NodesCulled = 0;
+	g_SceneBvhStats.EyeRefinements = 0;
+	g_SceneBvhStats.Visible[0] = g_SceneBvhStats.Visible[1] = 0;
+	if (l_Nodes.empty())
+		return;
+
+	float l_Union[5][4];
+	float l_EyeSides[2][4][4];
+	UnionFrustum(p_Eyes, l_Union);
+	FrustumSides(p_Eyes[0].View, PaddedFov(p_Eyes[0].Fov, p_Eyes[0].Fov), l_EyeSides[0]);
+	FrustumSides(p_Eyes[1].View, PaddedFov(p_Eyes[1].Fov, p_Eyes[1].Fov), l_EyeSides[1]);
+
+	struct StackEntry
+	{
+		int Node;
+		CullState State;
+	};
+	StackEntry l_Stack[64];
+	unsigned int l_StackSize = 0;
+	const CullState l_Root = { 0x1F, { 0xF, 0xF }, 0x3 };
+	l_Stack[l_StackSize].Node = 0;
+	l_Stack[l_StackSize].State = l_Root;
+	++l_StackSize;
+
+	while (l_StackSize > 0)
+	{
+		StackEntry l_Entry = l_Stack[--l_StackSize];
+		const SceneBvhNode& l_Node = l_Nodes[l_Entry.Node];
+		++g_SceneBvhStats.NodesVisited;
+
+		if (!CullBox(l_Node.Min, l_Node.Max, l_Union, l_EyeSides, p_PerEye, l_Entry.State))
+		{
+			++g_SceneBvhStats.NodesCulled;
+			continue;
+		}
+
+		if (l_Node.Left >= 0)
+		{
+			// Median splits keep the depth at log2 of the leaf count, far below the stack size...
+			l_Stack[l_StackSize].Node = l_Node.Right;
+			l_Stack[l_StackSize].State = l_Entry.State;
+			++l_StackSize;
+			l_Stack[l_StackSize].Node = l_Node.Left;
+			l_Stack[l_StackSize].State = l_Entry.State;
+			++l_StackSize;
+			continue;
+		}
+
+		for (unsigned int i = 0; i < l_Node.Count; i++)
+		{
+			const unsigned int l_Object = l_Objects[l_Node.First + i];
+			CullState l_State = l_Entry.State;
+			if (!CullBox(l_ObjectBounds[l_Object].Min, l_ObjectBounds[l_Object].Max, l_Union, l_EyeSides, p_PerEye, l_State))
+				continue;
+
+			if (!p_PerEye)
+			{
+				p_Visible[0].push_back(l_Object);
+				continue;
+			}
+			if (l_State.Eyes & 1)
+				p_Visible[0].push_back(l_Object);
+			if (l_State.Eyes & 2)
+				p_Visible[1].push_back(l_Object);
+		}
+	}
+
+	g_SceneBvhStats.Visible[0] = (unsigned int)p_Visible[0].size();
+	g_SceneBvhStats.Visible[1] = p_PerEye ? (unsigned int)p_Visible[1].size() : g_SceneBvhStats.Visible[0];
+}
+
+void CullSceneBvhRegion(const EyeView& p_Eye, const ovrFovPort& p_Region, std::vector<unsigned int>& p_Visible)
+{
+	p_Visible.clear();
+	if (l_Nodes.empty())
+		return;
+
+	// The region's sides, and the eye's front so nothing behind it gets in...
+	float l_Frustum[5][4];
+	FrustumSides(p_Eye.View, PaddedFov(p_Region, p_Eye.Fov), l_Frustum);
+	const float l_Front[4] = { 0.0f, 0.0f, -1.0f, 0.0f };
+	PlaneToWorld(p_Eye.View, l_Front, l_Frustum[4]);
+
+	// Same walk as above, with a single frustum and a plane mask per node...
+	struct StackEntry
+	{
+		int Node;
+		unsigned int Planes;
+	};
+	StackEntry l_Stack[64];
+	unsigned int l_StackSize = 0;
+	l_Stack[l_StackSize].Node = 0;
+	l_Stack[l_StackSize].Planes = 0x1F;
+	++l_StackSize;
+
+	while (l_StackSize > 0)
+	{
+		const StackEntry l_Entry = l_Stack[--l_StackSize];
+		const SceneBvhNode& l_Node = l_Nodes[l_Entry.Node];
+		unsigned int l_Planes = l_Entry.Planes;
+		if (!CullBoxPlanes(l_Node.Min, l_Node.Max, l_Frustum, 5, l_Planes))
+			continue;
+
+		if (l_Node.Left >= 0)
+		{
+			l_Stack[l_StackSize].Node = l_Node.Right;
+			l_Stack[l_StackSize].Planes = l_Planes;
+			++l_StackSize;
+			l_Stack[l_StackSize].Node = l_Node.Left;
+			l_Stack[l_StackSize].Planes = l_Planes;
+			++l_StackSize;
+			continue;
+		}
+
+		for (unsigned int i = 0; i < l_Node.Count; i++)
+		{
+			const unsigned int l_Object = l_Objects[l_Node.First + i];
+			unsigned int l_ObjectPlanes = l_Planes;
+			if (CullBoxPlanes(l_ObjectBounds[l_Object].Min, l_ObjectBounds[l_Object].Max, l_Frustum, 5, l_ObjectPlanes))
+				p_Visible.push_back(l_Object);
+		}
+	}
+}
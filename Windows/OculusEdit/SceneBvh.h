@@ -0,0 +1,67 @@
+//
+//  SceneBvh.h
+//  OculusEdit
+//
+//  Bounding volume hierarchy over the scene objects, for culling on the CPU. Every
+//  object's box is the box around its mesh's bounding sphere in world space. Objects
+//  that move only refit the boxes above them; once enough of them have moved (the
+//  boxes get loose) or objects come and go, the tree is built again.
+//
+//  Culling tests every node once against a single frustum that holds both eyes (the
+//  union of the two FOVs, with the apex pulled back behind the eyes so it contains
+//  both). That is all single-pass stereo needs. For multi-pass each eye's own sides are
+//  tested as well, but only for the nodes that straddle them: a node inside the inner
+//  sides of both eyes is in the overlap and seen by both without further tests.
+//
+//  Multi-resolution draws each eye in regions (see MultiResolution.h). Every region is
+//  culled on its own, against the sides of its part of the eye's FOV.
+//
+
+#pragma once
+
+#include <vector>
+
+#include "SceneRenderer.h"
+
+struct SceneBvhNode
+{
+	float Min[3];
+	float Max[3];
+	int Parent;         // -1 for the root.
+	int Left;           // Child nodes, -1 for a leaf...
+	int Right;
+	unsigned int First; // ... whose objects are l_Objects[First, First + Count).
+	unsigned int Count;
+};
+
+// What the last cull did, for the profiler:
+struct SceneBvhStats
+{
+	unsigned int Nodes;          // In the tree.
+	unsigned int NodesVisited;
+	unsigned int NodesCulled;    // Outside the union frustum, with everything below them.
+	unsigned int EyeRefinements; // Nodes and objects tested against the eyes' own sides.
+	unsigned int Visible[2];     // Objects per eye (both the same without per eye culling).
+	unsigned int Refits;         // Objects refitted since the last build.
+	unsigned int Rebuilds;       // Full builds so far.
+};
+
+extern SceneBvhStats g_SceneBvhStats;
+
+// Brings the tree up to date with g_SceneObjects, g_SceneRevision and g_SceneMovedObjects (which
+// it doesn't clear, that's up to the caller).
+void UpdateSceneBvh(void);
+
+// Drops the tree, the next update builds it from scratch.
+void InvalidateSceneBvh(void);
+
+// Collects the visible objects. With p_PerEye p_Visible[i] gets the objects eye i sees, otherwise
+// p_Visible[0] gets the ones either eye sees (and p_Visible[1] is left empty).
+void CullSceneBvh(const EyeView p_Eyes[2], bool p_PerEye, std::vector<unsigned int> p_Visible[2]);
+
+// The frustum that holds both eyes (padded a little for late latching): world to its apex, which
+// sits behind the eyes looking down -z, and the tangents of its sides. Light clustering uses it too.
+void GetSceneUnionFrustum(const EyeView p_Eyes[2], OVR::Matrix4f& p_View, ovrFovPort& p_Fov);
+
+// Collects the objects p_Eye sees through p_Region, a part of its FOV (p_Eye.Fov). Doesn't touch the stats.
+void CullSceneBvhRegion(const EyeView& p_Eye, const ovrFovPort& p_Region, std::vector<unsigned int>& p_Visible);
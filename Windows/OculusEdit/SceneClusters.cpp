@@ -0,0 +1,205 @@
+//
+//  SceneClusters.cpp
+//  OculusEdit
+//
+
+#include "SceneClusters.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "Scene.h"
+#include "SceneBvh.h"
+
+SceneClusterStats g_SceneClusterStats = { 0, 0, 0 };
+
+static const int CLUSTER_COUNT = SCENE_CLUSTER_TILES_X * SCENE_CLUSTER_TILES_Y * SCENE_CLUSTER_SLICES;
+
+static GLuint l_UniformBuffer = 0;
+static GLuint l_Buffers[3] = { 0, 0, 0 };   // Lights, grid and indices...
+static GLuint l_Textures[3] = { 0, 0, 0 };  // ... and the buffer textures reading them.
+static const GLenum l_Formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+static const GLuint l_Units[3] = { SCENE_CLUSTER_LIGHTS_TEXTURE_UNIT, SCENE_CLUSTER_GRID_TEXTURE_UNIT, SCENE_CLUSTER_INDICES_TEXTURE_UNIT };
+
+// Kept between frames so binning doesn't allocate...
+static std::vector<GLuint> l_Pairs;        // Cluster and light of every hit, two entries each.
+static std::vector<GLuint> l_Grid;         // First index and count per cluster.
+static std::vector<GLuint> l_Indices;
+static std::vector<GLfloat> l_LightData;
+
+void InitializeSceneClusters(void)
+{
+	glGenBuffers(1, &l_UniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, l_UniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(ClusterUniformBlock), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, CLUSTER_UNIFORM_BINDING, l_UniformBuffer);
+
+	// Never empty, buffer textures over no storage at all are asking for trouble...
+	const GLfloat l_Zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glGenBuffers(3, l_Buffers);
+	glGenTextures(3, l_Textures);
+	for (int i = 0; i < 3; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, l_Buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(l_Zero), l_Zero, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, l_Textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, l_Formats[i], l_Buffers[i]);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	l_Grid.assign(CLUSTER_COUNT * 2, 0);
+}
+
+void DestroySceneClusters(void)
+{
+	glDeleteTextures(3, l_Textures);
+	glDeleteBuffers(3, l_Buffers);
+	glDeleteBuffers(1, &l_UniformBuffer);
+	memset(l_Textures, 0, sizeof(l_Textures));
+	memset(l_Buffers, 0, sizeof(l_Buffers));
+	l_UniformBuffer = 0;
+	l_Pairs.clear();
+	l_Grid.clear();
+	l_Indices.clear();
+	l_LightData.clear();
+}
+
+void BindClusterUniformBlock(GLuint p_Program)
+{
+	const GLuint l_BlockIndex = glGetUniformBlockIndex(p_Program, "ClusterUniforms");
+	if (l_BlockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(p_Program, l_BlockIndex, CLUSTER_UNIFORM_BINDING);
+}
+
+// New storage every frame, the frames still in flight keep reading their own copy...
+static void Upload(GLenum p_Target, GLuint p_Buffer, GLsizeiptr p_Size, const void* p_Data)
+{
+	glBindBuffer(p_Target, p_Buffer);
+	glBufferData(p_Target, p_Size, p_Data, GL_STREAM_DRAW);
+	glBindBuffer(p_Target, 0);
+}
+
+void BuildSceneClusters(const EyeView p_Eyes[2])
+{
+	OVR::Matrix4f l_View;
+	ovrFovPort l_Fov;
+	GetSceneUnionFrustum(p_Eyes, l_View, l_Fov);
+
+	// Slice s starts at Near * (Far / Near) ^ (s / SLICES)...
+	const float l_Near = p_Eyes[0].ZNear;
+	const float l_Far = p_Eyes[0].ZFar;
+	const float l_TileScaleX = SCENE_CLUSTER_TILES_X / (l_Fov.LeftTan + l_Fov.RightTan);
+	const float l_TileScaleY = SCENE_CLUSTER_TILES_Y / (l_Fov.DownTan + l_Fov.UpTan);
+	const float l_SliceScale = SCENE_CLUSTER_SLICES / logf(l_Far / l_Near);
+
+	// Every light's sphere, slice by slice: its box spans a range of tangents over the slice's part
+	// of the sphere's depth, the tiles under that range get the light...
+	l_Pairs.clear();
+	g_SceneClusterStats.Lights = 0;
+	for (size_t l_Light = 0; l_Light < g_ScenePointLights.size(); l_Light++)
+	{
+		const ScenePointLight& l_PointLight = g_ScenePointLights[l_Light];
+		const OVR::Vector3f l_Center = l_View.Transform(OVR::Vector3f(l_PointLight.Position[0], l_PointLight.Position[1], l_PointLight.Position[2]));
+		const float l_Radius = l_PointLight.Radius;
+		const float l_MinDepth = std::max(-l_Center.z - l_Radius, l_Near);
+		const float l_MaxDepth = std::min(-l_Center.z + l_Radius, l_Far);
+		if (l_MinDepth >= l_MaxDepth)
+			continue;
+
+		bool l_Binned = false;
+		const int l_FirstSlice = std::min((int)(logf(l_MinDepth / l_Near) * l_SliceScale), SCENE_CLUSTER_SLICES - 1);
+		const int l_LastSlice = std::min((int)(logf(l_MaxDepth / l_Near) * l_SliceScale), SCENE_CLUSTER_SLICES - 1);
+		for (int l_Slice = l_FirstSlice; l_Slice <= l_LastSlice; l_Slice++)
+		{
+			const float l_Depth0 = std::max(l_MinDepth, l_Near * expf(l_Slice / l_SliceScale));
+			const float l_Depth1 = std::min(l_MaxDepth, l_Near * expf((l_Slice + 1) / l_SliceScale));
+			const float l_Left = std::min((l_Center.x - l_Radius) / l_Depth0, (l_Center.x - l_Radius) / l_Depth1);
+			const float l_Right = std::max((l_Center.x + l_Radius) / l_Depth0, (l_Center.x + l_Radius) / l_Depth1);
+			const float l_Down = std::min((l_Center.y - l_Radius) / l_Depth0, (l_Center.y - l_Radius) / l_Depth1);
+			const float l_Up = std::max((l_Center.y + l_Radius) / l_Depth0, (l_Center.y + l_Radius) / l_Depth1);
+			if (l_Right < -l_Fov.LeftTan || l_Left > l_Fov.RightTan || l_Up < -l_Fov.DownTan || l_Down > l_Fov.UpTan)
+				continue;
+
+			const int l_X0 = std::max((int)floorf((l_Left + l_Fov.LeftTan) * l_TileScaleX), 0);
+			const int l_X1 = std::min((int)floorf((l_Right + l_Fov.LeftTan) * l_TileScaleX), SCENE_CLUSTER_TILES_X - 1);
+			const int l_Y0 = std::max((int)floorf((l_Down + l_Fov.DownTan) * l_TileScaleY), 0);
+			const int l_Y1 = std::min((int)floorf((l_Up + l_Fov.DownTan) * l_TileScaleY), SCENE_CLUSTER_TILES_Y - 1);
+			for (int l_Y = l_Y0; l_Y <= l_Y1; l_Y++)
+			{
+				for (int l_X = l_X0; l_X <= l_X1; l_X++)
+				{
+					l_Pairs.push_back((GLuint)((l_Slice * SCENE_CLUSTER_TILES_Y + l_Y) * SCENE_CLUSTER_TILES_X + l_X));
+					l_Pairs.push_back((GLuint)l_Light);
+				}
+			}
+			l_Binned = true;
+		}
+		if (l_Binned)
+			++g_SceneClusterStats.Lights;
+	}
+
+	// Counting sort by cluster: counts, then first indices, then the indices themselves...
+	l_Grid.assign(CLUSTER_COUNT * 2, 0);
+	for (size_t i = 0; i < l_Pairs.size(); i += 2)
+		++l_Grid[l_Pairs[i] * 2 + 1];
+	GLuint l_First = 0;
+	g_SceneClusterStats.MaxClusterLights = 0;
+	for (int l_Cluster = 0; l_Cluster < CLUSTER_COUNT; l_Cluster++)
+	{
+		l_Grid[l_Cluster * 2] = l_First;
+		l_First += l_Grid[l_Cluster * 2 + 1];
+		g_SceneClusterStats.MaxClusterLights = std::max(g_SceneClusterStats.MaxClusterLights, l_Grid[l_Cluster * 2 + 1]);
+		l_Grid[l_Cluster * 2 + 1] = 0;
+	}
+	l_Indices.resize(std::max(l_First, (GLuint)1));
+	for (size_t i = 0; i < l_Pairs.size(); i += 2)
+	{
+		GLuint* l_Range = &l_Grid[l_Pairs[i] * 2];
+		l_Indices[l_Range[0] + l_Range[1]++] = l_Pairs[i + 1];
+	}
+	g_SceneClusterStats.LightIndices = l_First;
+
+	l_LightData.resize(std::max(g_ScenePointLights.size(), (size_t)1) * 8);
+	for (size_t i = 0; i < g_ScenePointLights.size(); i++)
+	{
+		const ScenePointLight& l_PointLight = g_ScenePointLights[i];
+		GLfloat* l_Data = &l_LightData[i * 8];
+		memcpy(l_Data, l_PointLight.Position, 3 * sizeof(GLfloat));
+		l_Data[3] = l_PointLight.Radius;
+		memcpy(l_Data + 4, l_PointLight.Color, 3 * sizeof(GLfloat));
+		l_Data[7] = 0.0f;
+	}
+
+	ClusterUniformBlock l_Block;
+	memcpy(l_Block.View, &l_View.M[0][0], sizeof(l_Block.View));
+	l_Block.Tiles[0] = l_Fov.LeftTan;
+	l_Block.Tiles[1] = l_Fov.DownTan;
+	l_Block.Tiles[2] = l_TileScaleX;
+	l_Block.Tiles[3] = l_TileScaleY;
+	l_Block.Slices[0] = l_Near;
+	l_Block.Slices[1] = l_SliceScale;
+	l_Block.Slices[2] = l_Block.Slices[3] = 0.0f;
+	l_Block.Size[0] = SCENE_CLUSTER_TILES_X;
+	l_Block.Size[1] = SCENE_CLUSTER_TILES_Y;
+	l_Block.Size[2] = SCENE_CLUSTER_SLICES;
+	l_Block.Size[3] = 0;
+
+	Upload(GL_UNIFORM_BUFFER, l_UniformBuffer, sizeof(l_Block), &l_Block);
+	Upload(GL_TEXTURE_BUFFER, l_Buffers[0], l_LightData.size() * sizeof(GLfloat), &l_LightData[0]);
+	Upload(GL_TEXTURE_BUFFER, l_Buffers[1], l_Grid.size() * sizeof(GLuint), &l_Grid[0]);
+	Upload(GL_TEXTURE_BUFFER, l_Buffers[2], l_Indices.size() * sizeof(GLuint), &l_Indices[0]);
+}
+
+void BindSceneClusterTextures(void)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + l_Units[i]);
+		glBindTexture(GL_TEXTURE_BUFFER, l_Textures[i]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
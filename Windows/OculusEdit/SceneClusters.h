@@ -0,0 +1,97 @@
+//
+//  SceneClusters.h
+//  OculusEdit
+//
+//  Clustered forward lighting for the point lights (g_ScenePointLights). The union
+//  frustum of both eyes (see SceneBvh.h) is cut into a grid of clusters: tiles across
+//  its tangents, and slices along its depth that get thicker with the distance. Every
+//  frame the lights are binned on the CPU into the clusters their spheres touch, and
+//  three buffers go to the GPU once: the lights, every cluster's range of light indices,
+//  and the indices. Both eyes look their pixels up in the same grid, so a fragment only
+//  loops over the handful of lights around it, whatever the total.
+//
+//  GLSL 3.30 has no storage buffers, the buffers are read as buffer textures. The grid
+//  parameters are a uniform block of their own (ClusterUniforms, fixed binding point).
+//  The grid keeps the pose it was built with, so late latching the eyes doesn't move it.
+//
+
+#pragma once
+
+#if !defined(__APPLE__)
+#  include <GL/glew.h>
+#else
+#  include <OpenGL/gl3.h>
+#endif
+
+#include "SceneRenderer.h"
+
+// Clusters across the tangents of the union frustum and along its depth:
+const int SCENE_CLUSTER_TILES_X = 16;
+const int SCENE_CLUSTER_TILES_Y = 8;
+const int SCENE_CLUSTER_SLICES = 24;
+
+// Uniform buffer binding point of the ClusterUniforms block:
+const GLuint CLUSTER_UNIFORM_BINDING = 1;
+
+// Texture units of the light, grid and index buffer textures:
+const GLuint SCENE_CLUSTER_LIGHTS_TEXTURE_UNIT = 3;
+const GLuint SCENE_CLUSTER_GRID_TEXTURE_UNIT = 4;
+const GLuint SCENE_CLUSTER_INDICES_TEXTURE_UNIT = 5;
+
+// GLSL declaration of the block and the buffers. A fragment's cluster comes from clusterView (world
+// to the union frustum's apex) and the two vectors below, ClusterLights(worldPosition) returns the
+// range of its lights in clusterLightIndices. Every light is two texels of clusterLights: position
+// and radius, then color.
+#define CLUSTER_GLSL \
+	"layout (std140, row_major) uniform ClusterUniforms\n" \
+	"{\n" \
+	"   mat4 clusterView;\n" \
+	"   vec4 clusterTiles;\n" \
+	"   vec4 clusterSlices;\n" \
+	"   ivec4 clusterSize;\n" \
+	"};\n" \
+	"uniform samplerBuffer clusterLights;\n" \
+	"uniform usamplerBuffer clusterGrid;\n" \
+	"uniform usamplerBuffer clusterLightIndices;\n" \
+	"uvec2 ClusterLights(vec3 world)\n" \
+	"{\n" \
+	"   vec3 position = (clusterView * vec4(world, 1.0)).xyz;\n" \
+	"   float depth = max(-position.z, clusterSlices.x);\n" \
+	"   vec2 tile = (position.xy / depth + clusterTiles.xy) * clusterTiles.zw;\n" \
+	"   float slice = log(depth / clusterSlices.x) * clusterSlices.y;\n" \
+	"   ivec3 cluster = clamp(ivec3(vec3(tile, slice)), ivec3(0), clusterSize.xyz - 1);\n" \
+	"   return texelFetch(clusterGrid, (cluster.z * clusterSize.y + cluster.y) * clusterSize.x + cluster.x).xy;\n" \
+	"}\n"
+
+// CPU side mirror of the block.
+struct ClusterUniformBlock
+{
+	GLfloat View[16];
+	GLfloat Tiles[4];  // Left and down tangents, tiles per tangent across and up.
+	GLfloat Slices[4]; // Depth of the first slice, slices per log depth.
+	GLint Size[4];     // Tiles across and up, slices.
+};
+
+// What the last build did, for the profiler:
+struct SceneClusterStats
+{
+	unsigned int Lights;       // Binned, the ones outside the grid aren't.
+	unsigned int LightIndices; // Over all clusters.
+	unsigned int MaxClusterLights;
+};
+
+extern SceneClusterStats g_SceneClusterStats;
+
+// Needs a current GL context. Creates the buffers (empty) and binds the block to CLUSTER_UNIFORM_BINDING.
+void InitializeSceneClusters(void);
+void DestroySceneClusters(void);
+
+// Points the program's ClusterUniforms block (if it has one) at CLUSTER_UNIFORM_BINDING.
+void BindClusterUniformBlock(GLuint p_Program);
+
+// Bins g_ScenePointLights into the grid around p_Eyes and uploads it. Once per frame, after the
+// lights have moved.
+void BuildSceneClusters(const EyeView p_Eyes[2]);
+
+// Binds the buffer textures to their units, for the draws that read them.
+void BindSceneClusterTextures(void);
@@ -0,0 +1,337 @@
+//
+//  SceneCulling.cpp
+//  OculusEdit
+//
+
+#include "SceneCulling.h"
+
+#include <stdio.h>
+#include <string>
+
+#include "EyeRenderTarget.h"
+#include "Profiler.h"
+#include "SceneOcclusion.h"
+#include "SceneRenderer.h"
+#include "Shader.h"
+
+// Storage buffer bindings of the cull pass:
+static const GLuint CULL_BINDING_TRANSFORMS = 0;
+static const GLuint CULL_BINDING_OBJECT_BATCHES = 1;
+static const GLuint CULL_BINDING_BATCHES = 2;
+static const GLuint CULL_BINDING_COMMANDS = 3;
+static const GLuint CULL_BINDING_VISIBLE = 4;
+static const GLuint CULL_BINDING_COUNTERS = 5;
+static const GLuint CULL_GROUP_SIZE = 64;
+
+// The counters get copied out after every pass and read back this many passes later, if the GPU is
+// done with them by then (a frame can cull more than once, hence a few more than frames in flight)...
+static const unsigned int CULL_READBACKS = 6;
+
+// std430 mirror of a batch: the mesh's bounding sphere and where its transforms go...
+struct CullBatch
+{
+	GLfloat Sphere[4];
+	GLuint FirstTransform;
+	GLuint Padding[3];
+};
+
+static bool l_Supported = false;
+static GLuint l_CullProgram = 0;
+static GLint l_ObjectCountUniform = -1;
+static GLint l_RepeatUniform = -1;
+static GLint l_OcclusionUniform = -1;
+static GLint l_ReverseZUniform = -1;
+
+static GLuint l_ObjectBatchBuffer = 0;  // Batch index of every transform.
+static GLuint l_BatchBuffer = 0;        // CullBatch per batch.
+static GLuint l_CommandBuffer = 0;      // Draw commands, the pass counts the instances into them.
+static GLuint l_VisibleBuffer = 0;      // The visible transforms, packed per batch.
+static GLuint l_CounterBuffer = 0;      // Visible and occluded objects, counted by the pass.
+static GLuint l_ReadbackBuffers[CULL_READBACKS] = { 0 };
+static GLsync l_ReadbackFences[CULL_READBACKS] = { 0 };
+static unsigned int l_Readback = 0;
+static GLuint l_TransformCount = 0;
+static std::vector<DrawElementsIndirectCommand> l_Commands; // With no instances, uploaded before every pass.
+static std::vector<MeshHandle> l_CommandMeshes;
+
+SceneCullingStats g_SceneCullingStats = { 0, 0, 0 };
+
+// Plane tests against the frustum sides and the plane through the eye (near and far don't matter
+// much for culling, and this way the depth range convention of the projection doesn't either).
+// An object is kept if either eye sees it, both draw it anyway. With occlusion on, an eye that sees
+// it has to see it in front of the pyramid as well (see SceneOcclusion.h). The counts add up per
+// group first, there's one atomic per group on the counters...
+static const std::string l_CullShader(
+	"#version 430\n"
+	EYE_UNIFORM_BLOCK_GLSL
+	OCCLUSION_GLSL
+	"layout (local_size_x = 64) in;\n"
+	"struct Batch { vec4 sphere; uint firstTransform; };\n"
+	"struct Command { uint count; uint instanceCount; uint firstIndex; int baseVertex; uint baseInstance; };\n"
+	"layout (std430, binding = 0) readonly buffer Transforms { vec4 transformRows[]; };\n"
+	"layout (std430, binding = 1) readonly buffer ObjectBatches { uint objectBatch[]; };\n"
+	"layout (std430, binding = 2) readonly buffer Batches { Batch batches[]; };\n"
+	"layout (std430, binding = 3) buffer Commands { Command commands[]; };\n"
+	"layout (std430, binding = 4) writeonly buffer Visible { vec4 visibleRows[]; };\n"
+	"layout (std430, binding = 5) buffer Counters { uint visibleObjects; uint occludedObjects; };\n"
+	"uniform uint objectCount;\n"
+	"uniform uint repeat;\n"
+	"uniform bool occlusion;\n"
+	"shared uint groupVisible;\n"
+	"shared uint groupOccluded;\n"
+	"bool inFrustum(int eye, vec3 center, float radius)\n"
+	"{\n"
+	"   mat4 rows = transpose(viewProjection[eye]);\n"
+	"   vec4 planes[5] = vec4[5](rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3]);\n"
+	"   for (int i = 0; i < 5; i++)\n"
+	"   {\n"
+	"      if (dot(planes[i].xyz, center) + planes[i].w < -radius * length(planes[i].xyz)) return false;\n"
+	"   }\n"
+	"   return true;\n"
+	"}\n"
+	"void Cull(uint object)\n"
+	"{\n"
+	"   uint batch = objectBatch[object];\n"
+	"   vec4 sphere = batches[batch].sphere;\n"
+	"   vec4 r0 = transformRows[object * 4 + 0];\n"
+	"   vec4 r1 = transformRows[object * 4 + 1];\n"
+	"   vec4 r2 = transformRows[object * 4 + 2];\n"
+	"   vec4 r3 = transformRows[object * 4 + 3];\n"
+	"   vec4 c = vec4(sphere.xyz, 1.0);\n"
+	"   vec3 center = vec3(dot(r0, c), dot(r1, c), dot(r2, c));\n"
+	"   float scale = max(length(vec3(r0.x, r1.x, r2.x)), max(length(vec3(r0.y, r1.y, r2.y)), length(vec3(r0.z, r1.z, r2.z))));\n"
+	"   float radius = sphere.w * scale;\n"
+	"   bool left = inFrustum(0, center, radius);\n"
+	"   bool right = inFrustum(1, center, radius);\n"
+	"   if (!left && !right) return;\n"
+	"   if (occlusion && (!left || OccludedInEye(0, center, radius)) && (!right || OccludedInEye(1, center, radius)))\n"
+	"   {\n"
+	"      atomicAdd(groupOccluded, 1u);\n"
+	"      return;\n"
+	"   }\n"
+	"   atomicAdd(groupVisible, 1u);\n"
+	"   uint slot = atomicAdd(commands[batch].instanceCount, repeat) / repeat;\n"
+	"   uint row = (batches[batch].firstTransform + slot) * 4;\n"
+	"   visibleRows[row + 0] = r0;\n"
+	"   visibleRows[row + 1] = r1;\n"
+	"   visibleRows[row + 2] = r2;\n"
+	"   visibleRows[row + 3] = r3;\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"   if (gl_LocalInvocationIndex == 0u)\n"
+	"   {\n"
+	"      groupVisible = 0u;\n"
+	"      groupOccluded = 0u;\n"
+	"   }\n"
+	"   barrier();\n"
+	"   if (gl_GlobalInvocationID.x < objectCount) Cull(gl_GlobalInvocationID.x);\n"
+	"   barrier();\n"
+	"   if (gl_LocalInvocationIndex == 0u)\n"
+	"   {\n"
+	"      atomicAdd(visibleObjects, groupVisible);\n"
+	"      atomicAdd(occludedObjects, groupOccluded);\n"
+	"   }\n"
+	"}\n"
+	);
+
+bool InitializeSceneCulling(void)
+{
+	l_Supported = false;
+	// (macOS stops at GL 4.1.)
+#if !defined(__APPLE__)
+	if (!GLEW_ARB_compute_shader || !GLEW_ARB_shader_storage_buffer_object || !GLEW_ARB_multi_draw_indirect)
+#endif
+	{
+		printf("Compute shaders or multi-draw indirect not supported, GPU culling disabled.\n");
+		return false;
+	}
+
+	// Tiny, built right away...
+	std::vector<GLuint> l_ShaderList;
+	l_ShaderList.push_back(SubmitShader(GL_COMPUTE_SHADER, l_CullShader));
+	l_CullProgram = SubmitProgram(l_ShaderList);
+	const bool l_Built = CheckShader(l_ShaderList[0], GL_COMPUTE_SHADER) && CheckProgram(l_CullProgram);
+	glDetachShader(l_CullProgram, l_ShaderList[0]);
+	glDeleteShader(l_ShaderList[0]);
+	if (!l_Built)
+	{
+		printf("The culling shader failed to build, GPU culling disabled.\n");
+		glDeleteProgram(l_CullProgram);
+		l_CullProgram = 0;
+		return false;
+	}
+	BindEyeUniformBlock(l_CullProgram);
+	l_ObjectCountUniform = glGetUniformLocation(l_CullProgram, "objectCount");
+	l_RepeatUniform = glGetUniformLocation(l_CullProgram, "repeat");
+	l_OcclusionUniform = glGetUniformLocation(l_CullProgram, "occlusion");
+	l_ReverseZUniform = glGetUniformLocation(l_CullProgram, "reverseZ");
+	glUseProgram(l_CullProgram);
+	glUniform1i(glGetUniformLocation(l_CullProgram, "occlusionPyramid"), SCENE_OCCLUSION_TEXTURE_UNIT);
+	glUseProgram(0);
+
+	glGenBuffers(1, &l_ObjectBatchBuffer);
+	glGenBuffers(1, &l_BatchBuffer);
+	glGenBuffers(1, &l_CommandBuffer);
+	glGenBuffers(1, &l_VisibleBuffer);
+	glGenBuffers(1, &l_CounterBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, l_CounterBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glGenBuffers(CULL_READBACKS, l_ReadbackBuffers);
+	for (unsigned int i = 0; i < CULL_READBACKS; i++)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, l_ReadbackBuffers[i]);
+		glBufferData(GL_COPY_WRITE_BUFFER, 2 * sizeof(GLuint), NULL, GL_STREAM_READ);
+		l_ReadbackFences[i] = 0;
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	l_Readback = 0;
+	g_SceneCullingStats.Objects = g_SceneCullingStats.Visible = g_SceneCullingStats.Occluded = 0;
+	l_TransformCount = 0;
+	l_Commands.clear();
+	l_CommandMeshes.clear();
+
+	l_Supported = true;
+	return true;
+}
+
+void DestroySceneCulling(void)
+{
+	if (!l_Supported)
+		return;
+
+	glDeleteProgram(l_CullProgram);
+	glDeleteBuffers(1, &l_ObjectBatchBuffer);
+	glDeleteBuffers(1, &l_BatchBuffer);
+	glDeleteBuffers(1, &l_CommandBuffer);
+	glDeleteBuffers(1, &l_VisibleBuffer);
+	glDeleteBuffers(1, &l_CounterBuffer);
+	glDeleteBuffers(CULL_READBACKS, l_ReadbackBuffers);
+	for (unsigned int i = 0; i < CULL_READBACKS; i++)
+	{
+		if (l_ReadbackFences[i])
+			glDeleteSync(l_ReadbackFences[i]);
+		l_ReadbackBuffers[i] = 0;
+		l_ReadbackFences[i] = 0;
+	}
+	l_CullProgram = 0;
+	l_ObjectBatchBuffer = l_BatchBuffer = l_CommandBuffer = l_VisibleBuffer = l_CounterBuffer = 0;
+	l_Commands.clear();
+	l_CommandMeshes.clear();
+	l_Supported = false;
+}
+
+void SetSceneCullingBatches(const std::vector<SceneInstanceBatch>& p_Batches, GLuint p_TransformCount)
+{
+	if (!l_Supported)
+		return;
+
+	std::vector<GLuint> l_ObjectBatches(p_TransformCount, 0);
+	std::vector<CullBatch> l_Batches(p_Batches.size());
+	l_Commands.resize(p_Batches.size());
+	l_CommandMeshes.resize(p_Batches.size());
+	for (size_t i = 0; i < p_Batches.size(); i++)
+	{
+		const SceneInstanceBatch& l_Batch = p_Batches[i];
+		for (GLsizei j = 0; j < l_Batch.TransformCount; j++)
+			l_ObjectBatches[l_Batch.FirstTransform + j] = (GLuint)i;
+
+		const Mesh& l_Mesh = g_Meshes[l_Batch.Mesh];
+		for (int c = 0; c < 4; c++)
+			l_Batches[i].Sphere[c] = l_Mesh.BoundingSphere[c];
+		l_Batches[i].FirstTransform = l_Batch.FirstTransform;
+
+		// The batch's transforms keep their place in the visible buffer, so the base instance is the same...
+		l_Commands[i] = GetMeshDrawCommand(l_Batch.Mesh);
+		l_Commands[i].BaseInstance = l_Batch.FirstTransform;
+		l_CommandMeshes[i] = l_Batch.Mesh;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, l_ObjectBatchBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, l_ObjectBatches.size() * sizeof(GLuint), l_ObjectBatches.empty() ? NULL : &l_ObjectBatches[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, l_BatchBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, l_Batches.size() * sizeof(CullBatch), l_Batches.empty() ? NULL : &l_Batches[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, l_CommandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, l_Commands.size() * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, l_VisibleBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)p_TransformCount * 16 * sizeof(GLfloat), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	l_TransformCount = p_TransformCount;
+}
+
+// The counts of the pass CULL_READBACKS passes ago go into g_SceneCullingStats, this pass's get
+// copied into their place. The fence is only polled: if the GPU isn't there yet, those counts are
+// dropped and the stats stay as they were, never a stall...
+static void ReadBackCullCounts(void)
+{
+	GLsync& l_Fence = l_ReadbackFences[l_Readback];
+	glBindBuffer(GL_COPY_WRITE_BUFFER, l_ReadbackBuffers[l_Readback]);
+	if (l_Fence)
+	{
+		const GLenum l_Status = glClientWaitSync(l_Fence, 0, 0);
+		glDeleteSync(l_Fence);
+		l_Fence = 0;
+		if (l_Status == GL_ALREADY_SIGNALED || l_Status == GL_CONDITION_SATISFIED)
+		{
+			GLuint l_Counts[2];
+			glGetBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(l_Counts), l_Counts);
+			g_SceneCullingStats.Visible = l_Counts[0];
+			g_SceneCullingStats.Occluded = l_Counts[1];
+		}
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, l_CounterBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, 2 * sizeof(GLuint));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	l_Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	l_Readback = (l_Readback + 1) % CULL_READBACKS;
+}
+
+void CullSceneInstances(GLuint p_TransformBuffer, GLuint p_Repeat, bool p_Occlusion)
+{
+	if (!l_Supported || l_TransformCount == 0)
+		return;
+
+	ProfileZone l_Zone("CullScene");
+
+	// Start every command at zero instances and the counters at zero, the pass adds the visible ones...
+	const GLuint l_NoCounts[2] = { 0, 0 };
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, l_CommandBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, l_Commands.size() * sizeof(DrawElementsIndirectCommand), &l_Commands[0]);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, l_CounterBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(l_NoCounts), l_NoCounts);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_BINDING_TRANSFORMS, p_TransformBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_BINDING_OBJECT_BATCHES, l_ObjectBatchBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_BINDING_BATCHES, l_BatchBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_BINDING_COMMANDS, l_CommandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_BINDING_VISIBLE, l_VisibleBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_BINDING_COUNTERS, l_CounterBuffer);
+	if (p_Occlusion)
+		BindSceneOcclusionPyramid();
+
+	glUseProgram(l_CullProgram);
+	glUniform1ui(l_ObjectCountUniform, l_TransformCount);
+	glUniform1ui(l_RepeatUniform, p_Repeat);
+	glUniform1i(l_OcclusionUniform, p_Occlusion ? 1 : 0);
+	glUniform1i(l_ReverseZUniform, g_EyeRenderTargets.ReverseZ ? 1 : 0);
+	glDispatchCompute((l_TransformCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	glUseProgram(0);
+
+	// The draws read the counts as commands and the transforms as attributes. The next pass resets the
+	// commands with glBufferSubData, and the readback copies the counters, both after the shader wrote them...
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	g_SceneCullingStats.Objects = l_TransformCount;
+	ReadBackCullCounts();
+}
+
+unsigned int DrawCulledSceneInstances(GLuint p_Repeat)
+{
+	if (!l_Supported || l_CommandMeshes.empty())
+		return 0;
+
+	return DrawMeshesIndirect(&l_CommandMeshes[0], (GLsizei)l_CommandMeshes.size(), l_CommandBuffer, l_VisibleBuffer, p_Repeat);
+}
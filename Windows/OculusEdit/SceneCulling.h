@@ -0,0 +1,61 @@
+//
+//  SceneCulling.h
+//  OculusEdit
+//
+//  GPU driven drawing of the instanced scene. A compute pass tests the bounding sphere of
+//  every object against both eye frustums (straight from the EyeUniforms block, so late
+//  latching moves them as well), packs the transforms of the visible ones per mesh and
+//  counts them into one DrawElementsIndirectCommand per mesh. A single multi-draw indirect
+//  call then draws everything, nothing is read back: the CPU issues the same handful of
+//  calls whether the scene has a hundred objects or a million. (Only the pass's counts
+//  come back, frames later, for the profiler.) With occlusion culling on, the objects are
+//  tested against last frame's depth as well (see SceneOcclusion.h).
+//
+//  Needs compute shaders, shader storage buffers and multi-draw indirect (GL 4.3), the
+//  scene renderer falls back to plain instancing without them.
+//
+
+#pragma once
+
+#include <vector>
+
+#if !defined(__APPLE__)
+#  include <GL/glew.h>
+#else
+#  include <OpenGL/gl3.h>
+#endif
+
+#include "Mesh.h"
+
+// A run of transforms in the instance buffer that all use the same mesh:
+struct SceneInstanceBatch
+{
+	MeshHandle Mesh;
+	GLuint FirstTransform;
+	GLsizei TransformCount;
+};
+
+// What the pass counted, read back a few frames late (it never waits on the GPU), for the profiler:
+struct SceneCullingStats
+{
+	unsigned int Objects;  // Tested by the last pass.
+	unsigned int Visible;  // Drawn.
+	unsigned int Occluded; // In an eye's frustum but behind the occlusion pyramid, not drawn.
+};
+
+extern SceneCullingStats g_SceneCullingStats;
+
+// Needs a current GL context. Returns false (and culling stays off) if the GL can't do it.
+bool InitializeSceneCulling(void);
+void DestroySceneCulling(void);
+
+// Call whenever the instance buffer got rebuilt: p_TransformCount transforms grouped into p_Batches.
+void SetSceneCullingBatches(const std::vector<SceneInstanceBatch>& p_Batches, GLuint p_TransformCount);
+
+// Culls the transforms (16 floats each, row major) in p_TransformBuffer for this frame's eye uniforms.
+// p_Repeat is how many instances every visible object is drawn with (2 for single-pass stereo).
+// p_Occlusion tests them against the occlusion pyramid as well (BuildSceneOcclusionPyramid first).
+void CullSceneInstances(GLuint p_TransformBuffer, GLuint p_Repeat, bool p_Occlusion);
+
+// Draws what the last CullSceneInstances kept, with the current program. Returns the number of draw calls.
+unsigned int DrawCulledSceneInstances(GLuint p_Repeat);
@@ -0,0 +1,371 @@
+//
+//  SceneOcclusion.cpp
+//  OculusEdit
+//
+
+#include "SceneOcclusion.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "EyeRenderTarget.h"
+#include "Profiler.h"
+#include "SceneRenderer.h"
+#include "Shader.h"
+
+SceneOcclusionState g_SceneOcclusion = { false };
+
+static const GLuint OCCLUSION_GROUP_SIZE = 8;
+
+static bool l_Supported = false;
+static bool l_Captured = false;         // The depth and the uniforms it goes with are there.
+static OVR::Sizei l_TargetSize(0, 0);
+static OVR::Sizei l_PyramidSize(0, 0);  // Level 0, half the target.
+static GLint l_PyramidLevels = 0;
+
+static GLuint l_DepthFramebuffer = 0;   // The eye depth gets copied in here...
+static GLuint l_DepthTexture = 0;
+static GLuint l_EyeUniformBuffer = 0;   // ... with the eye uniforms it was drawn with.
+static GLuint l_ReprojectedTexture = 0; // Farthest reprojected depth per texel, as float bits (0 for none).
+static GLuint l_PyramidTexture = 0;
+static GLuint l_ReprojectProgram = 0;
+static GLuint l_ResolveProgram = 0;
+static GLuint l_ClearProgram = 0;
+static GLuint l_ReduceProgram = 0;
+static GLint l_ReprojectReverseZUniform = -1;
+
+// Every depth sample goes from the old eye's clip space to the new one's (the matrix between them is
+// the same for the whole group) and onto the half resolution texel it lands in, the farthest one wins.
+// The background lands as the far plane (from just inside it, the far plane itself may be at infinity),
+// so a texel it shares with an occluder's edge isn't covered. The hidden areas (at the near plane) are skipped...
+static const std::string l_ReprojectShader(
+	"#version 430\n"
+	EYE_UNIFORM_BLOCK_GLSL
+	"layout (std140, row_major) uniform PreviousEyeUniforms\n"
+	"{\n"
+	"   mat4 previousView[2];\n"
+	"   mat4 previousProjection[2];\n"
+	"   mat4 previousViewProjection[2];\n"
+	"   vec4 previousEyePosition[2];\n"
+	"   vec4 previousEyeViewport[2];\n"
+	"};\n"
+	"layout (local_size_x = 8, local_size_y = 8) in;\n"
+	"layout (binding = 0, r32ui) uniform uimage2D reprojected;\n"
+	"uniform sampler2D previousDepth;\n"
+	"uniform bool reverseZ;\n"
+	"shared mat4 previousToCurrent[2];\n"
+	"void main()\n"
+	"{\n"
+	"   if (gl_LocalInvocationIndex < 2u)\n"
+	"   {\n"
+	"      int eye = int(gl_LocalInvocationIndex);\n"
+	"      previousToCurrent[eye] = viewProjection[eye] * inverse(previousViewProjection[eye]);\n"
+	"   }\n"
+	"   barrier();\n"
+	"   ivec2 texel = ivec2(gl_GlobalInvocationID.xy);\n"
+	"   ivec2 size = textureSize(previousDepth, 0);\n"
+	"   if (any(greaterThanEqual(texel, size))) return;\n"
+	"   float window = texelFetch(previousDepth, texel, 0).r;\n"
+	"   float depth = reverseZ ? 1.0 - window : window;\n"
+	"   if (depth <= 0.0) return;\n"
+	"   bool background = depth >= 1.0;\n"
+	"   if (background) window = reverseZ ? 1.0e-6 : 1.0 - 1.0e-6;\n"
+	"   vec2 full = (vec2(texel) + 0.5) / vec2(size) * 2.0 - 1.0;\n"
+	"   vec2 ndc = (full - previousEyeViewport[0].yw) / previousEyeViewport[0].xz;\n"
+	"   int eye = 0;\n"
+	"   if (any(greaterThan(abs(ndc), vec2(1.0))))\n"
+	"   {\n"
+	"      ndc = (full - previousEyeViewport[1].yw) / previousEyeViewport[1].xz;\n"
+	"      eye = 1;\n"
+	"      if (any(greaterThan(abs(ndc), vec2(1.0)))) return;\n"
+	"   }\n"
+	"   vec4 clip = previousToCurrent[eye] * vec4(ndc, reverseZ ? window : window * 2.0 - 1.0, 1.0);\n"
+	"   if (clip.w <= 0.0) return;\n"
+	"   vec3 current = clip.xyz / clip.w;\n"
+	"   float currentWindow = reverseZ ? current.z : current.z * 0.5 + 0.5;\n"
+	"   float currentDepth = reverseZ ? 1.0 - currentWindow : currentWindow;\n"
+	"   if (any(greaterThan(abs(current.xy), vec2(1.0)))) return;\n"
+	"   if (background || currentDepth >= 1.0) currentDepth = 1.0;\n"
+	"   else if (currentDepth <= 0.0) return;\n"
+	"   vec2 target = ((current.xy * eyeViewport[eye].xz + eyeViewport[eye].yw) * 0.5 + 0.5) * vec2(imageSize(reprojected));\n"
+	"   imageAtomicMax(reprojected, min(ivec2(target), imageSize(reprojected) - 1), floatBitsToUint(currentDepth));\n"
+	"}\n"
+	);
+
+// Level 0 of the pyramid: the farthest of the texel and its 8 neighbours, texels nothing landed in
+// are the far plane. A texel only some of its samples reached has the depth of those, the dilation
+// makes sure such a texel on an occluder's edge counts as far, whatever landed next to it...
+static const std::string l_ResolveShader(
+	"#version 430\n"
+	"layout (local_size_x = 8, local_size_y = 8) in;\n"
+	"layout (binding = 0, r32ui) readonly uniform uimage2D reprojected;\n"
+	"layout (binding = 1, r32f) writeonly uniform image2D pyramid;\n"
+	"void main()\n"
+	"{\n"
+	"   ivec2 texel = ivec2(gl_GlobalInvocationID.xy);\n"
+	"   ivec2 size = imageSize(pyramid);\n"
+	"   if (any(greaterThanEqual(texel, size))) return;\n"
+	"   float farthest = 0.0;\n"
+	"   for (int y = -1; y <= 1; y++)\n"
+	"   {\n"
+	"      for (int x = -1; x <= 1; x++)\n"
+	"      {\n"
+	"         uint depth = imageLoad(reprojected, clamp(texel + ivec2(x, y), ivec2(0), size - 1)).r;\n"
+	"         farthest = max(farthest, depth == 0u ? 1.0 : uintBitsToFloat(depth));\n"
+	"      }\n"
+	"   }\n"
+	"   imageStore(pyramid, texel, vec4(farthest));\n"
+	"}\n"
+	);
+
+// Empties the reprojected texels for next frame, once the resolve is done reading them...
+static const std::string l_ClearShader(
+	"#version 430\n"
+	"layout (local_size_x = 8, local_size_y = 8) in;\n"
+	"layout (binding = 0, r32ui) writeonly uniform uimage2D reprojected;\n"
+	"void main()\n"
+	"{\n"
+	"   ivec2 texel = ivec2(gl_GlobalInvocationID.xy);\n"
+	"   if (any(greaterThanEqual(texel, imageSize(reprojected)))) return;\n"
+	"   imageStore(reprojected, texel, uvec4(0u));\n"
+	"}\n"
+	);
+
+// Every texel keeps the farthest of the 2 x 2 under it, the last row and column of an odd sized level
+// take the one left over as well...
+static const std::string l_ReduceShader(
+	"#version 430\n"
+	"layout (local_size_x = 8, local_size_y = 8) in;\n"
+	"layout (binding = 0, r32f) readonly uniform image2D source;\n"
+	"layout (binding = 1, r32f) writeonly uniform image2D destination;\n"
+	"void main()\n"
+	"{\n"
+	"   ivec2 texel = ivec2(gl_GlobalInvocationID.xy);\n"
+	"   ivec2 size = imageSize(destination);\n"
+	"   if (any(greaterThanEqual(texel, size))) return;\n"
+	"   ivec2 sourceSize = imageSize(source);\n"
+	"   ivec2 first = texel * 2;\n"
+	"   ivec2 last = min(first + 1 + ivec2(equal(texel, size - 1)) * (sourceSize & 1), sourceSize - 1);\n"
+	"   float farthest = 0.0;\n"
+	"   for (int y = first.y; y <= last.y; y++)\n"
+	"   {\n"
+	"      for (int x = first.x; x <= last.x; x++)\n"
+	"         farthest = max(farthest, imageLoad(source, ivec2(x, y)).r);\n"
+	"   }\n"
+	"   imageStore(destination, texel, vec4(farthest));\n"
+	"}\n"
+	);
+
+// Tiny, built right away like the cull shader. Returns 0 if it doesn't build...
+static GLuint BuildComputeProgram(const std::string& p_Source)
+{
+	std::vector<GLuint> l_ShaderList;
+	l_ShaderList.push_back(SubmitShader(GL_COMPUTE_SHADER, p_Source));
+	GLuint l_Program = SubmitProgram(l_ShaderList);
+	const bool l_Built = CheckShader(l_ShaderList[0], GL_COMPUTE_SHADER) && CheckProgram(l_Program);
+	glDetachShader(l_Program, l_ShaderList[0]);
+	glDeleteShader(l_ShaderList[0]);
+	if (!l_Built)
+	{
+		glDeleteProgram(l_Program);
+		return 0;
+	}
+	return l_Program;
+}
+
+static void Dispatch(OVR::Sizei p_Size)
+{
+	glDispatchCompute((p_Size.w + OCCLUSION_GROUP_SIZE - 1) / OCCLUSION_GROUP_SIZE, (p_Size.h + OCCLUSION_GROUP_SIZE - 1) / OCCLUSION_GROUP_SIZE, 1);
+}
+
+void InitializeSceneOcclusion(OVR::Sizei p_TargetSize, bool p_Enabled)
+{
+	g_SceneOcclusion.Enabled = false;
+	l_Supported = false;
+	l_Captured = false;
+	if (!SceneGpuCullingSupported())
+	{
+		printf("Occlusion culling needs GPU culling, disabled.\n");
+		return;
+	}
+	// (GPU culling already rules out macOS.)
+#if !defined(__APPLE__)
+	if (!GLEW_ARB_texture_storage || !GLEW_ARB_shader_image_load_store)
+	{
+		printf("Immutable textures or image load/store not supported, occlusion culling disabled.\n");
+		return;
+	}
+#endif
+
+	l_ReprojectProgram = BuildComputeProgram(l_ReprojectShader);
+	l_ResolveProgram = BuildComputeProgram(l_ResolveShader);
+	l_ClearProgram = BuildComputeProgram(l_ClearShader);
+	l_ReduceProgram = BuildComputeProgram(l_ReduceShader);
+	if (!l_ReprojectProgram || !l_ResolveProgram || !l_ClearProgram || !l_ReduceProgram)
+	{
+		printf("The occlusion shaders failed to build, occlusion culling disabled.\n");
+		DestroySceneOcclusion();
+		return;
+	}
+	BindEyeUniformBlock(l_ReprojectProgram);
+	glUniformBlockBinding(l_ReprojectProgram, glGetUniformBlockIndex(l_ReprojectProgram, "PreviousEyeUniforms"), OCCLUSION_UNIFORM_BINDING);
+	l_ReprojectReverseZUniform = glGetUniformLocation(l_ReprojectProgram, "reverseZ");
+	glUseProgram(l_ReprojectProgram);
+	glUniform1i(glGetUniformLocation(l_ReprojectProgram, "previousDepth"), 0);
+	glUseProgram(0);
+
+	// Same format as the eye depth buffers, depth can only be copied between matching ones...
+	l_TargetSize = p_TargetSize;
+	glGenTextures(1, &l_DepthTexture);
+	glBindTexture(GL_TEXTURE_2D, l_DepthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GetEyeDepthFormat(), p_TargetSize.w, p_TargetSize.h, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	// The pyramid goes all the way down to a single texel...
+	l_PyramidSize = OVR::Sizei((p_TargetSize.w + 1) / 2, (p_TargetSize.h + 1) / 2);
+	l_PyramidLevels = 1;
+	for (int l_Size = (l_PyramidSize.w > l_PyramidSize.h) ? l_PyramidSize.w : l_PyramidSize.h; l_Size > 1; l_Size /= 2)
+		++l_PyramidLevels;
+	glGenTextures(1, &l_PyramidTexture);
+	glBindTexture(GL_TEXTURE_2D, l_PyramidTexture);
+	glTexStorage2D(GL_TEXTURE_2D, l_PyramidLevels, GL_R32F, l_PyramidSize.w, l_PyramidSize.h);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+
+	// Starts out empty, the resolve pass empties it again every frame...
+	const std::vector<GLuint> l_Empty(l_PyramidSize.w * l_PyramidSize.h, 0);
+	glGenTextures(1, &l_ReprojectedTexture);
+	glBindTexture(GL_TEXTURE_2D, l_ReprojectedTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, l_PyramidSize.w, l_PyramidSize.h);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, l_PyramidSize.w, l_PyramidSize.h, GL_RED_INTEGER, GL_UNSIGNED_INT, &l_Empty[0]);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &l_DepthFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, l_DepthFramebuffer);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, l_DepthTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	const bool l_Complete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!l_Complete)
+	{
+		printf("The occlusion depth framebuffer is incomplete, occlusion culling disabled.\n");
+		DestroySceneOcclusion();
+		return;
+	}
+
+	glGenBuffers(1, &l_EyeUniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, l_EyeUniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(EyeUniformBlock), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	l_Supported = true;
+	g_SceneOcclusion.Enabled = p_Enabled;
+	printf("Occlusion culling: %s, %d x %d pyramid with %d levels.\n", p_Enabled ? "on" : "off", l_PyramidSize.w, l_PyramidSize.h, l_PyramidLevels);
+}
+
+void DestroySceneOcclusion(void)
+{
+	glDeleteProgram(l_ReprojectProgram);
+	glDeleteProgram(l_ResolveProgram);
+	glDeleteProgram(l_ClearProgram);
+	glDeleteProgram(l_ReduceProgram);
+	glDeleteFramebuffers(1, &l_DepthFramebuffer);
+	glDeleteTextures(1, &l_DepthTexture);
+	glDeleteTextures(1, &l_ReprojectedTexture);
+	glDeleteTextures(1, &l_PyramidTexture);
+	glDeleteBuffers(1, &l_EyeUniformBuffer);
+	l_ReprojectProgram = l_ResolveProgram = l_ClearProgram = l_ReduceProgram = 0;
+	l_DepthFramebuffer = 0;
+	l_DepthTexture = l_ReprojectedTexture = l_PyramidTexture = 0;
+	l_EyeUniformBuffer = 0;
+	l_Supported = false;
+	l_Captured = false;
+	g_SceneOcclusion.Enabled = false;
+}
+
+bool SceneOcclusionSupported(void)
+{
+	return l_Supported;
+}
+
+void InvalidateSceneOcclusion(void)
+{
+	l_Captured = false;
+}
+
+void CaptureSceneOcclusion(GLuint p_Framebuffer, GLuint p_EyeUniformBuffer, GLintptr p_EyeUniformOffset)
+{
+	if (!l_Supported)
+		return;
+
+	ProfileZone l_Zone("CaptureOcclusion");
+
+	// Resolved if it's multisampled (one of the samples, the pyramid doesn't need better)...
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, p_Framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, l_DepthFramebuffer);
+	glBlitFramebuffer(0, 0, l_TargetSize.w, l_TargetSize.h, 0, 0, l_TargetSize.w, l_TargetSize.h, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, p_Framebuffer);
+
+	// Copied when the GPU gets there, after anything late latching writes into the block...
+	glBindBuffer(GL_COPY_READ_BUFFER, p_EyeUniformBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, l_EyeUniformBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, p_EyeUniformOffset, 0, sizeof(EyeUniformBlock));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	l_Captured = true;
+}
+
+bool BuildSceneOcclusionPyramid(void)
+{
+	if (!l_Supported || !l_Captured)
+		return false;
+
+	ProfileZone l_Zone("OcclusionPyramid");
+
+	// Last frame's depth into this frame's eyes...
+	glUseProgram(l_ReprojectProgram);
+	glUniform1i(l_ReprojectReverseZUniform, g_EyeRenderTargets.ReverseZ ? 1 : 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, OCCLUSION_UNIFORM_BINDING, l_EyeUniformBuffer);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, l_DepthTexture);
+	glBindImageTexture(0, l_ReprojectedTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+	Dispatch(l_TargetSize);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	glUseProgram(l_ResolveProgram);
+	glBindImageTexture(1, l_PyramidTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	Dispatch(l_PyramidSize);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	// Neighbours read each other's texels, so they are only emptied once they are all resolved...
+	glUseProgram(l_ClearProgram);
+	Dispatch(l_PyramidSize);
+
+	// ... and down the pyramid, level by level...
+	glUseProgram(l_ReduceProgram);
+	OVR::Sizei l_Size = l_PyramidSize;
+	for (GLint l_Level = 1; l_Level < l_PyramidLevels; l_Level++)
+	{
+		l_Size = OVR::Sizei((l_Size.w > 1) ? l_Size.w / 2 : 1, (l_Size.h > 1) ? l_Size.h / 2 : 1);
+		glBindImageTexture(0, l_PyramidTexture, l_Level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, l_PyramidTexture, l_Level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		Dispatch(l_Size);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+	glUseProgram(0);
+
+	// The cull pass fetches it as a texture...
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	return true;
+}
+
+void BindSceneOcclusionPyramid(void)
+{
+	glActiveTexture(GL_TEXTURE0 + SCENE_OCCLUSION_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, l_PyramidTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,112 @@
+//
+//  SceneOcclusion.h
+//  OculusEdit
+//
+//  Occlusion culling for the GPU culled scene (see SceneCulling.h) against the previous
+//  frame's depth. Once the eyes are drawn their depth buffer is copied out, along with the
+//  eye uniforms it was drawn with. Next frame, before the cull pass, every depth sample is
+//  unprojected with those old matrices and scattered into the new eye views (the pose
+//  delta), keeping the farthest depth per texel at half the resolution. The background
+//  lands as the far plane, texels nothing lands in are disoccluded and count as far too,
+//  and every texel takes the farthest of its neighbours as well: a texel an occluder only
+//  partly covers is never taken as covered. A max depth pyramid (Hi-Z) is built on top,
+//  and the cull pass drops the objects whose bounding box is behind every depth in the
+//  2 x 2 pyramid texels its footprint covers.
+//
+//  Wrong culls cost a missing object, so everything in doubt stays visible: boxes reaching
+//  behind the eye, the frame after the scene changed (the depth may have an occluder that
+//  moved or is gone), and everything when the depth layers or the multi-resolution regions
+//  were on (the depth buffer doesn't hold the whole scene in plain eye viewports then).
+//
+//  Needs what GPU culling needs (GL 4.3 compute), plus immutable textures and image loads.
+//
+
+#pragma once
+
+#if !defined(__APPLE__)
+#  include <GL/glew.h>
+#else
+#  include <OpenGL/gl3.h>
+#endif
+
+#include "OVR.h"
+
+// Uniform buffer binding point of the eye uniforms the depth was drawn with (PreviousEyeUniforms):
+const GLuint OCCLUSION_UNIFORM_BINDING = 2;
+
+// Texture unit the cull pass reads the pyramid from:
+const GLuint SCENE_OCCLUSION_TEXTURE_UNIT = 6;
+
+// GLSL for the cull pass (after EYE_UNIFORM_BLOCK_GLSL). Depths are 0 at the near plane and 1 at the
+// far one whichever way the eye buffers have them, OccludedInEye is true if the sphere is behind the
+// pyramid in the eye...
+#define OCCLUSION_GLSL \
+	"uniform sampler2D occlusionPyramid;\n" \
+	"uniform bool reverseZ;\n" \
+	"float OcclusionDepth(vec4 clip)\n" \
+	"{\n" \
+	"   float window = reverseZ ? clip.z / clip.w : clip.z / clip.w * 0.5 + 0.5;\n" \
+	"   return reverseZ ? 1.0 - window : window;\n" \
+	"}\n" \
+	"bool OccludedInEye(int eye, vec3 center, float radius)\n" \
+	"{\n" \
+	"   vec2 low = vec2(1.0);\n" \
+	"   vec2 high = vec2(-1.0);\n" \
+	"   float nearest = 1.0;\n" \
+	"   for (int i = 0; i < 8; i++)\n" \
+	"   {\n" \
+	"      vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);\n" \
+	"      vec4 clip = viewProjection[eye] * vec4(corner, 1.0);\n" \
+	"      if (clip.w <= 0.0) return false;\n" \
+	"      float depth = OcclusionDepth(clip);\n" \
+	"      if (depth <= 0.0) return false;\n" \
+	"      low = min(low, clip.xy / clip.w);\n" \
+	"      high = max(high, clip.xy / clip.w);\n" \
+	"      nearest = min(nearest, depth);\n" \
+	"   }\n" \
+	"   vec2 size = vec2(textureSize(occlusionPyramid, 0));\n" \
+	"   vec2 lowTexel = ((clamp(low, -1.0, 1.0) * eyeViewport[eye].xz + eyeViewport[eye].yw) * 0.5 + 0.5) * size;\n" \
+	"   vec2 highTexel = ((clamp(high, -1.0, 1.0) * eyeViewport[eye].xz + eyeViewport[eye].yw) * 0.5 + 0.5) * size;\n" \
+	"   vec2 extent = highTexel - lowTexel;\n" \
+	"   int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, textureQueryLevels(occlusionPyramid) - 1);\n" \
+	"   ivec2 levelSize = textureSize(occlusionPyramid, level);\n" \
+	"   ivec2 first = clamp(ivec2(floor(lowTexel)) >> level, ivec2(0), levelSize - 1);\n" \
+	"   ivec2 last = clamp(ivec2(floor(highTexel)) >> level, ivec2(0), levelSize - 1);\n" \
+	"   float farthest = 0.0;\n" \
+	"   for (int y = first.y; y <= last.y; y++)\n" \
+	"   {\n" \
+	"      for (int x = first.x; x <= last.x; x++)\n" \
+	"         farthest = max(farthest, texelFetch(occlusionPyramid, ivec2(x, y), level).r);\n" \
+	"   }\n" \
+	"   return nearest > farthest;\n" \
+	"}\n"
+
+struct SceneOcclusionState
+{
+	bool Enabled;
+};
+
+extern SceneOcclusionState g_SceneOcclusion;
+
+// Needs a current GL context, after InitializeSceneRenderer. The copy of the depth and the pyramid
+// are p_TargetSize, the size of the eye render targets. Stays off if the GL can't do it.
+void InitializeSceneOcclusion(OVR::Sizei p_TargetSize, bool p_Enabled);
+void DestroySceneOcclusion(void);
+
+// True if InitializeSceneOcclusion found everything it needs.
+bool SceneOcclusionSupported(void);
+
+// Forgets the captured depth: the scene changed since, or it didn't hold the whole scene.
+void InvalidateSceneOcclusion(void);
+
+// Copies the depth of p_Framebuffer (the eye framebuffer, after the last draw of the frame) and the
+// eye uniform block it was drawn with (p_EyeUniformOffset into p_EyeUniformBuffer). The uniforms are
+// copied on the GPU, after the draws that read them.
+void CaptureSceneOcclusion(GLuint p_Framebuffer, GLuint p_EyeUniformBuffer, GLintptr p_EyeUniformOffset);
+
+// Reprojects the captured depth into this frame's eyes (the EyeUniforms block bound) and builds
+// the pyramid from it. Returns false if there is nothing to test against.
+bool BuildSceneOcclusionPyramid(void);
+
+// Binds the pyramid to SCENE_OCCLUSION_TEXTURE_UNIT, for the cull pass.
+void BindSceneOcclusionPyramid(void);
@@ -0,0 +1,1154 @@
+//
+//  SceneRenderer.cpp
+//  OculusEdit
+//
+
+#include "SceneRenderer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "EyeRenderTarget.h"
+#include "Mesh.h"
+#include "Profiler.h"
+#include "Scene.h"
+#include "SceneBvh.h"
+#include "SceneClusters.h"
+#include "SceneCulling.h"
+#include "SceneOcclusion.h"
+#include "SceneShadows.h"
+#include "Shader.h"
+#include "ShaderCache.h"
+#include "ShaderSource.h"
+
+StereoMode g_StereoMode = StereoMode_SinglePassInstanced;
+bool g_LateLatching = true;
+bool g_SceneMultisample = false;
+bool g_SceneInstancing = true;
+bool g_SceneDepthPrePass = false;
+bool g_SceneGpuCulling = true;
+bool g_SceneBvhCulling = true;
+float g_SceneDepthSplit = 0.0f;
+
+// The eye uniform buffer. With GL_ARB_buffer_storage it holds EYE_UNIFORM_REGIONS copies of the
+// blocks, stays mapped for good and every region is fenced until the GPU is done with it. Without
+// it there is a single copy that gets orphaned every frame, and no late latching. Every region has
+// a block per depth layer, the layers other than the full one are only written with a depth split.
+//
+// The draws never read what the CPU writes: a region has EYE_UNIFORM_SLOTS sets of blocks, the
+// frame's update and the late latch each write their own staging set and queue a GPU copy of it
+// into the live one. The copies are ordered with the draws like any other command, so every draw
+// sees a single pose, and the staging sets aren't touched again until the region's fence passed.
+static const unsigned int EYE_UNIFORM_REGIONS = 3;
+static const unsigned int EYE_UNIFORM_SLOTS = 3;
+static const unsigned int EYE_UNIFORM_LIVE = 0;
+static const unsigned int EYE_UNIFORM_STAGED = 1;
+static const unsigned int EYE_UNIFORM_LATCHED = 2;
+static GLuint l_EyeUniformBuffer = 0;
+static GLubyte* l_EyeUniformMapping = NULL;
+static GLsizeiptr l_EyeUniformStride = sizeof(EyeUniformBlock); // Between the layers, a slot is SceneDepthLayer_Count of them.
+static unsigned int l_EyeUniformLayers = 1; // Written this frame.
+static unsigned int l_EyeUniformLayer = 0;  // Bound for the draws.
+static GLsync l_EyeUniformFences[EYE_UNIFORM_REGIONS] = { 0 };
+static unsigned int l_EyeUniformRegion = 0;
+
+// Pose to GPU latency: a timestamp right after each region's last copy, with the time its poses
+// were sampled. Read back once the region comes around again, its fence has passed by then...
+struct EyeUniformTiming
+{
+	GLuint Query;
+	bool Pending;
+	unsigned int Frame;
+	double PoseTime;
+};
+static EyeUniformTiming l_EyeUniformTimings[EYE_UNIFORM_REGIONS];
+static bool l_PoseToGpuResolved = false;
+static unsigned int l_PoseToGpuFrame = 0;
+static double l_PoseToGpuMs = 0.0;
+
+// A scene shader variant with the uniform locations the draws need:
+struct SceneProgram
+{
+	GLuint Program;          // 0 until the variant is built.
+	unsigned int Handle;     // Shader cache handle, valid if Submitted.
+	bool Submitted;
+	GLint ModelUniform;
+	GLint EyeIndexUniform;
+	GLint ShadowMatricesUniform;
+	unsigned int ShadowRevision; // Of the shadow matrices it has.
+	bool Clustered;              // Reads the light clusters.
+};
+
+// Indexed by the variant key (SceneShaderFeature bits). Variants are submitted to the shader cache
+// the first time they're needed and built in the background, meanwhile the flat shaded variant
+// with the same key draws instead (those are tiny and built right away)...
+static SceneProgram l_ScenePrograms[SceneShader_VariantCount];
+static std::string l_SceneShaderDefines[SceneShader_VariantCount];
+
+// Ids of scene.vert and scene.frag in the shader sources (the strings below are the built-in copies)...
+static unsigned int l_SceneVertexSource = 0;
+static unsigned int l_SceneFragmentSource = 0;
+
+// The instanced path: every object's transform lives in one buffer, grouped by mesh, so each mesh
+// is a single draw no matter how many objects use it. The buffer is rebuilt when objects come or
+// go (g_SceneRevision), moved objects are patched in place...
+static GLuint l_InstanceBuffer = 0;
+static unsigned int l_InstanceRevision = 0;
+static bool l_InstancesValid = false;
+static std::vector<SceneInstanceBatch> l_InstanceBatches;
+static std::vector<GLuint> l_InstanceSlots; // Object index to its matrix in the buffer.
+static std::vector<OVR::Matrix4f> l_InstanceTransforms; // CPU copy of the buffer, in buffer order.
+
+// GPU culling runs once a frame, before the first draw that needs it. Again if a later draw needs it
+// for another repeat count (per eye or both eyes at once) or, on the GPU, another depth layer...
+static bool l_SceneCullingSupported = false;
+static bool l_SceneCulled = false;
+static GLuint l_CulledRepeat = 0;
+static unsigned int l_CulledLayer = 0;
+
+// BVH culling (once a frame as well) needs the eyes, and keeps what they see. Single-pass only fills
+// l_BvhVisible[0]. Instanced, the visible transforms are streamed into their own buffer, batched per
+// mesh and eye...
+static EyeView l_SceneEyes[2];
+static std::vector<unsigned int> l_BvhVisible[2];
+static GLuint l_VisibleInstanceBuffer = 0;
+static std::vector<SceneInstanceBatch> l_VisibleBatches[2];
+
+// Multi-resolution: what every region of the eyes sees, instead of the whole eyes...
+static ovrFovPort l_RegionFovs[2][SCENE_MAX_EYE_REGIONS];
+static int l_RegionCounts[2] = { 0, 0 };
+static std::vector<unsigned int> l_RegionVisible[2][SCENE_MAX_EYE_REGIONS];
+static std::vector<SceneInstanceBatch> l_RegionBatches[2][SCENE_MAX_EYE_REGIONS];
+
+// The eye is eyeIndex for multi-pass and the low bit of gl_InstanceID for single-pass (instanced
+// objects come in pairs of instances, one per eye, with an attribute divisor of 2). Instance
+// matrices are uploaded row major like the uniform, the attribute reads them in as columns. In the latter
+// case eyeViewport moves the eye's [-1, 1] clip space into its rectangle of the full viewport, and
+// the clip distances are the eye's own frustum sides so nothing leaks into the other half.
+// gl_Position is invariant, the depth pre-pass is another variant and has to match it exactly.
+static const std::string l_SceneVertexShader(
+	SHADER_GLSL_VERSION
+	EYE_UNIFORM_BLOCK_GLSL
+	"#if MULTISAMPLE\n"
+	"#define INTERPOLATION centroid\n"
+	"#else\n"
+	"#define INTERPOLATION\n"
+	"#endif\n"
+	"layout (location = 0) in vec3 position;\n"
+	"layout (location = 1) in vec3 normal;\n"
+	"#if INSTANCED\n"
+	"layout (location = 4) in mat4 instanceModel;\n"
+	"#else\n"
+	"uniform mat4 model;\n"
+	"#endif\n"
+	"#if !STEREO_INSTANCED\n"
+	"uniform int eyeIndex;\n"
+	"#endif\n"
+	"INTERPOLATION out vec3 worldPosition;\n"
+	"INTERPOLATION out vec3 worldNormal;\n"
+	"flat out int eye;\n"
+	"#if STEREO_INSTANCED\n"
+	"out float gl_ClipDistance[4];\n"
+	"#endif\n"
+	"invariant gl_Position;\n"
+	"void main()\n"
+	"{\n"
+	"#if INSTANCED\n"
+	"   mat4 model = transpose(instanceModel);\n"
+	"#endif\n"
+	"#if STEREO_INSTANCED\n"
+	"   eye = gl_InstanceID & 1;\n"
+	"#else\n"
+	"   eye = eyeIndex;\n"
+	"#endif\n"
+	"   vec4 world = model * vec4(position, 1.0);\n"
+	"   worldPosition = world.xyz;\n"
+	"   worldNormal = mat3(model) * normal;\n"
+	"   vec4 clip = viewProjection[eye] * world;\n"
+	"#if STEREO_INSTANCED\n"
+	"   gl_ClipDistance[0] = clip.w + clip.x;\n"
+	"   gl_ClipDistance[1] = clip.w - clip.x;\n"
+	"   gl_ClipDistance[2] = clip.w + clip.y;\n"
+	"   gl_ClipDistance[3] = clip.w - clip.y;\n"
+	"   vec4 viewport = eyeViewport[eye];\n"
+	"   clip.x = clip.x * viewport.x + viewport.y * clip.w;\n"
+	"   clip.y = clip.y * viewport.z + viewport.w * clip.w;\n"
+	"#endif\n"
+	"   gl_Position = clip;\n"
+	"}\n"
+	);
+
+// PHONG: the lighting the fixed function setup used to give us (global ambient 0.2 * material ambient 0.2,
+// material diffuse 0.8, two directional lights), but per pixel and with a local viewer. Otherwise flat
+// shading with a head-on light, just enough to make out the shapes while the real variant loads.
+// SHADOWS: every light is looked up in its tile of the shadow map atlas, the comparison (filtered
+// over 2 x 2 texels) scales what the light adds. The point lights come from the fragment's light
+// cluster (SceneClusters.h), with the same diffuse and specular terms and a smooth falloff to their
+// radius. They're not shadowed.
+// DEPTH_ONLY: the depth pre-pass, there's no color to write.
+static const std::string l_SceneFragmentShader(
+	SHADER_GLSL_VERSION
+	EYE_UNIFORM_BLOCK_GLSL
+	"#if MULTISAMPLE\n"
+	"#define INTERPOLATION centroid\n"
+	"#else\n"
+	"#define INTERPOLATION\n"
+	"#endif\n"
+	"INTERPOLATION in vec3 worldPosition;\n"
+	"INTERPOLATION in vec3 worldNormal;\n"
+	"flat in int eye;\n"
+	"out vec4 outputColor;\n"
+	"#if DEPTH_ONLY\n"
+	"void main()\n"
+	"{\n"
+	"}\n"
+	"#elif PHONG\n"
+	"uniform vec3 lightDirection[LIGHT_COUNT];\n"
+	"uniform vec3 lightDiffuse[LIGHT_COUNT];\n"
+	"uniform vec3 lightSpecular[LIGHT_COUNT];\n"
+	"uniform vec3 materialSpecular;\n"
+	"uniform float materialShininess;\n"
+	"#if SHADOWS\n"
+	"uniform mat4 shadowMatrix[LIGHT_COUNT];\n"
+	"uniform sampler2DShadow shadowMap;\n"
+	"#endif\n"
+	CLUSTER_GLSL
+	"void main()\n"
+	"{\n"
+	"   vec3 n = normalize(worldNormal);\n"
+	"   vec3 v = normalize(eyePosition[eye].xyz - worldPosition);\n"
+	"   vec3 color = vec3(0.04);\n"
+	"   for (int i = 0; i < LIGHT_COUNT; i++)\n"
+	"   {\n"
+	"      float nDotL = dot(n, lightDirection[i]);\n"
+	"      if (nDotL <= 0.0) continue;\n"
+	"      float nDotH = max(dot(n, normalize(lightDirection[i] + v)), 0.0);\n"
+	"      vec3 light = 0.8 * lightDiffuse[i] * nDotL + materialSpecular * lightSpecular[i] * pow(nDotH, materialShininess);\n"
+	"#if SHADOWS\n"
+	"      light *= texture(shadowMap, (shadowMatrix[i] * vec4(worldPosition, 1.0)).xyz);\n"
+	"#endif\n"
+	"      color += light;\n"
+	"   }\n"
+	"   uvec2 lights = ClusterLights(worldPosition);\n"
+	"   for (uint i = 0u; i < lights.y; i++)\n"
+	"   {\n"
+	"      int index = int(texelFetch(clusterLightIndices, int(lights.x + i)).r);\n"
+	"      vec4 positionRadius = texelFetch(clusterLights, index * 2);\n"
+	"      vec3 toLight = positionRadius.xyz - worldPosition;\n"
+	"      float lightDistance = length(toLight);\n"
+	"      if (lightDistance >= positionRadius.w) continue;\n"
+	"      vec3 l = toLight / lightDistance;\n"
+	"      float nDotL = dot(n, l);\n"
+	"      if (nDotL <= 0.0) continue;\n"
+	"      float falloff = 1.0 - lightDistance / positionRadius.w;\n"
+	"      float nDotH = max(dot(n, normalize(l + v)), 0.0);\n"
+	"      vec3 lightColor = texelFetch(clusterLights, index * 2 + 1).rgb;\n"
+	"      color += falloff * falloff * lightColor * (0.8 * nDotL + materialSpecular * pow(nDotH, materialShininess));\n"
+	"   }\n"
+	"   outputColor = vec4(color, 1.0);\n"
+	"}\n"
+	"#else\n"
+	"void main()\n"
+	"{\n"
+	"   outputColor = vec4(vec3(0.2 + 0.5 * abs(normalize(worldNormal).z)), 1.0);\n"
+	"}\n"
+	"#endif\n"
+	);
+
+void BindEyeUniformBlock(GLuint p_Program)
+{
+	// GLSL 3.30 has no layout(binding = ...), so set the binding point from here...
+	const GLuint l_BlockIndex = glGetUniformBlockIndex(p_Program, "EyeUniforms");
+	if (l_BlockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(p_Program, l_BlockIndex, EYE_UNIFORM_BINDING);
+}
+
+// Looks up the uniforms and sets the ones that never change (the lights and the material)...
+static void SetupSceneProgram(GLuint p_Program, SceneProgram& p_SceneProgram)
+{
+	p_SceneProgram.Program = p_Program;
+	p_SceneProgram.ModelUniform = glGetUniformLocation(p_Program, "model");
+	p_SceneProgram.EyeIndexUniform = glGetUniformLocation(p_Program, "eyeIndex");
+	p_SceneProgram.ShadowMatricesUniform = glGetUniformLocation(p_Program, "shadowMatrix");
+	p_SceneProgram.ShadowRevision = g_SceneShadows.Revision - 1; // The matrices get set with the first draw.
+	p_SceneProgram.Clustered = (glGetUniformLocation(p_Program, "clusterGrid") >= 0);
+	BindEyeUniformBlock(p_Program);
+	BindClusterUniformBlock(p_Program);
+
+	GLfloat l_Directions[SCENE_LIGHT_COUNT * 3];
+	GLfloat l_Diffuse[SCENE_LIGHT_COUNT * 3];
+	GLfloat l_Specular[SCENE_LIGHT_COUNT * 3];
+	for (unsigned int i = 0; i < SCENE_LIGHT_COUNT; i++)
+	{
+		const OVR::Vector3f l_Direction = OVR::Vector3f(g_SceneLights[i].Position[0], g_SceneLights[i].Position[1], g_SceneLights[i].Position[2]).Normalized();
+		l_Directions[i * 3 + 0] = l_Direction.x;
+		l_Directions[i * 3 + 1] = l_Direction.y;
+		l_Directions[i * 3 + 2] = l_Direction.z;
+		for (int c = 0; c < 3; c++)
+		{
+			l_Diffuse[i * 3 + c] = g_SceneLights[i].Diffuse[c];
+			l_Specular[i * 3 + c] = g_SceneLights[i].Specular[c];
+		}
+	}
+
+	// Uniforms the variant doesn't have (flat shading has none of these) come back as -1 and are ignored...
+	glUseProgram(p_Program);
+	glUniform3fv(glGetUniformLocation(p_Program, "lightDirection"), SCENE_LIGHT_COUNT, l_Directions);
+	glUniform3fv(glGetUniformLocation(p_Program, "lightDiffuse"), SCENE_LIGHT_COUNT, l_Diffuse);
+	glUniform3fv(glGetUniformLocation(p_Program, "lightSpecular"), SCENE_LIGHT_COUNT, l_Specular);
+	glUniform3fv(glGetUniformLocation(p_Program, "materialSpecular"), 1, g_SceneMaterial.Specular);
+	glUniform1f(glGetUniformLocation(p_Program, "materialShininess"), g_SceneMaterial.Shininess);
+	glUniform1i(glGetUniformLocation(p_Program, "shadowMap"), SCENE_SHADOW_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(p_Program, "clusterLights"), SCENE_CLUSTER_LIGHTS_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(p_Program, "clusterGrid"), SCENE_CLUSTER_GRID_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(p_Program, "clusterLightIndices"), SCENE_CLUSTER_INDICES_TEXTURE_UNIT);
+	glUseProgram(0);
+}
+
+static void SubmitSceneProgram(unsigned int p_Key)
+{
+	SceneProgram& l_Variant = l_ScenePrograms[p_Key];
+
+	// A build of an earlier edit that wasn't swapped in yet is superseded...
+	if (l_Variant.Submitted)
+		DiscardCachedProgram(l_Variant.Handle, l_Variant.Program);
+	l_Variant.Handle = SubmitCachedProgram(GetShaderSource(l_SceneVertexSource), GetShaderSource(l_SceneFragmentSource), l_SceneShaderDefines[p_Key]);
+	l_Variant.Submitted = true;
+}
+
+// Returns the variant if it's built, submits it if nobody asked for it before. p_Wait blocks until it's there.
+static SceneProgram* GetSceneProgram(unsigned int p_Key, bool p_Wait)
+{
+	SceneProgram& l_Variant = l_ScenePrograms[p_Key];
+	if (!l_Variant.Submitted)
+		SubmitSceneProgram(p_Key);
+
+	// A reloaded variant replaces the old program once it's linked, until then (or if the edit
+	// broke it) the old one keeps drawing. Only a variant with nothing to draw with yet waits...
+	const GLuint l_Program = (p_Wait && !l_Variant.Program) ? WaitForCachedProgram(l_Variant.Handle) : GetCachedProgram(l_Variant.Handle);
+	if (l_Program && l_Program != l_Variant.Program)
+	{
+		glDeleteProgram(l_Variant.Program);
+		SetupSceneProgram(l_Program, l_Variant);
+	}
+
+	return l_Variant.Program ? &l_Variant : NULL;
+}
+
+// Binds the variant for p_Key if it's ready by now, its flat shaded sibling otherwise (which has no
+// shadows or point lights either). Shadowed variants get the atlas, and the light matrices if they
+// changed, lit ones the light clusters...
+static const SceneProgram& UseSceneProgram(unsigned int p_Key)
+{
+	const unsigned int l_FlatKey = p_Key & ~(SceneShader_Phong | SceneShader_Shadowed);
+	SceneProgram* l_Program = GetSceneProgram(p_Key, false);
+	if (!l_Program)
+		l_Program = GetSceneProgram(l_FlatKey, true);
+	if (!l_Program)
+	{
+		printf("The flat shaded scene shader (variant %u) failed to build.\n", l_FlatKey);
+		exit(EXIT_FAILURE);
+	}
+
+	glUseProgram(l_Program->Program);
+	if (l_Program->ShadowMatricesUniform >= 0)
+	{
+		if (l_Program->ShadowRevision != g_SceneShadows.Revision)
+		{
+			glUniformMatrix4fv(l_Program->ShadowMatricesUniform, SCENE_LIGHT_COUNT, GL_TRUE, GetSceneShadowMatrices());
+			l_Program->ShadowRevision = g_SceneShadows.Revision;
+		}
+		glActiveTexture(GL_TEXTURE0 + SCENE_SHADOW_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_2D, GetSceneShadowTexture());
+		glActiveTexture(GL_TEXTURE0);
+	}
+	if (l_Program->Clustered)
+		BindSceneClusterTextures();
+	return *l_Program;
+}
+
+// The lit variants the scene can need, indexed by [shadowed][multisample][stereo instanced][instanced]...
+static const unsigned int l_SceneShaderKeys[2][2][2][2] =
+{
+	{
+		{
+			{ SceneShaderKey<true, false, false, false, false>::Value, SceneShaderKey<true, false, false, true, false>::Value },
+			{ SceneShaderKey<true, false, true, false, false>::Value, SceneShaderKey<true, false, true, true, false>::Value }
+		},
+		{
+			{ SceneShaderKey<true, true, false, false, false>::Value, SceneShaderKey<true, true, false, true, false>::Value },
+			{ SceneShaderKey<true, true, true, false, false>::Value, SceneShaderKey<true, true, true, true, false>::Value }
+		}
+	},
+	{
+		{
+			{ SceneShaderKey<true, false, false, false, true>::Value, SceneShaderKey<true, false, false, true, true>::Value },
+			{ SceneShaderKey<true, false, true, false, true>::Value, SceneShaderKey<true, false, true, true, true>::Value }
+		},
+		{
+			{ SceneShaderKey<true, true, false, false, true>::Value, SceneShaderKey<true, true, false, true, true>::Value },
+			{ SceneShaderKey<true, true, true, false, true>::Value, SceneShaderKey<true, true, true, true, true>::Value }
+		}
+	}
+};
+
+// The variant for what's being drawn right now...
+static unsigned int GetCurrentSceneShaderKey(bool p_StereoInstanced)
+{
+	return l_SceneShaderKeys[g_SceneShadows.Enabled ? 1 : 0][g_SceneMultisample ? 1 : 0][p_StereoInstanced ? 1 : 0][g_SceneInstancing ? 1 : 0];
+}
+
+// The depth pre-pass variant for the same draws (the interpolation doesn't matter without color)...
+static unsigned int GetDepthOnlyShaderKey(unsigned int p_Key)
+{
+	return (p_Key & (SceneShader_StereoInstanced | SceneShader_Instanced)) | SceneShader_DepthOnly;
+}
+
+void InitializeSceneRenderer(void)
+{
+	// One buffer for both eyes...
+	glGenBuffers(1, &l_EyeUniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, l_EyeUniformBuffer);
+
+	// Blocks have to start at a multiple of the uniform buffer offset alignment...
+	GLint l_Alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &l_Alignment);
+	l_EyeUniformStride = ((sizeof(EyeUniformBlock) + l_Alignment - 1) / l_Alignment) * l_Alignment;
+	const GLsizeiptr l_SlotSize = l_EyeUniformStride * SceneDepthLayer_Count;
+
+#if !defined(__APPLE__)
+	if (GLEW_ARB_buffer_storage)
+	{
+		const GLbitfield l_Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_UNIFORM_BUFFER, l_SlotSize * EYE_UNIFORM_SLOTS * EYE_UNIFORM_REGIONS, NULL, l_Flags);
+		l_EyeUniformMapping = (GLubyte*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, l_SlotSize * EYE_UNIFORM_SLOTS * EYE_UNIFORM_REGIONS, l_Flags);
+	}
+#endif
+	if (!l_EyeUniformMapping)
+	{
+		printf("GL_ARB_buffer_storage not supported, late latching disabled.\n");
+		glBufferData(GL_UNIFORM_BUFFER, l_SlotSize, NULL, GL_STREAM_DRAW);
+	}
+	l_EyeUniformRegion = 0;
+
+	for (unsigned int i = 0; i < EYE_UNIFORM_REGIONS; i++)
+	{
+		l_EyeUniformTimings[i].Query = 0;
+		l_EyeUniformTimings[i].Pending = false;
+		if (l_EyeUniformMapping && g_Profiler.GpuTiming)
+			glGenQueries(1, &l_EyeUniformTimings[i].Query);
+	}
+	l_PoseToGpuResolved = false;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferRange(GL_UNIFORM_BUFFER, EYE_UNIFORM_BINDING, l_EyeUniformBuffer, 0, sizeof(EyeUniformBlock));
+
+	glGenBuffers(1, &l_InstanceBuffer);
+	glGenBuffers(1, &l_VisibleInstanceBuffer);
+	l_InstancesValid = false;
+	InvalidateSceneBvh();
+	l_SceneCullingSupported = InitializeSceneCulling();
+	InitializeSceneClusters();
+
+	l_SceneVertexSource = RegisterShaderSource("scene.vert", l_SceneVertexShader);
+	l_SceneFragmentSource = RegisterShaderSource("scene.frag", l_SceneFragmentShader);
+
+	// The defines of every variant, so picking one later is just a table lookup...
+	for (unsigned int l_Key = 0; l_Key < SceneShader_VariantCount; l_Key++)
+	{
+		char l_Defines[256];
+		sprintf(l_Defines,
+			"#define PHONG %d\n#define MULTISAMPLE %d\n#define STEREO_INSTANCED %d\n#define INSTANCED %d\n#define SHADOWS %d\n#define DEPTH_ONLY %d\n#define LIGHT_COUNT %u\n",
+			(l_Key & SceneShader_Phong) ? 1 : 0,
+			(l_Key & SceneShader_Multisample) ? 1 : 0,
+			(l_Key & SceneShader_StereoInstanced) ? 1 : 0,
+			(l_Key & SceneShader_Instanced) ? 1 : 0,
+			(l_Key & SceneShader_Shadowed) ? 1 : 0,
+			(l_Key & SceneShader_DepthOnly) ? 1 : 0,
+			SCENE_LIGHT_COUNT);
+		l_SceneShaderDefines[l_Key] = l_Defines;
+		l_ScenePrograms[l_Key].Program = 0;
+		l_ScenePrograms[l_Key].Submitted = false;
+	}
+
+	// Get the variants the first frames are going to want going...
+	const bool l_StereoInstanced = (g_StereoMode == StereoMode_SinglePassInstanced);
+	GetSceneProgram(GetCurrentSceneShaderKey(l_StereoInstanced) & ~(SceneShader_Phong | SceneShader_Shadowed), true);
+	GetSceneProgram(GetCurrentSceneShaderKey(l_StereoInstanced), false);
+	if (g_SceneDepthPrePass)
+		GetSceneProgram(GetDepthOnlyShaderKey(GetCurrentSceneShaderKey(l_StereoInstanced)), false);
+}
+
+void ReloadSceneShaders(void)
+{
+	for (unsigned int l_Key = 0; l_Key < SceneShader_VariantCount; l_Key++)
+	{
+		if (l_ScenePrograms[l_Key].Submitted)
+			SubmitSceneProgram(l_Key);
+	}
+}
+
+void DestroySceneRenderer(void)
+{
+	for (unsigned int l_Key = 0; l_Key < SceneShader_VariantCount; l_Key++)
+	{
+		glDeleteProgram(l_ScenePrograms[l_Key].Program);
+		l_ScenePrograms[l_Key].Program = 0;
+		l_ScenePrograms[l_Key].Submitted = false;
+	}
+	DestroySceneCulling();
+	l_SceneCullingSupported = false;
+	DestroySceneClusters();
+	glDeleteBuffers(1, &l_InstanceBuffer);
+	glDeleteBuffers(1, &l_VisibleInstanceBuffer);
+	l_InstanceBuffer = l_VisibleInstanceBuffer = 0;
+	l_VisibleBatches[0].clear();
+	l_VisibleBatches[1].clear();
+	for (int l_Eye = 0; l_Eye < 2; l_Eye++)
+	{
+		for (int i = 0; i < SCENE_MAX_EYE_REGIONS; i++)
+		{
+			l_RegionVisible[l_Eye][i].clear();
+			l_RegionBatches[l_Eye][i].clear();
+		}
+		l_RegionCounts[l_Eye] = 0;
+	}
+	InvalidateSceneBvh();
+	l_InstanceBatches.clear();
+	l_InstanceSlots.clear();
+	l_InstanceTransforms.clear();
+	l_InstancesValid = false;
+
+	for (unsigned int i = 0; i < EYE_UNIFORM_REGIONS; i++)
+	{
+		if (l_EyeUniformFences[i])
+			glDeleteSync(l_EyeUniformFences[i]);
+		l_EyeUniformFences[i] = 0;
+
+		if (l_EyeUniformTimings[i].Query)
+			glDeleteQueries(1, &l_EyeUniformTimings[i].Query);
+		l_EyeUniformTimings[i].Query = 0;
+		l_EyeUniformTimings[i].Pending = false;
+	}
+	if (l_EyeUniformMapping)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, l_EyeUniformBuffer);
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		l_EyeUniformMapping = NULL;
+	}
+	glDeleteBuffers(1, &l_EyeUniformBuffer);
+	l_EyeUniformBuffer = 0;
+}
+
+// The eye's projection clipped to the depth range of p_Layer. The depth row is replaced with one in the
+// eye buffers' convention (see EyeRenderTarget.h) over the layer's range, so the split is exactly where
+// the layers clip. The layers never share a depth buffer with the full projection...
+static OVR::Matrix4f GetLayerProjection(const EyeView& p_Eye, SceneDepthLayer p_Layer)
+{
+	OVR::Matrix4f l_Projection = p_Eye.Projection;
+	if (p_Layer == SceneDepthLayer_Full)
+		return l_Projection;
+
+	const float l_Near = (p_Layer == SceneDepthLayer_Near) ? p_Eye.ZNear : g_SceneDepthSplit;
+	const float l_Far = (p_Layer == SceneDepthLayer_Near) ? g_SceneDepthSplit : p_Eye.ZFar;
+	SetEyeProjectionDepth(l_Projection, l_Near, l_Far);
+	return l_Projection;
+}
+
+static void FillEyeUniformBlock(const EyeView p_Eyes[2], OVR::Sizei p_TargetSize, SceneDepthLayer p_Layer, EyeUniformBlock& p_Block)
+{
+	for (int l_Eye = 0; l_Eye < 2; l_Eye++)
+	{
+		const OVR::Matrix4f l_Projection = GetLayerProjection(p_Eyes[l_Eye], p_Layer);
+		const OVR::Matrix4f l_ViewProjection = l_Projection * p_Eyes[l_Eye].View;
+		memcpy(p_Block.View[l_Eye], &p_Eyes[l_Eye].View.M[0][0], sizeof(p_Block.View[l_Eye]));
+		memcpy(p_Block.Projection[l_Eye], &l_Projection.M[0][0], sizeof(p_Block.Projection[l_Eye]));
+		memcpy(p_Block.ViewProjection[l_Eye], &l_ViewProjection.M[0][0], sizeof(p_Block.ViewProjection[l_Eye]));
+
+		p_Block.EyePosition[l_Eye][0] = p_Eyes[l_Eye].Position.x;
+		p_Block.EyePosition[l_Eye][1] = p_Eyes[l_Eye].Position.y;
+		p_Block.EyePosition[l_Eye][2] = p_Eyes[l_Eye].Position.z;
+		p_Block.EyePosition[l_Eye][3] = 1.0f;
+
+		// Window x = Pos.x + (x_ndc + 1) / 2 * Size.w has to come out of the full size viewport...
+		const ovrRecti& l_Viewport = p_Eyes[l_Eye].Viewport;
+		p_Block.EyeViewport[l_Eye][0] = (GLfloat)l_Viewport.Size.w / (GLfloat)p_TargetSize.w;
+		p_Block.EyeViewport[l_Eye][1] = (GLfloat)(2 * l_Viewport.Pos.x + l_Viewport.Size.w) / (GLfloat)p_TargetSize.w - 1.0f;
+		p_Block.EyeViewport[l_Eye][2] = (GLfloat)l_Viewport.Size.h / (GLfloat)p_TargetSize.h;
+		p_Block.EyeViewport[l_Eye][3] = (GLfloat)(2 * l_Viewport.Pos.y + l_Viewport.Size.h) / (GLfloat)p_TargetSize.h - 1.0f;
+	}
+}
+
+// Offset of the block of p_Layer in p_Slot of the current region (the one copy without a mapping)...
+static GLintptr EyeUniformOffset(unsigned int p_Slot, unsigned int p_Layer)
+{
+	return l_EyeUniformStride * (SceneDepthLayer_Count * (EYE_UNIFORM_SLOTS * l_EyeUniformRegion + p_Slot) + p_Layer);
+}
+
+// Writes the blocks of every layer in use into p_Slot of the current region and queues their copy
+// into the live slot, or without a mapping, straight into the orphaned buffer...
+static void WriteEyeUniforms(const EyeView p_Eyes[2], OVR::Sizei p_TargetSize, unsigned int p_Slot)
+{
+	l_EyeUniformLayers = (g_SceneDepthSplit > 0.0f) ? (unsigned int)SceneDepthLayer_Count : 1;
+	for (unsigned int l_Layer = 0; l_Layer < l_EyeUniformLayers; l_Layer++)
+	{
+		EyeUniformBlock l_Block;
+		FillEyeUniformBlock(p_Eyes, p_TargetSize, (SceneDepthLayer)l_Layer, l_Block);
+		if (l_EyeUniformMapping)
+		{
+			memcpy(l_EyeUniformMapping + EyeUniformOffset(p_Slot, l_Layer), &l_Block, sizeof(l_Block));
+		}
+		else
+		{
+			glBufferSubData(GL_UNIFORM_BUFFER, EyeUniformOffset(EYE_UNIFORM_LIVE, l_Layer), sizeof(EyeUniformBlock), &l_Block);
+		}
+	}
+
+	if (l_EyeUniformMapping)
+	{
+		// The mapping is coherent, the copy sees everything written before it was queued...
+		glBindBuffer(GL_COPY_READ_BUFFER, l_EyeUniformBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, l_EyeUniformBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, EyeUniformOffset(p_Slot, 0), EyeUniformOffset(EYE_UNIFORM_LIVE, 0),
+			l_EyeUniformStride * l_EyeUniformLayers);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+}
+
+// Timestamps the copy just queued, the GPU reaches it once it starts on the frame's eye uniforms...
+static void TimeEyeUniformCopy(double p_PoseTime)
+{
+	EyeUniformTiming& l_Timing = l_EyeUniformTimings[l_EyeUniformRegion];
+	if (!l_Timing.Query)
+		return;
+
+	glQueryCounter(l_Timing.Query, GL_TIMESTAMP);
+	l_Timing.Pending = true;
+	l_Timing.PoseTime = p_PoseTime;
+}
+
+// Reads back the timestamp of the region's previous frame. Its fence has passed, so this doesn't
+// wait, but a timestamp that still isn't there is dropped rather than waited on...
+static void ResolveEyeUniformTiming(void)
+{
+	EyeUniformTiming& l_Timing = l_EyeUniformTimings[l_EyeUniformRegion];
+	if (!l_Timing.Pending)
+		return;
+	l_Timing.Pending = false;
+
+	GLint l_Available = GL_FALSE;
+	glGetQueryObjectiv(l_Timing.Query, GL_QUERY_RESULT_AVAILABLE, &l_Available);
+	if (!l_Available)
+		return;
+
+	GLuint64 l_Timestamp = 0;
+	glGetQueryObjectui64v(l_Timing.Query, GL_QUERY_RESULT, &l_Timestamp);
+	l_PoseToGpuMs = ((double)l_Timestamp * 1.0e-9 + g_Profiler.GpuToCpuOffset - l_Timing.PoseTime) * 1000.0;
+	l_PoseToGpuFrame = l_Timing.Frame;
+	l_PoseToGpuResolved = true;
+}
+
+void UpdateEyeUniforms(const EyeView p_Eyes[2], OVR::Sizei p_TargetSize, unsigned int p_FrameIndex, double p_PoseTime)
+{
+	l_SceneEyes[0] = p_Eyes[0];
+	l_SceneEyes[1] = p_Eyes[1];
+	l_SceneCulled = false;
+
+	if (!l_EyeUniformMapping)
+	{
+		// Orphan last frame's storage so we never wait on draws still reading it...
+		glBindBuffer(GL_UNIFORM_BUFFER, l_EyeUniformBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, l_EyeUniformStride * SceneDepthLayer_Count, NULL, GL_STREAM_DRAW);
+		WriteEyeUniforms(p_Eyes, p_TargetSize, EYE_UNIFORM_LIVE);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		UseSceneDepthLayer(SceneDepthLayer_Full);
+		return;
+	}
+
+	// Next region, the GPU normally finished with it two frames ago so the wait is for free. Nothing
+	// gets written into it before the fence has signaled: a timeout just waits again, a failed wait
+	// waits for everything...
+	l_EyeUniformRegion = (l_EyeUniformRegion + 1) % EYE_UNIFORM_REGIONS;
+	GLsync& l_Fence = l_EyeUniformFences[l_EyeUniformRegion];
+	if (l_Fence)
+	{
+		GLenum l_Status;
+		do
+		{
+			l_Status = glClientWaitSync(l_Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+		} while (l_Status == GL_TIMEOUT_EXPIRED);
+		if (l_Status == GL_WAIT_FAILED)
+			glFinish();
+		glDeleteSync(l_Fence);
+		l_Fence = 0;
+	}
+	ResolveEyeUniformTiming();
+
+	WriteEyeUniforms(p_Eyes, p_TargetSize, EYE_UNIFORM_STAGED);
+	TimeEyeUniformCopy(p_PoseTime);
+	l_EyeUniformTimings[l_EyeUniformRegion].Frame = p_FrameIndex;
+	UseSceneDepthLayer(SceneDepthLayer_Full);
+}
+
+void UseSceneDepthLayer(SceneDepthLayer p_Layer)
+{
+	// Layers that weren't written this frame fall back to the full one...
+	const unsigned int l_Layer = ((unsigned int)p_Layer < l_EyeUniformLayers) ? (unsigned int)p_Layer : 0;
+	l_EyeUniformLayer = l_Layer;
+	glBindBufferRange(GL_UNIFORM_BUFFER, EYE_UNIFORM_BINDING, l_EyeUniformBuffer,
+		EyeUniformOffset(EYE_UNIFORM_LIVE, l_Layer), sizeof(EyeUniformBlock));
+}
+
+bool LateLatchingSupported(void)
+{
+	return l_EyeUniformMapping != NULL;
+}
+
+bool LatchEyeUniforms(const EyeView p_Eyes[2], OVR::Sizei p_TargetSize, double p_PoseTime)
+{
+	if (!l_EyeUniformMapping)
+		return false;
+
+	// The CPU culling follows the new pose too...
+	l_SceneEyes[0] = p_Eyes[0];
+	l_SceneEyes[1] = p_Eyes[1];
+	l_SceneCulled = false;
+
+	// Its own staging slot, the update's copy may not have run yet and must not see half of it...
+	WriteEyeUniforms(p_Eyes, p_TargetSize, EYE_UNIFORM_LATCHED);
+	TimeEyeUniformCopy(p_PoseTime);
+	return true;
+}
+
+void FenceEyeUniforms(void)
+{
+	if (!l_EyeUniformMapping)
+		return;
+
+	GLsync& l_Fence = l_EyeUniformFences[l_EyeUniformRegion];
+	if (l_Fence)
+		glDeleteSync(l_Fence);
+	l_Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool ResolvePoseToGpuLatency(unsigned int& p_FrameIndex, double& p_Ms)
+{
+	if (!l_PoseToGpuResolved)
+		return false;
+
+	l_PoseToGpuResolved = false;
+	p_FrameIndex = l_PoseToGpuFrame;
+	p_Ms = l_PoseToGpuMs;
+	return true;
+}
+
+// Draws every object, or just p_Objects if given, p_Instances times each...
+static unsigned int DrawSceneObjects(const SceneProgram& p_Program, GLsizei p_Instances, const std::vector<unsigned int>* p_Objects)
+{
+	const size_t l_Count = p_Objects ? p_Objects->size() : g_SceneObjects.size();
+	for (size_t i = 0; i < l_Count; i++)
+	{
+		const SceneObject& l_Object = g_SceneObjects[p_Objects ? (*p_Objects)[i] : i];
+		glUniformMatrix4fv(p_Program.ModelUniform, 1, GL_TRUE, &l_Object.Transform.M[0][0]);
+		if (p_Instances == 1)
+			DrawMesh(l_Object.Mesh);
+		else
+			DrawMeshInstanced(l_Object.Mesh, p_Instances);
+	}
+	return (unsigned int)l_Count;
+}
+
+// Sorts the objects into one batch per mesh and uploads all their transforms...
+static void RebuildSceneInstances(void)
+{
+	// Count the objects per mesh, that gives every batch its range in the buffer...
+	std::vector<GLuint> l_MeshCounts(g_Meshes.size(), 0);
+	for (size_t i = 0; i < g_SceneObjects.size(); i++)
+	{
+		if (g_SceneObjects[i].Mesh < g_Meshes.size())
+			++l_MeshCounts[g_SceneObjects[i].Mesh];
+	}
+
+	l_InstanceBatches.clear();
+	std::vector<GLuint> l_MeshNext(g_Meshes.size(), 0);
+	GLuint l_First = 0;
+	for (MeshHandle l_Mesh = 0; l_Mesh < g_Meshes.size(); l_Mesh++)
+	{
+		l_MeshNext[l_Mesh] = l_First;
+		if (l_MeshCounts[l_Mesh] == 0)
+			continue;
+		SceneInstanceBatch l_Batch = { l_Mesh, l_First, (GLsizei)l_MeshCounts[l_Mesh] };
+		l_InstanceBatches.push_back(l_Batch);
+		l_First += l_MeshCounts[l_Mesh];
+	}
+
+	l_InstanceSlots.assign(g_SceneObjects.size(), 0);
+	l_InstanceTransforms.resize(l_First);
+	for (size_t i = 0; i < g_SceneObjects.size(); i++)
+	{
+		if (g_SceneObjects[i].Mesh >= g_Meshes.size())
+			continue;
+		const GLuint l_Slot = l_MeshNext[g_SceneObjects[i].Mesh]++;
+		l_InstanceSlots[i] = l_Slot;
+		l_InstanceTransforms[l_Slot] = g_SceneObjects[i].Transform;
+	}
+
+	// New storage every time, the draws of the frames in flight keep the old one...
+	glBindBuffer(GL_ARRAY_BUFFER, l_InstanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, l_InstanceTransforms.size() * sizeof(OVR::Matrix4f), l_InstanceTransforms.empty() ? NULL : &l_InstanceTransforms[0], GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	SetSceneCullingBatches(l_InstanceBatches, l_First);
+}
+
+static bool UseGpuCulling(void)
+{
+	return g_SceneInstancing && g_SceneGpuCulling && l_SceneCullingSupported;
+}
+
+static bool UseBvhCulling(void)
+{
+	return g_SceneBvhCulling && !UseGpuCulling();
+}
+
+// The depth layers and the multi-resolution regions leave depth buffers the occlusion pyramid can't
+// be built from...
+static bool UseOcclusionCulling(void)
+{
+	return g_SceneOcclusion.Enabled && UseGpuCulling() && g_SceneDepthSplit <= 0.0f && l_RegionCounts[0] == 0 && l_RegionCounts[1] == 0;
+}
+
+// Brings the instance buffer (and the BVH) up to date with g_SceneObjects, once a frame is enough...
+static void UpdateSceneInstances(void)
+{
+	// The BVH goes first, it needs the moved objects as well...
+	if (UseBvhCulling())
+		UpdateSceneBvh();
+	else
+		InvalidateSceneBvh();
+
+	if (!g_SceneInstancing)
+	{
+		// Nothing to keep up to date, rebuild it if instancing comes back on...
+		g_SceneMovedObjects.clear();
+		l_InstancesValid = false;
+		return;
+	}
+
+	// Objects that came, went or really moved may have been occluders in the captured depth...
+	if (!l_InstancesValid || l_InstanceRevision != g_SceneRevision)
+	{
+		InvalidateSceneOcclusion();
+		RebuildSceneInstances();
+		l_InstanceRevision = g_SceneRevision;
+		l_InstancesValid = true;
+		g_SceneMovedObjects.clear();
+		return;
+	}
+	if (g_SceneMovedObjects.empty())
+		return;
+
+	// A few moved objects get patched one by one, lots of them are cheaper as a single upload...
+	glBindBuffer(GL_ARRAY_BUFFER, l_InstanceBuffer);
+	const bool l_Patch = g_SceneMovedObjects.size() * 8 < l_InstanceTransforms.size();
+	for (size_t i = 0; i < g_SceneMovedObjects.size(); i++)
+	{
+		const unsigned int l_Object = g_SceneMovedObjects[i];
+		const GLuint l_Slot = l_InstanceSlots[l_Object];
+		if (memcmp(&l_InstanceTransforms[l_Slot], &g_SceneObjects[l_Object].Transform, sizeof(OVR::Matrix4f)) != 0)
+			InvalidateSceneOcclusion();
+		l_InstanceTransforms[l_Slot] = g_SceneObjects[l_Object].Transform;
+		if (l_Patch)
+			glBufferSubData(GL_ARRAY_BUFFER, l_Slot * sizeof(OVR::Matrix4f), sizeof(OVR::Matrix4f), &l_InstanceTransforms[l_Slot]);
+	}
+	if (!l_Patch)
+		glBufferData(GL_ARRAY_BUFFER, l_InstanceTransforms.size() * sizeof(OVR::Matrix4f), &l_InstanceTransforms[0], GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	g_SceneMovedObjects.clear();
+}
+
+void UpdateSceneShadowMaps(void)
+{
+	if (!g_SceneShadows.Enabled)
+		return;
+
+	// The bounds go first, they need the moved objects before the instances catch up with them...
+	ProfileZone l_Zone("ShadowMaps");
+	const unsigned int l_Renders = g_SceneShadows.MapRenders;
+	const bool l_Dirty = UpdateSceneShadowBounds();
+	UpdateSceneInstances();
+	if (l_Dirty)
+		RenderSceneShadows(g_SceneInstancing ? l_InstanceBuffer : 0, l_InstanceBatches);
+	ProfilerCounter("ShadowMapRenders", (double)(g_SceneShadows.MapRenders - l_Renders));
+}
+
+void UpdateSceneLightClusters(void)
+{
+	ProfileZone l_Zone("BuildClusters", -1, false);
+	BuildSceneClusters(l_SceneEyes);
+	ProfilerCounter("ClusterLights", (double)g_SceneClusterStats.Lights);
+	ProfilerCounter("ClusterLightIndices", (double)g_SceneClusterStats.LightIndices);
+	ProfilerCounter("ClusterMaxLights", (double)g_SceneClusterStats.MaxClusterLights);
+}
+
+bool SceneGpuCullingSupported(void)
+{
+	return l_SceneCullingSupported;
+}
+
+void CaptureSceneOcclusionDepth(GLuint p_Framebuffer)
+{
+	if (!UseOcclusionCulling())
+	{
+		InvalidateSceneOcclusion();
+		return;
+	}
+
+	// The full layer of this frame's live slot (or the one copy) holds the matrices the depth was drawn with...
+	CaptureSceneOcclusion(p_Framebuffer, l_EyeUniformBuffer, EyeUniformOffset(EYE_UNIFORM_LIVE, SceneDepthLayer_Full));
+}
+
+// Groups the transforms of p_Count lists of visible objects (eyes or regions) per mesh, into p_Batches,
+// and streams them into l_VisibleInstanceBuffer, list after list...
+static void UploadVisibleInstances(const std::vector<unsigned int>* p_Visible, std::vector<SceneInstanceBatch>* p_Batches, int p_Count)
+{
+	std::vector<OVR::Matrix4f> l_Transforms;
+	std::vector<GLuint> l_MeshCounts(g_Meshes.size());
+	std::vector<GLuint> l_MeshNext(g_Meshes.size());
+	for (int l_List = 0; l_List < p_Count; l_List++)
+	{
+		const std::vector<unsigned int>& l_Visible = p_Visible[l_List];
+		l_MeshCounts.assign(g_Meshes.size(), 0);
+		for (size_t i = 0; i < l_Visible.size(); i++)
+		{
+			if (g_SceneObjects[l_Visible[i]].Mesh < g_Meshes.size())
+				++l_MeshCounts[g_SceneObjects[l_Visible[i]].Mesh];
+		}
+
+		p_Batches[l_List].clear();
+		GLuint l_First = (GLuint)l_Transforms.size();
+		for (MeshHandle l_Mesh = 0; l_Mesh < g_Meshes.size(); l_Mesh++)
+		{
+			l_MeshNext[l_Mesh] = l_First;
+			if (l_MeshCounts[l_Mesh] == 0)
+				continue;
+			SceneInstanceBatch l_Batch = { l_Mesh, l_First, (GLsizei)l_MeshCounts[l_Mesh] };
+			p_Batches[l_List].push_back(l_Batch);
+			l_First += l_MeshCounts[l_Mesh];
+		}
+
+		l_Transforms.resize(l_First);
+		for (size_t i = 0; i < l_Visible.size(); i++)
+		{
+			const SceneObject& l_Object = g_SceneObjects[l_Visible[i]];
+			if (l_Object.Mesh < g_Meshes.size())
+				l_Transforms[l_MeshNext[l_Object.Mesh]++] = l_Object.Transform;
+		}
+	}
+
+	// Orphaned every frame, like the eye uniforms without buffer storage...
+	glBindBuffer(GL_ARRAY_BUFFER, l_VisibleInstanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, l_Transforms.size() * sizeof(OVR::Matrix4f), l_Transforms.empty() ? NULL : &l_Transforms[0], GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// The cull pass has to run before the scene program is bound, and only once for both eyes. The BVH
+// tests the eyes one by one for multi-pass (p_Repeat 1), single-pass only needs their union. The GPU
+// pass culls against the frustums of the bound depth layer, the BVH always against the whole eyes...
+static void CullSceneIfNeeded(GLuint p_Repeat)
+{
+	const unsigned int l_Layer = UseGpuCulling() ? l_EyeUniformLayer : 0;
+	if (l_SceneCulled && l_CulledRepeat == p_Repeat && l_CulledLayer == l_Layer)
+		return;
+
+	if (UseGpuCulling())
+	{
+		const bool l_Occlusion = UseOcclusionCulling() && BuildSceneOcclusionPyramid();
+		CullSceneInstances(l_InstanceBuffer, p_Repeat, l_Occlusion);
+
+		// (From a few frames ago, the counts don't hold up the GPU.)
+		ProfilerCounter("CullVisible", (double)g_SceneCullingStats.Visible);
+		ProfilerCounter("OcclusionCulled", (double)g_SceneCullingStats.Occluded);
+	}
+	else if (UseBvhCulling())
+	{
+		ProfileZone l_Zone("CullBvh", -1, false);
+		const bool l_PerEye = (p_Repeat == 1);
+		CullSceneBvh(l_SceneEyes, l_PerEye, l_BvhVisible);
+
+		// Regions only draw what they see themselves...
+		unsigned int l_RegionObjects = 0;
+		const bool l_Regions = (l_RegionCounts[0] > 0 || l_RegionCounts[1] > 0);
+		for (int l_Eye = 0; l_Eye < 2; l_Eye++)
+		{
+			for (int i = 0; i < SCENE_MAX_EYE_REGIONS; i++)
+			{
+				l_RegionVisible[l_Eye][i].clear();
+				if (i < l_RegionCounts[l_Eye])
+					CullSceneBvhRegion(l_SceneEyes[l_Eye], l_RegionFovs[l_Eye][i], l_RegionVisible[l_Eye][i]);
+				l_RegionObjects += (unsigned int)l_RegionVisible[l_Eye][i].size();
+			}
+		}
+
+		if (g_SceneInstancing && l_Regions)
+			UploadVisibleInstances(&l_RegionVisible[0][0], &l_RegionBatches[0][0], 2 * SCENE_MAX_EYE_REGIONS);
+		else if (g_SceneInstancing)
+			UploadVisibleInstances(l_BvhVisible, l_VisibleBatches, l_PerEye ? 2 : 1);
+
+		ProfilerCounter("BvhNodesVisited", (double)g_SceneBvhStats.NodesVisited);
+		ProfilerCounter("BvhNodesCulled", (double)g_SceneBvhStats.NodesCulled);
+		ProfilerCounter("BvhEyeRefinements", (double)g_SceneBvhStats.EyeRefinements);
+		ProfilerCounter("BvhVisibleLeft", (double)g_SceneBvhStats.Visible[0]);
+		ProfilerCounter("BvhVisibleRight", (double)g_SceneBvhStats.Visible[1]);
+		ProfilerCounter("BvhRebuilds", (double)g_SceneBvhStats.Rebuilds);
+		if (l_Regions)
+			ProfilerCounter("BvhRegionObjects", (double)l_RegionObjects);
+	}
+	l_SceneCulled = true;
+	l_CulledRepeat = p_Repeat;
+	l_CulledLayer = l_Layer;
+}
+
+// One draw per mesh, every transform p_Repeat times. p_Eye and p_Region pick the BVH culled batches
+// (0 and -1 for single-pass)...
+static unsigned int DrawSceneInstances(GLuint p_Repeat, int p_Eye, int p_Region)
+{
+	if (UseGpuCulling())
+		return DrawCulledSceneInstances(p_Repeat);
+
+	const bool l_Culled = UseBvhCulling();
+	const std::vector<SceneInstanceBatch>& l_Batches = !l_Culled ? l_InstanceBatches :
+		(p_Region >= 0 ? l_RegionBatches[p_Eye][p_Region] : l_VisibleBatches[p_Eye]);
+	const GLuint l_Buffer = l_Culled ? l_VisibleInstanceBuffer : l_InstanceBuffer;
+	for (size_t i = 0; i < l_Batches.size(); i++)
+	{
+		const SceneInstanceBatch& l_Batch = l_Batches[i];
+		DrawMeshTransformed(l_Batch.Mesh, l_Buffer, l_Batch.FirstTransform, l_Batch.TransformCount, p_Repeat);
+	}
+	return (unsigned int)l_Batches.size();
+}
+
+// The depth pre-pass writes depth only. The shaded pass after it only passes where it hits that depth
+// exactly, and has nothing left to write there...
+static void BeginDepthPrePass(void)
+{
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+}
+
+static void BeginShadedPass(void)
+{
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_EQUAL);
+}
+
+static void EndShadedPass(void)
+{
+	glDepthFunc(GetEyeDepthFunc());
+	glDepthMask(GL_TRUE);
+}
+
+static unsigned int DrawSceneStereoObjects(unsigned int p_Key)
+{
+	const SceneProgram& l_Program = UseSceneProgram(p_Key);
+	unsigned int l_DrawCalls;
+	if (g_SceneInstancing)
+	{
+		l_DrawCalls = DrawSceneInstances(2, 0, -1);
+	}
+	else
+	{
+		l_DrawCalls = DrawSceneObjects(l_Program, 2, UseBvhCulling() ? &l_BvhVisible[0] : NULL);
+	}
+	glUseProgram(0);
+	return l_DrawCalls;
+}
+
+unsigned int DrawSceneSinglePassStereo(OVR::Sizei p_TargetSize)
+{
+	glViewport(0, 0, p_TargetSize.w, p_TargetSize.h);
+	for (int i = 0; i < 4; i++)
+		glEnable(GL_CLIP_DISTANCE0 + i);
+
+	unsigned int l_DrawCalls = 0;
+	UpdateSceneInstances();
+	CullSceneIfNeeded(2);
+	const unsigned int l_Key = GetCurrentSceneShaderKey(true);
+	if (g_SceneDepthPrePass)
+	{
+		{
+			ProfileZone l_Zone("DepthPrePass");
+			BeginDepthPrePass();
+			l_DrawCalls += DrawSceneStereoObjects(GetDepthOnlyShaderKey(l_Key));
+		}
+		BeginShadedPass();
+	}
+	l_DrawCalls += DrawSceneStereoObjects(l_Key);
+	if (g_SceneDepthPrePass)
+		EndShadedPass();
+
+	for (int i = 0; i < 4; i++)
+		glDisable(GL_CLIP_DISTANCE0 + i);
+
+	return l_DrawCalls;
+}
+
+void SetSceneEyeRegions(const ovrFovPort p_Regions[2][SCENE_MAX_EYE_REGIONS], const int p_Counts[2])
+{
+	for (int l_Eye = 0; l_Eye < 2; l_Eye++)
+	{
+		l_RegionCounts[l_Eye] = p_Counts[l_Eye];
+		for (int i = 0; i < p_Counts[l_Eye]; i++)
+			l_RegionFovs[l_Eye][i] = p_Regions[l_Eye][i];
+	}
+}
+
+static unsigned int DrawSceneEyeObjects(unsigned int p_Key, int p_Eye, int p_Region)
+{
+	const SceneProgram& l_Program = UseSceneProgram(p_Key);
+	glUniform1i(l_Program.EyeIndexUniform, p_Eye);
+	unsigned int l_DrawCalls;
+	if (g_SceneInstancing)
+	{
+		l_DrawCalls = DrawSceneInstances(1, p_Eye, p_Region);
+	}
+	else if (UseBvhCulling())
+	{
+		l_DrawCalls = DrawSceneObjects(l_Program, 1, p_Region >= 0 ? &l_RegionVisible[p_Eye][p_Region] : &l_BvhVisible[p_Eye]);
+	}
+	else
+	{
+		l_DrawCalls = DrawSceneObjects(l_Program, 1, NULL);
+	}
+	glUseProgram(0);
+	return l_DrawCalls;
+}
+
+unsigned int DrawSceneEye(int p_Eye, int p_Region)
+{
+	UpdateSceneInstances();
+	CullSceneIfNeeded(1);
+	if (p_Region >= l_RegionCounts[p_Eye])
+		p_Region = -1;
+
+	unsigned int l_DrawCalls = 0;
+	const unsigned int l_Key = GetCurrentSceneShaderKey(false);
+	if (g_SceneDepthPrePass)
+	{
+		{
+			ProfileZone l_Zone("DepthPrePass", p_Eye);
+			BeginDepthPrePass();
+			l_DrawCalls += DrawSceneEyeObjects(GetDepthOnlyShaderKey(l_Key), p_Eye, p_Region);
+		}
+		BeginShadedPass();
+	}
+	l_DrawCalls += DrawSceneEyeObjects(l_Key, p_Eye, p_Region);
+	if (g_SceneDepthPrePass)
+		EndShadedPass();
+	return l_DrawCalls;
+}
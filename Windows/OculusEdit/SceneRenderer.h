@@ -0,0 +1,224 @@
+//
+//  SceneRenderer.h
+//  OculusEdit
+//
+//  Shader based scene rendering. The view/projection state of both eyes lives in one
+//  uniform buffer (EyeUniforms, fixed binding point) that is written once per frame;
+//  every program that declares the block reads its eye from there, so there is no
+//  matrix setup left per eye or per draw.
+//
+//  Single-pass stereo draws every object once with two instances, the instance ID picks
+//  the eye. The vertex shader squeezes each eye's clip space into its half of the shared
+//  eye texture and clip distances keep the instances out of each other's half, so one
+//  full size viewport covers both.
+//
+//  The scene shader is one source with a handful of feature switches (lighting model,
+//  MSAA, stereo mode, instancing). Every combination is a variant with its own program,
+//  so none of the switches is a branch in the shader. Variants are built on first use
+//  and looked up in a table indexed by the variant key. The sources are scene.vert and
+//  scene.frag (see ShaderSource.h), edits rebuild every variant built so far.
+//
+//  With instancing on the object transforms are kept in a vertex buffer, grouped by mesh,
+//  and every mesh is a single instanced draw whatever the object count. The buffer follows
+//  the scene through g_SceneRevision and g_SceneMovedObjects (see Scene.h). Where the GL
+//  allows, the instances are culled on the GPU and drawn indirectly (SceneCulling.h),
+//  otherwise the objects are culled on the CPU against a BVH (SceneBvh.h) first.
+//
+//  Multi-resolution (MultiResolution.h) draws each eye in regions. The BVH then culls
+//  every region against its own part of the eye's FOV, so an object only gets drawn in
+//  the regions that can see it.
+//
+//  With a depth split (stereo reprojection, StereoReprojection.h) the eye uniforms come in
+//  three depth layers: the full depth range, and the parts in front of and behind the
+//  split. Binding a layer clips whatever draws next to its part of the depth range.
+//
+//  With the depth pre-pass on every pass draws its objects twice: depth only first, then
+//  shaded with the depth test on equal and depth writes off, so every pixel gets shaded
+//  once whatever the overdraw. gl_Position is invariant, both come out with the same depth.
+//
+//  The lit variants can sample shadow maps of the lights (SceneShadows.h). The maps are
+//  brought up to date once a frame, before the eyes, and every eye pass reads the same ones.
+//  The point lights are clustered the same way, once a frame for both eyes (SceneClusters.h).
+//
+
+#pragma once
+
+#if !defined(__APPLE__)
+#  include <GL/glew.h>
+#else
+#  include <OpenGL/gl3.h>
+#endif
+
+#include "OVR.h"
+#include "OVR_CAPI.h"
+
+// The most regions an eye gets drawn in (multi-resolution):
+const int SCENE_MAX_EYE_REGIONS = 9;
+
+// Uniform buffer binding point of the EyeUniforms block:
+const GLuint EYE_UNIFORM_BINDING = 0;
+
+// GLSL declaration of the block, for shaders that want to use it. std140 layout, the matrices
+// are row major so OVR matrices can be copied in as they are.
+#define EYE_UNIFORM_BLOCK_GLSL \
+	"layout (std140, row_major) uniform EyeUniforms\n" \
+	"{\n" \
+	"   mat4 view[2];\n" \
+	"   mat4 projection[2];\n" \
+	"   mat4 viewProjection[2];\n" \
+	"   vec4 eyePosition[2];\n" \
+	"   vec4 eyeViewport[2];\n" \
+	"};\n"
+
+// CPU side mirror of the block (std140: every member is 16 byte aligned already).
+struct EyeUniformBlock
+{
+	GLfloat View[2][16];
+	GLfloat Projection[2][16];
+	GLfloat ViewProjection[2][16];
+	GLfloat EyePosition[2][4];   // World space, w unused.
+	GLfloat EyeViewport[2][4];   // (scale x, offset x, scale y, offset y) into the full render target.
+};
+
+enum StereoMode
+{
+	StereoMode_MultiPass,             // One pass per eye (glViewport per eye, every draw submitted twice).
+	StereoMode_SinglePassInstanced    // One pass, every draw instanced twice.
+};
+
+// Feature bits of a scene shader variant key:
+enum SceneShaderFeature
+{
+	SceneShader_Phong = 1 << 0,           // Per pixel lighting, otherwise flat shading (also what draws while a variant loads).
+	SceneShader_Multisample = 1 << 1,     // Centroid interpolation, for the MSAA eye buffer.
+	SceneShader_StereoInstanced = 1 << 2, // Single-pass stereo, the eye comes from the instance ID.
+	SceneShader_Instanced = 1 << 3,       // Model matrix per instance from an attribute instead of a uniform.
+	SceneShader_Shadowed = 1 << 4,        // The lights are shadowed (needs Phong).
+	SceneShader_DepthOnly = 1 << 5,       // Depth pre-pass, the fragment shader does nothing.
+	SceneShader_VariantCount = 1 << 6
+};
+
+// The key of a variant, worked out by the compiler (VS2013 has no constexpr, hence the enum).
+template <bool Phong, bool Multisample, bool StereoInstanced, bool Instanced, bool Shadowed>
+struct SceneShaderKey
+{
+	enum
+	{
+		Value = (Phong ? SceneShader_Phong : 0) |
+			(Multisample ? SceneShader_Multisample : 0) |
+			(StereoInstanced ? SceneShader_StereoInstanced : 0) |
+			(Instanced ? SceneShader_Instanced : 0) |
+			(Shadowed ? SceneShader_Shadowed : 0)
+	};
+};
+
+// Everything the shaders need to know about one eye:
+struct EyeView
+{
+	OVR::Matrix4f View;        // World to eye, row major.
+	OVR::Matrix4f Projection;
+	OVR::Vector3f Position;    // Eye position in world space (for the specular highlight).
+	ovrRecti Viewport;         // Where the eye lives in the render target.
+	ovrFovPort Fov;            // The tangents Projection was made from (for culling).
+	float ZNear;               // The depth range Projection was made with.
+	float ZFar;
+};
+
+enum SceneDepthLayer
+{
+	SceneDepthLayer_Full,  // Everything between the near and far planes.
+	SceneDepthLayer_Near,  // From the near plane to g_SceneDepthSplit.
+	SceneDepthLayer_Far,   // From g_SceneDepthSplit to the far plane.
+	SceneDepthLayer_Count
+};
+
+extern StereoMode g_StereoMode;
+
+// The eye buffer being drawn into is multisampled (picks the variants with centroid interpolation).
+extern bool g_SceneMultisample;
+
+// Draw every mesh once for all the objects using it (per instance transforms from a buffer) instead
+// of once per object.
+extern bool g_SceneInstancing;
+
+// Lay down the depth of the objects before shading them (see above).
+extern bool g_SceneDepthPrePass;
+
+// Instanced drawing goes through the compute culling pass and multi-draw indirect (see SceneCulling.h),
+// if SceneGpuCullingSupported().
+extern bool g_SceneGpuCulling;
+
+// Without GPU culling, cull on the CPU against the scene BVH (see SceneBvh.h) and only draw what
+// the eyes can see.
+extern bool g_SceneBvhCulling;
+
+// Distance (meters) where the near depth layer ends and the far one starts, 0 for no layers. Takes
+// effect with the next UpdateEyeUniforms.
+extern float g_SceneDepthSplit;
+
+// Re-write the eye matrices with a fresh pose right before the eyes are drawn (needs
+// LateLatchingSupported()).
+extern bool g_LateLatching;
+
+// Needs a current GL context. Creates the eye uniform buffer and binds it to EYE_UNIFORM_BINDING.
+// The lit scene program is only submitted here, the scene draws with a flat shaded fallback until
+// PollCachedPrograms finishes it.
+void InitializeSceneRenderer(void);
+void DestroySceneRenderer(void);
+
+// Rebuilds the variants built so far from the current shader sources (after UpdateShaderSources).
+// The old programs keep drawing until the new ones are linked.
+void ReloadSceneShaders(void);
+
+// Points the program's EyeUniforms block (if it has one) at EYE_UNIFORM_BINDING.
+void BindEyeUniformBlock(GLuint p_Program);
+
+// Writes both eyes into the uniform buffer. Call once per frame, after the eye poses are known,
+// p_PoseTime is when they were sampled (ovr_GetTimeInSeconds). Leaves the full depth layer bound.
+void UpdateEyeUniforms(const EyeView p_Eyes[2], OVR::Sizei p_TargetSize, unsigned int p_FrameIndex, double p_PoseTime);
+
+// Binds the eye uniforms of p_Layer for the draws that follow (the full layer without a depth split).
+void UseSceneDepthLayer(SceneDepthLayer p_Layer);
+
+// True if the eye uniform buffer is persistently mapped (GL_ARB_buffer_storage).
+bool LateLatchingSupported(void);
+
+// True if the GL has what GPU culling needs (GL 4.3 compute and multi-draw indirect).
+bool SceneGpuCullingSupported(void);
+
+// Late latching: replaces this frame's eye uniforms with a fresher pose. The GPU copies them in
+// ahead of everything queued after this call, so call it before the first draw that reads them
+// (culling included). Returns false if the buffer isn't persistently mapped.
+bool LatchEyeUniforms(const EyeView p_Eyes[2], OVR::Sizei p_TargetSize, double p_PoseTime);
+
+// Call once per frame after the last draw that reads the eye uniforms (and after latching).
+void FenceEyeUniforms(void);
+
+// Time from sampling the poses to the GPU picking up the eye uniforms made from them, of an older
+// frame (p_FrameIndex) whose timestamp came back since the last call. False if there is none
+// (needs LateLatchingSupported() and GL_ARB_timer_query).
+bool ResolvePoseToGpuLatency(unsigned int& p_FrameIndex, double& p_Ms);
+
+// Keeps the depth of p_Framebuffer, the eye framebuffer with the whole frame drawn, for next frame's
+// occlusion culling (SceneOcclusion.h). Call once per frame, after the last scene draw.
+void CaptureSceneOcclusionDepth(GLuint p_Framebuffer);
+
+// Renders the shadow maps the scene changes affect (SceneShadows.h), if shadows are on. Call once
+// per frame before the eyes are drawn. Leaves the default framebuffer bound.
+void UpdateSceneShadowMaps(void);
+
+// Bins the point lights into the light clusters around this frame's eyes (SceneClusters.h). Call once
+// per frame after UpdateEyeUniforms and after the lights moved, before the eyes are drawn.
+void UpdateSceneLightClusters(void);
+
+// Draws g_SceneObjects for both eyes in one pass into the currently bound framebuffer
+// (p_TargetSize is its full size). Returns the number of draw calls issued.
+unsigned int DrawSceneSinglePassStereo(OVR::Sizei p_TargetSize);
+
+// Multi-resolution: eye i is drawn in p_Counts[i] regions, region j sees p_Regions[i][j] of its FOV.
+// Call every frame before the first draw, counts of 0 go back to drawing whole eyes.
+void SetSceneEyeRegions(const ovrFovPort p_Regions[2][SCENE_MAX_EYE_REGIONS], const int p_Counts[2]);
+
+// Draws g_SceneObjects for a single eye into the current viewport, or only what region p_Region (of
+// the ones given to SetSceneEyeRegions) sees of them. Returns the number of draw calls.
+unsigned int DrawSceneEye(int p_Eye, int p_Region = -1);
@@ -0,0 +1,342 @@
+//
+//  SceneShadows.cpp
+//  OculusEdit
+//
+
+#include "SceneShadows.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+#include "OVR.h"
+#include "Mesh.h"
+#include "Scene.h"
+#include "Shader.h"
+
+SceneShadowState g_SceneShadows = { false, 2048, 0, 0 };
+
+// A light's view of the scene: its box in light space (x and y across the map, z towards the light)...
+struct ShadowLight
+{
+	OVR::Matrix4f View;
+	OVR::Matrix4f ViewProjection;
+	float Min[3];
+	float Max[3];
+	bool Dirty;
+	bool Refit;
+};
+
+static ShadowLight l_Lights[SCENE_LIGHT_COUNT];
+static GLfloat l_ShadowMatrices[SCENE_LIGHT_COUNT * 16];
+static std::vector<OVR::Matrix4f> l_Transforms; // What the maps were rendered with.
+static unsigned int l_SceneRevision = 0;
+static bool l_Valid = false;
+
+static GLuint l_Framebuffer = 0;
+static GLuint l_DepthTexture = 0;
+static GLuint l_Programs[2] = { 0, 0 };        // Per object and instanced...
+static GLint l_ModelUniform = -1;
+static GLint l_ViewProjectionUniforms[2] = { -1, -1 };
+
+// Depth only. Instance matrices come in row major like in the scene shader, the uniforms are
+// uploaded transposed...
+static const std::string l_ShadowVertexShader(
+	"layout (location = POSITION_LOCATION) in vec3 position;\n"
+	"#if INSTANCED\n"
+	"layout (location = INSTANCE_MODEL_LOCATION) in mat4 instanceModel;\n"
+	"#else\n"
+	"uniform mat4 model;\n"
+	"#endif\n"
+	"uniform mat4 lightViewProjection;\n"
+	"void main()\n"
+	"{\n"
+	"#if INSTANCED\n"
+	"   mat4 model = transpose(instanceModel);\n"
+	"#endif\n"
+	"   gl_Position = lightViewProjection * model * vec4(position, 1.0);\n"
+	"}\n"
+	);
+
+static const std::string l_ShadowFragmentShader(
+	SHADER_GLSL_VERSION
+	"void main()\n"
+	"{\n"
+	"}\n"
+	);
+
+// World space bounding sphere of an object, false if it has no mesh...
+static bool GetObjectSphere(const SceneObject& p_Object, const OVR::Matrix4f& p_Transform, OVR::Vector3f& p_Center, float& p_Radius)
+{
+	if (p_Object.Mesh >= g_Meshes.size())
+		return false;
+
+	const GLfloat* l_Sphere = g_Meshes[p_Object.Mesh].BoundingSphere;
+	p_Center = p_Transform.Transform(OVR::Vector3f(l_Sphere[0], l_Sphere[1], l_Sphere[2]));
+
+	float l_ScaleSquared = 0.0f;
+	for (int j = 0; j < 3; j++)
+	{
+		const float l_ColumnSquared = p_Transform.M[0][j] * p_Transform.M[0][j] + p_Transform.M[1][j] * p_Transform.M[1][j] + p_Transform.M[2][j] * p_Transform.M[2][j];
+		l_ScaleSquared = std::max(l_ScaleSquared, l_ColumnSquared);
+	}
+	p_Radius = l_Sphere[3] * sqrtf(l_ScaleSquared);
+	return true;
+}
+
+static bool InsideLight(const ShadowLight& p_Light, const OVR::Vector3f& p_Center, float p_Radius)
+{
+	const OVR::Vector3f l_Center = p_Light.View.Transform(p_Center);
+	const float l_Position[3] = { l_Center.x, l_Center.y, l_Center.z };
+	for (int c = 0; c < 3; c++)
+	{
+		if (l_Position[c] - p_Radius < p_Light.Min[c] || l_Position[c] + p_Radius > p_Light.Max[c])
+			return false;
+	}
+	return true;
+}
+
+// Fits the light's box around every object (with some room, so small moves don't refit it
+// again) and works out its matrices...
+static void FitLight(unsigned int p_Light)
+{
+	ShadowLight& l_Light = l_Lights[p_Light];
+	const OVR::Vector3f l_Direction = OVR::Vector3f(g_SceneLights[p_Light].Position[0], g_SceneLights[p_Light].Position[1], g_SceneLights[p_Light].Position[2]).Normalized();
+	const OVR::Vector3f l_Up = (fabsf(l_Direction.y) > 0.99f) ? OVR::Vector3f(0.0f, 0.0f, 1.0f) : OVR::Vector3f(0.0f, 1.0f, 0.0f);
+	const OVR::Vector3f l_X = l_Up.Cross(l_Direction).Normalized();
+	const OVR::Vector3f l_Y = l_Direction.Cross(l_X);
+	l_Light.View = OVR::Matrix4f(
+		l_X.x, l_X.y, l_X.z, 0.0f,
+		l_Y.x, l_Y.y, l_Y.z, 0.0f,
+		l_Direction.x, l_Direction.y, l_Direction.z, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+
+	bool l_Empty = true;
+	for (size_t i = 0; i < l_Transforms.size(); i++)
+	{
+		OVR::Vector3f l_Center;
+		float l_Radius;
+		if (!GetObjectSphere(g_SceneObjects[i], l_Transforms[i], l_Center, l_Radius))
+			continue;
+
+		const OVR::Vector3f l_LightCenter = l_Light.View.Transform(l_Center);
+		const float l_Position[3] = { l_LightCenter.x, l_LightCenter.y, l_LightCenter.z };
+		for (int c = 0; c < 3; c++)
+		{
+			l_Light.Min[c] = l_Empty ? l_Position[c] - l_Radius : std::min(l_Light.Min[c], l_Position[c] - l_Radius);
+			l_Light.Max[c] = l_Empty ? l_Position[c] + l_Radius : std::max(l_Light.Max[c], l_Position[c] + l_Radius);
+		}
+		l_Empty = false;
+	}
+	for (int c = 0; c < 3; c++)
+	{
+		const float l_Margin = l_Empty ? 1.0f : 0.05f * (l_Light.Max[c] - l_Light.Min[c]) + 0.01f;
+		l_Light.Min[c] = (l_Empty ? 0.0f : l_Light.Min[c]) - l_Margin;
+		l_Light.Max[c] = (l_Empty ? 0.0f : l_Light.Max[c]) + l_Margin;
+	}
+
+	// Orthographic, the side of the box facing the light is the near plane...
+	OVR::Matrix4f l_Projection;
+	l_Projection.M[0][0] = 2.0f / (l_Light.Max[0] - l_Light.Min[0]);
+	l_Projection.M[0][3] = -(l_Light.Max[0] + l_Light.Min[0]) / (l_Light.Max[0] - l_Light.Min[0]);
+	l_Projection.M[1][1] = 2.0f / (l_Light.Max[1] - l_Light.Min[1]);
+	l_Projection.M[1][3] = -(l_Light.Max[1] + l_Light.Min[1]) / (l_Light.Max[1] - l_Light.Min[1]);
+	l_Projection.M[2][2] = -2.0f / (l_Light.Max[2] - l_Light.Min[2]);
+	l_Projection.M[2][3] = (l_Light.Max[2] + l_Light.Min[2]) / (l_Light.Max[2] - l_Light.Min[2]);
+	l_Light.ViewProjection = l_Projection * l_Light.View;
+
+	// The scene shader wants [0, 1] depth and coordinates into the light's tile of the atlas...
+	OVR::Matrix4f l_Tile;
+	l_Tile.M[0][0] = 0.5f / SCENE_LIGHT_COUNT;
+	l_Tile.M[0][3] = (0.5f + p_Light) / SCENE_LIGHT_COUNT;
+	l_Tile.M[1][1] = 0.5f;
+	l_Tile.M[1][3] = 0.5f;
+	l_Tile.M[2][2] = 0.5f;
+	l_Tile.M[2][3] = 0.5f;
+	const OVR::Matrix4f l_ShadowMatrix = l_Tile * l_Light.ViewProjection;
+	memcpy(&l_ShadowMatrices[p_Light * 16], &l_ShadowMatrix.M[0][0], 16 * sizeof(GLfloat));
+
+	l_Light.Dirty = true;
+	l_Light.Refit = false;
+	++g_SceneShadows.Revision;
+}
+
+static GLuint CreateShadowProgram(bool p_Instanced)
+{
+	// The attribute locations are the ones DrawMesh and DrawMeshTransformed set up...
+	char l_Locations[128];
+	sprintf(l_Locations, "#define POSITION_LOCATION %u\n#define INSTANCE_MODEL_LOCATION %u\n", MESH_ATTRIBUTE_POSITION, MESH_ATTRIBUTE_INSTANCE_MODEL);
+	const std::string l_Vertex = std::string(SHADER_GLSL_VERSION) + (p_Instanced ? "#define INSTANCED 1\n" : "#define INSTANCED 0\n") + l_Locations + l_ShadowVertexShader;
+	return CreateProgram(l_Vertex, l_ShadowFragmentShader);
+}
+
+void InitializeSceneShadows(int p_MapSize, bool p_Enabled)
+{
+	// The lights' tiles side by side...
+	GLint l_MaxSize = 4096;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &l_MaxSize);
+	g_SceneShadows.MapSize = std::min(p_MapSize, (int)(l_MaxSize / SCENE_LIGHT_COUNT));
+	g_SceneShadows.Enabled = p_Enabled;
+	g_SceneShadows.MapRenders = 0;
+
+	// Compared in the lookup, linear filtering gets the 2 x 2 samples around it blended for free...
+	glGenTextures(1, &l_DepthTexture);
+	glBindTexture(GL_TEXTURE_2D, l_DepthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, g_SceneShadows.MapSize * SCENE_LIGHT_COUNT, g_SceneShadows.MapSize, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &l_Framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, l_Framebuffer);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, l_DepthTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("The shadow map framebuffer is incomplete, shadows stay off.\n");
+		glDeleteTextures(1, &l_DepthTexture);
+		l_DepthTexture = 0;
+		g_SceneShadows.Enabled = false;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	for (int i = 0; i < 2; i++)
+	{
+		l_Programs[i] = CreateShadowProgram(i == 1);
+		l_ViewProjectionUniforms[i] = glGetUniformLocation(l_Programs[i], "lightViewProjection");
+	}
+	l_ModelUniform = glGetUniformLocation(l_Programs[0], "model");
+	InvalidateSceneShadows();
+
+	printf("Shadows: %s, %d x %d per light.\n", g_SceneShadows.Enabled ? "on" : "off", g_SceneShadows.MapSize, g_SceneShadows.MapSize);
+}
+
+void DestroySceneShadows(void)
+{
+	glDeleteProgram(l_Programs[0]);
+	glDeleteProgram(l_Programs[1]);
+	glDeleteFramebuffers(1, &l_Framebuffer);
+	glDeleteTextures(1, &l_DepthTexture);
+	l_Programs[0] = l_Programs[1] = 0;
+	l_Framebuffer = 0;
+	l_DepthTexture = 0;
+	l_Transforms.clear();
+	l_Valid = false;
+	g_SceneShadows.Enabled = false;
+}
+
+void InvalidateSceneShadows(void)
+{
+	l_Valid = false;
+}
+
+bool UpdateSceneShadowBounds(void)
+{
+	if (!g_SceneShadows.Enabled)
+		return false;
+
+	// Objects came or went, start over...
+	if (!l_Valid || l_SceneRevision != g_SceneRevision)
+	{
+		l_Transforms.resize(g_SceneObjects.size());
+		for (size_t i = 0; i < g_SceneObjects.size(); i++)
+			l_Transforms[i] = g_SceneObjects[i].Transform;
+		for (unsigned int l_Light = 0; l_Light < SCENE_LIGHT_COUNT; l_Light++)
+			FitLight(l_Light);
+		l_SceneRevision = g_SceneRevision;
+		l_Valid = true;
+		return true;
+	}
+
+	// Objects get "moved" to where they are all the time, only the ones that really did count...
+	for (size_t i = 0; i < g_SceneMovedObjects.size(); i++)
+	{
+		const unsigned int l_Object = g_SceneMovedObjects[i];
+		if (memcmp(&l_Transforms[l_Object], &g_SceneObjects[l_Object].Transform, sizeof(OVR::Matrix4f)) == 0)
+			continue;
+
+		l_Transforms[l_Object] = g_SceneObjects[l_Object].Transform;
+		OVR::Vector3f l_Center;
+		float l_Radius;
+		if (!GetObjectSphere(g_SceneObjects[l_Object], l_Transforms[l_Object], l_Center, l_Radius))
+			continue;
+
+		for (unsigned int l_Light = 0; l_Light < SCENE_LIGHT_COUNT; l_Light++)
+		{
+			if (InsideLight(l_Lights[l_Light], l_Center, l_Radius))
+				l_Lights[l_Light].Dirty = true;
+			else
+				l_Lights[l_Light].Refit = true;
+		}
+	}
+
+	bool l_Dirty = false;
+	for (unsigned int l_Light = 0; l_Light < SCENE_LIGHT_COUNT; l_Light++)
+	{
+		if (l_Lights[l_Light].Refit)
+			FitLight(l_Light);
+		l_Dirty = l_Dirty || l_Lights[l_Light].Dirty;
+	}
+	return l_Dirty;
+}
+
+void RenderSceneShadows(GLuint p_TransformBuffer, const std::vector<SceneInstanceBatch>& p_Batches)
+{
+	const int l_Program = p_TransformBuffer ? 1 : 0;
+	glBindFramebuffer(GL_FRAMEBUFFER, l_Framebuffer);
+	glUseProgram(l_Programs[l_Program]);
+	glEnable(GL_SCISSOR_TEST);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f); // Keeps lit surfaces from shadowing themselves...
+
+	const GLsizei l_Size = g_SceneShadows.MapSize;
+	for (unsigned int l_Light = 0; l_Light < SCENE_LIGHT_COUNT; l_Light++)
+	{
+		ShadowLight& l_ShadowLight = l_Lights[l_Light];
+		if (!l_ShadowLight.Dirty)
+			continue;
+
+		glViewport(l_Light * l_Size, 0, l_Size, l_Size);
+		glScissor(l_Light * l_Size, 0, l_Size, l_Size);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		glUniformMatrix4fv(l_ViewProjectionUniforms[l_Program], 1, GL_TRUE, &l_ShadowLight.ViewProjection.M[0][0]);
+		if (p_TransformBuffer)
+		{
+			for (size_t i = 0; i < p_Batches.size(); i++)
+				DrawMeshTransformed(p_Batches[i].Mesh, p_TransformBuffer, p_Batches[i].FirstTransform, p_Batches[i].TransformCount, 1);
+		}
+		else
+		{
+			for (size_t i = 0; i < g_SceneObjects.size(); i++)
+			{
+				glUniformMatrix4fv(l_ModelUniform, 1, GL_TRUE, &g_SceneObjects[i].Transform.M[0][0]);
+				DrawMesh(g_SceneObjects[i].Mesh);
+			}
+		}
+
+		l_ShadowLight.Dirty = false;
+		++g_SceneShadows.MapRenders;
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glDisable(GL_SCISSOR_TEST);
+	glUseProgram(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+GLuint GetSceneShadowTexture(void)
+{
+	return l_DepthTexture;
+}
+
+const GLfloat* GetSceneShadowMatrices(void)
+{
+	return l_ShadowMatrices;
+}
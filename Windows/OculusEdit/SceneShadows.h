@@ -0,0 +1,68 @@
+//
+//  SceneShadows.h
+//  OculusEdit
+//
+//  Shadow maps for the scene lights. Every light gets a square tile of one depth texture
+//  (the atlas), rendered from the light with an orthographic projection fitted around
+//  the objects in light space. The maps don't depend on the eyes, so they are rendered
+//  once a frame at most, before the eyes, and every eye pass (both eyes, single or
+//  multi-pass, all the regions of multi-resolution) samples the same atlas.
+//
+//  They are only rendered again when something in them changed: objects added or
+//  removed (g_SceneRevision), or an object that really moved (g_SceneMovedObjects, a
+//  transform that differs from the one the maps were rendered with) inside a light's
+//  box. An object that leaves the box refits it first. Every box holds all the objects,
+//  so a real move re-renders every map; what gets saved are the frames where nothing
+//  really moved. The lights are stationary, so they never dirty a map themselves;
+//  InvalidateSceneShadows is there for anything else.
+//
+
+#pragma once
+
+#include <vector>
+
+#if !defined(__APPLE__)
+#  include <GL/glew.h>
+#else
+#  include <OpenGL/gl3.h>
+#endif
+
+#include "SceneCulling.h"
+
+// Texture unit the scene shader finds the atlas on:
+const GLuint SCENE_SHADOW_TEXTURE_UNIT = 2;
+
+// Range of the tile size (texels per side):
+const int SCENE_SHADOW_MIN_SIZE = 256;
+const int SCENE_SHADOW_MAX_SIZE = 4096;
+
+struct SceneShadowState
+{
+	bool Enabled;
+	int MapSize;              // Of every light's tile.
+	unsigned int MapRenders;  // Tiles rendered so far.
+	unsigned int Revision;    // Bumped whenever the light matrices change.
+};
+
+extern SceneShadowState g_SceneShadows;
+
+// Needs a current GL context. Shadows stay off if the atlas can't be created.
+void InitializeSceneShadows(int p_MapSize, bool p_Enabled);
+void DestroySceneShadows(void);
+
+// Fits and renders every map again with the next update.
+void InvalidateSceneShadows(void);
+
+// Works out which maps the scene changes since the last call affect. Reads g_SceneRevision and
+// g_SceneMovedObjects, so it has to run before the renderer clears the moved objects. Returns
+// true if any map has to be rendered.
+bool UpdateSceneShadowBounds(void);
+
+// Renders the maps UpdateSceneShadowBounds marked. With p_TransformBuffer the objects are drawn
+// instanced, a draw per batch, otherwise one by one. Leaves the default framebuffer bound.
+void RenderSceneShadows(GLuint p_TransformBuffer, const std::vector<SceneInstanceBatch>& p_Batches);
+
+GLuint GetSceneShadowTexture(void);
+
+// World space to atlas coordinates (and depth) per light, 16 floats each, row major.
+const GLfloat* GetSceneShadowMatrices(void);
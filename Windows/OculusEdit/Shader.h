@@ -0,0 +1,37 @@
+//
+//  Shader.h
+//  OculusEdit
+//
+//  Shader program builder functions shared by every renderer.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#if !defined(__APPLE__)
+#  include <GL/glew.h>
+#else
+#  include <OpenGL/gl3.h>
+#endif
+
+// Every shader source starts with this line, variants add their #defines right after it...
+#define SHADER_GLSL_VERSION "#version 330\n"
+
+// Compiles a single shader stage. Compile errors are printed, the shader is returned regardless.
+GLuint CreateShader(GLenum eShaderType, const std::string &strShaderFile);
+
+// Links the shaders into a program and detaches them again. Link errors are printed.
+// retrievable asks the driver to keep the binary around for glGetProgramBinary.
+GLuint CreateProgram(const std::vector<GLuint> &shaderList, bool retrievable = false);
+
+// The two halves of the above, for building without waiting on the driver: Submit* only kick off
+// the compile/link, Check* query the status (which blocks until the driver is done) and print errors.
+GLuint SubmitShader(GLenum eShaderType, const std::string &strShaderFile);
+bool CheckShader(GLuint shader, GLenum eShaderType);
+GLuint SubmitProgram(const std::vector<GLuint> &shaderList, bool retrievable = false);
+bool CheckProgram(GLuint program);
+
+// Convenience wrapper: compiles a vertex + fragment pair, links them and deletes the shader objects.
+GLuint CreateProgram(const std::string &strVertexShader, const std::string &strFragmentShader);
@@ -0,0 +1,380 @@
+//
+//  ShaderCache.cpp
+//  OculusEdit
+//
+
+#include "ShaderCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#if defined(_WIN32)
+#  include <direct.h>
+#else
+#  include <sys/stat.h>
+#endif
+
+#include "OVR_CAPI.h"
+#include "Shader.h"
+
+ShaderCacheState g_ShaderCache;
+
+// GLEW 1.11 predates GL_KHR_parallel_shader_compile, the status query is all we use of it...
+#if !defined(GL_COMPLETION_STATUS_KHR)
+#  define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// "OESC". The "OESB" files before it recorded the time until the program got picked up as BuildMs,
+// they are rejected and rebuilt...
+static const unsigned int SHADER_CACHE_MAGIC = 0x4F455343;
+
+// Fixed header in front of the binary in every cache file:
+struct ShaderCacheFileHeader
+{
+	unsigned int Magic;
+	unsigned int Format;       // As returned by glGetProgramBinary.
+	unsigned int Length;       // Bytes of binary following the header.
+	float BuildMs;             // How long the compile, link and status calls took when the file was written.
+	unsigned long long Key;    // Full hash, guards against a truncated file name match.
+};
+
+unsigned long long HashString(const std::string& p_String, unsigned long long p_Hash)
+{
+	for (size_t i = 0; i < p_String.size(); i++)
+	{
+		p_Hash ^= (unsigned char)p_String[i];
+		p_Hash *= 1099511628211ull;
+	}
+	return p_Hash;
+}
+
+static std::string InsertDefines(const std::string& p_Source, const std::string& p_Defines)
+{
+	if (p_Defines.empty())
+		return p_Source;
+
+	// #version has to stay the first line...
+	const size_t l_LineEnd = p_Source.find('\n');
+	if (p_Source.compare(0, 8, "#version") != 0 || l_LineEnd == std::string::npos)
+		return p_Defines + p_Source;
+	return p_Source.substr(0, l_LineEnd + 1) + p_Defines + p_Source.substr(l_LineEnd + 1);
+}
+
+static std::string CachePath(unsigned long long p_Key)
+{
+	char l_Name[32];
+	sprintf(l_Name, "%016llx.bin", p_Key);
+	return g_ShaderCache.Directory + "/" + l_Name;
+}
+
+static GLuint LoadCachedProgram(unsigned long long p_Key, float& p_BuildMs)
+{
+	const std::string l_Path = CachePath(p_Key);
+	FILE* l_File = fopen(l_Path.c_str(), "rb");
+	if (!l_File)
+		return 0;
+
+	ShaderCacheFileHeader l_Header;
+	std::vector<unsigned char> l_Binary;
+	bool l_Valid = fread(&l_Header, sizeof(l_Header), 1, l_File) == 1 &&
+		l_Header.Magic == SHADER_CACHE_MAGIC && l_Header.Key == p_Key && l_Header.Length > 0;
+	if (l_Valid)
+	{
+		l_Binary.resize(l_Header.Length);
+		l_Valid = fread(&l_Binary[0], 1, l_Binary.size(), l_File) == l_Binary.size();
+	}
+	fclose(l_File);
+
+	GLuint l_Program = 0;
+	if (l_Valid)
+	{
+		l_Program = glCreateProgram();
+		glProgramBinary(l_Program, l_Header.Format, &l_Binary[0], (GLsizei)l_Binary.size());
+
+		// Drivers are free to reject binaries (e.g. after an update that kept the version string)...
+		GLint l_Status = GL_FALSE;
+		glGetProgramiv(l_Program, GL_LINK_STATUS, &l_Status);
+		if (l_Status == GL_FALSE)
+		{
+			glDeleteProgram(l_Program);
+			l_Program = 0;
+		}
+	}
+
+	if (!l_Program)
+	{
+		++g_ShaderCache.Rejected;
+		remove(l_Path.c_str());
+		return 0;
+	}
+
+	p_BuildMs = l_Header.BuildMs;
+	return l_Program;
+}
+
+static void StoreCachedProgram(unsigned long long p_Key, GLuint p_Program, float p_BuildMs)
+{
+	GLint l_Length = 0;
+	glGetProgramiv(p_Program, GL_PROGRAM_BINARY_LENGTH, &l_Length);
+	if (l_Length <= 0)
+		return;
+
+	std::vector<unsigned char> l_Binary(l_Length);
+	GLenum l_Format = 0;
+	glGetProgramBinary(p_Program, l_Length, &l_Length, &l_Format, &l_Binary[0]);
+	if (l_Length <= 0)
+		return;
+
+	ShaderCacheFileHeader l_Header;
+	l_Header.Magic = SHADER_CACHE_MAGIC;
+	l_Header.Format = l_Format;
+	l_Header.Length = (unsigned int)l_Length;
+	l_Header.BuildMs = p_BuildMs;
+	l_Header.Key = p_Key;
+
+	// A failed write only costs us the compile next time...
+	const std::string l_Path = CachePath(p_Key);
+	FILE* l_File = fopen(l_Path.c_str(), "wb");
+	if (!l_File)
+		return;
+	const bool l_Written = fwrite(&l_Header, sizeof(l_Header), 1, l_File) == 1 &&
+		fwrite(&l_Binary[0], 1, l_Header.Length, l_File) == l_Header.Length;
+	fclose(l_File);
+	if (!l_Written)
+		remove(l_Path.c_str());
+}
+
+static bool HasGLExtension(const char* p_Name)
+{
+	// Core profiles have no glGetString(GL_EXTENSIONS), which is what GLEW 1.x looks at...
+	GLint l_Count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &l_Count);
+	for (GLint i = 0; i < l_Count; i++)
+	{
+		const char* l_Extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+		if (l_Extension && strcmp(l_Extension, p_Name) == 0)
+			return true;
+	}
+	return false;
+}
+
+void InitializeShaderCache(const char* p_Directory)
+{
+	g_ShaderCache.Enabled = false;
+	g_ShaderCache.Directory = p_Directory ? p_Directory : "";
+	g_ShaderCache.Entries.clear();
+	g_ShaderCache.Pending = 0;
+	g_ShaderCache.Programs = 0;
+	g_ShaderCache.Hits = 0;
+	g_ShaderCache.Rejected = 0;
+	g_ShaderCache.BuildMs = 0.0;
+	g_ShaderCache.SavedMs = 0.0;
+
+	// Drivers with the extension compile on their own threads by default, we only need the status query...
+	g_ShaderCache.ParallelCompile = HasGLExtension("GL_KHR_parallel_shader_compile") || HasGLExtension("GL_ARB_parallel_shader_compile");
+
+	const char* l_Vendor = reinterpret_cast<const char*>(glGetString(GL_VENDOR));
+	const char* l_Renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+	const char* l_Version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+	g_ShaderCache.DriverKey = std::string(l_Vendor ? l_Vendor : "") + "|" + (l_Renderer ? l_Renderer : "") + "|" + (l_Version ? l_Version : "");
+
+	if (g_ShaderCache.Directory.empty())
+		return;
+
+	// Program binaries are core since 4.1, some drivers expose the entry points but no formats...
+	GLint l_Formats = 0;
+#if !defined(__APPLE__)
+	if (GLEW_ARB_get_program_binary)
+#endif
+	{
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &l_Formats);
+	}
+	if (l_Formats <= 0)
+	{
+		printf("No program binary formats, shader cache disabled.\n");
+		return;
+	}
+
+#if defined(_WIN32)
+	_mkdir(g_ShaderCache.Directory.c_str());
+#else
+	mkdir(g_ShaderCache.Directory.c_str(), 0755);
+#endif
+	g_ShaderCache.Enabled = true;
+}
+
+void ShutdownShaderCache(void)
+{
+	for (size_t i = 0; i < g_ShaderCache.Entries.size(); i++)
+	{
+		ShaderProgramEntry& l_Entry = g_ShaderCache.Entries[i];
+		if (l_Entry.State != ShaderProgram_Pending)
+			continue;
+		glDeleteShader(l_Entry.Shaders[0]);
+		glDeleteShader(l_Entry.Shaders[1]);
+		glDeleteProgram(l_Entry.Program);
+	}
+	g_ShaderCache.Entries.clear();
+	g_ShaderCache.Pending = 0;
+}
+
+unsigned int SubmitCachedProgram(const std::string& p_VertexShader, const std::string& p_FragmentShader, const std::string& p_Defines)
+{
+	const double l_SubmitTime = ovr_GetTimeInSeconds();
+	ShaderProgramEntry l_Entry;
+	l_Entry.BuildMs = 0.0;
+	l_Entry.Shaders[0] = 0;
+	l_Entry.Shaders[1] = 0;
+	++g_ShaderCache.Programs;
+
+	const std::string l_VertexShader = InsertDefines(p_VertexShader, p_Defines);
+	const std::string l_FragmentShader = InsertDefines(p_FragmentShader, p_Defines);
+
+	// The separators keep "ab" + "c" and "a" + "bc" apart...
+	l_Entry.Key = HashString(g_ShaderCache.DriverKey + "\x1f");
+	l_Entry.Key = HashString(p_Defines + "\x1f", l_Entry.Key);
+	l_Entry.Key = HashString(l_VertexShader + "\x1f", l_Entry.Key);
+	l_Entry.Key = HashString(l_FragmentShader, l_Entry.Key);
+
+	float l_RecordedBuildMs = 0.0f;
+	l_Entry.Program = g_ShaderCache.Enabled ? LoadCachedProgram(l_Entry.Key, l_RecordedBuildMs) : 0;
+	if (l_Entry.Program)
+	{
+		const double l_LoadMs = (ovr_GetTimeInSeconds() - l_SubmitTime) * 1000.0;
+		++g_ShaderCache.Hits;
+		g_ShaderCache.BuildMs += l_LoadMs;
+		g_ShaderCache.SavedMs += (double)l_RecordedBuildMs - l_LoadMs;
+		l_Entry.State = ShaderProgram_Ready;
+	}
+	else
+	{
+		// Only queue the work, nothing here asks the driver for a result...
+		std::vector<GLuint> l_Shaders;
+		l_Shaders.push_back(SubmitShader(GL_VERTEX_SHADER, l_VertexShader));
+		l_Shaders.push_back(SubmitShader(GL_FRAGMENT_SHADER, l_FragmentShader));
+		l_Entry.Program = SubmitProgram(l_Shaders, g_ShaderCache.Enabled);
+		l_Entry.Shaders[0] = l_Shaders[0];
+		l_Entry.Shaders[1] = l_Shaders[1];
+		l_Entry.State = ShaderProgram_Pending;
+		l_Entry.BuildMs = (ovr_GetTimeInSeconds() - l_SubmitTime) * 1000.0;
+		++g_ShaderCache.Pending;
+	}
+
+	g_ShaderCache.Entries.push_back(l_Entry);
+	return (unsigned int)g_ShaderCache.Entries.size() - 1;
+}
+
+// Collects the results of a submitted program (blocks if the driver isn't done yet). The build time
+// is what submitting and this took, the frames the program spent pending in between don't count...
+static void FinishCachedProgram(ShaderProgramEntry& p_Entry)
+{
+	const double l_FinishTime = ovr_GetTimeInSeconds();
+	CheckShader(p_Entry.Shaders[0], GL_VERTEX_SHADER);
+	CheckShader(p_Entry.Shaders[1], GL_FRAGMENT_SHADER);
+	const bool l_Linked = CheckProgram(p_Entry.Program);
+
+	for (int i = 0; i < 2; i++)
+	{
+		glDetachShader(p_Entry.Program, p_Entry.Shaders[i]);
+		glDeleteShader(p_Entry.Shaders[i]);
+		p_Entry.Shaders[i] = 0;
+	}
+
+	p_Entry.BuildMs += (ovr_GetTimeInSeconds() - l_FinishTime) * 1000.0;
+	if (l_Linked && g_ShaderCache.Enabled)
+	{
+		StoreCachedProgram(p_Entry.Key, p_Entry.Program, (float)p_Entry.BuildMs);
+	}
+
+	g_ShaderCache.BuildMs += p_Entry.BuildMs;
+	p_Entry.State = l_Linked ? ShaderProgram_Ready : ShaderProgram_Failed;
+	--g_ShaderCache.Pending;
+}
+
+GLuint GetCachedProgram(unsigned int p_Handle)
+{
+	if (p_Handle >= g_ShaderCache.Entries.size() || g_ShaderCache.Entries[p_Handle].State != ShaderProgram_Ready)
+		return 0;
+	return g_ShaderCache.Entries[p_Handle].Program;
+}
+
+unsigned int PollCachedPrograms(void)
+{
+	for (size_t i = 0; i < g_ShaderCache.Entries.size() && g_ShaderCache.Pending > 0; i++)
+	{
+		ShaderProgramEntry& l_Entry = g_ShaderCache.Entries[i];
+		if (l_Entry.State != ShaderProgram_Pending)
+			continue;
+
+		if (!g_ShaderCache.ParallelCompile)
+		{
+			// No way to ask without waiting, take the hit for one program this frame...
+			FinishCachedProgram(l_Entry);
+			break;
+		}
+
+		const double l_PollTime = ovr_GetTimeInSeconds();
+		GLint l_Completed = GL_FALSE;
+		glGetProgramiv(l_Entry.Program, GL_COMPLETION_STATUS_KHR, &l_Completed);
+		l_Entry.BuildMs += (ovr_GetTimeInSeconds() - l_PollTime) * 1000.0;
+		if (l_Completed)
+			FinishCachedProgram(l_Entry);
+	}
+	return g_ShaderCache.Pending;
+}
+
+GLuint WaitForCachedProgram(unsigned int p_Handle)
+{
+	if (p_Handle >= g_ShaderCache.Entries.size())
+		return 0;
+
+	ShaderProgramEntry& l_Entry = g_ShaderCache.Entries[p_Handle];
+	if (l_Entry.State == ShaderProgram_Pending)
+		FinishCachedProgram(l_Entry);
+	return GetCachedProgram(p_Handle);
+}
+
+void DiscardCachedProgram(unsigned int p_Handle, GLuint p_InUse)
+{
+	if (p_Handle >= g_ShaderCache.Entries.size())
+		return;
+
+	ShaderProgramEntry& l_Entry = g_ShaderCache.Entries[p_Handle];
+	if (l_Entry.Program == p_InUse)
+		return;
+
+	if (l_Entry.State == ShaderProgram_Pending)
+	{
+		glDeleteShader(l_Entry.Shaders[0]);
+		glDeleteShader(l_Entry.Shaders[1]);
+		l_Entry.Shaders[0] = 0;
+		l_Entry.Shaders[1] = 0;
+		--g_ShaderCache.Pending;
+	}
+	glDeleteProgram(l_Entry.Program);
+	l_Entry.Program = 0;
+	l_Entry.State = ShaderProgram_Failed;
+}
+
+GLuint CreateCachedProgram(const std::string& p_VertexShader, const std::string& p_FragmentShader, const std::string& p_Defines)
+{
+	const unsigned int l_Handle = SubmitCachedProgram(p_VertexShader, p_FragmentShader, p_Defines);
+	WaitForCachedProgram(l_Handle);
+
+	// Failed programs are handed out anyway, like CreateProgram does...
+	return g_ShaderCache.Entries[l_Handle].Program;
+}
+
+void PrintShaderCacheStats(void)
+{
+	if (!g_ShaderCache.Enabled)
+	{
+		printf("Shader cache: off, %u programs built in %.1f ms\n", g_ShaderCache.Programs, g_ShaderCache.BuildMs);
+		return;
+	}
+
+	printf("Shader cache: %u programs, %u from %s (%u rejected), built in %.1f ms, %.1f ms saved\n",
+		g_ShaderCache.Programs, g_ShaderCache.Hits, g_ShaderCache.Directory.c_str(), g_ShaderCache.Rejected,
+		g_ShaderCache.BuildMs, g_ShaderCache.SavedMs);
+}
@@ -0,0 +1,96 @@
+//
+//  ShaderCache.h
+//  OculusEdit
+//
+//  On-disk cache of linked shader programs (GL_ARB_get_program_binary). Programs are
+//  keyed by a hash of their sources, their defines and the GL vendor/renderer/version
+//  strings, so a driver update or any shader edit simply misses. A binary the driver
+//  rejects is deleted and the program is rebuilt from source. Each cache file also
+//  remembers how long the program took to build (the time spent in the compile, link
+//  and status calls, not the frames it was pending for), which is how the time a warm
+//  cache saves gets reported.
+//
+//  Misses are built asynchronously: SubmitCachedProgram only kicks off the compile and
+//  link, and PollCachedPrograms (once a frame) picks up the programs the driver is done
+//  with. With GL_KHR_parallel_shader_compile the driver compiles on its own threads
+//  and we never ask for a status before it's ready; without it one program is
+//  finished per frame so the wait is spread out.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#if !defined(__APPLE__)
+#  include <GL/glew.h>
+#else
+#  include <OpenGL/gl3.h>
+#endif
+
+enum ShaderProgramState
+{
+	ShaderProgram_Pending,
+	ShaderProgram_Ready,
+	ShaderProgram_Failed
+};
+
+struct ShaderProgramEntry
+{
+	GLuint Program;
+	GLuint Shaders[2];        // Vertex and fragment, 0 once the program is finished (or came from the cache).
+	ShaderProgramState State;
+	unsigned long long Key;
+	double BuildMs;           // Spent in the compile, link and status calls for it so far (not the frames in between).
+};
+
+struct ShaderCacheState
+{
+	bool Enabled;            // False without a directory or without binary formats.
+	bool ParallelCompile;    // GL_KHR_parallel_shader_compile is there.
+	std::string Directory;
+	std::string DriverKey;   // Vendor, renderer and version of the current GL.
+
+	std::vector<ShaderProgramEntry> Entries; // Indexed by the handles SubmitCachedProgram returns.
+	unsigned int Pending;
+
+	unsigned int Programs;   // Submitted so far...
+	unsigned int Hits;       // ... of which came from the cache.
+	unsigned int Rejected;   // Binaries the driver refused.
+	double BuildMs;          // Compiling and linking (or loading), summed over all programs.
+	double SavedMs;          // Recorded build time of the hits minus the time loading them.
+};
+
+extern ShaderCacheState g_ShaderCache;
+
+// Needs a current GL context. An empty p_Directory disables the cache (everything is compiled).
+void InitializeShaderCache(const char* p_Directory);
+
+// Deletes whatever is still being built. Finished programs belong to whoever asked for them.
+void ShutdownShaderCache(void);
+
+// Starts building a program, p_Defines (lines of "#define ...") are inserted right after the
+// #version line of both stages. Returns the handle for GetCachedProgram.
+unsigned int SubmitCachedProgram(const std::string& p_VertexShader, const std::string& p_FragmentShader, const std::string& p_Defines = "");
+
+// The linked program, or 0 while it is still being built (or if building it failed).
+GLuint GetCachedProgram(unsigned int p_Handle);
+
+// Call once a frame: finishes the programs the driver is done with. Returns how many are still pending.
+unsigned int PollCachedPrograms(void);
+
+// Finishes the program right away if it's still pending (blocks on the driver). Returns 0 if it failed.
+GLuint WaitForCachedProgram(unsigned int p_Handle);
+
+// For a program superseded by a newer submit before it was taken over: deletes it (stops building it
+// if it's still pending) unless it is p_InUse, the one the caller draws with. The handle gives 0 after.
+void DiscardCachedProgram(unsigned int p_Handle, GLuint p_InUse);
+
+// Submits and waits for the program, like CreateProgram(vertex, fragment).
+GLuint CreateCachedProgram(const std::string& p_VertexShader, const std::string& p_FragmentShader, const std::string& p_Defines = "");
+
+// One line summary of the counters above.
+void PrintShaderCacheStats(void);
+
+// 64 bit FNV-1a of p_String, chained onto p_Hash. Good enough to tell cache keys apart.
+unsigned long long HashString(const std::string& p_String, unsigned long long p_Hash = 14695981039346656037ull);
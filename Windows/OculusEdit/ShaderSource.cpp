@@ -0,0 +1,238 @@
+//
+//  ShaderSource.cpp
+//  OculusEdit
+//
+
+#include "ShaderSource.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <system_error>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#  include <poll.h>
+#  include <unistd.h>
+#  include <sys/inotify.h>
+#endif
+
+ShaderSourceState g_ShaderSources;
+
+static std::string FilePath(const std::string& p_FileName)
+{
+	return g_ShaderSources.Directory + "/" + p_FileName;
+}
+
+static bool ReadFile(const std::string& p_Path, std::string& p_Text)
+{
+	FILE* l_File = fopen(p_Path.c_str(), "rb");
+	if (!l_File)
+		return false;
+
+	p_Text.clear();
+	char l_Buffer[4096];
+	size_t l_Read;
+	while ((l_Read = fread(l_Buffer, 1, sizeof(l_Buffer), l_File)) > 0)
+		p_Text.append(l_Buffer, l_Read);
+	fclose(l_File);
+	return true;
+}
+
+static long long ModifiedTime(const std::string& p_Path)
+{
+	struct stat l_Stat;
+	if (stat(p_Path.c_str(), &l_Stat) != 0)
+		return -1;
+	return (long long)l_Stat.st_mtime;
+}
+
+// Watcher side: reads the file again and leaves it for UpdateShaderSources...
+static void FileChanged(size_t p_Index)
+{
+	std::string l_Text;
+	const std::string l_Path = FilePath(g_ShaderSources.Files[p_Index].FileName);
+	if (!ReadFile(l_Path, l_Text) || l_Text.empty())
+		return; // Editors can leave the file empty for a moment, the final write comes with its own event...
+
+	std::lock_guard<std::mutex> l_Guard(g_ShaderSources.Lock);
+	ShaderSourceFile& l_File = g_ShaderSources.Files[p_Index];
+	l_File.PendingSource = l_Text;
+	l_File.Pending = true;
+	g_ShaderSources.Changed.store(true, std::memory_order_release);
+}
+
+#if defined(__linux__)
+static void WatcherThread(void)
+{
+	const int l_Inotify = inotify_init1(IN_NONBLOCK);
+	// Watch the directory rather than the files, editors that save through a rename replace the file...
+	if (l_Inotify < 0 || inotify_add_watch(l_Inotify, g_ShaderSources.Directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		printf("Could not watch %s for shader edits.\n", g_ShaderSources.Directory.c_str());
+		if (l_Inotify >= 0)
+			close(l_Inotify);
+		return;
+	}
+
+	// Wake up every now and then to notice StopShaderWatcher...
+	char l_Buffer[4096];
+	while (g_ShaderSources.Running.load(std::memory_order_acquire))
+	{
+		pollfd l_Poll = { l_Inotify, POLLIN, 0 };
+		if (poll(&l_Poll, 1, 100) <= 0)
+			continue;
+
+		const ssize_t l_Length = read(l_Inotify, l_Buffer, sizeof(l_Buffer));
+		for (ssize_t l_Offset = 0; l_Offset < l_Length;)
+		{
+			const inotify_event* l_Event = (const inotify_event*)(l_Buffer + l_Offset);
+			l_Offset += sizeof(inotify_event) + l_Event->len;
+			if (l_Event->len == 0)
+				continue;
+
+			for (size_t i = 0; i < g_ShaderSources.Files.size(); i++)
+			{
+				if (g_ShaderSources.Files[i].FileName == l_Event->name)
+					FileChanged(i);
+			}
+		}
+	}
+
+	close(l_Inotify);
+}
+#else
+static void WatcherThread(void)
+{
+	// No inotify, look at the modification times a few times a second...
+	while (g_ShaderSources.Running.load(std::memory_order_acquire))
+	{
+		for (size_t i = 0; i < g_ShaderSources.Files.size(); i++)
+		{
+			const long long l_Time = ModifiedTime(FilePath(g_ShaderSources.Files[i].FileName));
+			{
+				std::lock_guard<std::mutex> l_Guard(g_ShaderSources.Lock);
+				if (l_Time < 0 || l_Time == g_ShaderSources.Files[i].ModifiedTime)
+					continue;
+				g_ShaderSources.Files[i].ModifiedTime = l_Time;
+			}
+			FileChanged(i);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+	}
+}
+#endif
+
+void InitializeShaderSources(const char* p_Directory)
+{
+	g_ShaderSources.Directory = p_Directory ? p_Directory : "";
+	g_ShaderSources.Files.clear();
+	g_ShaderSources.Running.store(false);
+	g_ShaderSources.Changed.store(false);
+	g_ShaderSources.Reloads = 0;
+}
+
+unsigned int RegisterShaderSource(const char* p_FileName, const std::string& p_BuiltIn)
+{
+	ShaderSourceFile l_File;
+	l_File.FileName = p_FileName;
+	l_File.Source = p_BuiltIn;
+	l_File.Pending = false;
+	l_File.ModifiedTime = -1;
+
+	if (!g_ShaderSources.Directory.empty())
+	{
+		const std::string l_Path = FilePath(l_File.FileName);
+		if (!ReadFile(l_Path, l_File.Source))
+		{
+			// First run with this directory: start out from the built-in source...
+			l_File.Source = p_BuiltIn;
+			FILE* l_Output = fopen(l_Path.c_str(), "wb");
+			if (l_Output)
+			{
+				fwrite(p_BuiltIn.data(), 1, p_BuiltIn.size(), l_Output);
+				fclose(l_Output);
+			}
+			else
+			{
+				printf("Could not write %s, using the built-in shader.\n", l_Path.c_str());
+			}
+		}
+		l_File.ModifiedTime = ModifiedTime(l_Path);
+	}
+
+	std::lock_guard<std::mutex> l_Guard(g_ShaderSources.Lock);
+	g_ShaderSources.Files.push_back(l_File);
+	return (unsigned int)g_ShaderSources.Files.size() - 1;
+}
+
+const std::string& GetShaderSource(unsigned int p_Id)
+{
+	return g_ShaderSources.Files[p_Id].Source;
+}
+
+void StartShaderWatcher(void)
+{
+	if (g_ShaderSources.Directory.empty() || g_ShaderSources.Running.load())
+		return;
+
+	g_ShaderSources.Running.store(true);
+	try
+	{
+		g_ShaderSources.Watcher = std::thread(WatcherThread);
+	}
+	catch (const std::system_error&)
+	{
+		printf("Could not start the shader watcher thread.\n");
+		g_ShaderSources.Running.store(false);
+		return;
+	}
+
+	// Same as the pose sampler, the error paths leave through exit()...
+	static bool l_AtExitRegistered = false;
+	if (!l_AtExitRegistered)
+	{
+		atexit(StopShaderWatcher);
+		l_AtExitRegistered = true;
+	}
+	printf("Watching %s for shader edits.\n", g_ShaderSources.Directory.c_str());
+}
+
+void StopShaderWatcher(void)
+{
+	if (!g_ShaderSources.Running.load())
+		return;
+
+	g_ShaderSources.Running.store(false, std::memory_order_release);
+	g_ShaderSources.Watcher.join();
+}
+
+bool UpdateShaderSources(void)
+{
+	if (!g_ShaderSources.Changed.load(std::memory_order_acquire))
+		return false;
+
+	std::lock_guard<std::mutex> l_Guard(g_ShaderSources.Lock);
+	g_ShaderSources.Changed.store(false, std::memory_order_relaxed);
+
+	bool l_Changed = false;
+	for (size_t i = 0; i < g_ShaderSources.Files.size(); i++)
+	{
+		ShaderSourceFile& l_File = g_ShaderSources.Files[i];
+		if (!l_File.Pending)
+			continue;
+		l_File.Pending = false;
+		if (l_File.PendingSource == l_File.Source)
+			continue; // Saved without changes...
+
+		l_File.Source.swap(l_File.PendingSource);
+		printf("Reloading %s\n", l_File.FileName.c_str());
+		l_Changed = true;
+	}
+
+	if (l_Changed)
+		++g_ShaderSources.Reloads;
+	return l_Changed;
+}
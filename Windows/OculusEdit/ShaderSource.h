@@ -0,0 +1,56 @@
+//
+//  ShaderSource.h
+//  OculusEdit
+//
+//  Shader sources by file name. Every source has a built-in copy; with a shader
+//  directory the files there take over (missing ones are written out from the
+//  built-in copy, so there is something to edit) and a watcher thread picks up
+//  edits: inotify on Linux, polling the modification times elsewhere. The watcher
+//  only reads the files, the new text is handed to the render thread at a frame
+//  boundary (UpdateShaderSources) which rebuilds the programs in the background and
+//  swaps them in once they link. A broken edit just keeps the old program around.
+//
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ShaderSourceFile
+{
+	std::string FileName;
+	std::string Source;         // What the programs are built from.
+	std::string PendingSource;  // Read by the watcher, not picked up yet (guarded by the lock).
+	bool Pending;
+	long long ModifiedTime;     // For the polling watcher (guarded by the lock).
+};
+
+struct ShaderSourceState
+{
+	std::string Directory;      // Empty: built-in sources only, nothing is watched.
+	std::vector<ShaderSourceFile> Files;
+	std::mutex Lock;
+	std::thread Watcher;
+	std::atomic<bool> Running;
+	std::atomic<bool> Changed;  // Some file has a pending source.
+	unsigned int Reloads;
+};
+
+extern ShaderSourceState g_ShaderSources;
+
+// p_Directory may be empty (or NULL) to just use the built-in sources.
+void InitializeShaderSources(const char* p_Directory);
+
+// Returns the id of p_FileName's source, loading it from the shader directory if there is one.
+unsigned int RegisterShaderSource(const char* p_FileName, const std::string& p_BuiltIn);
+const std::string& GetShaderSource(unsigned int p_Id);
+
+// Starts watching the files registered so far (does nothing without a directory). StopShaderWatcher joins the thread.
+void StartShaderWatcher(void);
+void StopShaderWatcher(void);
+
+// Call at a frame boundary on the render thread: takes over the edited sources. Returns true if any changed.
+bool UpdateShaderSources(void);
@@ -0,0 +1,201 @@
+//
+//  StereoReprojection.cpp
+//  OculusEdit
+//
+
+#include "StereoReprojection.h"
+
+#include <stdio.h>
+#include <string>
+
+#include "EyeRenderTarget.h"
+#include "Profiler.h"
+#include "SceneRenderer.h"
+#include "Shader.h"
+
+StereoReprojectionState g_StereoReprojection = { false, 5.0f };
+
+static GLuint l_Framebuffer = 0;        // The left eye gets copied in here...
+static GLuint l_ColorTexture = 0;
+static GLuint l_DepthTexture = 0;
+static GLuint l_Program = 0;            // ... and reprojected from here.
+static GLuint l_VertexArray = 0;
+static GLint l_LeftViewportUniform = -1;
+static GLint l_RightViewportUniform = -1;
+
+// A triangle over the whole viewport, from the vertex ID alone, halfway into the depth range so the
+// right eye's hidden area (at the near plane) rejects it. nearFar are the NDC depths of the near and
+// far planes: -1 and 1, or 1 and 0 with reverse-Z. The matrices between the eyes and the
+// search length are the same for every pixel, they're worked out here. The search length is how far
+// apart the left eye sees the split distance and the far plane, along the right eye's center ray
+// (at most 64 pixels, the disparity of the split is far below that unless it gets very close)...
+static const std::string l_VertexShader(
+	SHADER_GLSL_VERSION
+	EYE_UNIFORM_BLOCK_GLSL
+	"uniform vec4 leftViewport;\n"
+	"uniform vec2 nearFar;\n"
+	"flat out mat4 leftToRight;\n"
+	"flat out mat4 rightToLeft;\n"
+	"flat out int searchStep;\n"
+	"flat out int searchLength;\n"
+	"void main()\n"
+	"{\n"
+	"   vec2 position = vec2((gl_VertexID & 1) * 4.0 - 1.0, (gl_VertexID & 2) * 2.0 - 1.0);\n"
+	"   gl_Position = vec4(position, (nearFar.x + nearFar.y) * 0.5, 1.0);\n"
+	"   leftToRight = viewProjection[1] * inverse(viewProjection[0]);\n"
+	"   rightToLeft = viewProjection[0] * inverse(viewProjection[1]);\n"
+	"   vec4 splitLeft = rightToLeft * vec4(0.0, 0.0, nearFar.x, 1.0);\n"
+	"   vec4 farLeft = rightToLeft * vec4(0.0, 0.0, nearFar.y, 1.0);\n"
+	"   float disparity = (splitLeft.x / splitLeft.w - farLeft.x / farLeft.w) * 0.5 * leftViewport.z;\n"
+	"   searchStep = disparity < 0.0 ? -1 : 1;\n"
+	"   searchLength = min(int(ceil(abs(disparity))) + 1, 64);\n"
+	"}\n"
+	);
+
+// Every pixel of the right eye starts where the left eye sees its ray at the far plane and walks
+// towards the split distance. A left pixel matches when its depth reprojects it onto our pixel,
+// the closest match is what the right eye sees. The depths are turned into 0 at the near plane and 1 at
+// the far one whichever way the buffer has them. 0 is the left eye's hidden area, never a match...
+static const std::string l_FragmentShader(
+	SHADER_GLSL_VERSION
+	"uniform vec4 leftViewport;\n"
+	"uniform vec4 rightViewport;\n"
+	"uniform vec2 nearFar;\n"
+	"uniform sampler2D leftColor;\n"
+	"uniform sampler2D leftDepth;\n"
+	"flat in mat4 leftToRight;\n"
+	"flat in mat4 rightToLeft;\n"
+	"flat in int searchStep;\n"
+	"flat in int searchLength;\n"
+	"out vec4 outputColor;\n"
+	"void main()\n"
+	"{\n"
+	"   vec2 rightNdc = (gl_FragCoord.xy - rightViewport.xy) / rightViewport.zw * 2.0 - 1.0;\n"
+	"   vec4 start = rightToLeft * vec4(rightNdc, nearFar.y, 1.0);\n"
+	"   float nearDepth = nearFar.x > nearFar.y ? 1.0 : 0.0;\n"
+	"   vec2 startPixel = leftViewport.xy + (start.xy / start.w * 0.5 + 0.5) * leftViewport.zw;\n"
+	"   ivec2 low = ivec2(leftViewport.xy);\n"
+	"   ivec2 high = low + ivec2(leftViewport.zw) - 1;\n"
+	"   ivec2 texel = clamp(ivec2(floor(startPixel)), low, high);\n"
+	"   ivec2 match = texel;\n"
+	"   float matchDepth = 2.0;\n"
+	"   ivec2 background = texel;\n"
+	"   float backgroundDepth = -1.0;\n"
+	"   for (int i = 0; i <= searchLength; i++)\n"
+	"   {\n"
+	"      ivec2 candidate = ivec2(texel.x + searchStep * i, texel.y);\n"
+	"      if (candidate.x < low.x || candidate.x > high.x) break;\n"
+	"      float depth = abs(texelFetch(leftDepth, candidate, 0).r - nearDepth);\n"
+	"      if (depth <= 0.0) continue;\n"
+	"      if (depth > backgroundDepth)\n"
+	"      {\n"
+	"         backgroundDepth = depth;\n"
+	"         background = candidate;\n"
+	"      }\n"
+	"      vec2 leftNdc = (vec2(candidate) + 0.5 - leftViewport.xy) / leftViewport.zw * 2.0 - 1.0;\n"
+	"      vec4 right = leftToRight * vec4(leftNdc, mix(nearFar.x, nearFar.y, depth), 1.0);\n"
+	"      float x = rightViewport.x + (right.x / right.w * 0.5 + 0.5) * rightViewport.z;\n"
+	"      if (abs(x - gl_FragCoord.x) <= 0.5 && depth < matchDepth)\n"
+	"      {\n"
+	"         matchDepth = depth;\n"
+	"         match = candidate;\n"
+	"      }\n"
+	"   }\n"
+	"   outputColor = texelFetch(leftColor, matchDepth <= 1.0 ? match : background, 0);\n"
+	"}\n"
+	);
+
+void InitializeStereoReprojection(OVR::Sizei p_TargetSize, float p_SplitDistance, bool p_Enabled)
+{
+	g_StereoReprojection.Enabled = p_Enabled;
+	g_StereoReprojection.SplitDistance = p_SplitDistance;
+
+	// Same formats as the eye framebuffers, depth can only be copied between matching ones...
+	glGenTextures(1, &l_ColorTexture);
+	glBindTexture(GL_TEXTURE_2D, l_ColorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, p_TargetSize.w, p_TargetSize.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glGenTextures(1, &l_DepthTexture);
+	glBindTexture(GL_TEXTURE_2D, l_DepthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GetEyeDepthFormat(), p_TargetSize.w, p_TargetSize.h, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &l_Framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, l_Framebuffer);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, l_ColorTexture, 0);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, l_DepthTexture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("The stereo reprojection framebuffer is incomplete, stereo reprojection stays off.\n");
+		g_StereoReprojection.Enabled = false;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	l_Program = CreateProgram(l_VertexShader, l_FragmentShader);
+	BindEyeUniformBlock(l_Program);
+	l_LeftViewportUniform = glGetUniformLocation(l_Program, "leftViewport");
+	l_RightViewportUniform = glGetUniformLocation(l_Program, "rightViewport");
+	glUseProgram(l_Program);
+	glUniform1i(glGetUniformLocation(l_Program, "leftColor"), 0);
+	glUniform1i(glGetUniformLocation(l_Program, "leftDepth"), 1);
+	glUniform2f(glGetUniformLocation(l_Program, "nearFar"), g_EyeRenderTargets.ReverseZ ? 1.0f : -1.0f, g_EyeRenderTargets.ReverseZ ? 0.0f : 1.0f);
+	glUseProgram(0);
+	glGenVertexArrays(1, &l_VertexArray);
+
+	printf("Stereo reprojection: %s, split at %.1f m.\n", g_StereoReprojection.Enabled ? "on" : "off", p_SplitDistance);
+}
+
+void DestroyStereoReprojection(void)
+{
+	glDeleteProgram(l_Program);
+	glDeleteVertexArrays(1, &l_VertexArray);
+	glDeleteFramebuffers(1, &l_Framebuffer);
+	glDeleteTextures(1, &l_ColorTexture);
+	glDeleteTextures(1, &l_DepthTexture);
+	l_Program = 0;
+	l_VertexArray = 0;
+	l_Framebuffer = 0;
+	l_ColorTexture = l_DepthTexture = 0;
+	g_StereoReprojection.Enabled = false;
+}
+
+void ReprojectStereo(GLuint p_Framebuffer, const ovrRecti& p_LeftViewport, const ovrRecti& p_RightViewport)
+{
+	ProfileZone l_Zone("ReprojectStereo");
+
+	// The left eye's far layer, resolved if it's multisampled...
+	const GLint l_X0 = p_LeftViewport.Pos.x;
+	const GLint l_Y0 = p_LeftViewport.Pos.y;
+	const GLint l_X1 = p_LeftViewport.Pos.x + p_LeftViewport.Size.w;
+	const GLint l_Y1 = p_LeftViewport.Pos.y + p_LeftViewport.Size.h;
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, p_Framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, l_Framebuffer);
+	glBlitFramebuffer(l_X0, l_Y0, l_X1, l_Y1, l_X0, l_Y0, l_X1, l_Y1, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	// Every right eye pixel outside its hidden area gets written, nothing else changes...
+	glBindFramebuffer(GL_FRAMEBUFFER, p_Framebuffer);
+	glViewport(p_RightViewport.Pos.x, p_RightViewport.Pos.y, p_RightViewport.Size.w, p_RightViewport.Size.h);
+	glDepthMask(GL_FALSE);
+	glDisable(GL_BLEND);
+	glUseProgram(l_Program);
+	glUniform4f(l_LeftViewportUniform, (GLfloat)p_LeftViewport.Pos.x, (GLfloat)p_LeftViewport.Pos.y, (GLfloat)p_LeftViewport.Size.w, (GLfloat)p_LeftViewport.Size.h);
+	glUniform4f(l_RightViewportUniform, (GLfloat)p_RightViewport.Pos.x, (GLfloat)p_RightViewport.Pos.y, (GLfloat)p_RightViewport.Size.w, (GLfloat)p_RightViewport.Size.h);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, l_DepthTexture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, l_ColorTexture);
+	glBindVertexArray(l_VertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+	glEnable(GL_BLEND);
+	glDepthMask(GL_TRUE);
+}
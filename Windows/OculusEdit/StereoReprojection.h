@@ -0,0 +1,48 @@
+//
+//  StereoReprojection.h
+//  OculusEdit
+//
+//  Stereo reprojection. Past a few meters the two eyes see almost the same picture, the
+//  eye offsets only shift it by a handful of pixels. The scene is split in depth (see
+//  g_SceneDepthSplit in SceneRenderer.h): the far layer is rendered for the left eye only,
+//  then every pixel of the right eye looks for the left eye pixel that lands on it once
+//  reprojected with its depth. The search runs along the row over the disparity the
+//  split distance can cause, the closest match wins. Pixels nothing lands on were hidden
+//  from the left eye (disocclusions), they take the farthest surface of their search,
+//  the background around the hole. The near layer is then rendered for both eyes on top.
+//
+//  The left eye's color and depth are copied out of the eye framebuffer first (resolving
+//  them with MSAA). The right eye's hidden area mask still skips its pixels.
+//
+
+#pragma once
+
+#if !defined(__APPLE__)
+#  include <GL/glew.h>
+#else
+#  include <OpenGL/gl3.h>
+#endif
+
+#include "OVR.h"
+#include "OVR_CAPI.h"
+
+// Range of the split distance (meters):
+const float STEREO_REPROJECTION_MIN_SPLIT = 1.0f;
+const float STEREO_REPROJECTION_MAX_SPLIT = 50.0f;
+
+struct StereoReprojectionState
+{
+	bool Enabled;
+	float SplitDistance; // Everything behind it is rendered for the left eye only.
+};
+
+extern StereoReprojectionState g_StereoReprojection;
+
+// Needs a current GL context. p_TargetSize is the size of the eye render targets.
+void InitializeStereoReprojection(OVR::Sizei p_TargetSize, float p_SplitDistance, bool p_Enabled);
+void DestroyStereoReprojection(void);
+
+// Reprojects the left eye of p_Framebuffer (the eye render framebuffer, multisampled or not) into
+// p_RightViewport. The far depth layer's eye uniforms have to be bound (UseSceneDepthLayer), the
+// right eye's depth buffer has to be clear apart from its hidden area. Leaves p_Framebuffer bound.
+void ReprojectStereo(GLuint p_Framebuffer, const ovrRecti& p_LeftViewport, const ovrRecti& p_RightViewport);
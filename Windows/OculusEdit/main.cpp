@@ -1,935 +1,1529 @@
-﻿//
-//  main.cpp
-//  hello_opengl_oculus
-//
-//  Created by James Hagerman on 12/26/14.
-//  Copyright (c) 2014 James Hagerman. All rights reserved.
-//
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <vector>
-#include <algorithm>
-#include <string>
-
-#if !defined(__APPLE__)
-#include <GL/glew.h>
-#endif
-
-#if defined(__APPLE__)
-//#include <OpenGL/gl3.h>
-#endif
-
-#if defined(_WIN32)
-//#  include <Windows.h>
-//#  include <algorithm>
-// If you don't include these in the Visual Studio project configs. These need to go before OVR_CAPI.h:
-#pragma comment(lib, "winmm.lib")
-#pragma comment(lib, "Ws2_32.lib")
-#pragma comment(linker, "/SUBSYSTEM:windows /ENTRY:mainCRTStartup")
-#  define GLFW_EXPOSE_NATIVE_WIN32
-#  define GLFW_EXPOSE_NATIVE_WGL
-#elif defined(__APPLE__)
-#  define GLFW_INCLUDE_GLCOREARB
-#elif defined(__linux__)
-#  include <X11/X.h>
-#  include <X11/extensions/Xrandr.h>
-#  define GLFW_EXPOSE_NATIVE_X11
-#  define GLFW_EXPOSE_NATIVE_GLX
-#endif
-
-#include <GLFW/glfw3.h>
-#if !defined(__APPLE__)
-#  include <GLFW/glfw3native.h>
-#endif
-
-
-#include <glm/glm.hpp>
-
-#include "OVR.h"
-#include "OVR_CAPI.h"
-#include "OVR_CAPI_GL.h"
-//#include "Kernel\OVR_Math.h"
-//#include "Kernel\OVR_TYPES.h"
-
-using namespace OVR;
-
-// Requred variables:
-ovrHmd hmd;
-bool directHmdMode = true;
-ovrSizei resolution;
-ovrVector2i position;
-GLFWwindow* l_Window;
-GLFWmonitor* l_Monitor;
-ovrSizei l_ClientSize;
-
-
-// More variables taken from the single page OpenGL demo:
-int g_DistortionCaps = 0
-| ovrDistortionCap_Vignette
-| ovrDistortionCap_Chromatic
-| ovrDistortionCap_Overdrive
-| ovrDistortionCap_TimeWarp // Turning this on gives ghosting???
-;
-
-ovrGLConfig g_Cfg;
-ovrEyeRenderDesc g_EyeRenderDesc[2];
-ovrVector3f g_EyeOffsets[2];
-ovrPosef g_EyePoses[2];
-ovrTexture g_EyeTextures[2];
-OVR::Matrix4f g_ProjectionMatrici[2];
-OVR::Sizei g_RenderTargetSize;
-ovrVector3f g_CameraPosition;
-
-// The OpenGL Shader Program variables:
-GLuint theProgram; // The program itself
-GLuint positionBufferObject; // The position buffer object
-GLuint elapsedTimeUniform;
-GLuint loopDuration; // We will set this only once when the program is finished linking
-GLuint vao; // the vertex array
-
-// The shaders themselves:
-const std::string strVertexShader(
-	"#version 330\n"
-	"layout (location = 0) in vec4 position;\n"
-	"layout (location = 1) in vec4 color;\n"
-	"smooth out vec4 theColor;\n"
-	"uniform float loopDuration;\n"
-	"uniform float time;\n"
-	"void main()\n"
-	"{\n"
-	"   float timeScale = 3.14159f * 2.0f / loopDuration;\n"
-	"   float currTime = mod(time, loopDuration);\n"
-	"   vec4 totalOffset = vec4(cos(currTime * timeScale) * 0.5f, sin(currTime *timeScale) * 0.5f, 0.0, 0.0);\n"
-	"   gl_Position = position + totalOffset;\n"
-	"   theColor = color;\n"
-	"}\n"
-	);
-
-const std::string strFragmentShader(
-	"#version 330\n"
-	"smooth in vec4 theColor;\n"
-	"out vec4 outputColor;\n"
-	"void main()\n"
-	"{\n"
-	//"//   outputColor = vec4(1.0f, 1.0f, 1.0f, 1.0f);\n"
-	"   outputColor = theColor;\n"
-	"}\n"
-	);
-
-// Shader program builder functions:
-GLuint CreateShader(GLenum eShaderType, const std::string &strShaderFile)
-{
-	GLuint shader = glCreateShader(eShaderType);
-	const char *strFileData = strShaderFile.c_str();
-	glShaderSource(shader, 1, &strFileData, NULL);
-
-	glCompileShader(shader);
-
-	GLint status;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-	if (status == GL_FALSE)
-	{
-		GLint infoLogLength;
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogLength);
-
-		GLchar *strInfoLog = new GLchar[infoLogLength + 1];
-		glGetShaderInfoLog(shader, infoLogLength, NULL, strInfoLog);
-
-		const char *strShaderType = NULL;
-		switch (eShaderType)
-		{
-		case GL_VERTEX_SHADER: strShaderType = "vertex"; break;
-		case GL_GEOMETRY_SHADER: strShaderType = "geometry"; break;
-		case GL_FRAGMENT_SHADER: strShaderType = "fragment"; break;
-		}
-		printf("JDB: oops! shader compile issue...\n");
-		fprintf(stderr, "Compile failure in %s shader:\n%s\n", strShaderType, strInfoLog);
-		delete[] strInfoLog;
-	}
-
-	return shader;
-}
-
-GLuint CreateProgram(const std::vector<GLuint> &shaderList)
-{
-	GLuint program = glCreateProgram();
-
-	for (size_t iLoop = 0; iLoop < shaderList.size(); iLoop++)
-		glAttachShader(program, shaderList[iLoop]);
-
-	glLinkProgram(program);
-
-	GLint status;
-	glGetProgramiv(program, GL_LINK_STATUS, &status);
-	if (status == GL_FALSE)
-	{
-		GLint infoLogLength;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
-
-		GLchar *strInfoLog = new GLchar[infoLogLength + 1];
-		glGetProgramInfoLog(program, infoLogLength, NULL, strInfoLog);
-		printf("JDB: oops! shader program linker issue\n");
-		fprintf(stderr, "Linker failure: %s\n", strInfoLog);
-		delete[] strInfoLog;
-	}
-
-	for (size_t iLoop = 0; iLoop < shaderList.size(); iLoop++)
-		glDetachShader(program, shaderList[iLoop]);
-
-	return program;
-}
-
-void InitializeProgram()
-{
-	std::vector<GLuint> shaderList;
-
-	shaderList.push_back(CreateShader(GL_VERTEX_SHADER, strVertexShader));
-	shaderList.push_back(CreateShader(GL_FRAGMENT_SHADER, strFragmentShader));
-
-	theProgram = CreateProgram(shaderList);
-
-	std::for_each(shaderList.begin(), shaderList.end(), glDeleteShader);
-
-	
-}
-
-// Vertex array for use with shader program:
-const float vertexPositions[] = {
-	0.75f, 0.75f, 0.0f, 1.0f, 
-	0.75f, -0.75f, 0.0f, 1.0f, 
-	-0.75f, -0.75f, 0.0f, 1.0f, 
-	1.0f, 0.0f, 0.0f, 1.0f,
-	0.0f, 1.0f, 0.0f, 1.0f,
-	0.0f, 0.0f, 1.0f, 1.0f
-};
-
-// Old OpenGL Scene object:
-GLfloat l_VAPoints[] =
-{
-	0.5f, 0.5f, 0.5f,
-	-0.5f, 0.5f, 0.5f,
-	-0.5f, -0.5f, 0.5f,
-	0.5f, -0.5f, 0.5f,
-	-0.5f, -0.5f, -0.5f,
-	-0.5f, 0.5f, -0.5f,
-	0.5f, 0.5f, -0.5f,
-	0.5f, -0.5f, -0.5f,
-	0.5f, 0.5f, 0.5f,
-	0.5f, 0.5f, -0.5f,
-	-0.5f, 0.5f, -0.5f,
-	-0.5f, 0.5f, 0.5f,
-	-0.5f, -0.5f, -0.5f,
-	0.5f, -0.5f, -0.5f,
-	0.5f, -0.5f, 0.5f,
-	-0.5f, -0.5f, 0.5f,
-	0.5f, 0.5f, 0.5f,
-	0.5f, -0.5f, 0.5f,
-	0.5f, -0.5f, -0.5f,
-	0.5f, 0.5f, -0.5f,
-	-0.5f, -0.5f, -0.5f,
-	-0.5f, -0.5f, 0.5f,
-	-0.5f, 0.5f, 0.5f,
-	-0.5f, 0.5f, -0.5f
-};
-
-GLfloat l_VANormals[] =
-{
-	0.0f, 0.0f, 1.0f,
-	0.0f, 0.0f, 1.0f,
-	0.0f, 0.0f, 1.0f,
-	0.0f, 0.0f, 1.0f,
-	0.0f, 0.0f, -1.0f,
-	0.0f, 0.0f, -1.0f,
-	0.0f, 0.0f, -1.0f,
-	0.0f, 0.0f, -1.0f,
-	0.0f, 1.0f, 0.0f,
-	0.0f, 1.0f, 0.0f,
-	0.0f, 1.0f, 0.0f,
-	0.0f, 1.0f, 0.0f,
-	0.0f, -1.0f, 0.0f,
-	0.0f, -1.0f, 0.0f,
-	0.0f, -1.0f, 0.0f,
-	0.0f, -1.0f, 0.0f,
-	1.0f, 0.0f, 0.0f,
-	1.0f, 0.0f, 0.0f,
-	1.0f, 0.0f, 0.0f,
-	1.0f, 0.0f, 0.0f,
-	-1.0f, 0.0f, 0.0f,
-	-1.0f, 0.0f, 0.0f,
-	-1.0f, 0.0f, 0.0f,
-	-1.0f, 0.0f, 0.0f
-};
-
-GLuint l_VAIndici[] =
-{
-	0, 1, 2, 3,
-	4, 5, 6, 7,
-	8, 9, 10, 11,
-	12, 13, 14, 15,
-	16, 17, 18, 19,
-	20, 21, 22, 23
-};
-
-// Vertex array initializer functions:
-void InitializeVertexBuffer()
-{
-	// For use with the new shader version of this code
-	glGenBuffers(1, &positionBufferObject);
-
-	glBindBuffer(GL_ARRAY_BUFFER, positionBufferObject);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertexPositions), vertexPositions, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-}
-
-void RenderCubeVertexArrays(void)
-{
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glVertexPointer(3, GL_FLOAT, 0, l_VAPoints);
-
-	glEnableClientState(GL_NORMAL_ARRAY);
-	glNormalPointer(GL_FLOAT, 0, l_VANormals);
-
-	glDrawElements(GL_QUADS, 6 * 4, GL_UNSIGNED_INT, l_VAIndici);
-
-	glDisableClientState(GL_NORMAL_ARRAY);
-	glDisableClientState(GL_VERTEX_ARRAY);
-}
-
-static void SetStaticLightPositions(void)
-{
-	GLfloat l_Light0Position[] = { 3.0f, 4.0f, 2.0f, 0.0f };
-	glLightfv(GL_LIGHT0, GL_POSITION, l_Light0Position);
-
-	GLfloat l_Light1Position[] = { -3.0f, -4.0f, 2.0f, 0.0f };
-	glLightfv(GL_LIGHT1, GL_POSITION, l_Light1Position);
-}
-
-// Taken from the one page opengl demo:
-const bool l_MultiSampling = false;
-static void SetOpenGLState(void)
-{
-	// Some state...
-	//glEnable(GL_CULL_FACE); // Disable until out triangles are ordered correctly...
-	glEnable(GL_LIGHTING);
-	glDisable(GL_TEXTURE_2D);
-	glEnable(GL_DEPTH_TEST);
-	glShadeModel(GL_SMOOTH);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	if (l_MultiSampling) glEnable(GL_MULTISAMPLE); else glDisable(GL_MULTISAMPLE);
-	glClearColor(0.2f, 0.3f, 0.4f, 1.0f);
-
-	// Material...
-	GLfloat l_MaterialSpecular[] = { 0.3f, 0.3f, 0.3f, 1.0f };
-	GLfloat l_MaterialShininess[] = { 10.0f };
-	glMaterialfv(GL_FRONT, GL_SPECULAR, l_MaterialSpecular);
-	glMaterialfv(GL_FRONT, GL_SHININESS, l_MaterialShininess);
-
-	// Some (stationary) lights, position will be set every frame separately...
-	GLfloat l_Light0Diffuse[] = { 1.0f, 0.8f, 0.6f, 1.0f };
-	glLightfv(GL_LIGHT0, GL_DIFFUSE, l_Light0Diffuse);
-	glEnable(GL_LIGHT0);
-
-	GLfloat l_Light1Diffuse[] = { 0.6f, 0.8f, 1.0f, 1.0f };
-	glLightfv(GL_LIGHT1, GL_DIFFUSE, l_Light1Diffuse);
-	glEnable(GL_LIGHT1);
-}
-
-static void ErrorCallback(int p_Error, const char* p_Description)
-{
-	printf("ERROR: %d, %s\n", p_Error, p_Description);
-}
-
-void printGLContextInfo(GLFWwindow* pW)
-{
-	// Print some info about the OpenGL context...
-	const int l_Major = glfwGetWindowAttrib(pW, GLFW_CONTEXT_VERSION_MAJOR);
-	const int l_Minor = glfwGetWindowAttrib(pW, GLFW_CONTEXT_VERSION_MINOR);
-	const int l_Profile = glfwGetWindowAttrib(pW, GLFW_OPENGL_PROFILE);
-	if (l_Major >= 3) // Profiles introduced in OpenGL 3.0...
-	{
-		if (l_Profile == GLFW_OPENGL_COMPAT_PROFILE)
-		{
-			printf("GLFW_OPENGL_COMPAT_PROFILE\n");
-		}
-		else
-		{
-			printf("GLFW_OPENGL_CORE_PROFILE\n");
-		}
-	}
-	printf("OpenGL: %d.%d ", l_Major, l_Minor);
-	printf("Vendor: %s\n", reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
-	printf("Renderer: %s\n", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
-}
-
-static void WindowSizeCallback(GLFWwindow* p_Window, int p_Width, int p_Height)
-{
-	if (p_Width>0 && p_Height>0)
-	{
-		g_Cfg.OGL.Header.BackBufferSize.w = p_Width;
-		g_Cfg.OGL.Header.BackBufferSize.h = p_Height;
-
-		ovrBool l_ConfigureResult = ovrHmd_ConfigureRendering(hmd, &g_Cfg.Config, g_DistortionCaps, hmd->MaxEyeFov, g_EyeRenderDesc);
-		glUseProgram(0); // Avoid OpenGL state leak in ovrHmd_ConfigureRendering...
-		if (!l_ConfigureResult)
-		{
-			printf("Configure failed.\n");
-			exit(EXIT_FAILURE);
-		}
-	}
-}
-
-void keyboard(GLFWwindow* pWindow, int key, int codes, int action, int mods)
-{
-	(void)pWindow;
-	(void)codes;
-
-	if ((key > -1) && (key <= GLFW_KEY_LAST))
-	{
-		printf("key ac  %d %d\n", key, action);
-	}
-
-	if (action == GLFW_PRESS)
-	{
-		switch (key)
-		{
-		default:
-			ovrHmd_DismissHSWDisplay(hmd);
-			break;
-
-		case GLFW_KEY_ESCAPE:
-			glfwSetWindowShouldClose(pWindow, GL_TRUE);
-			//if (directHmdMode)
-			//{
-			//	// Clear the frame before calling all the destructors - even a few
-			//	// frames worth of frozen video is enough to cause discomfort!
-			//	///@note This does not seem to work in Direct mode.
-			//	//glClearColor(58.f / 255.f, 110.f / 255.f, 165.f / 255.f, 1.f); // Win7 default desktop color
-			//	//glClear(GL_COLOR_BUFFER_BIT);
-			//	//glfwSwapBuffers(g_pHMDWindow);
-			//	//glClear(GL_COLOR_BUFFER_BIT);
-			//	//glfwSwapBuffers(g_pHMDWindow);
-
-			//	//deallocateFBO(m_renderBuffer);
-			//	ovrHmd_Destroy(hmd);
-			//	ovr_Shutdown();
-
-			//	glfwDestroyWindow(l_Window);
-			//	glfwTerminate();
-			//	exit(0);
-			//}
-			//else
-			//{
-			//	//destroyAuxiliaryWindow(l_Window);
-			//	//glfwMakeContextCurrent(g_pHMDWindow);
-			//}
-
-			// Clean up FBO...
-
-
-			//ovrHmd_Destroy(hmd);
-			//ovr_Shutdown();
-
-			//glfwDestroyWindow(l_Window);
-			//glfwTerminate();
-			//exit(EXIT_SUCCESS);
-			break;
-		case GLFW_KEY_R:
-			ovrHmd_RecenterPose(hmd);
-			break;
-		case GLFW_KEY_UP:
-			g_CameraPosition.z += 0.1f;
-			break;
-		case GLFW_KEY_DOWN:
-			g_CameraPosition.z -= 0.1f;
-			break;
-		case GLFW_KEY_LEFT:
-			g_CameraPosition.x += 0.1f;
-			break;
-		case GLFW_KEY_RIGHT:
-			g_CameraPosition.x -= 0.1f;
-			break;
-		}
-
-	}
-}
-
-
-int main(int argc, const char * argv[]) {
-	printf("hello world\n");
-
-	// Setup GLFW Window:
-	l_Window = NULL;
-	glfwSetErrorCallback(ErrorCallback);
-	if (!glfwInit())
-	{
-		exit(EXIT_FAILURE);
-	}
-
-//#define USE_CORE_CONTEXT
-#ifdef USE_CORE_CONTEXT	
-#if defined(_MACOS)
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-#else
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
-#endif
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE); // Use the new OpenGL
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // Make OS X Happy. Shouldn't need this... I guess?
-#endif
-
-	glfwWindowHint(GLFW_SAMPLES, 4); // Use 4x antialiasing
-
-	// Init HMD:
-	ovr_Initialize();
-	hmd = ovrHmd_Create(0);
-	if (hmd) { // Get more details about the HMD.
-
-		// Set size and position of the window:
-		//const ovrSizei sz = g_app.getHmdResolution();
-		//const ovrVector2i pos = g_app.getHmdWindowPos();
-		resolution = hmd->Resolution;
-		position = hmd->WindowsPos;
-		printf("Resolution: %i, %i\n", resolution.h, resolution.w);
-
-		// Check to see if we're using direct HMD mode or not:
-		///@todo Why does ovrHmd_GetEnabledCaps always return 0 when querying the caps
-		/// through the field in ovrHmd appears to work correctly?
-		//const unsigned int caps = ovrHmd_GetEnabledCaps(m_Hmd);
-		const unsigned int caps = hmd->HmdCaps;
-		if ((caps & ovrHmdCap_ExtendDesktop) != 0)
-		{
-			directHmdMode = false;
-		}
-	} // Do something with the HMD. ....
-	else {
-		printf("No Oculus Rift device attached, using virtual version...\n");
-		hmd = ovrHmd_CreateDebug(ovrHmd_DK2);
-	}
-
-	if (directHmdMode)
-	{
-		printf("Using Direct to Rift mode...\n");
-		//LOG_INFO("Using Direct to Rift mode...\n");
-		const GLFWmonitor* pPrimary = glfwGetPrimaryMonitor();
-		int monitorCount = 0;
-		GLFWmonitor** ppMonitors = glfwGetMonitors(&monitorCount);
-		for (int i = 0; i<monitorCount; ++i)
-		{
-			l_Monitor = ppMonitors[i];
-			if (l_Monitor == pPrimary)
-				continue;
-			//const GLFWvidmode* mode = glfwGetVideoMode(l_Monitor);
-		}
-
-		l_ClientSize.w = hmd->Resolution.w; // Something reasonable, smaller, but maintain aspect ratio...
-		l_ClientSize.h = hmd->Resolution.h; // Something reasonable, smaller, but maintain aspect ratio...
-	}
-	else
-	{
-		int l_Count;
-		GLFWmonitor** l_Monitors = glfwGetMonitors(&l_Count);
-		switch (l_Count)
-		{
-		case 0:
-			printf("No monitors found, exiting...\n");
-			exit(EXIT_FAILURE);
-			break;
-		case 1:
-			printf("Two monitors expected, found only one, using primary...\n");
-			l_Monitor = glfwGetPrimaryMonitor();
-			break;
-		case 2:
-			printf("Two monitors found, using second monitor...\n");
-			l_Monitor = l_Monitors[1];
-			break;
-		default:
-			printf("More than two monitors found, using second monitor...\n");
-			l_Monitor = l_Monitors[1];
-		}
-
-		printf("Using Extended Desktop mode...\n");
-		l_ClientSize.w = hmd->Resolution.w;
-		l_ClientSize.h = hmd->Resolution.h;
-	}
-
-#if defined(__APPLE__)
-	// Full screen is needed for OS X...
-	l_Window = glfwCreateWindow(l_ClientSize.w, l_ClientSize.h, "GLFW Oculus Rift Test", l_Monitor, NULL);
-#else
-	// ... but it doesn't play well with direct mode in Windows 
-	l_Window = glfwCreateWindow(l_ClientSize.w, l_ClientSize.h, "GLFW Oculus Rift Test", NULL, NULL);
-#endif
-	glfwWindowHint(GLFW_DECORATED, 0);
-
-
-	// Attach the window in "Direct Mode"...
-#if defined(_WIN32)
-	if (directHmdMode)
-	{
-		ovrBool l_AttachResult = ovrHmd_AttachToWindow(hmd, glfwGetWin32Window(l_Window), NULL, NULL);
-		if (!l_AttachResult)
-		{
-			printf("Could not attach to window...");
-			exit(EXIT_FAILURE);
-		}
-	}
-#endif
-
-	glfwSetWindowPos(l_Window, position.x, position.y);
-	//g_renderMode.outputType = RenderingMode::OVR_SDK; // Left over from riftskeleton...
-
-	if (!l_Window)
-	{
-		printf("Failure!\n");
-		glfwTerminate();
-		exit(EXIT_FAILURE);
-	}
-
-	glfwMakeContextCurrent(l_Window);
-
-
-#if !defined(__APPLE__)
-	// Don't forget to initialize Glew, turn glewExperimental on to
-	// avoid problems fetching function pointers...
-	glewExperimental = GL_TRUE;
-	const GLenum l_Result = glewInit();
-	if (l_Result != GLEW_OK)
-	{
-		printf("glewInit() error.\n");
-		glfwTerminate();
-		exit(EXIT_FAILURE);
-	}
-#endif
-
-	printGLContextInfo(l_Window);
-
-	//=================
-	// Finish setting up the framebuffers and the OpenGL scene:
-	// (Taken from the single page opengl demo:	
-
-	// Create some lights, materials, etc...
-	SetOpenGLState();
-
-	// Calculate the dimenstions of the Render Texture based on the field of view of each eye:
-	// Find out what the texture sizes should be for each eye separately first...
-	ovrSizei l_EyeTextureSizes[2];
-	l_EyeTextureSizes[ovrEye_Left] = ovrHmd_GetFovTextureSize(hmd, ovrEye_Left, hmd->MaxEyeFov[ovrEye_Left], 1.0f);
-	l_EyeTextureSizes[ovrEye_Right] = ovrHmd_GetFovTextureSize(hmd, ovrEye_Right, hmd->MaxEyeFov[ovrEye_Right], 1.0f);
-	// Combine the dimensions for both eyes so we can use a single texture for the full display...
-	g_RenderTargetSize.w = l_EyeTextureSizes[ovrEye_Left].w + l_EyeTextureSizes[ovrEye_Right].w;
-	g_RenderTargetSize.h = (l_EyeTextureSizes[ovrEye_Left].h>l_EyeTextureSizes[ovrEye_Right].h ? l_EyeTextureSizes[ovrEye_Left].h : l_EyeTextureSizes[ovrEye_Right].h);
-
-
-	//===========================
-	// Configure our custom framebuffer that LibOVR will use to display our content:
-	//
-	// Create the FBO being a single one for both eyes (using one texture for both is open for debate)...
-	// Because we are binding this buffer to the GL_FRAMEBUFFER OpenGL target, it will be used for 
-	// both drawing and reading functions. This replaces the default OpenGL framebuffer and allows
-	// us (and LibOVR) to control the rendering pipeline specifically instead of just writing to
-	// the screen itself. LibOVR needs to read this framebuffer to be able to warp it during rendering.
-	GLuint l_FBOId;
-	glGenFramebuffers(1, &l_FBOId);
-	glBindFramebuffer(GL_FRAMEBUFFER, l_FBOId);
-
-	// Create the texture we're going to render to...
-	GLuint l_TextureId;
-	glGenTextures(1, &l_TextureId);
-	// "Bind" the newly created texture : all future texture functions will modify this texture...
-	glBindTexture(GL_TEXTURE_2D, l_TextureId);
-	// Give an empty image to OpenGL (the last "0")
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, g_RenderTargetSize.w, g_RenderTargetSize.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
-	// Linear filtering...
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-	// Create Depth Buffer (Depth Buffers are just special types of RenderBuffers)...
-	GLuint l_DepthBufferId;
-	glGenRenderbuffers(1, &l_DepthBufferId);
-	glBindRenderbuffer(GL_RENDERBUFFER, l_DepthBufferId);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, g_RenderTargetSize.w, g_RenderTargetSize.h);
-	// Bind the depth buffer (Z buffer) to our custom framebuffer (l_FBOId):
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, l_DepthBufferId);
-	// Set the texture as our colour attachment #0...
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, l_TextureId, 0);
-
-	// Set the list of draw buffers...
-	GLenum l_GLDrawBuffers[1] = { GL_COLOR_ATTACHMENT0 };
-	glDrawBuffers(1, l_GLDrawBuffers); // "1" is the size of DrawBuffers
-
-	// Check if everything is OK...
-	GLenum l_Check = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
-	if (l_Check != GL_FRAMEBUFFER_COMPLETE)
-	{
-		printf("There is a problem with the FBO.\n");
-		exit(EXIT_FAILURE);
-	}
-
-	// Initialize the shader program we will use to render the scene:
-	InitializeProgram();
-	// Initialize the vertex buffer for use with the shader:
-	InitializeVertexBuffer();
-
-
-	// Initialize the vertex attribute array
-	// All of the settings we configure for the shader program will be stored in the Vertex attribute array object
-	// so that we won't have to bind all of this crap for every new object we want to render:
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	// Get the memory location of the offset uniform. Do NOT set "default uniform values" here. It breaks things.
-	// I think this could be moved into InitializeProgram()... but I'm not sure how to organize all of this quite 
-	// yet due to the use of the VAO. It could probably be moved anywhere after the program is linked, and before
-	// any rendering is done.
-	elapsedTimeUniform = glGetUniformLocation(theProgram, "time");
-	GLuint loopDurationUnf = glGetUniformLocation(theProgram, "loopDuration");
-	glUseProgram(theProgram);
-	glUniform1f(loopDurationUnf, 5.0f);
-	glUseProgram(0);
-
-	// Bind our objects vertex buffer to opengl:
-	// (I'm not sure why we have to bind this if we're using VAO's but maybe I'll see why later...?)
-	glBindBuffer(GL_ARRAY_BUFFER, positionBufferObject);
-	// Tell OpenGL to use the first two shader attibutes:
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	// Tell OpenGL where in the vertex buffer to get the data for each attribute:
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, (void*)48);
-
-
-	// Unbind all of that and get on with it...
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	// End OpenGL Framebuffer configuration
-	//=====================================
-
-
-	// Set configurations for each eye:
-	// This includes the eye's dedicated texture size and the eyes location in the main texture buffer.
-	// These values will be passed to LibOVR so that the library knows how to render each eye:
-	// Left eye...
-	g_EyeTextures[ovrEye_Left].Header.API = ovrRenderAPI_OpenGL;
-	g_EyeTextures[ovrEye_Left].Header.TextureSize = g_RenderTargetSize;
-	g_EyeTextures[ovrEye_Left].Header.RenderViewport.Pos.x = 0;
-	g_EyeTextures[ovrEye_Left].Header.RenderViewport.Pos.y = 0;
-	g_EyeTextures[ovrEye_Left].Header.RenderViewport.Size = l_EyeTextureSizes[ovrEye_Left];
-	((ovrGLTexture&)(g_EyeTextures[ovrEye_Left])).OGL.TexId = l_TextureId;
-	// Right eye (mostly the same as left but with the viewport on the right side of the texture)...
-	g_EyeTextures[ovrEye_Right] = g_EyeTextures[ovrEye_Left];
-	g_EyeTextures[ovrEye_Right].Header.RenderViewport.Pos.x = (g_RenderTargetSize.w + 1) / 2;
-	g_EyeTextures[ovrEye_Right].Header.RenderViewport.Pos.y = 0;
-
-	// Oculus Rift main texture buffer size configurations...
-	g_Cfg.OGL.Header.API = ovrRenderAPI_OpenGL;
-	//g_Cfg.OGL.Header.BackBufferSize.w = l_ClientSize.w;
-	//g_Cfg.OGL.Header.BackBufferSize.h = l_ClientSize.h;
-	g_Cfg.OGL.Header.BackBufferSize = Sizei(l_ClientSize.w, l_ClientSize.h);
-	g_Cfg.OGL.Header.Multisample = (l_MultiSampling ? 1 : 0);
-#if defined(_WIN32)
-	g_Cfg.OGL.Window = glfwGetWin32Window(l_Window);
-	g_Cfg.OGL.DC = GetDC(g_Cfg.OGL.Window);
-#elif defined(__linux__)
-	//l_Cfg.OGL.Win = glfwGetX11Window(l_Window);
-	//l_Cfg.OGL.Disp = glfwGetX11Display();
-#endif
-
-	// Enable capabilities...
-	ovrHmd_SetEnabledCaps(hmd, ovrHmdCap_LowPersistence | ovrHmdCap_DynamicPrediction);
-
-	// Actually configure Oculus LibOVR rendering using the configurations we set up above (and stored in g_Cfg.OGL):
-	ovrBool l_ConfigureResult = ovrHmd_ConfigureRendering(hmd, &g_Cfg.Config, g_DistortionCaps, hmd->MaxEyeFov, g_EyeRenderDesc);
-	glUseProgram(0); // Avoid OpenGL state leak in ovrHmd_ConfigureRendering...
-	if (!l_ConfigureResult)
-	{
-		printf("Configure failed.\n");
-		exit(EXIT_FAILURE);
-	}
-
-
-	// Projection matrici for each eye will not change at runtime, we can set them here...
-	g_ProjectionMatrici[ovrEye_Left] = ovrMatrix4f_Projection(g_EyeRenderDesc[ovrEye_Left].Fov, 0.3f, 100.0f, true);
-	g_ProjectionMatrici[ovrEye_Right] = ovrMatrix4f_Projection(g_EyeRenderDesc[ovrEye_Right].Fov, 0.3f, 100.0f, true);
-
-	// IPD offset values will not change at runtime, we can set them here...
-	g_EyeOffsets[ovrEye_Left] = g_EyeRenderDesc[ovrEye_Left].HmdToEyeViewOffset;
-	g_EyeOffsets[ovrEye_Right] = g_EyeRenderDesc[ovrEye_Right].HmdToEyeViewOffset;
-
-	// Initial camera position...
-	g_CameraPosition.x = 0.0f;
-	g_CameraPosition.y = 0.0f;
-	g_CameraPosition.z = -2.0f;
-
-
-	// Start the sensor which provides the Rift's pose and motion.
-	ovrBool l_TrackingResult = ovrHmd_ConfigureTracking(hmd, ovrTrackingCap_Orientation |
-		ovrTrackingCap_MagYawCorrection |
-		ovrTrackingCap_Position, 0);
-	if (!l_TrackingResult)
-	{
-		printf("Could not start tracking...");
-		exit(EXIT_FAILURE);
-	}
-
-	// Setup GLFW Callbacks:
-	glfwSetWindowSizeCallback(l_Window, WindowSizeCallback);
-	//glfwSetMouseButtonCallback(l_Window, mouseDown);
-	//glfwSetCursorPosCallback(l_Window, mouseMove);
-	//glfwSetScrollCallback(l_Window, mouseWheel);
-	glfwSetKeyCallback(l_Window, keyboard);
-
-
-	// Do a single recenter to calibrate orientation to current state of the Rift...
-	ovrHmd_RecenterPose(hmd);
-
-
-	//=====================
-	// Scene variables:
-	GLfloat l_SpinX;
-	GLfloat l_SpinY;
-	const bool l_Spin = false;
-
-	// Head tracking:
-	float yaw;
-	float eyePitch;
-	float eyeRoll;
-
-	// Begin draw loop:
-	unsigned int l_FrameIndex = 0;
-	while (!glfwWindowShouldClose(l_Window)) {
-
-		// Begin the frame...
-		ovrHmd_BeginFrame(hmd, l_FrameIndex);
-
-		// Get eye poses for both the left and the right eye. g_EyePoses contains all Rift information: orientation, positional tracking and
-		// the IPD in the form of the input variable g_EyeOffsets.
-		ovrHmd_GetEyePoses(hmd, l_FrameIndex, g_EyeOffsets, g_EyePoses, NULL);
-
-		// Bind our custom FBO (instead of using the default OpenGL framebuffer)...
-		glBindFramebuffer(GL_FRAMEBUFFER, l_FBOId);
-
-		// Clear...
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		for (int l_EyeIndex = 0; l_EyeIndex<ovrEye_Count; l_EyeIndex++)
-		{
-			ovrEyeType l_Eye = hmd->EyeRenderOrder[l_EyeIndex];
-
-			glViewport(
-				g_EyeTextures[l_Eye].Header.RenderViewport.Pos.x,
-				g_EyeTextures[l_Eye].Header.RenderViewport.Pos.y,
-				g_EyeTextures[l_Eye].Header.RenderViewport.Size.w,
-				g_EyeTextures[l_Eye].Header.RenderViewport.Size.h
-				);
-
-			// Pass projection matrix on to OpenGL...
-			glMatrixMode(GL_PROJECTION);
-			glLoadIdentity();
-			glMultMatrixf(&(g_ProjectionMatrici[l_Eye].Transposed().M[0][0]));
-
-			// Create the model-view matrix and pass on to OpenGL...
-			glMatrixMode(GL_MODELVIEW);
-			glLoadIdentity();
-
-			// Multiply with orientation retrieved from sensor...
-			OVR::Quatf l_Orientation = OVR::Quatf(g_EyePoses[l_Eye].Orientation);
-			OVR::Matrix4f l_ModelViewMatrix = OVR::Matrix4f(l_Orientation.Inverted());
-			glMultMatrixf(&(l_ModelViewMatrix.Transposed().M[0][0]));
-
-			// Translation due to positional tracking (DK2) and IPD...
-			glTranslatef(-g_EyePoses[l_Eye].Position.x, -g_EyePoses[l_Eye].Position.y, -g_EyePoses[l_Eye].Position.z);
-
-			// Move the world forward a bit to show the scene in front of us...
-			glTranslatef(g_CameraPosition.x, g_CameraPosition.y, g_CameraPosition.z);
-
-			// (Re)set the light positions so they don't move along with the cube...
-			SetStaticLightPositions();
-
-			// Make the cube spin...
-			if (l_Spin)
-			{
-				l_SpinX = (GLfloat)fmod(glfwGetTime()*17.0, 360.0);
-				l_SpinY = (GLfloat)fmod(glfwGetTime()*23.0, 360.0);
-			}
-			else
-			{
-				l_SpinX = 30.0f;
-				l_SpinY = 40.0f;
-			}
-			glRotatef(l_SpinX, 1.0f, 0.0f, 0.0f);
-			glRotatef(l_SpinY, 0.0f, 1.0f, 0.0f);
-
-			// Use old render functions to draw a cube...
-			// RenderCubeFixedFunction();
-			//RenderCubeVertexArrays();
-
-			// Use shader program to render instead:
-
-			glUseProgram(theProgram);
-			glBindVertexArray(vao);
-
-			glUniform1f(elapsedTimeUniform, (float)glfwGetTime());
-
-			//glBindBuffer(GL_ARRAY_BUFFER, positionBufferObject);
-			//glEnableVertexAttribArray(0);
-			//glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
-
-			glDrawArrays(GL_TRIANGLES, 0, 3);
-
-			//glDisableVertexAttribArray(0);
-			glBindVertexArray(0);
-			glUseProgram(0);
-
-			
-		}
-
-		// Query the HMD for the current tracking state.
-		ovrTrackingState ts = ovrHmd_GetTrackingState(hmd, ovr_GetTimeInSeconds());
-		if (ts.StatusFlags & (ovrStatus_OrientationTracked | ovrStatus_PositionTracked))
-		{
-			ovrPosef pose = ts.HeadPose.ThePose;
-			//printf("Pos: %f, %f, %f\t", pose.Position.x, pose.Position.y, pose.Position.z);
-
-			ovrQuatf ori = pose.Orientation;
-			Quatf OculusRiftOrientation = ori;
-			OculusRiftOrientation.GetEulerAngles<OVR::Axis_X, OVR::Axis_Y, OVR::Axis_Z>(&yaw, &eyePitch, &eyeRoll);
-			//printf("Ori: %f, %f, %f\n", yaw, eyePitch, eyeRoll);
-		}
-		else {
-			//printf("No tracking yet...\n");
-		}
-
-		// Back to the default framebuffer...
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-		// Do everything, distortion, front/back buffer swap...
-		ovrHmd_EndFrame(hmd, g_EyePoses, g_EyeTextures);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // Avoid OpenGL state leak in ovrHmd_EndFrame...
-		glBindBuffer(GL_ARRAY_BUFFER, 0); // Avoid OpenGL state leak in ovrHmd_EndFrame...
-
-		++l_FrameIndex;
-
-		glfwPollEvents();
-
-	}// End head tracking.
-
-
-	glDeleteRenderbuffers(1, &l_DepthBufferId);
-	glDeleteTextures(1, &l_TextureId);
-	glDeleteFramebuffers(1, &l_FBOId);
-
-	ovrHmd_Destroy(hmd);
-	ovr_Shutdown();
-
-	// Clean up window...
-	glfwDestroyWindow(l_Window);
-	glfwTerminate();
-
-	exit(EXIT_SUCCESS);
-
+//
+//  main.cpp
+//  hello_opengl_oculus
+//
+//  Created by James Hagerman on 12/26/14.
+//  Copyright (c) 2014 James Hagerman. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <string>
+
+#if !defined(__APPLE__)
+#include <GL/glew.h>
+#endif
+
+#if defined(__APPLE__)
+//#include <OpenGL/gl3.h>
+#endif
+
+#if defined(_WIN32)
+//#  include <Windows.h>
+//#  include <algorithm>
+// If you don't include these in the Visual Studio project configs. These need to go before OVR_CAPI.h:
+#pragma comment(lib, "winmm.lib")
+#pragma comment(lib, "Ws2_32.lib")
+#pragma comment(linker, "/SUBSYSTEM:windows /ENTRY:mainCRTStartup")
+#  define GLFW_EXPOSE_NATIVE_WIN32
+#  define GLFW_EXPOSE_NATIVE_WGL
+#elif defined(__APPLE__)
+#  define GLFW_INCLUDE_GLCOREARB
+#elif defined(__linux__)
+#  include <X11/X.h>
+#  include <X11/extensions/Xrandr.h>
+#  define GLFW_EXPOSE_NATIVE_X11
+#  define GLFW_EXPOSE_NATIVE_GLX
+#endif
+
+#include <GLFW/glfw3.h>
+#if !defined(__APPLE__)
+#  include <GLFW/glfw3native.h>
+#endif
+
+
+#include <glm/glm.hpp>
+
+#include "OVR.h"
+#include "OVR_CAPI.h"
+#include "OVR_CAPI_GL.h"
+#include "Benchmark.h"
+#include "HeadlessContext.h"
+#include "Profiler.h"
+#include "Mesh.h"
+#include "Scene.h"
+#include "SceneCulling.h"
+#include "Shader.h"
+#include "SceneOcclusion.h"
+#include "SceneRenderer.h"
+#include "SceneShadows.h"
+#include "PoseSampler.h"
+#include "DynamicResolution.h"
+#include "EyeRenderTarget.h"
+#include "ShaderCache.h"
+#include "ShaderSource.h"
+#include "HiddenArea.h"
+#include "ClientDistortion.h"
+#include "MultiResolution.h"
+#include "StereoReprojection.h"
+//#include "Kernel\OVR_Math.h"
+//#include "Kernel\OVR_TYPES.h"
+
+using namespace OVR;
+
+// Requred variables:
+ovrHmd hmd;
+bool directHmdMode = true;
+ovrSizei resolution;
+ovrVector2i position;
+GLFWwindow* l_Window;
+GLFWmonitor* l_Monitor;
+ovrSizei l_ClientSize;
+
+
+// More variables taken from the single page OpenGL demo:
+int g_DistortionCaps = 0
+| ovrDistortionCap_Vignette
+| ovrDistortionCap_Chromatic
+| ovrDistortionCap_Overdrive
+| ovrDistortionCap_TimeWarp // Turning this on gives ghosting???
+;
+
+ovrGLConfig g_Cfg;
+ovrEyeRenderDesc g_EyeRenderDesc[2];
+ovrVector3f g_EyeOffsets[2];
+ovrPosef g_EyePoses[2];
+ovrTexture g_EyeTextures[2];
+OVR::Matrix4f g_ProjectionMatrici[2];
+const float g_ZNear = 0.3f; // Depth range of the projection matrici (the far plane is --far)...
+float g_ZFar = 100.0f;
+OVR::Sizei g_RenderTargetSize;
+ovrSizei g_MaxEyeViewportSizes[2]; // Eye viewports at DYNAMIC_RESOLUTION_MAX_DENSITY, the eye texture fits these.
+ovrVector3f g_CameraPosition;
+
+// The OpenGL Shader Program variables:
+GLuint theProgram; // The program itself (0 until the shader cache finished building it)
+unsigned int theProgramHandle; // What the shader cache knows it by
+unsigned int theVertexSource; // triangle.vert and triangle.frag in the shader sources
+unsigned int theFragmentSource;
+GLuint positionBufferObject; // The position buffer object
+GLuint elapsedTimeUniform;
+GLuint vao; // the vertex array
+
+// The shaders themselves:
+// (LOOP_DURATION comes from strShaderDefines, it's baked into the program instead of being a uniform.
+// REVERSE_Z moves the GL style depth over to reverse-Z's, see EyeRenderTarget.h.)
+const std::string strVertexShader(
+	SHADER_GLSL_VERSION
+	"layout (location = 0) in vec4 position;\n"
+	"layout (location = 1) in vec4 color;\n"
+	"smooth out vec4 theColor;\n"
+	"uniform float time;\n"
+	"void main()\n"
+	"{\n"
+	"   float timeScale = 3.14159f * 2.0f / LOOP_DURATION;\n"
+	"   float currTime = mod(time, LOOP_DURATION);\n"
+	"   vec4 totalOffset = vec4(cos(currTime * timeScale) * 0.5f, sin(currTime *timeScale) * 0.5f, 0.0, 0.0);\n"
+	"   gl_Position = position + totalOffset;\n"
+	"#if REVERSE_Z\n"
+	"   gl_Position.z = 0.5 * (gl_Position.w - gl_Position.z);\n"
+	"#endif\n"
+	"   theColor = color;\n"
+	"}\n"
+	);
+
+const std::string strFragmentShader(
+	SHADER_GLSL_VERSION
+	"smooth in vec4 theColor;\n"
+	"out vec4 outputColor;\n"
+	"void main()\n"
+	"{\n"
+	//"//   outputColor = vec4(1.0f, 1.0f, 1.0f, 1.0f);\n"
+	"   outputColor = theColor;\n"
+	"}\n"
+	);
+
+// Seconds the triangle takes to go around once:
+const std::string strShaderDefines("#define LOOP_DURATION 5.0\n");
+
+static std::string GetProgramDefines()
+{
+	return strShaderDefines + (g_EyeRenderTargets.ReverseZ ? "#define REVERSE_Z 1\n" : "#define REVERSE_Z 0\n");
+}
+
+void InitializeProgram()
+{
+	// The strings above are the built-in copies, with --shader-dir the files there win...
+	theVertexSource = RegisterShaderSource("triangle.vert", strVertexShader);
+	theFragmentSource = RegisterShaderSource("triangle.frag", strFragmentShader);
+	// Only submitted, the compile runs while we keep rendering (see ProgramReady())...
+	theProgramHandle = SubmitCachedProgram(GetShaderSource(theVertexSource), GetShaderSource(theFragmentSource), GetProgramDefines());
+}
+
+// After an edit: build it again, ProgramReady() swaps it in once it's linked...
+void ReloadProgram()
+{
+	// A build of an earlier edit that wasn't swapped in yet is superseded...
+	DiscardCachedProgram(theProgramHandle, theProgram);
+	theProgramHandle = SubmitCachedProgram(GetShaderSource(theVertexSource), GetShaderSource(theFragmentSource), GetProgramDefines());
+}
+
+// True once the program is linked, every time a (re)build finishes it also gets its uniforms set up:
+static bool ProgramReady()
+{
+	// Until a reload is linked, or if the edit broke it, the old program stays...
+	const GLuint l_Program = GetCachedProgram(theProgramHandle);
+	if (!l_Program || l_Program == theProgram)
+		return theProgram != 0;
+	glDeleteProgram(theProgram);
+	theProgram = l_Program;
+
+	// Programs that need the eye matrices find them at the fixed binding point...
+	BindEyeUniformBlock(theProgram);
+
+	// Get the memory location of the offset uniform. Do NOT set "default uniform values" in the shader. It breaks things.
+	// This has to happen after the program is linked, and before any rendering is done with it.
+	elapsedTimeUniform = glGetUniformLocation(theProgram, "time");
+	return true;
+}
+
+// Vertex array for use with shader program:
+const float vertexPositions[] = {
+	0.75f, 0.75f, 0.0f, 1.0f, 
+	0.75f, -0.75f, 0.0f, 1.0f, 
+	-0.75f, -0.75f, 0.0f, 1.0f, 
+	1.0f, 0.0f, 0.0f, 1.0f,
+	0.0f, 1.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f, 1.0f
+};
+
+// Old OpenGL Scene object:
+GLfloat l_VAPoints[] =
+{
+	0.5f, 0.5f, 0.5f,
+	-0.5f, 0.5f, 0.5f,
+	-0.5f, -0.5f, 0.5f,
+	0.5f, -0.5f, 0.5f,
+	-0.5f, -0.5f, -0.5f,
+	-0.5f, 0.5f, -0.5f,
+	0.5f, 0.5f, -0.5f,
+	0.5f, -0.5f, -0.5f,
+	0.5f, 0.5f, 0.5f,
+	0.5f, 0.5f, -0.5f,
+	-0.5f, 0.5f, -0.5f,
+	-0.5f, 0.5f, 0.5f,
+	-0.5f, -0.5f, -0.5f,
+	0.5f, -0.5f, -0.5f,
+	0.5f, -0.5f, 0.5f,
+	-0.5f, -0.5f, 0.5f,
+	0.5f, 0.5f, 0.5f,
+	0.5f, -0.5f, 0.5f,
+	0.5f, -0.5f, -0.5f,
+	0.5f, 0.5f, -0.5f,
+	-0.5f, -0.5f, -0.5f,
+	-0.5f, -0.5f, 0.5f,
+	-0.5f, 0.5f, 0.5f,
+	-0.5f, 0.5f, -0.5f
+};
+
+GLfloat l_VANormals[] =
+{
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, -1.0f,
+	0.0f, 0.0f, -1.0f,
+	0.0f, 0.0f, -1.0f,
+	0.0f, 0.0f, -1.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, -1.0f, 0.0f,
+	0.0f, -1.0f, 0.0f,
+	0.0f, -1.0f, 0.0f,
+	0.0f, -1.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	-1.0f, 0.0f, 0.0f,
+	-1.0f, 0.0f, 0.0f,
+	-1.0f, 0.0f, 0.0f,
+	-1.0f, 0.0f, 0.0f
+};
+
+GLuint l_VAIndici[] =
+{
+	0, 1, 2, 3,
+	4, 5, 6, 7,
+	8, 9, 10, 11,
+	12, 13, 14, 15,
+	16, 17, 18, 19,
+	20, 21, 22, 23
+};
+
+// Vertex array initializer functions:
+void InitializeVertexBuffer()
+{
+	// For use with the new shader version of this code
+	glGenBuffers(1, &positionBufferObject);
+
+	glBindBuffer(GL_ARRAY_BUFFER, positionBufferObject);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertexPositions), vertexPositions, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// The cube above lives on the GPU once InitializeSceneMeshes() has run. The host arrays are
+// only read at startup, every draw after that comes straight from the buffer objects:
+MeshHandle g_CubeMesh = INVALID_MESH_HANDLE;
+unsigned int g_CubeObject = 0;
+
+void InitializeSceneMeshes()
+{
+	g_CubeMesh = CreateMeshFromQuads(l_VAPoints, l_VANormals, 24, l_VAIndici, 6 * 4);
+	g_CubeObject = AddSceneObject(g_CubeMesh, OVR::Matrix4f());
+}
+
+// The stress test scene: the demo cube plus p_Count small cubes in a block behind it, filling
+// up the view as the count grows (--cubes)...
+static void SpawnCubes(unsigned int p_Count)
+{
+	ClearScene();
+	g_CubeObject = AddSceneObject(g_CubeMesh, OVR::Matrix4f());
+
+	unsigned int l_Side = 1;
+	while (l_Side * l_Side * l_Side < p_Count)
+		++l_Side;
+
+	const float l_Spacing = 0.25f;
+	const float l_Offset = (l_Side - 1) * l_Spacing * 0.5f;
+	for (unsigned int i = 0; i < p_Count; i++)
+	{
+		const unsigned int l_X = i % l_Side;
+		const unsigned int l_Y = (i / l_Side) % l_Side;
+		const unsigned int l_Z = i / (l_Side * l_Side);
+		AddSceneObject(g_CubeMesh,
+			OVR::Matrix4f::Translation(l_X * l_Spacing - l_Offset, l_Y * l_Spacing - l_Offset, -1.5f - l_Z * l_Spacing) *
+			OVR::Matrix4f::RotationY(i * 0.7f) *
+			OVR::Matrix4f::Scaling(0.1f));
+	}
+	printf("Scene: %u objects\n", (unsigned int)g_SceneObjects.size());
+}
+
+// p_Count point lights of all colors spread around the cubes (--lights). Where they start is
+// fixed, the same for every run; MoveLights takes them around from there...
+static std::vector<OVR::Vector3f> g_LightOrigins;
+
+static void SpawnLights(unsigned int p_Count)
+{
+	g_ScenePointLights.resize(p_Count);
+	g_LightOrigins.resize(p_Count);
+	unsigned int l_Seed = 12345;
+	for (unsigned int i = 0; i < p_Count; i++)
+	{
+		float l_Random[7];
+		for (int j = 0; j < 7; j++)
+		{
+			l_Seed = l_Seed * 1664525 + 1013904223;
+			l_Random[j] = (l_Seed >> 8) / 16777216.0f;
+		}
+		g_LightOrigins[i] = OVR::Vector3f(l_Random[0] * 8.0f - 4.0f, l_Random[1] * 8.0f - 4.0f, l_Random[2] * -9.0f + 3.0f);
+		g_ScenePointLights[i].Radius = 0.75f + 0.25f * l_Random[3];
+		g_ScenePointLights[i].Color[0] = l_Random[4];
+		g_ScenePointLights[i].Color[1] = l_Random[5];
+		g_ScenePointLights[i].Color[2] = l_Random[6];
+	}
+	if (p_Count > 0)
+		printf("Scene: %u point lights\n", p_Count);
+}
+
+// Every light circles the vertical axis through the scene, at its own height and distance...
+static void MoveLights(double p_Time)
+{
+	for (size_t i = 0; i < g_ScenePointLights.size(); i++)
+	{
+		const float l_Angle = (float)fmod(p_Time * (0.2 + 0.05 * (i % 7)), 2.0 * 3.14159265);
+		const OVR::Vector3f l_Position = OVR::Matrix4f::Translation(0.0f, 0.0f, -1.5f).Transform(
+			OVR::Matrix4f::RotationY(l_Angle).Transform(g_LightOrigins[i] + OVR::Vector3f(0.0f, 0.0f, 1.5f)));
+		g_ScenePointLights[i].Position[0] = l_Position.x;
+		g_ScenePointLights[i].Position[1] = l_Position.y;
+		g_ScenePointLights[i].Position[2] = l_Position.z;
+	}
+}
+
+// Taken from the one page opengl demo:
+static void SetOpenGLState(void)
+{
+	// Some state...
+	//glEnable(GL_CULL_FACE); // Disable until out triangles are ordered correctly...
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable(GL_MULTISAMPLE); // Only has an effect while rendering into the multisampled eye buffer...
+	glClearColor(0.2f, 0.3f, 0.4f, 1.0f);
+
+	// Lights and material are uniforms of the scene program now (see Scene.cpp)...
+}
+
+static void ErrorCallback(int p_Error, const char* p_Description)
+{
+	printf("ERROR: %d, %s\n", p_Error, p_Description);
+}
+
+void printGLContextInfo(GLFWwindow* pW)
+{
+	// Without a window (headless benchmark) there are no GLFW attributes to query...
+	if (!pW)
+	{
+		printf("OpenGL: %s ", reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+		printf("Vendor: %s\n", reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+		printf("Renderer: %s\n", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+		return;
+	}
+
+	// Print some info about the OpenGL context...
+	const int l_Major = glfwGetWindowAttrib(pW, GLFW_CONTEXT_VERSION_MAJOR);
+	const int l_Minor = glfwGetWindowAttrib(pW, GLFW_CONTEXT_VERSION_MINOR);
+	const int l_Profile = glfwGetWindowAttrib(pW, GLFW_OPENGL_PROFILE);
+	if (l_Major >= 3) // Profiles introduced in OpenGL 3.0...
+	{
+		if (l_Profile == GLFW_OPENGL_COMPAT_PROFILE)
+		{
+			printf("GLFW_OPENGL_COMPAT_PROFILE\n");
+		}
+		else
+		{
+			printf("GLFW_OPENGL_CORE_PROFILE\n");
+		}
+	}
+	printf("OpenGL: %d.%d ", l_Major, l_Minor);
+	printf("Vendor: %s\n", reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+	printf("Renderer: %s\n", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+}
+
+static void WindowSizeCallback(GLFWwindow* p_Window, int p_Width, int p_Height)
+{
+	if (p_Width>0 && p_Height>0)
+	{
+		// Our own distortion just draws into whatever size the window has...
+		if (g_ClientDistortion.Enabled)
+		{
+			l_ClientSize.w = p_Width;
+			l_ClientSize.h = p_Height;
+			return;
+		}
+
+		g_Cfg.OGL.Header.BackBufferSize.w = p_Width;
+		g_Cfg.OGL.Header.BackBufferSize.h = p_Height;
+
+		ovrBool l_ConfigureResult = ovrHmd_ConfigureRendering(hmd, &g_Cfg.Config, g_DistortionCaps, hmd->MaxEyeFov, g_EyeRenderDesc);
+		glUseProgram(0); // Avoid OpenGL state leak in ovrHmd_ConfigureRendering...
+		if (!l_ConfigureResult)
+		{
+			printf("Configure failed.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+void keyboard(GLFWwindow* pWindow, int key, int codes, int action, int mods)
+{
+	(void)pWindow;
+	(void)codes;
+
+	if ((key > -1) && (key <= GLFW_KEY_LAST))
+	{
+		printf("key ac  %d %d\n", key, action);
+	}
+
+	if (action == GLFW_PRESS)
+	{
+		switch (key)
+		{
+		default:
+			ovrHmd_DismissHSWDisplay(hmd);
+			break;
+
+		case GLFW_KEY_ESCAPE:
+			glfwSetWindowShouldClose(pWindow, GL_TRUE);
+			//if (directHmdMode)
+			//{
+			//	// Clear the frame before calling all the destructors - even a few
+			//	// frames worth of frozen video is enough to cause discomfort!
+			//	///@note This does not seem to work in Direct mode.
+			//	//glClearColor(58.f / 255.f, 110.f / 255.f, 165.f / 255.f, 1.f); // Win7 default desktop color
+			//	//glClear(GL_COLOR_BUFFER_BIT);
+			//	//glfwSwapBuffers(g_pHMDWindow);
+			//	//glClear(GL_COLOR_BUFFER_BIT);
+			//	//glfwSwapBuffers(g_pHMDWindow);
+
+			//	//deallocateFBO(m_renderBuffer);
+			//	ovrHmd_Destroy(hmd);
+			//	ovr_Shutdown();
+
+			//	glfwDestroyWindow(l_Window);
+			//	glfwTerminate();
+			//	exit(0);
+			//}
+			//else
+			//{
+			//	//destroyAuxiliaryWindow(l_Window);
+			//	//glfwMakeContextCurrent(g_pHMDWindow);
+			//}
+
+			// Clean up FBO...
+
+
+			//ovrHmd_Destroy(hmd);
+			//ovr_Shutdown();
+
+			//glfwDestroyWindow(l_Window);
+			//glfwTerminate();
+			//exit(EXIT_SUCCESS);
+			break;
+		case GLFW_KEY_R:
+			ovrHmd_RecenterPose(hmd);
+			break;
+		case GLFW_KEY_S:
+			// Toggle between single-pass (instanced) and multi-pass stereo...
+			g_StereoMode = (g_StereoMode == StereoMode_MultiPass) ? StereoMode_SinglePassInstanced : StereoMode_MultiPass;
+			printf("Stereo mode: %s\n", g_StereoMode == StereoMode_MultiPass ? "multi-pass" : "single-pass instanced");
+			break;
+		case GLFW_KEY_D:
+			// Toggle dynamic resolution, back to the default pixel density when it's off...
+			InitializeDynamicResolution(!g_DynamicResolution.Enabled, g_DynamicResolution.TargetGpuMs, 1.0f / DYNAMIC_RESOLUTION_MAX_DENSITY);
+			printf("Dynamic resolution: %s\n", g_DynamicResolution.Enabled ? "on" : "off");
+			break;
+		case GLFW_KEY_M:
+			// Cycle the eye buffer MSAA sample count 1 -> 2 -> 4 -> 8 -> 1...
+			g_Benchmark.Settings.MsaaSamples = SetEyeRenderTargetSamples(g_EyeRenderTargets.Samples >= 8 ? 1 : g_EyeRenderTargets.Samples * 2);
+			g_SceneMultisample = (g_Benchmark.Settings.MsaaSamples > 1);
+			printf("MSAA: %ux\n", g_Benchmark.Settings.MsaaSamples);
+			break;
+		case GLFW_KEY_Z:
+			// Toggle the depth pre-pass...
+			g_SceneDepthPrePass = !g_SceneDepthPrePass;
+			printf("Depth pre-pass: %s\n", g_SceneDepthPrePass ? "on" : "off");
+			break;
+		case GLFW_KEY_I:
+			// Toggle instanced drawing (one draw per mesh) against one draw per object...
+			g_SceneInstancing = !g_SceneInstancing;
+			printf("Instancing: %s\n", g_SceneInstancing ? "on" : "off");
+			break;
+		case GLFW_KEY_C:
+			// Toggle GPU culling with multi-draw indirect (stays off if the GL can't do it)...
+			g_SceneGpuCulling = !g_SceneGpuCulling && SceneGpuCullingSupported();
+			printf("GPU culling: %s\n", g_SceneGpuCulling ? "on" : "off");
+			break;
+		case GLFW_KEY_H:
+			// Toggle the hidden area masks...
+			g_HiddenArea.Enabled = !g_HiddenArea.Enabled;
+			printf("Hidden area: %s\n", g_HiddenArea.Enabled ? "on" : "off");
+			break;
+		case GLFW_KEY_F:
+			// Toggle the multi-resolution eye buffers...
+			g_MultiResolution.Enabled = !g_MultiResolution.Enabled;
+			printf("Multi-resolution: %s\n", g_MultiResolution.Enabled ? "on" : "off");
+			break;
+		case GLFW_KEY_T:
+			// Toggle stereo reprojection of the far depth layer...
+			g_StereoReprojection.Enabled = !g_StereoReprojection.Enabled;
+			printf("Stereo reprojection: %s\n", g_StereoReprojection.Enabled ? "on" : "off");
+			break;
+		case GLFW_KEY_B:
+			// Toggle CPU culling against the scene BVH (used while GPU culling is off)...
+			g_SceneBvhCulling = !g_SceneBvhCulling;
+			printf("BVH culling: %s\n", g_SceneBvhCulling ? "on" : "off");
+			break;
+		case GLFW_KEY_O:
+			// Toggle the shadow maps (stays off without the atlas), they're rendered from scratch when they come back...
+			g_SceneShadows.Enabled = !g_SceneShadows.Enabled && GetSceneShadowTexture() != 0;
+			InvalidateSceneShadows();
+			printf("Shadows: %s\n", g_SceneShadows.Enabled ? "on" : "off");
+			break;
+		case GLFW_KEY_Q:
+			// Toggle occlusion culling (stays off without GPU culling), it starts over from next frame's depth...
+			g_SceneOcclusion.Enabled = !g_SceneOcclusion.Enabled && SceneOcclusionSupported();
+			InvalidateSceneOcclusion();
+			printf("Occlusion culling: %s\n", g_SceneOcclusion.Enabled ? "on" : "off");
+			break;
+		case GLFW_KEY_L:
+			// Toggle late latching (stays off if the GL can't do it)...
+			g_LateLatching = !g_LateLatching && LateLatchingSupported();
+			printf("Late latching: %s\n", g_LateLatching ? "on" : "off");
+			break;
+		case GLFW_KEY_P:
+			// Dump the last few seconds of profiler zones...
+			WriteChromeTrace(g_Benchmark.Settings.TracePath.empty() ? "trace.json" : g_Benchmark.Settings.TracePath.c_str());
+			break;
+		case GLFW_KEY_UP:
+			g_CameraPosition.z += 0.1f;
+			break;
+		case GLFW_KEY_DOWN:
+			g_CameraPosition.z -= 0.1f;
+			break;
+		case GLFW_KEY_LEFT:
+			g_CameraPosition.x += 0.1f;
+			break;
+		case GLFW_KEY_RIGHT:
+			g_CameraPosition.x -= 0.1f;
+			break;
+		}
+
+	}
+}
+
+
+// Shrinks (or grows) both eye viewports to p_Scale of their maximum size. They stay anchored at
+// their corner of the eye texture, LibOVR picks up the new RenderViewport with the next EndFrame:
+static void SetEyeViewportScale(float p_Scale)
+{
+	for (int l_Eye = 0; l_Eye < ovrEye_Count; l_Eye++)
+	{
+		ovrSizei& l_Size = g_EyeTextures[l_Eye].Header.RenderViewport.Size;
+		l_Size.w = (int)(g_MaxEyeViewportSizes[l_Eye].w * p_Scale + 0.5f);
+		l_Size.h = (int)(g_MaxEyeViewportSizes[l_Eye].h * p_Scale + 0.5f);
+		if (l_Size.w < 1) l_Size.w = 1;
+		if (l_Size.h < 1) l_Size.h = 1;
+	}
+}
+
+// World to eye: the inverse head orientation, the eye position (positional tracking (DK2) and IPD)
+// and the camera offset that moves the world forward a bit to show the scene in front of us:
+static void GetEyeView(ovrEyeType p_Eye, EyeView& p_View)
+{
+	const OVR::Vector3f l_EyePosition(g_EyePoses[p_Eye].Position);
+	const OVR::Vector3f l_CameraPosition(g_CameraPosition);
+
+	p_View.View =
+		OVR::Matrix4f(OVR::Quatf(g_EyePoses[p_Eye].Orientation).Inverted()) *
+		OVR::Matrix4f::Translation(-l_EyePosition) *
+		OVR::Matrix4f::Translation(l_CameraPosition);
+	p_View.Projection = g_ProjectionMatrici[p_Eye];
+	p_View.Position = l_EyePosition - l_CameraPosition;
+	p_View.Viewport = g_EyeTextures[p_Eye].Header.RenderViewport;
+	p_View.Fov = g_EyeRenderDesc[p_Eye].Fov;
+	p_View.ZNear = g_ZNear;
+	p_View.ZFar = g_ZFar;
+}
+
+// Builds both eye views from the current g_EyePoses and writes them into the eye uniform buffer.
+// Called once per frame, right after the poses have been fetched (at p_PoseTime):
+static void UpdateEyeViews(unsigned int p_FrameIndex, double p_PoseTime)
+{
+	// Stereo reprojection draws in depth layers (not with multi-resolution, the eyes are in regions there)...
+	g_SceneDepthSplit = (g_StereoReprojection.Enabled && !g_MultiResolution.Enabled) ? g_StereoReprojection.SplitDistance : 0.0f;
+
+	EyeView l_EyeViews[2];
+	for (int l_Eye = 0; l_Eye < ovrEye_Count; l_Eye++)
+	{
+		GetEyeView((ovrEyeType)l_Eye, l_EyeViews[l_Eye]);
+	}
+	UpdateEyeUniforms(l_EyeViews, g_RenderTargetSize, p_FrameIndex, p_PoseTime);
+}
+
+// Late latching: fetches the eye poses again, right before the eyes are drawn, and has the frame
+// drawn (and timewarped) with those. Returns false if that isn't possible.
+static bool LatchEyeViews(unsigned int p_FrameIndex)
+{
+	ovrPosef l_EyePoses[2];
+	const double l_PoseTime = ovr_GetTimeInSeconds();
+	ovrHmd_GetEyePoses(hmd, p_FrameIndex, g_EyeOffsets, l_EyePoses, NULL);
+
+	EyeView l_EyeViews[2];
+	const ovrPosef l_RenderedPoses[2] = { g_EyePoses[0], g_EyePoses[1] };
+	g_EyePoses[0] = l_EyePoses[0];
+	g_EyePoses[1] = l_EyePoses[1];
+	for (int l_Eye = 0; l_Eye < ovrEye_Count; l_Eye++)
+	{
+		GetEyeView((ovrEyeType)l_Eye, l_EyeViews[l_Eye]);
+	}
+
+	if (!LatchEyeUniforms(l_EyeViews, g_RenderTargetSize, l_PoseTime))
+	{
+		// Keep the poses we really render with, timewarp has to know about those...
+		g_EyePoses[0] = l_RenderedPoses[0];
+		g_EyePoses[1] = l_RenderedPoses[1];
+		return false;
+	}
+	return true;
+}
+
+// The viewport of p_Eye as a single region, or with multi-resolution on, the regions it's split into.
+// Returns how many there are:
+static int GetEyeRegions(int p_Eye, MultiResolutionRegion p_Regions[MULTI_RESOLUTION_REGION_COUNT])
+{
+	const ovrRecti& l_Viewport = g_EyeTextures[p_Eye].Header.RenderViewport;
+	if (g_MultiResolution.Enabled)
+	{
+		return GetMultiResolutionRegions(p_Eye, l_Viewport, p_Regions);
+	}
+	p_Regions[0].Viewport = l_Viewport;
+	p_Regions[0].Scissor = l_Viewport;
+	p_Regions[0].Fov = g_EyeRenderDesc[p_Eye].Fov;
+	return 1;
+}
+
+static void SetEyeRegion(const MultiResolutionRegion& p_Region)
+{
+	glViewport(p_Region.Viewport.Pos.x, p_Region.Viewport.Pos.y, p_Region.Viewport.Size.w, p_Region.Viewport.Size.h);
+	glScissor(p_Region.Scissor.Pos.x, p_Region.Scissor.Pos.y, p_Region.Scissor.Size.w, p_Region.Scissor.Size.h);
+}
+
+// Mask out what the lenses never show (in every region of both eyes), before anything gets shaded there...
+static void MaskHiddenAreas(const MultiResolutionRegion p_Regions[ovrEye_Count][MULTI_RESOLUTION_REGION_COUNT], const int p_RegionCounts[ovrEye_Count])
+{
+	if (!g_HiddenArea.Enabled)
+		return;
+
+	ProfileZone l_Zone("HiddenArea");
+	for (int l_Eye = 0; l_Eye < ovrEye_Count; l_Eye++)
+	{
+		for (int l_Region = 0; l_Region < p_RegionCounts[l_Eye]; l_Region++)
+		{
+			SetEyeRegion(p_Regions[l_Eye][l_Region]);
+			DrawHiddenArea(l_Eye);
+		}
+	}
+}
+
+// Draws what p_Eye sees into its region p_Region (already set up): the scene, unless p_Scene is false
+// (single-pass drew it already), and the triangle. Returns the number of draw calls:
+static unsigned int DrawEye(ovrEyeType p_Eye, int p_Region, bool p_Scene, double p_Time)
+{
+	unsigned int l_DrawCalls = 0;
+
+	// Multi-pass (or region by region): the eye matrices are already in the uniform buffer, just pick the eye...
+	if (p_Scene)
+	{
+		l_DrawCalls += DrawSceneEye(p_Eye, p_Region);
+	}
+
+	// Use shader program to render instead (the triangle just shows up once its program is built):
+	if (ProgramReady())
+	{
+		glUseProgram(theProgram);
+		glBindVertexArray(vao);
+
+		glUniform1f(elapsedTimeUniform, (float)p_Time);
+
+		//glBindBuffer(GL_ARRAY_BUFFER, positionBufferObject);
+		//glEnableVertexAttribArray(0);
+		//glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		++l_DrawCalls;
+
+		//glDisableVertexAttribArray(0);
+		glBindVertexArray(0);
+		glUseProgram(0);
+	}
+	return l_DrawCalls;
+}
+
+// Renders the scene for both eyes into the eye render target (p_Time is in seconds and drives the animations):
+static void RenderEyeBuffers(const EyeRenderTarget& p_Target, unsigned int p_FrameIndex, double p_Time)
+{
+	// Scene variables:
+	GLfloat l_SpinX;
+	GLfloat l_SpinY;
+	const bool l_Spin = false;
+
+	// Make the cube spin...
+	if (l_Spin)
+	{
+		l_SpinX = (GLfloat)fmod(p_Time*17.0, 360.0);
+		l_SpinY = (GLfloat)fmod(p_Time*23.0, 360.0);
+	}
+	else
+	{
+		l_SpinX = 30.0f;
+		l_SpinY = 40.0f;
+	}
+	SetSceneObjectTransform(g_CubeObject,
+		OVR::Matrix4f::RotationX(OVR::DegreeToRad(l_SpinX)) *
+		OVR::Matrix4f::RotationY(OVR::DegreeToRad(l_SpinY)));
+
+	// The shadow maps don't depend on the eyes, whatever moved gets them rendered once for both...
+	UpdateSceneShadowMaps();
+
+	// Neither do the light clusters, they cover both eyes...
+	MoveLights(p_Time);
+	UpdateSceneLightClusters();
+
+	// Everything from here on sees the eyes, swap in the freshest eye poses...
+	if (g_LateLatching)
+	{
+		ProfileZone l_Zone("LateLatch", -1, false);
+		LatchEyeViews(p_FrameIndex);
+	}
+
+	// Bind our custom FBO (instead of using the default OpenGL framebuffer), the multisampled one with MSAA on...
+	glBindFramebuffer(GL_FRAMEBUFFER, GetEyeRenderFramebuffer(p_Target));
+	BeginEyeDepth();
+
+	// The eyes as a whole, or with multi-resolution on, in regions. Every region is drawn on its own, cut
+	// out with the scissor, and only gets the objects it sees...
+	MultiResolutionRegion l_Regions[ovrEye_Count][MULTI_RESOLUTION_REGION_COUNT];
+	int l_RegionCounts[ovrEye_Count];
+	ovrFovPort l_RegionFovs[ovrEye_Count][SCENE_MAX_EYE_REGIONS];
+	int l_SceneRegionCounts[ovrEye_Count];
+	for (int l_Eye = 0; l_Eye < ovrEye_Count; l_Eye++)
+	{
+		l_RegionCounts[l_Eye] = GetEyeRegions(l_Eye, l_Regions[l_Eye]);
+		for (int l_Region = 0; l_Region < l_RegionCounts[l_Eye]; l_Region++)
+		{
+			l_RegionFovs[l_Eye][l_Region] = l_Regions[l_Eye][l_Region].Fov;
+		}
+		l_SceneRegionCounts[l_Eye] = g_MultiResolution.Enabled ? l_RegionCounts[l_Eye] : 0;
+	}
+	SetSceneEyeRegions(l_RegionFovs, l_SceneRegionCounts);
+	if (g_MultiResolution.Enabled)
+	{
+		glEnable(GL_SCISSOR_TEST);
+	}
+
+	// Clear, with multi-resolution on only the regions (the rest of the eye viewports never gets read)...
+	{
+		ProfileZone l_Zone("Clear");
+		if (g_MultiResolution.Enabled)
+		{
+			for (int l_Eye = 0; l_Eye < ovrEye_Count; l_Eye++)
+			{
+				for (int l_Region = 0; l_Region < l_RegionCounts[l_Eye]; l_Region++)
+				{
+					SetEyeRegion(l_Regions[l_Eye][l_Region]);
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				}
+			}
+		}
+		else
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}
+	}
+
+	MaskHiddenAreas(l_Regions, l_RegionCounts);
+
+	// Stereo reprojection: the far depth layer is only drawn for the left eye and reprojected into the
+	// right one. The depth buffer then starts over (the hidden areas with it), everything of the near
+	// layer is in front of the far one...
+	unsigned int l_DrawCalls = 0;
+	const bool l_Reproject = (g_SceneDepthSplit > 0.0f);
+	if (l_Reproject)
+	{
+		ProfileZone l_Zone("FarLayer");
+		UseSceneDepthLayer(SceneDepthLayer_Far);
+		SetEyeRegion(l_Regions[ovrEye_Left][0]);
+		l_DrawCalls += DrawSceneEye(ovrEye_Left, 0); // Just the scene, the triangle is drawn with the near layer.
+		ReprojectStereo(GetEyeRenderFramebuffer(p_Target), g_EyeTextures[ovrEye_Left].Header.RenderViewport, g_EyeTextures[ovrEye_Right].Header.RenderViewport);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		MaskHiddenAreas(l_Regions, l_RegionCounts);
+		UseSceneDepthLayer(SceneDepthLayer_Near);
+	}
+
+	// Single-pass: both eyes in one go, every object is a single instanced draw (the regions of
+	// multi-resolution don't fit into a single viewport, it goes eye by eye)...
+	const bool l_SinglePass = (g_StereoMode == StereoMode_SinglePassInstanced) && !g_MultiResolution.Enabled;
+	if (l_SinglePass)
+	{
+		ProfileZone l_Zone("RenderStereo");
+		l_DrawCalls += DrawSceneSinglePassStereo(g_RenderTargetSize);
+	}
+
+	for (int l_EyeIndex = 0; l_EyeIndex<ovrEye_Count; l_EyeIndex++)
+	{
+		ovrEyeType l_Eye = hmd->EyeRenderOrder[l_EyeIndex];
+		ProfileZone l_EyeZone("RenderEye", l_Eye);
+
+		for (int l_Region = 0; l_Region < l_RegionCounts[l_Eye]; l_Region++)
+		{
+			SetEyeRegion(l_Regions[l_Eye][l_Region]);
+			l_DrawCalls += DrawEye(l_Eye, l_Region, !l_SinglePass, p_Time);
+		}
+	}
+
+	if (g_MultiResolution.Enabled)
+	{
+		glDisable(GL_SCISSOR_TEST);
+	}
+	if (l_Reproject)
+	{
+		UseSceneDepthLayer(SceneDepthLayer_Full);
+	}
+
+	// Next frame culls against what this one's depth hides...
+	CaptureSceneOcclusionDepth(GetEyeRenderFramebuffer(p_Target));
+	EndEyeDepth();
+
+	// Resolve MSAA into the texture LibOVR reads, just the part the (possibly scaled down) eye viewports cover...
+	if (g_EyeRenderTargets.Samples > 1)
+	{
+		ProfileZone l_Zone("ResolveMsaa");
+		const ovrRecti& l_Left = g_EyeTextures[ovrEye_Left].Header.RenderViewport;
+		const ovrRecti& l_Right = g_EyeTextures[ovrEye_Right].Header.RenderViewport;
+		ResolveEyeRenderTarget(p_Target,
+			l_Right.Pos.x + l_Right.Size.w,
+			l_Left.Size.h > l_Right.Size.h ? l_Left.Size.h : l_Right.Size.h);
+	}
+
+	// LibOVR's distortion wants the usual layout, stretch the packed regions back over the whole eye
+	// viewports. Ours reads them where they are...
+	if (g_MultiResolution.Enabled)
+	{
+		const ovrRecti l_EyeViewports[2] = { g_EyeTextures[ovrEye_Left].Header.RenderViewport, g_EyeTextures[ovrEye_Right].Header.RenderViewport };
+		ComposeMultiResolution(p_Target.Framebuffer, l_EyeViewports, !g_ClientDistortion.Enabled);
+	}
+
+	ProfilerCounter("DrawCalls", (double)l_DrawCalls);
+	ProfilerCounter("SceneObjects", (double)g_SceneObjects.size());
+	ProfilerCounter("MsaaSamples", (double)g_EyeRenderTargets.Samples);
+	ProfilerCounter("MultiResPixels", g_MultiResolution.Enabled ? (double)g_MultiResolution.PixelFraction : 1.0);
+}
+
+// The draw loop runs until the window is closed or, when benchmarking, the requested frames have been rendered:
+static bool KeepRendering(void)
+{
+	if (g_Benchmark.Settings.Enabled && BenchmarkFinished())
+		return false;
+
+	return !l_Window || !glfwWindowShouldClose(l_Window);
+}
+
+// Picks the monitor for the current HMD mode, creates the window on it and makes its context current:
+static void CreateHmdWindow(void)
+{
+	if (directHmdMode)
+	{
+		printf("Using Direct to Rift mode...\n");
+		//LOG_INFO("Using Direct to Rift mode...\n");
+		const GLFWmonitor* pPrimary = glfwGetPrimaryMonitor();
+		int monitorCount = 0;
+		GLFWmonitor** ppMonitors = glfwGetMonitors(&monitorCount);
+		for (int i = 0; i<monitorCount; ++i)
+		{
+			l_Monitor = ppMonitors[i];
+			if (l_Monitor == pPrimary)
+				continue;
+			//const GLFWvidmode* mode = glfwGetVideoMode(l_Monitor);
+		}
+
+		l_ClientSize.w = hmd->Resolution.w; // Something reasonable, smaller, but maintain aspect ratio...
+		l_ClientSize.h = hmd->Resolution.h; // Something reasonable, smaller, but maintain aspect ratio...
+	}
+	else
+	{
+		int l_Count;
+		GLFWmonitor** l_Monitors = glfwGetMonitors(&l_Count);
+		switch (l_Count)
+		{
+		case 0:
+			printf("No monitors found, exiting...\n");
+			exit(EXIT_FAILURE);
+			break;
+		case 1:
+			printf("Two monitors expected, found only one, using primary...\n");
+			l_Monitor = glfwGetPrimaryMonitor();
+			break;
+		case 2:
+			printf("Two monitors found, using second monitor...\n");
+			l_Monitor = l_Monitors[1];
+			break;
+		default:
+			printf("More than two monitors found, using second monitor...\n");
+			l_Monitor = l_Monitors[1];
+		}
+
+		printf("Using Extended Desktop mode...\n");
+		l_ClientSize.w = hmd->Resolution.w;
+		l_ClientSize.h = hmd->Resolution.h;
+	}
+
+#if defined(__APPLE__)
+	// Full screen is needed for OS X...
+	l_Window = glfwCreateWindow(l_ClientSize.w, l_ClientSize.h, "GLFW Oculus Rift Test", l_Monitor, NULL);
+#else
+	// ... but it doesn't play well with direct mode in Windows 
+	l_Window = glfwCreateWindow(l_ClientSize.w, l_ClientSize.h, "GLFW Oculus Rift Test", NULL, NULL);
+#endif
+	glfwWindowHint(GLFW_DECORATED, 0);
+
+
+	// Attach the window in "Direct Mode"...
+#if defined(_WIN32)
+	if (directHmdMode)
+	{
+		ovrBool l_AttachResult = ovrHmd_AttachToWindow(hmd, glfwGetWin32Window(l_Window), NULL, NULL);
+		if (!l_AttachResult)
+		{
+			printf("Could not attach to window...");
+			exit(EXIT_FAILURE);
+		}
+	}
+#endif
+
+	glfwSetWindowPos(l_Window, position.x, position.y);
+	//g_renderMode.outputType = RenderingMode::OVR_SDK; // Left over from riftskeleton...
+
+	if (!l_Window)
+	{
+		printf("Failure!\n");
+		glfwTerminate();
+		exit(EXIT_FAILURE);
+	}
+
+	glfwMakeContextCurrent(l_Window);
+}
+
+int main(int argc, const char * argv[]) {
+	printf("hello world\n");
+
+	// Command line options (currently only the benchmark mode)...
+	if (!ParseBenchmarkArguments(argc, argv))
+	{
+		exit(EXIT_FAILURE);
+	}
+
+	// Setup GLFW Window (the headless benchmark uses an offscreen context instead):
+	l_Window = NULL;
+	if (!g_Benchmark.Settings.Headless)
+	{
+		glfwSetErrorCallback(ErrorCallback);
+		if (!glfwInit())
+		{
+			exit(EXIT_FAILURE);
+		}
+
+//#define USE_CORE_CONTEXT
+#ifdef USE_CORE_CONTEXT	
+#if defined(_MACOS)
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+#else
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+#endif
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE); // Use the new OpenGL
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // Make OS X Happy. Shouldn't need this... I guess?
+#endif
+
+		glfwWindowHint(GLFW_SAMPLES, 0); // Anti-aliasing happens in the eye buffers, LibOVR only draws the distortion mesh here...
+
+		// A windowed benchmark still needs a context, but nobody has to look at it...
+		if (g_Benchmark.Settings.Enabled)
+		{
+			glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+		}
+	}
+
+	// Init HMD (benchmarks always use the virtual DK2 so numbers are comparable between machines):
+	ovr_Initialize();
+	hmd = g_Benchmark.Settings.Enabled ? NULL : ovrHmd_Create(0);
+	if (hmd) { // Get more details about the HMD.
+
+		// Set size and position of the window:
+		//const ovrSizei sz = g_app.getHmdResolution();
+		//const ovrVector2i pos = g_app.getHmdWindowPos();
+		resolution = hmd->Resolution;
+		position = hmd->WindowsPos;
+		printf("Resolution: %i, %i\n", resolution.h, resolution.w);
+
+		// Check to see if we're using direct HMD mode or not:
+		///@todo Why does ovrHmd_GetEnabledCaps always return 0 when querying the caps
+		/// through the field in ovrHmd appears to work correctly?
+		//const unsigned int caps = ovrHmd_GetEnabledCaps(m_Hmd);
+		const unsigned int caps = hmd->HmdCaps;
+		if ((caps & ovrHmdCap_ExtendDesktop) != 0)
+		{
+			directHmdMode = false;
+		}
+	} // Do something with the HMD. ....
+	else {
+		printf("No Oculus Rift device attached, using virtual version...\n");
+		hmd = ovrHmd_CreateDebug(ovrHmd_DK2);
+	}
+
+	if (g_Benchmark.Settings.Headless)
+	{
+		// No window at all, LibOVR's distortion rendering is skipped and we only time our own work...
+		if (!CreateHeadlessContext())
+		{
+			printf("Could not create an offscreen OpenGL context.\n");
+			exit(EXIT_FAILURE);
+		}
+		directHmdMode = false;
+		l_ClientSize = hmd->Resolution;
+	}
+	else
+	{
+		CreateHmdWindow();
+	}
+
+
+#if !defined(__APPLE__)
+	// Don't forget to initialize Glew, turn glewExperimental on to
+	// avoid problems fetching function pointers...
+	glewExperimental = GL_TRUE;
+	const GLenum l_Result = glewInit();
+	if (l_Result != GLEW_OK)
+	{
+		printf("glewInit() error.\n");
+		glfwTerminate();
+		exit(EXIT_FAILURE);
+	}
+#endif
+
+	printGLContextInfo(l_Window);
+
+	// Frame loop instrumentation (GPU timer queries need the GL function pointers from above)...
+	InitializeProfiler();
+
+	//=================
+	// Finish setting up the framebuffers and the OpenGL scene:
+	// (Taken from the single page opengl demo:	
+
+	// Create some lights, materials, etc...
+	SetOpenGLState();
+
+	// Calculate the dimenstions of the Render Texture based on the field of view of each eye:
+	// Find out what the texture sizes should be for each eye separately first. The texture is sized for
+	// the highest pixel density, the dynamic resolution controller decides how much of it gets used...
+	ovrSizei l_EyeTextureSizes[2];
+	l_EyeTextureSizes[ovrEye_Left] = ovrHmd_GetFovTextureSize(hmd, ovrEye_Left, hmd->MaxEyeFov[ovrEye_Left], DYNAMIC_RESOLUTION_MAX_DENSITY);
+	l_EyeTextureSizes[ovrEye_Right] = ovrHmd_GetFovTextureSize(hmd, ovrEye_Right, hmd->MaxEyeFov[ovrEye_Right], DYNAMIC_RESOLUTION_MAX_DENSITY);
+	g_MaxEyeViewportSizes[ovrEye_Left] = l_EyeTextureSizes[ovrEye_Left];
+	g_MaxEyeViewportSizes[ovrEye_Right] = l_EyeTextureSizes[ovrEye_Right];
+	// Combine the dimensions for both eyes so we can use a single texture for the full display...
+	g_RenderTargetSize.w = l_EyeTextureSizes[ovrEye_Left].w + l_EyeTextureSizes[ovrEye_Right].w;
+	g_RenderTargetSize.h = (l_EyeTextureSizes[ovrEye_Left].h>l_EyeTextureSizes[ovrEye_Right].h ? l_EyeTextureSizes[ovrEye_Left].h : l_EyeTextureSizes[ovrEye_Right].h);
+
+
+	//===========================
+	// Configure our custom framebuffers that LibOVR will use to display our content. There are a few of
+	// them, each frame renders into the next one so it never waits on LibOVR still reading the last:
+	if (!CreateEyeRenderTargets(g_RenderTargetSize, g_Benchmark.Settings.EyeBufferCount, g_Benchmark.Settings.ReverseZ))
+	{
+		exit(EXIT_FAILURE);
+	}
+	g_Benchmark.Settings.MsaaSamples = SetEyeRenderTargetSamples(g_Benchmark.Settings.MsaaSamples);
+	g_SceneMultisample = (g_Benchmark.Settings.MsaaSamples > 1);
+
+	// Linked programs are cached on disk, only the first launch (or a driver update) pays for compiling:
+	InitializeShaderCache(g_Benchmark.Settings.ShaderCachePath.c_str());
+	// Shader sources come built in, or from --shader-dir where edits get picked up while running:
+	InitializeShaderSources(g_Benchmark.Settings.ShaderDirectory.c_str());
+	// Initialize the shader program we will use to render the scene:
+	InitializeProgram();
+	// Initialize the vertex buffer for use with the shader:
+	InitializeVertexBuffer();
+	// Upload the scene geometry once:
+	InitializeSceneMeshes();
+	if (!g_Benchmark.Settings.CubeCounts.empty())
+		SpawnCubes(g_Benchmark.Settings.CubeCounts[0]);
+	SpawnLights(g_Benchmark.Settings.PointLights);
+	g_SceneInstancing = g_Benchmark.Settings.Instancing;
+	g_SceneDepthPrePass = g_Benchmark.Settings.DepthPrePass;
+	g_SceneGpuCulling = g_Benchmark.Settings.GpuCulling;
+	g_SceneBvhCulling = g_Benchmark.Settings.BvhCulling;
+	// Shadow maps of the lights, shared by the eyes:
+	InitializeSceneShadows(g_Benchmark.Settings.ShadowMapSize, g_Benchmark.Settings.Shadows);
+	// The shader based scene path (single-pass stereo), it starts building the variants the stereo mode needs:
+	g_StereoMode = g_Benchmark.Settings.SinglePassStereo ? StereoMode_SinglePassInstanced : StereoMode_MultiPass;
+	InitializeSceneRenderer();
+	g_LateLatching = LateLatchingSupported() && g_Benchmark.Settings.LateLatch;
+	g_Benchmark.Settings.GpuCulling = g_SceneGpuCulling = SceneGpuCullingSupported() && g_Benchmark.Settings.GpuCulling;
+	// Everything came from the cache, otherwise the stats get printed once the last program is built...
+	if (g_ShaderCache.Pending == 0)
+		PrintShaderCacheStats();
+	StartShaderWatcher();
+
+
+	// Initialize the vertex attribute array
+	// All of the settings we configure for the shader program will be stored in the Vertex attribute array object
+	// so that we won't have to bind all of this crap for every new object we want to render:
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	// Bind our objects vertex buffer to opengl:
+	// (I'm not sure why we have to bind this if we're using VAO's but maybe I'll see why later...?)
+	glBindBuffer(GL_ARRAY_BUFFER, positionBufferObject);
+	// Tell OpenGL to use the first two shader attibutes:
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	// Tell OpenGL where in the vertex buffer to get the data for each attribute:
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, (void*)48);
+
+
+	// Unbind all of that and get on with it...
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	// End OpenGL Framebuffer configuration
+	//=====================================
+
+
+	// Set configurations for each eye:
+	// This includes the eye's dedicated texture size and the eyes location in the main texture buffer.
+	// These values will be passed to LibOVR so that the library knows how to render each eye:
+	// Left eye...
+	g_EyeTextures[ovrEye_Left].Header.API = ovrRenderAPI_OpenGL;
+	g_EyeTextures[ovrEye_Left].Header.TextureSize = g_RenderTargetSize;
+	g_EyeTextures[ovrEye_Left].Header.RenderViewport.Pos.x = 0;
+	g_EyeTextures[ovrEye_Left].Header.RenderViewport.Pos.y = 0;
+	g_EyeTextures[ovrEye_Left].Header.RenderViewport.Size = l_EyeTextureSizes[ovrEye_Left];
+	((ovrGLTexture&)(g_EyeTextures[ovrEye_Left])).OGL.TexId = g_EyeRenderTargets.Targets[0].ColorTexture;
+	// Right eye (mostly the same as left but with the viewport on the right side of the texture)...
+	g_EyeTextures[ovrEye_Right] = g_EyeTextures[ovrEye_Left];
+	g_EyeTextures[ovrEye_Right].Header.RenderViewport.Pos.x = (g_RenderTargetSize.w + 1) / 2;
+	g_EyeTextures[ovrEye_Right].Header.RenderViewport.Pos.y = 0;
+
+	// Start out at LibOVR's default 1:1 pixel density, the controller takes it from there...
+	InitializeDynamicResolution(g_Benchmark.Settings.DynamicResolution, g_Benchmark.Settings.GpuBudgetMs, 1.0f / DYNAMIC_RESOLUTION_MAX_DENSITY);
+	SetEyeViewportScale(g_DynamicResolution.Scale);
+
+	// Oculus Rift main texture buffer size configurations...
+	g_Cfg.OGL.Header.API = ovrRenderAPI_OpenGL;
+	//g_Cfg.OGL.Header.BackBufferSize.w = l_ClientSize.w;
+	//g_Cfg.OGL.Header.BackBufferSize.h = l_ClientSize.h;
+	g_Cfg.OGL.Header.BackBufferSize = Sizei(l_ClientSize.w, l_ClientSize.h);
+	g_Cfg.OGL.Header.Multisample = 0;
+#if defined(_WIN32)
+	g_Cfg.OGL.Window = glfwGetWin32Window(l_Window);
+	g_Cfg.OGL.DC = GetDC(g_Cfg.OGL.Window);
+#elif defined(__linux__)
+	//l_Cfg.OGL.Win = glfwGetX11Window(l_Window);
+	//l_Cfg.OGL.Disp = glfwGetX11Display();
+#endif
+
+	// Enable capabilities...
+	ovrHmd_SetEnabledCaps(hmd, ovrHmdCap_LowPersistence | ovrHmdCap_DynamicPrediction);
+
+	if (g_Benchmark.Settings.Headless || g_Benchmark.Settings.ClientDistortion)
+	{
+		// There is no back buffer for LibOVR to distort into (or we distort ourselves), just ask it for the eye descriptions...
+		g_EyeRenderDesc[ovrEye_Left] = ovrHmd_GetRenderDesc(hmd, ovrEye_Left, hmd->MaxEyeFov[ovrEye_Left]);
+		g_EyeRenderDesc[ovrEye_Right] = ovrHmd_GetRenderDesc(hmd, ovrEye_Right, hmd->MaxEyeFov[ovrEye_Right]);
+	}
+	else
+	{
+		// Actually configure Oculus LibOVR rendering using the configurations we set up above (and stored in g_Cfg.OGL):
+		ovrBool l_ConfigureResult = ovrHmd_ConfigureRendering(hmd, &g_Cfg.Config, g_DistortionCaps, hmd->MaxEyeFov, g_EyeRenderDesc);
+		glUseProgram(0); // Avoid OpenGL state leak in ovrHmd_ConfigureRendering...
+		if (!l_ConfigureResult)
+		{
+			printf("Configure failed.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+
+	// Projection matrici for each eye will not change at runtime, we can set them here (reverse-Z
+	// swaps LibOVR's depth mapping for its own)...
+	g_ZFar = g_Benchmark.Settings.FarPlane;
+	for (int l_Eye = 0; l_Eye < ovrEye_Count; l_Eye++)
+	{
+		g_ProjectionMatrici[l_Eye] = ovrMatrix4f_Projection(g_EyeRenderDesc[l_Eye].Fov, g_ZNear, g_ZFar, true);
+		if (g_EyeRenderTargets.ReverseZ)
+			SetEyeProjectionDepth(g_ProjectionMatrici[l_Eye], g_ZNear, g_ZFar);
+	}
+
+	// IPD offset values will not change at runtime, we can set them here...
+	g_EyeOffsets[ovrEye_Left] = g_EyeRenderDesc[ovrEye_Left].HmdToEyeViewOffset;
+	g_EyeOffsets[ovrEye_Right] = g_EyeRenderDesc[ovrEye_Right].HmdToEyeViewOffset;
+
+	// The parts of the eye viewports the lenses never show, for the FOVs we render with...
+	const ovrFovPort l_EyeFov[2] = { g_EyeRenderDesc[ovrEye_Left].Fov, g_EyeRenderDesc[ovrEye_Right].Fov };
+	InitializeHiddenArea(hmd, l_EyeFov, g_DistortionCaps, g_Benchmark.Settings.HiddenArea);
+	// Distortion drawn by us, from meshes cached on disk (offscreen without a window)...
+	if (g_Benchmark.Settings.ClientDistortion)
+	{
+		InitializeClientDistortion(hmd, l_EyeFov, g_DistortionCaps, g_Benchmark.Settings.DistortionCachePath.c_str(), g_Benchmark.Settings.Headless);
+	}
+	// Full pixel density only in the middle of the eyes, if asked for...
+	InitializeMultiResolution(g_RenderTargetSize, l_EyeFov, g_Benchmark.Settings.MultiResCenter, g_Benchmark.Settings.MultiResDensity, g_Benchmark.Settings.MultiResolution);
+	// Far geometry only rendered for one eye, if asked for...
+	InitializeStereoReprojection(g_RenderTargetSize, g_Benchmark.Settings.ReprojectionSplit, g_Benchmark.Settings.StereoReprojection);
+	// Culling against the previous frame's depth, if asked for (needs GPU culling)...
+	InitializeSceneOcclusion(g_RenderTargetSize, g_Benchmark.Settings.Occlusion);
+	g_Benchmark.Settings.Occlusion = g_SceneOcclusion.Enabled;
+
+	// Initial camera position...
+	g_CameraPosition.x = 0.0f;
+	g_CameraPosition.y = 0.0f;
+	g_CameraPosition.z = -2.0f;
+
+
+	// Start the sensor which provides the Rift's pose and motion.
+	ovrBool l_TrackingResult = ovrHmd_ConfigureTracking(hmd, ovrTrackingCap_Orientation |
+		ovrTrackingCap_MagYawCorrection |
+		ovrTrackingCap_Position, 0);
+	if (!l_TrackingResult)
+	{
+		printf("Could not start tracking...");
+		exit(EXIT_FAILURE);
+	}
+
+	// Sample the head pose at the sensor rate on its own thread, the frame loop only reads the ring buffer...
+	if (!StartPoseSampler(hmd))
+	{
+		exit(EXIT_FAILURE);
+	}
+
+	// Setup GLFW Callbacks:
+	if (l_Window)
+	{
+		glfwSetWindowSizeCallback(l_Window, WindowSizeCallback);
+		//glfwSetMouseButtonCallback(l_Window, mouseDown);
+		//glfwSetCursorPosCallback(l_Window, mouseMove);
+		//glfwSetScrollCallback(l_Window, mouseWheel);
+		glfwSetKeyCallback(l_Window, keyboard);
+	}
+
+
+	// Do a single recenter to calibrate orientation to current state of the Rift...
+	ovrHmd_RecenterPose(hmd);
+
+
+	//=====================
+	// Head tracking:
+	float yaw;
+	float eyePitch;
+	float eyeRoll;
+
+	// Begin draw loop:
+	unsigned int l_FrameIndex = 0;
+	unsigned int l_CubeStage = 0;
+	const double l_StartTime = ovr_GetTimeInSeconds();
+	while (KeepRendering()) {
+
+		if (g_Benchmark.Settings.Enabled)
+		{
+			// Next stage of a --cubes sweep...
+			if (g_Benchmark.Stage != l_CubeStage)
+			{
+				l_CubeStage = g_Benchmark.Stage;
+				SpawnCubes(g_Benchmark.Settings.CubeCounts[l_CubeStage]);
+			}
+			BenchmarkBeginFrame();
+		}
+
+		// Collect last frames' GPU timings, then time the whole frame...
+		ProfilerBeginFrame(l_FrameIndex);
+		ProfileZone l_FrameZone("Frame");
+
+		// Begin the frame (without a window, or with our own distortion, LibOVR only keeps track of the frame timing for us)...
+		ovrFrameTiming l_FrameTiming;
+		{
+			ProfileZone l_Zone("BeginFrame");
+			if (g_Benchmark.Settings.Headless || g_ClientDistortion.Enabled)
+			{
+				l_FrameTiming = ovrHmd_BeginFrameTiming(hmd, l_FrameIndex);
+			}
+			else
+			{
+				l_FrameTiming = ovrHmd_BeginFrame(hmd, l_FrameIndex);
+			}
+		}
+
+		// Shader files edited since the last frame get rebuilt in the background, the old programs draw meanwhile...
+		if (UpdateShaderSources())
+		{
+			ReloadSceneShaders();
+			ReloadProgram();
+		}
+
+		// Pick up the shader programs the driver finished compiling in the meantime...
+		if (g_ShaderCache.Pending > 0)
+		{
+			ProfileZone l_Zone("PollShaders", -1, false);
+			if (PollCachedPrograms() == 0)
+				PrintShaderCacheStats();
+			ProfilerCounter("ShadersPending", (double)g_ShaderCache.Pending);
+		}
+
+		// Get eye poses for both the left and the right eye. g_EyePoses contains all Rift information: orientation, positional tracking and
+		// the IPD in the form of the input variable g_EyeOffsets.
+		// Pick this frame's eye viewport size from the latest measured eye rendering GPU time...
+		{
+			unsigned int l_GpuFrame = 0;
+			const double l_GpuMs = ProfilerLastGpuMs("RenderEyeBuffers", l_GpuFrame);
+			SetEyeViewportScale(UpdateDynamicResolution(l_GpuMs, l_GpuFrame, l_FrameIndex));
+		}
+
+		const double l_PoseTime = ovr_GetTimeInSeconds();
+		{
+			ProfileZone l_Zone("GetEyePoses", -1, false);
+			ovrHmd_GetEyePoses(hmd, l_FrameIndex, g_EyeOffsets, g_EyePoses, NULL);
+		}
+
+		// Both eyes' view/projection matrices go to the GPU once per frame...
+		{
+			ProfileZone l_Zone("UpdateEyeUniforms");
+			UpdateEyeViews(l_FrameIndex, l_PoseTime);
+		}
+
+		// Next eye render target, both eyes hand its texture to LibOVR...
+		const EyeRenderTarget& l_EyeTarget = AcquireEyeRenderTarget();
+		((ovrGLTexture&)(g_EyeTextures[ovrEye_Left])).OGL.TexId = l_EyeTarget.ColorTexture;
+		((ovrGLTexture&)(g_EyeTextures[ovrEye_Right])).OGL.TexId = l_EyeTarget.ColorTexture;
+
+		{
+			ProfileZone l_Zone("RenderEyeBuffers");
+			RenderEyeBuffers(l_EyeTarget, l_FrameIndex, ovr_GetTimeInSeconds() - l_StartTime);
+		}
+
+		// Newest tracking state from the sampler thread (never blocks)...
+		{
+			ProfileZone l_Zone("GetTrackingState", -1, false);
+			PoseSample l_Sample;
+			if (GetLatestPose(l_Sample) && (l_Sample.StatusFlags & (ovrStatus_OrientationTracked | ovrStatus_PositionTracked)))
+			{
+				ProfilerCounter("PoseAgeMs", (ovr_GetTimeInSeconds() - l_Sample.HeadPose.TimeInSeconds) * 1000.0);
+
+				ovrPosef pose = l_Sample.HeadPose.ThePose;
+				//printf("Pos: %f, %f, %f\t", pose.Position.x, pose.Position.y, pose.Position.z);
+
+				ovrQuatf ori = pose.Orientation;
+				Quatf OculusRiftOrientation = ori;
+				OculusRiftOrientation.GetEulerAngles<OVR::Axis_X, OVR::Axis_Y, OVR::Axis_Z>(&yaw, &eyePitch, &eyeRoll);
+				//printf("Ori: %f, %f, %f\n", yaw, eyePitch, eyeRoll);
+			}
+			else {
+				//printf("No tracking yet...\n");
+			}
+		}
+
+		// Back to the default framebuffer...
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		// How old the poses of an earlier frame were when the GPU picked them up...
+		unsigned int l_PoseFrame = 0;
+		double l_PoseToGpuMs = 0.0;
+		if (ResolvePoseToGpuLatency(l_PoseFrame, l_PoseToGpuMs))
+		{
+			ProfilerCounter("PoseToGpuMs", l_PoseToGpuMs);
+			if (g_Benchmark.Settings.Enabled)
+			{
+				BenchmarkPoseToGpu(l_PoseFrame, l_PoseToGpuMs);
+			}
+		}
+
+		if (g_Benchmark.Settings.Enabled)
+		{
+			BenchmarkSubmitDone();
+		}
+
+		{
+			ProfileZone l_Zone("EndFrame");
+			if (g_ClientDistortion.Enabled)
+			{
+				// Timewarp as close to scanout as LibOVR thinks is safe, like its own EndFrame does...
+				if (l_Window && (g_DistortionCaps & ovrDistortionCap_TimeWarp))
+				{
+					ProfileZone l_WaitZone("WaitForTimewarp", -1, false);
+					ovr_WaitTillTime(l_FrameTiming.TimewarpPointSeconds);
+				}
+				RenderClientDistortion(hmd, g_EyeTextures, g_EyePoses, l_ClientSize);
+				if (l_Window)
+				{
+					glfwSwapBuffers(l_Window);
+				}
+				else
+				{
+					glFinish();
+				}
+				ovrHmd_EndFrameTiming(hmd);
+			}
+			else if (g_Benchmark.Settings.Headless)
+			{
+				// Nothing gets presented, wait for the GPU so the frame time includes the rendering itself...
+				glFinish();
+				ovrHmd_EndFrameTiming(hmd);
+			}
+			else
+			{
+				// Do everything, distortion, front/back buffer swap...
+				ovrHmd_EndFrame(hmd, g_EyePoses, g_EyeTextures);
+
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // Avoid OpenGL state leak in ovrHmd_EndFrame...
+				glBindBuffer(GL_ARRAY_BUFFER, 0); // Avoid OpenGL state leak in ovrHmd_EndFrame...
+			}
+		}
+
+		// This frame's eye uniforms and render target can be reused once the GPU gets past here...
+		FenceEyeUniforms();
+		ReleaseEyeRenderTarget();
+
+		++l_FrameIndex;
+
+		if (l_Window)
+		{
+			ProfileZone l_Zone("PollEvents", -1, false);
+			glfwPollEvents();
+		}
+
+		if (g_Benchmark.Settings.Enabled)
+		{
+			BenchmarkEndFrame(g_EyeRenderTargets.Samples, (unsigned int)g_SceneObjects.size(),
+				g_SceneGpuCulling ? g_SceneCullingStats.Visible : 0, g_SceneGpuCulling ? g_SceneCullingStats.Occluded : 0);
+
+			// The eye GPU time comes back a couple of frames late, it goes to the frame it was measured in...
+			unsigned int l_GpuFrame = 0;
+			const double l_EyeGpuMs = ProfilerLastGpuMs("RenderEyeBuffers", l_GpuFrame);
+			if (l_EyeGpuMs >= 0.0)
+			{
+				BenchmarkEyeGpu(l_GpuFrame, l_EyeGpuMs);
+			}
+		}
+
+	}// End head tracking.
+
+	bool l_ReportWritten = true;
+	if (g_Benchmark.Settings.Enabled)
+	{
+		l_ReportWritten = WriteBenchmarkReport(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+	}
+	if (!g_Benchmark.Settings.TracePath.empty())
+	{
+		l_ReportWritten = WriteChromeTrace(g_Benchmark.Settings.TracePath.c_str()) && l_ReportWritten;
+	}
+	ShutdownProfiler();
+
+
+	StopShaderWatcher();
+	DestroySceneOcclusion();
+	DestroySceneRenderer();
+	DestroySceneShadows();
+	DestroyHiddenArea();
+	DestroyClientDistortion();
+	DestroyMultiResolution();
+	DestroyStereoReprojection();
+	ShutdownShaderCache();
+	ClearScene();
+	DestroyMeshes();
+
+	DestroyEyeRenderTargets();
+
+	StopPoseSampler();
+	ovrHmd_Destroy(hmd);
+	ovr_Shutdown();
+
+	// Clean up window (or the offscreen context)...
+	if (l_Window)
+	{
+		glfwDestroyWindow(l_Window);
+		glfwTerminate();
+	}
+	else
+	{
+		DestroyHeadlessContext();
+	}
+
+	exit(l_ReportWritten ? EXIT_SUCCESS : EXIT_FAILURE);
+
 }
\ No newline at end of file